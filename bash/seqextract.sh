@@ -0,0 +1,70 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Splits a sequence container (<name>-<fs>.seq, see main/seqfile.h) copied
+# off the SD card back into one file per frame, named
+# <frame number>-<capture time in ms>.<jpg|raw>, checking each frame's CRC
+# on the way if python3 is around.
+
+IN="${1:?usage: $0 <file.seq> [outdir]}"
+OUT="${2:-${IN%.seq}}"
+
+u32() { od -An -t u4 -j "$2" -N 4 "$1" | tr -d ' '; }
+u64() { od -An -t u8 -j "$2" -N 8 "$1" | tr -d ' '; }
+s64() { od -An -t d8 -j "$2" -N 8 "$1" | tr -d ' '; }
+magic() { dd if="$1" bs=1 skip="$2" count=4 2>/dev/null; }
+
+SIZE=$(stat -c %s "$IN")
+
+if [ "$(magic "$IN" 0)" != "CWSQ" ]; then
+  echo "$IN: not a sequence file" >&2
+  exit 1
+fi
+
+FOOTER=$((SIZE - 16))
+
+if [ "$(magic "$IN" "$FOOTER")" != "CWIX" ]; then
+  echo "$IN: no index; the capture did not finish" >&2
+  exit 1
+fi
+
+# header: pixformat 4 is jpeg, everything else is raw sensor data
+
+PIXFORMAT=$(u32 "$IN" 12)
+EXT=$([ "$PIXFORMAT" -eq 4 ] && echo jpg || echo raw)
+
+COUNT=$(u32 "$IN" $((FOOTER + 4)))
+INDEX=$(u64 "$IN" $((FOOTER + 8)))
+
+CRC=$(command -v python3 || true)
+BAD=0
+
+mkdir -p "$OUT"
+
+# each 32-byte index entry: offset, tstamp (us), len, number, crc, seq; the
+# frame data follows the 32-byte record header at offset
+
+for ((i = 0; i < COUNT; i++)); do
+  ENTRY=$((INDEX + i * 32))
+  OFFSET=$(u64 "$IN" "$ENTRY")
+  TSTAMP=$(s64 "$IN" $((ENTRY + 8)))
+  LEN=$(u32 "$IN" $((ENTRY + 16)))
+  NUMBER=$(u32 "$IN" $((ENTRY + 20)))
+  SUM=$(u32 "$IN" $((ENTRY + 24)))
+
+  NAME=$(printf '%s/%06d-%d.%s' "$OUT" "$NUMBER" $((TSTAMP / 1000)) "$EXT")
+
+  # not tail | head: head leaves as soon as it has LEN bytes, and tail
+  # dying of SIGPIPE then fails the whole script under pipefail
+
+  dd if="$IN" of="$NAME" bs=64K iflag=skip_bytes,count_bytes skip=$((OFFSET + 32)) count="$LEN" status=none
+
+  if [ -n "$CRC" ] && [ "$("$CRC" -c 'import sys, zlib; print(zlib.crc32(open(sys.argv[1], "rb").read()))' "$NAME")" != "$SUM" ]; then
+    echo "$NAME: CRC mismatch" >&2
+    BAD=$((BAD + 1))
+  fi
+done
+
+echo "$COUNT frames extracted to $OUT${CRC:+, $BAD bad}"
+
+[ "$BAD" -eq 0 ]
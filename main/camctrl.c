@@ -0,0 +1,142 @@
+// 2026-10-16 camctrl.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "camctrl.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// most controls map straight onto a sensor setter and its status field;
+// this generates the accessors for those
+
+#define _CAMWEBSRV_CAMCTRL_SENSOR(NAME, SETTER, FIELD) \
+  static int _camwebsrv_camctrl_set_##NAME(sensor_t *sensor, int value) \
+  { \
+    return sensor->SETTER(sensor, value); \
+  } \
+  static int _camwebsrv_camctrl_get_##NAME(const sensor_t *sensor) \
+  { \
+    return sensor->FIELD; \
+  }
+
+_CAMWEBSRV_CAMCTRL_SENSOR(ae_level, set_ae_level, status.ae_level)
+_CAMWEBSRV_CAMCTRL_SENSOR(aec, set_exposure_ctrl, status.aec)
+_CAMWEBSRV_CAMCTRL_SENSOR(aec2, set_aec2, status.aec2)
+_CAMWEBSRV_CAMCTRL_SENSOR(aec_value, set_aec_value, status.aec_value)
+_CAMWEBSRV_CAMCTRL_SENSOR(agc, set_gain_ctrl, status.agc)
+_CAMWEBSRV_CAMCTRL_SENSOR(agc_gain, set_agc_gain, status.agc_gain)
+_CAMWEBSRV_CAMCTRL_SENSOR(awb, set_whitebal, status.awb)
+_CAMWEBSRV_CAMCTRL_SENSOR(awb_gain, set_awb_gain, status.awb_gain)
+_CAMWEBSRV_CAMCTRL_SENSOR(bpc, set_bpc, status.bpc)
+_CAMWEBSRV_CAMCTRL_SENSOR(brightness, set_brightness, status.brightness)
+_CAMWEBSRV_CAMCTRL_SENSOR(colorbar, set_colorbar, status.colorbar)
+_CAMWEBSRV_CAMCTRL_SENSOR(contrast, set_contrast, status.contrast)
+_CAMWEBSRV_CAMCTRL_SENSOR(dcw, set_dcw, status.dcw)
+_CAMWEBSRV_CAMCTRL_SENSOR(gainceiling, set_gainceiling, status.gainceiling)
+_CAMWEBSRV_CAMCTRL_SENSOR(hmirror, set_hmirror, status.hmirror)
+_CAMWEBSRV_CAMCTRL_SENSOR(lenc, set_lenc, status.lenc)
+_CAMWEBSRV_CAMCTRL_SENSOR(quality, set_quality, status.quality)
+_CAMWEBSRV_CAMCTRL_SENSOR(raw_gma, set_raw_gma, status.raw_gma)
+_CAMWEBSRV_CAMCTRL_SENSOR(saturation, set_saturation, status.saturation)
+_CAMWEBSRV_CAMCTRL_SENSOR(sharpness, set_sharpness, status.sharpness)
+_CAMWEBSRV_CAMCTRL_SENSOR(special_effect, set_special_effect, status.special_effect)
+_CAMWEBSRV_CAMCTRL_SENSOR(vflip, set_vflip, status.vflip)
+_CAMWEBSRV_CAMCTRL_SENSOR(wb_mode, set_wb_mode, status.wb_mode)
+_CAMWEBSRV_CAMCTRL_SENSOR(wpc, set_wpc, status.wpc)
+
+// indexed by camwebsrv_camera_ctrl_t, and so also sorted by name; ranges are
+// wide enough for both the ov2640 and the ov3660, and the sensor drivers
+// clamp anything beyond what they support; no wider than the status field
+// the value is read back from, though, or it would not read back the same
+
+#define _CAMWEBSRV_CAMCTRL(NAME, MIN, MAX) { #NAME, _camwebsrv_camctrl_set_##NAME, _camwebsrv_camctrl_get_##NAME, MIN, MAX }
+#define _CAMWEBSRV_CAMCTRL_OWN(NAME, MIN, MAX) { #NAME, NULL, NULL, MIN, MAX }
+
+static const camwebsrv_camctrl_desc_t _camwebsrv_camctrls[CAMWEBSRV_CAMERA_CTRL_MAX] =
+{
+  _CAMWEBSRV_CAMCTRL(ae_level, -5, 5),
+  _CAMWEBSRV_CAMCTRL(aec, 0, 1),
+  _CAMWEBSRV_CAMCTRL(aec2, 0, 1),
+  _CAMWEBSRV_CAMCTRL(aec_value, 0, 1536),
+  _CAMWEBSRV_CAMCTRL(agc, 0, 1),
+  _CAMWEBSRV_CAMCTRL(agc_gain, 0, 64),
+  _CAMWEBSRV_CAMCTRL(awb, 0, 1),
+  _CAMWEBSRV_CAMCTRL(awb_gain, 0, 1),
+  _CAMWEBSRV_CAMCTRL(bpc, 0, 1),
+  _CAMWEBSRV_CAMCTRL(brightness, -3, 3),
+  _CAMWEBSRV_CAMCTRL(colorbar, 0, 1),
+  _CAMWEBSRV_CAMCTRL(contrast, -3, 3),
+  _CAMWEBSRV_CAMCTRL(dcw, 0, 1),
+  _CAMWEBSRV_CAMCTRL_OWN(flash, 0, 1),
+  _CAMWEBSRV_CAMCTRL_OWN(fps, CAMWEBSRV_CAMERA_FPS_MIN, CAMWEBSRV_CAMERA_FPS_MAX),
+  _CAMWEBSRV_CAMCTRL_OWN(framesize, 0, FRAMESIZE_INVALID - 1),
+  _CAMWEBSRV_CAMCTRL(gainceiling, 0, 255),
+  _CAMWEBSRV_CAMCTRL(hmirror, 0, 1),
+  _CAMWEBSRV_CAMCTRL(lenc, 0, 1),
+  _CAMWEBSRV_CAMCTRL_OWN(motion, 0, 1000),
+  _CAMWEBSRV_CAMCTRL_OWN(pixformat, 0, PIXFORMAT_RAW8),
+  _CAMWEBSRV_CAMCTRL(quality, 0, 63),
+  _CAMWEBSRV_CAMCTRL(raw_gma, 0, 1),
+  _CAMWEBSRV_CAMCTRL(saturation, -4, 4),
+  _CAMWEBSRV_CAMCTRL(sharpness, -3, 3),
+  _CAMWEBSRV_CAMCTRL(special_effect, 0, 6),
+  _CAMWEBSRV_CAMCTRL(vflip, 0, 1),
+  _CAMWEBSRV_CAMCTRL(wb_mode, 0, 4),
+  _CAMWEBSRV_CAMCTRL(wpc, 0, 1)
+};
+
+const camwebsrv_camctrl_desc_t *camwebsrv_camctrl_desc(camwebsrv_camera_ctrl_t ctrl)
+{
+  if (ctrl >= CAMWEBSRV_CAMERA_CTRL_MAX)
+  {
+    return NULL;
+  }
+
+  return &(_camwebsrv_camctrls[ctrl]);
+}
+
+camwebsrv_camera_ctrl_t camwebsrv_camera_ctrl_find(const char *name)
+{
+  int lo = 0;
+  int hi = CAMWEBSRV_CAMERA_CTRL_MAX - 1;
+
+  if (name == NULL)
+  {
+    return CAMWEBSRV_CAMERA_CTRL_MAX;
+  }
+
+  // the table is sorted by name
+
+  while(lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    int cmp = strcmp(name, _camwebsrv_camctrls[mid].name);
+
+    if (cmp == 0)
+    {
+      return (camwebsrv_camera_ctrl_t) mid;
+    }
+
+    if (cmp < 0)
+    {
+      hi = mid - 1;
+    }
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+
+  return CAMWEBSRV_CAMERA_CTRL_MAX;
+}
+
+const char *camwebsrv_camera_ctrl_name(camwebsrv_camera_ctrl_t ctrl)
+{
+  if (ctrl >= CAMWEBSRV_CAMERA_CTRL_MAX)
+  {
+    return NULL;
+  }
+
+  return _camwebsrv_camctrls[ctrl].name;
+}
@@ -0,0 +1,33 @@
+// 2026-10-16 camctrl.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_CAMCTRL_H
+#define _CAMWEBSRV_CAMCTRL_H
+
+#include <stdint.h>
+
+#include <sensor.h>
+
+#include "camera.h"
+
+// What there is to know about each camera control: its name and valid
+// range, and, for those that map straight onto the sensor, the setter and
+// the status field the driver leaves the value in. The ones the camera
+// keeps for itself (flash, fps, framesize, motion and pixformat) have no
+// accessors here; camera.c has its own for those. Needs nothing but the
+// sensor driver's header, so it can be checked on the host.
+//
+// desc() returns NULL for anything that isn't a control.
+
+typedef struct
+{
+  const char *name;
+  int (*set)(sensor_t *sensor, int value);
+  int (*get)(const sensor_t *sensor);
+  int16_t min;
+  int16_t max;
+} camwebsrv_camctrl_desc_t;
+
+const camwebsrv_camctrl_desc_t *camwebsrv_camctrl_desc(camwebsrv_camera_ctrl_t ctrl);
+
+#endif
@@ -4,6 +4,10 @@
 
 #include "config.h"
 #include "camera.h"
+#include "camctrl.h"
+#include "warmup.h"
+#include "motion.h"
+#include "replay.h"
 
 #include <stdlib.h>
 #include <stddef.h>
@@ -12,30 +16,184 @@
 #include <stdbool.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_camera.h>
 #include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <img_converters.h>
+#include <jpeg_decoder.h>
 
 #include <driver/gpio.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+
+#define _CAMWEBSRV_CAMERA_EVENT_FRAME BIT0
+#define _CAMWEBSRV_CAMERA_EVENT_RELEASED BIT1
+
+// ov2640_sensor_mode_t is private to the driver; set_res_raw() takes the
+// mode through its startX
+
+#define _CAMWEBSRV_CAMERA_OV2640_MODE_UXGA 0
 
 typedef struct
 {
+  camwebsrv_camera_frame_t frame;
   camera_fb_t *fb;
+  uint8_t *jpg;
+  const camwebsrv_camera_frame_t *src;
+  uint8_t scale;
+  uint8_t quality;
+  uint16_t refs;
+} _camwebsrv_camera_frame_t;
+
+// where frames come from: the sensor, through the esp32-camera driver, or a
+// directory of recorded frames standing in for it
+
+typedef struct
+{
+  const char *name;
+  bool sensor;
+  esp_err_t (*start)(void **ctx, const camera_config_t *config);
+  esp_err_t (*stop)(void **ctx);
+  camera_fb_t *(*grab)(void *ctx);
+  void (*dispose)(void *ctx, camera_fb_t *fb);
+} _camwebsrv_camera_source_t;
+
+typedef struct
+{
+  _camwebsrv_camera_frame_t frames[CAMWEBSRV_CAMERA_FB_COUNT];
+  _camwebsrv_camera_frame_t *current;
+  _camwebsrv_camera_frame_t variants[CAMWEBSRV_CAMERA_VARIANT_COUNT];
+  _camwebsrv_camera_frame_t history[CAMWEBSRV_CAMERA_HISTORY_COUNT];
+  uint8_t hfirst;
+  uint8_t hcount;
+  size_t hbytes;
   bool flash;
   bool ov3660;
   int64_t tstamp;
+  int64_t tafter;
+  uint32_t seq;
+  camwebsrv_camera_stats_t stats;
   uint8_t fps;
+  pixformat_t pixformat;
+  framesize_t fbsize;
+  camwebsrv_camera_roi_t roi;
+  volatile uint32_t version;
+  volatile bool draining;
+  int pending[CAMWEBSRV_CAMERA_CTRL_MAX];
+  volatile uint32_t pmask;
+  int64_t tflush;
+  uint16_t motion;
+  uint16_t mscore;
+  int64_t tmotion;
+  camwebsrv_motion_t md;
+  uint8_t *mbuf;
+  size_t mlen;
+  const _camwebsrv_camera_source_t *source;
+  void *sctx;
+  portMUX_TYPE spinlock;
   SemaphoreHandle_t mutex1;
   SemaphoreHandle_t mutex2;
+  SemaphoreHandle_t mutex3;
+  EventGroupHandle_t events;
+  TaskHandle_t task;
+  SemaphoreHandle_t tdone;
+  volatile bool trun;
+  TaskHandle_t vtask;
+  SemaphoreHandle_t vdone;
+  volatile bool vrun;
 } _camwebsrv_camera_t;
 
+typedef struct
+{
+  int (*set)(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value);
+  int (*get)(_camwebsrv_camera_t *pcam, sensor_t *sensor);
+} _camwebsrv_camera_ctrl_own_t;
+
+static int _camwebsrv_camera_ctrl_set_flash(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value);
+static int _camwebsrv_camera_ctrl_get_flash(_camwebsrv_camera_t *pcam, sensor_t *sensor);
+static int _camwebsrv_camera_ctrl_set_fps(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value);
+static int _camwebsrv_camera_ctrl_get_fps(_camwebsrv_camera_t *pcam, sensor_t *sensor);
+static int _camwebsrv_camera_ctrl_set_framesize(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value);
+static int _camwebsrv_camera_ctrl_get_framesize(_camwebsrv_camera_t *pcam, sensor_t *sensor);
+static int _camwebsrv_camera_ctrl_set_motion(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value);
+static int _camwebsrv_camera_ctrl_get_motion(_camwebsrv_camera_t *pcam, sensor_t *sensor);
+static int _camwebsrv_camera_ctrl_set_pixformat(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value);
+static int _camwebsrv_camera_ctrl_get_pixformat(_camwebsrv_camera_t *pcam, sensor_t *sensor);
+
+// the controls kept here rather than in the sensor, which camctrl.c has
+// no accessors for; the rest go straight to the sensor through camctrl.c
+
+#define _CAMWEBSRV_CAMERA_CTRL_OWN(NAME, CTRL) [CTRL] = { _camwebsrv_camera_ctrl_set_##NAME, _camwebsrv_camera_ctrl_get_##NAME }
+
+static const _camwebsrv_camera_ctrl_own_t _camwebsrv_camera_ctrls_own[CAMWEBSRV_CAMERA_CTRL_MAX] =
+{
+  _CAMWEBSRV_CAMERA_CTRL_OWN(flash, CAMWEBSRV_CAMERA_CTRL_FLASH),
+  _CAMWEBSRV_CAMERA_CTRL_OWN(fps, CAMWEBSRV_CAMERA_CTRL_FPS),
+  _CAMWEBSRV_CAMERA_CTRL_OWN(framesize, CAMWEBSRV_CAMERA_CTRL_FRAMESIZE),
+  _CAMWEBSRV_CAMERA_CTRL_OWN(motion, CAMWEBSRV_CAMERA_CTRL_MOTION),
+  _CAMWEBSRV_CAMERA_CTRL_OWN(pixformat, CAMWEBSRV_CAMERA_CTRL_PIXFORMAT)
+};
+
+static esp_err_t _camwebsrv_camera_source_sensor_start(void **ctx, const camera_config_t *config);
+static esp_err_t _camwebsrv_camera_source_sensor_stop(void **ctx);
+static camera_fb_t *_camwebsrv_camera_source_sensor_grab(void *ctx);
+static void _camwebsrv_camera_source_sensor_dispose(void *ctx, camera_fb_t *fb);
+static esp_err_t _camwebsrv_camera_source_replay_start(void **ctx, const camera_config_t *config);
+static esp_err_t _camwebsrv_camera_source_replay_stop(void **ctx);
+static camera_fb_t *_camwebsrv_camera_source_replay_grab(void *ctx);
+static void _camwebsrv_camera_source_replay_dispose(void *ctx, camera_fb_t *fb);
+
+static const _camwebsrv_camera_source_t _camwebsrv_camera_source_sensor =
+{
+  "sensor",
+  true,
+  _camwebsrv_camera_source_sensor_start,
+  _camwebsrv_camera_source_sensor_stop,
+  _camwebsrv_camera_source_sensor_grab,
+  _camwebsrv_camera_source_sensor_dispose
+};
+
+static const _camwebsrv_camera_source_t _camwebsrv_camera_source_replay =
+{
+  "replay",
+  false,
+  _camwebsrv_camera_source_replay_start,
+  _camwebsrv_camera_source_replay_stop,
+  _camwebsrv_camera_source_replay_grab,
+  _camwebsrv_camera_source_replay_dispose
+};
+
 static esp_err_t _camwebsrv_camera_init(_camwebsrv_camera_t *pcam);
+static esp_err_t _camwebsrv_camera_sensor_setup(_camwebsrv_camera_t *pcam);
+static esp_err_t _camwebsrv_camera_restart(_camwebsrv_camera_t *pcam);
+static void _camwebsrv_camera_config(_camwebsrv_camera_t *pcam, camera_config_t *config);
+static esp_err_t _camwebsrv_camera_mode_set(_camwebsrv_camera_t *pcam, pixformat_t pixformat, framesize_t framesize);
+static esp_err_t _camwebsrv_camera_roi_apply(_camwebsrv_camera_t *pcam, sensor_t *sensor, const camwebsrv_camera_roi_t *roi);
+static void _camwebsrv_camera_roi_clear(_camwebsrv_camera_t *pcam);
+static void _camwebsrv_camera_version_bump(_camwebsrv_camera_t *pcam);
+static esp_err_t _camwebsrv_camera_frames_drop(_camwebsrv_camera_t *pcam, TickType_t timeout);
+static esp_err_t _camwebsrv_camera_warmup(_camwebsrv_camera_t *pcam);
+static esp_err_t _camwebsrv_camera_aec_read(_camwebsrv_camera_t *pcam, sensor_t *sensor, uint32_t *exposure, uint32_t *gain);
+static esp_err_t _camwebsrv_camera_frame_refresh(_camwebsrv_camera_t *pcam, bool force, int64_t after);
+static int64_t _camwebsrv_camera_fb_tstamp(const camera_fb_t *fb);
+static _camwebsrv_camera_frame_t *_camwebsrv_camera_frame_current(_camwebsrv_camera_t *pcam);
+static void _camwebsrv_camera_frame_unref(_camwebsrv_camera_t *pcam, _camwebsrv_camera_frame_t *pframe);
+static void _camwebsrv_camera_history_record(_camwebsrv_camera_t *pcam, const _camwebsrv_camera_frame_t *pframe);
+static void _camwebsrv_camera_history_evict(_camwebsrv_camera_t *pcam);
+static void _camwebsrv_camera_motion_detect(_camwebsrv_camera_t *pcam, const _camwebsrv_camera_frame_t *pframe);
+static esp_err_t _camwebsrv_camera_variant_encode(_camwebsrv_camera_frame_t *pvar, const camwebsrv_camera_frame_t *src);
+static void _camwebsrv_camera_variant_task(void *arg);
+static int _camwebsrv_camera_ctrl_write(_camwebsrv_camera_t *pcam, sensor_t *sensor, camwebsrv_camera_ctrl_t ctrl, int value);
+static int _camwebsrv_camera_ctrl_read(_camwebsrv_camera_t *pcam, sensor_t *sensor, camwebsrv_camera_ctrl_t ctrl);
+static void _camwebsrv_camera_ctrl_flush(_camwebsrv_camera_t *pcam);
+static void _camwebsrv_camera_task(void *arg);
 
 esp_err_t camwebsrv_camera_init(camwebsrv_camera_t *cam)
 {
@@ -77,9 +235,66 @@ esp_err_t camwebsrv_camera_init(camwebsrv_camera_t *cam)
     return ESP_FAIL;
   }
 
-  pcam->fb = NULL;
+  pcam->mutex3 = xSemaphoreCreateMutex();
+
+  if (pcam->mutex3 == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_init(): xSemaphoreCreateMutex(3) failed");
+    vSemaphoreDelete(pcam->mutex2);
+    vSemaphoreDelete(pcam->mutex1);
+    free(pcam);
+    return ESP_FAIL;
+  }
+
+  pcam->events = xEventGroupCreate();
+
+  if (pcam->events == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_init(): xEventGroupCreate() failed");
+    vSemaphoreDelete(pcam->mutex3);
+    vSemaphoreDelete(pcam->mutex2);
+    vSemaphoreDelete(pcam->mutex1);
+    free(pcam);
+    return ESP_FAIL;
+  }
+
+  memset(pcam->frames, 0x00, sizeof(pcam->frames));
+  memset(pcam->variants, 0x00, sizeof(pcam->variants));
+  memset(pcam->history, 0x00, sizeof(pcam->history));
+
+  pcam->hfirst = 0;
+  pcam->hcount = 0;
+  pcam->hbytes = 0;
+  pcam->mscore = 0;
+  pcam->tmotion = -1;
+  pcam->mbuf = NULL;
+  pcam->mlen = 0;
+  pcam->current = NULL;
+  pcam->task = NULL;
+  pcam->tdone = NULL;
+  pcam->trun = false;
+  pcam->vtask = NULL;
+  pcam->vdone = NULL;
+  pcam->vrun = false;
   pcam->ov3660 = false;
   pcam->tstamp = -1;
+  pcam->tafter = 0;
+  pcam->seq = 0;
+  pcam->version = 0;
+  pcam->draining = false;
+  pcam->pmask = 0;
+  pcam->tflush = 0;
+  pcam->pixformat = PIXFORMAT_JPEG;
+  pcam->fbsize = FRAMESIZE_UXGA;
+  memset(&(pcam->roi), 0x00, sizeof(pcam->roi));
+  pcam->source = CAMWEBSRV_CAMERA_REPLAY ? &_camwebsrv_camera_source_replay : &_camwebsrv_camera_source_sensor;
+  pcam->sctx = NULL;
+
+  memset(&(pcam->stats), 0x00, sizeof(pcam->stats));
+
+  camwebsrv_motion_init(&(pcam->md));
+
+  portMUX_INITIALIZE(&(pcam->spinlock));
 
   // set flash led gpio
 
@@ -88,6 +303,8 @@ esp_err_t camwebsrv_camera_init(camwebsrv_camera_t *cam)
   if (rv != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_init(): gpio_set_direction() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    vEventGroupDelete(pcam->events);
+    vSemaphoreDelete(pcam->mutex3);
     vSemaphoreDelete(pcam->mutex2);
     vSemaphoreDelete(pcam->mutex1);
     free(pcam);
@@ -101,12 +318,49 @@ esp_err_t camwebsrv_camera_init(camwebsrv_camera_t *cam)
   if (rv != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_init(): _camwebsrv_camera_init() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    vEventGroupDelete(pcam->events);
+    vSemaphoreDelete(pcam->mutex3);
     vSemaphoreDelete(pcam->mutex2);
     vSemaphoreDelete(pcam->mutex1);
     free(pcam);
     return rv;
   }
 
+  // start capture task, if configured; without it, frames are grabbed on
+  // demand by whoever asks for one
+
+  if (CAMWEBSRV_CAMERA_CAPTURE_TASK)
+  {
+    pcam->tdone = xSemaphoreCreateBinary();
+
+    if (pcam->tdone == NULL)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_init(): xSemaphoreCreateBinary() failed");
+      pcam->source->stop(&(pcam->sctx));
+      vEventGroupDelete(pcam->events);
+      vSemaphoreDelete(pcam->mutex3);
+      vSemaphoreDelete(pcam->mutex2);
+      vSemaphoreDelete(pcam->mutex1);
+      free(pcam);
+      return ESP_FAIL;
+    }
+
+    pcam->trun = true;
+
+    if (xTaskCreatePinnedToCore(_camwebsrv_camera_task, "camera", CAMWEBSRV_CAMERA_TASK_STACK, pcam, CAMWEBSRV_CAMERA_TASK_PRIO, &(pcam->task), CAMWEBSRV_CAMERA_TASK_CORE) != pdPASS)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_init(): xTaskCreatePinnedToCore() failed");
+      pcam->source->stop(&(pcam->sctx));
+      vSemaphoreDelete(pcam->tdone);
+      vEventGroupDelete(pcam->events);
+      vSemaphoreDelete(pcam->mutex3);
+      vSemaphoreDelete(pcam->mutex2);
+      vSemaphoreDelete(pcam->mutex1);
+      free(pcam);
+      return ESP_FAIL;
+    }
+  }
+
   *cam = (camwebsrv_camera_t) pcam;
 
   return ESP_OK;
@@ -115,6 +369,7 @@ esp_err_t camwebsrv_camera_init(camwebsrv_camera_t *cam)
 esp_err_t camwebsrv_camera_destroy(camwebsrv_camera_t *cam)
 {
   _camwebsrv_camera_t *pcam;
+  uint8_t i;
 
   if (cam == NULL)
   {
@@ -128,6 +383,32 @@ esp_err_t camwebsrv_camera_destroy(camwebsrv_camera_t *cam)
     return ESP_OK;
   }
 
+  // stop capture task, and wait for it to finish its current grab
+
+  if (pcam->task != NULL)
+  {
+    pcam->trun = false;
+
+    xTaskNotifyGive(pcam->task);
+    xSemaphoreTake(pcam->tdone, portMAX_DELAY);
+    vSemaphoreDelete(pcam->tdone);
+
+    pcam->task = NULL;
+  }
+
+  // same with the variant encoder, if anyone ever asked for one
+
+  if (pcam->vtask != NULL)
+  {
+    pcam->vrun = false;
+
+    xTaskNotifyGive(pcam->vtask);
+    xSemaphoreTake(pcam->vdone, portMAX_DELAY);
+    vSemaphoreDelete(pcam->vdone);
+
+    pcam->vtask = NULL;
+  }
+
   if (xSemaphoreTake(pcam->mutex1, portMAX_DELAY) != pdTRUE)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_destroy(): xSemaphoreTake(1) failed");
@@ -140,6 +421,42 @@ esp_err_t camwebsrv_camera_destroy(camwebsrv_camera_t *cam)
     return ESP_FAIL;
   }
 
+  if (xSemaphoreTake(pcam->mutex3, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_destroy(): xSemaphoreTake(3) failed");
+    return ESP_FAIL;
+  }
+
+  // drop the cache's own references to any variants, and to the frames of
+  // those that never got encoded
+
+  for (i = 0; i < CAMWEBSRV_CAMERA_VARIANT_COUNT; i++)
+  {
+    if (pcam->variants[i].jpg != NULL)
+    {
+      _camwebsrv_camera_frame_unref(pcam, &(pcam->variants[i]));
+    }
+
+    if (pcam->variants[i].src != NULL)
+    {
+      _camwebsrv_camera_frame_unref(pcam, (_camwebsrv_camera_frame_t *) pcam->variants[i].src);
+      pcam->variants[i].src = NULL;
+      pcam->variants[i].refs = 0;
+    }
+  }
+
+  // and to whatever is in the history ring
+
+  while (pcam->hcount > 0)
+  {
+    _camwebsrv_camera_history_evict(pcam);
+  }
+
+  // and the motion detector's buffers
+
+  camwebsrv_motion_destroy(&(pcam->md));
+  free(pcam->mbuf);
+
   // we have the mutexes, so clear the caller's reference to this object before giving it back
 
   *cam = NULL;
@@ -150,6 +467,11 @@ esp_err_t camwebsrv_camera_destroy(camwebsrv_camera_t *cam)
   xSemaphoreGive(pcam->mutex2);
   vSemaphoreDelete(pcam->mutex2);
 
+  xSemaphoreGive(pcam->mutex3);
+  vSemaphoreDelete(pcam->mutex3);
+
+  vEventGroupDelete(pcam->events);
+
   free(pcam);
 
   return ESP_OK;
@@ -182,27 +504,36 @@ esp_err_t camwebsrv_camera_reset(camwebsrv_camera_t cam)
     return ESP_FAIL;
   }
 
-  // if we're still holding on to a frame, give it back
+  // let go of all frames, waiting a while for everyone else to let go of
+  // theirs; a reader that never does must not keep both locks held, so
+  // give up and leave the camera running as it was
+
+  rv = _camwebsrv_camera_frames_drop(pcam, pdMS_TO_TICKS(CAMWEBSRV_CAMERA_DROP_TMOUT));
 
-  if (pcam->fb != NULL)
+  if (rv != ESP_OK)
   {
-    esp_camera_fb_return(pcam->fb);
-    pcam->fb = NULL;
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_reset(): _camwebsrv_camera_frames_drop() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    xSemaphoreGive(pcam->mutex2);
+    xSemaphoreGive(pcam->mutex1);
+    return rv;
   }
 
   // de-init
 
-  rv = esp_camera_deinit();
+  rv = pcam->source->stop(&(pcam->sctx));
 
   if (rv != ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_reset(): esp_camera_deinit() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_reset(): source.stop() failed: [%d]: %s", rv, esp_err_to_name(rv));
     xSemaphoreGive(pcam->mutex2);
     xSemaphoreGive(pcam->mutex1);
     return ESP_FAIL;
   }
 
-  // re-init
+  // re-init, back in the default mode
+
+  pcam->pixformat = PIXFORMAT_JPEG;
+  pcam->fbsize = FRAMESIZE_UXGA;
 
   rv = _camwebsrv_camera_init(pcam);
 
@@ -214,9 +545,10 @@ esp_err_t camwebsrv_camera_reset(camwebsrv_camera_t cam)
     return ESP_FAIL;
   }
 
-  // reset timestamp
+  // reset timestamp; the sensor is back to its defaults, too
 
   pcam->tstamp = -1;
+  _camwebsrv_camera_version_bump(pcam);
 
   // unnlock
 
@@ -226,418 +558,537 @@ esp_err_t camwebsrv_camera_reset(camwebsrv_camera_t cam)
   return ESP_OK;
 }
 
-esp_err_t camwebsrv_camera_frame_grab(camwebsrv_camera_t cam, uint8_t **fbuf, size_t *flen, int64_t *tstamp)
+esp_err_t camwebsrv_camera_warmup(camwebsrv_camera_t cam)
 {
   _camwebsrv_camera_t *pcam;
-  int64_t now;
+  esp_err_t rv;
 
-  if (cam == NULL || fbuf == NULL || flen == NULL)
+  if (cam == NULL)
   {
     return ESP_ERR_INVALID_ARG;
   }
 
   pcam = (_camwebsrv_camera_t *) cam;
 
-  // lock
+  // get both locks
+
+  if (xSemaphoreTake(pcam->mutex1, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_warmup(): xSemaphoreTake(1) failed");
+    return ESP_FAIL;
+  }
 
   if (xSemaphoreTake(pcam->mutex2, portMAX_DELAY) != pdTRUE)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_frame_grab(): xSemaphoreTake() failed");
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_warmup(): xSemaphoreTake(2) failed");
+    xSemaphoreGive(pcam->mutex1);
     return ESP_FAIL;
   }
 
-  // do we need a new frame?
+  // frame buffers held here would leave the driver short
 
-  now = esp_timer_get_time();
+  rv = _camwebsrv_camera_frames_drop(pcam, pdMS_TO_TICKS(CAMWEBSRV_CAMERA_DROP_TMOUT));
+
+  if (rv == ESP_OK)
+  {
+    rv = _camwebsrv_camera_warmup(pcam);
+  }
+
+  // whatever comes next should be fresh
+
+  pcam->tstamp = -1;
+
+  xSemaphoreGive(pcam->mutex2);
+  xSemaphoreGive(pcam->mutex1);
+
+  return rv;
+}
+
+esp_err_t camwebsrv_camera_frame_acquire(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t **frame)
+{
+  _camwebsrv_camera_t *pcam;
+  _camwebsrv_camera_frame_t *pframe;
+  esp_err_t rv;
 
-  if ((now - pcam->tstamp) >= (1000000 / pcam->fps))
+  if (cam == NULL || frame == NULL)
   {
-    sensor_t *sensor = NULL;
-    uint8_t i;
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  // with the capture task running, the current frame is always fresh, so
+  // all there is to do is to take a reference to it
 
-    // return previous frame
+  if (pcam->task != NULL)
+  {
+    pframe = _camwebsrv_camera_frame_current(pcam);
 
-    if (pcam->fb != NULL)
+    if (pframe != NULL)
     {
-      esp_camera_fb_return(pcam->fb);
+      *frame = &(pframe->frame);
+      return ESP_OK;
+    }
+  }
+
+  // otherwise, or if it has yet to grab its first one, do it ourselves;
+  // but not while the frames are being dropped, as the caller may well be
+  // holding on to one of them
 
-      pcam->fb = NULL;
-      pcam->tstamp = 0;
+  while(xSemaphoreTake(pcam->mutex2, pdMS_TO_TICKS(CAMWEBSRV_MAIN_MIN_CYCLE_MSEC)) != pdTRUE)
+  {
+    if (pcam->draining)
+    {
+      return ESP_ERR_NOT_FOUND;
     }
+  }
+
+  // replace the current frame if it is due
 
-    // get sensor
+  rv = _camwebsrv_camera_frame_refresh(pcam, false, 0);
 
-    sensor = esp_camera_sensor_get();
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_frame_acquire(): _camwebsrv_camera_frame_refresh() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    xSemaphoreGive(pcam->mutex2);
+    return rv;
+  }
+
+  // give out a counted reference to the current frame
+
+  pframe = _camwebsrv_camera_frame_current(pcam);
+
+  xSemaphoreGive(pcam->mutex2);
+
+  *frame = &(pframe->frame);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_frame_next(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t **frame)
+{
+  _camwebsrv_camera_t *pcam;
+  _camwebsrv_camera_frame_t *pframe;
+  TickType_t started;
+  int64_t now;
+  esp_err_t rv;
+
+  if (cam == NULL || frame == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
 
-    if (sensor == NULL)
+  now = esp_timer_get_time();
+
+  // without the capture task, just grab one right now
+
+  if (pcam->task == NULL)
+  {
+    if (xSemaphoreTake(pcam->mutex2, portMAX_DELAY) != pdTRUE)
     {
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM (): camwebsrv_camera_frame_grab(): esp_camera_sensor_get() failed");
-      xSemaphoreGive(pcam->mutex2);
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_frame_next(): xSemaphoreTake() failed");
       return ESP_FAIL;
     }
 
-    // get frame, but skip the first couple of frames if this is the first grab
+    rv = _camwebsrv_camera_frame_refresh(pcam, true, now);
 
-    for (i = 0; i < (pcam->tstamp >= 0 ? 1 : CAMWEBSRV_CAMERA_INITIAL_FRAME_SKIP); i++)
+    if (rv != ESP_OK)
     {
-      if (i > 0)
-      {
-        esp_camera_fb_return(pcam->fb);
-        vTaskDelay((1000 / pcam->fps) / portTICK_PERIOD_MS);
-      }
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_frame_next(): _camwebsrv_camera_frame_refresh() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      xSemaphoreGive(pcam->mutex2);
+      return rv;
+    }
 
-      pcam->fb = esp_camera_fb_get(); 
+    pframe = _camwebsrv_camera_frame_current(pcam);
 
-      if (pcam->fb == NULL)
-      {
-        ESP_LOGE(CAMWEBSRV_TAG, "CAM (): camwebsrv_camera_frame_grab(): esp_camera_fb_get() failed");
-        xSemaphoreGive(pcam->mutex2);
-        return ESP_FAIL;
-      }
-    }
+    xSemaphoreGive(pcam->mutex2);
+
+    *frame = &(pframe->frame);
 
-    pcam->tstamp = now;
+    return ESP_OK;
   }
 
-  // give out reference to the current frame
+  // otherwise, ask the task for one now rather than when it is next due,
+  // and not one exposed any earlier than this; then wait for it to be
+  // published; the wait is bounded by a frame interval, in case it was
+  // published just before we started waiting
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+  pcam->tafter = now > pcam->tafter ? now : pcam->tafter;
+  portEXIT_CRITICAL(&(pcam->spinlock));
 
-  *fbuf = pcam->fb->buf;
-  *flen = pcam->fb->len;
+  started = xTaskGetTickCount();
 
-  if (tstamp != NULL)
+  xTaskNotifyGive(pcam->task);
+
+  while(1)
   {
-    *tstamp = pcam->tstamp;
+    pframe = _camwebsrv_camera_frame_current(pcam);
+
+    if (pframe != NULL)
+    {
+      if (pframe->frame.tstamp >= now)
+      {
+        *frame = &(pframe->frame);
+        return ESP_OK;
+      }
+
+      // the task gave up on getting a fresh one; ask again
+
+      _camwebsrv_camera_frame_unref(pcam, pframe);
+      xTaskNotifyGive(pcam->task);
+    }
+
+    if ((xTaskGetTickCount() - started) > pdMS_TO_TICKS(CAMWEBSRV_CAMERA_NEXT_TMOUT))
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_frame_next(): timed out");
+      return ESP_ERR_TIMEOUT;
+    }
+
+    xEventGroupWaitBits(pcam->events, _CAMWEBSRV_CAMERA_EVENT_FRAME, pdFALSE, pdFALSE, pdMS_TO_TICKS(1000 / pcam->fps));
   }
-  xSemaphoreGive(pcam->mutex2);
-  return ESP_OK;
 }
 
-esp_err_t camwebsrv_camera_frame_dispose(camwebsrv_camera_t cam)
+esp_err_t camwebsrv_camera_frame_retain(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t *frame)
 {
   _camwebsrv_camera_t *pcam;
+  _camwebsrv_camera_frame_t *pframe;
 
-  if (cam == NULL)
+  if (cam == NULL || frame == NULL)
   {
     return ESP_ERR_INVALID_ARG;
   }
 
   pcam = (_camwebsrv_camera_t *) cam;
+  pframe = (_camwebsrv_camera_frame_t *) frame;
+
+  // the caller already holds a reference, so the frame cannot be recycled
+  // underneath us
 
-  // do we hold the lock?
+  portENTER_CRITICAL(&(pcam->spinlock));
+  pframe->refs++;
+  portEXIT_CRITICAL(&(pcam->spinlock));
 
-  if (xSemaphoreGetMutexHolder(pcam->mutex2) != xTaskGetCurrentTaskHandle())
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_frame_release(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t **frame)
+{
+  _camwebsrv_camera_t *pcam;
+
+  if (cam == NULL || frame == NULL)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_frame_dispose(): frame not held");
-    return ESP_FAIL;
+    return ESP_ERR_INVALID_ARG;
   }
 
-  // unlock
+  if (*frame == NULL)
+  {
+    return ESP_OK;
+  }
 
-  xSemaphoreGive(pcam->mutex2);
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  _camwebsrv_camera_frame_unref(pcam, (_camwebsrv_camera_frame_t *) *frame);
+
+  *frame = NULL;
 
   return ESP_OK;
 }
 
-esp_err_t camwebsrv_camera_ctrl_set(camwebsrv_camera_t cam, const char *name, int value)
+esp_err_t camwebsrv_camera_variant_acquire(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t *src, uint8_t scale, uint8_t quality, const camwebsrv_camera_frame_t **frame)
 {
-  sensor_t *sensor = NULL;
   _camwebsrv_camera_t *pcam;
+  _camwebsrv_camera_frame_t *pvar = NULL;
+  _camwebsrv_camera_frame_t *pfound = NULL;
+  _camwebsrv_camera_frame_t *pbest = NULL;
+  _camwebsrv_camera_frame_t *pfree = NULL;
+  _camwebsrv_camera_frame_t *pold = NULL;
+  bool pending = false;
+  uint8_t i;
 
-  if (cam == NULL || name == NULL)
+  if (cam == NULL || src == NULL || frame == NULL || scale > JPEG_IMAGE_SCALE_1_8)
   {
     return ESP_ERR_INVALID_ARG;
   }
 
   pcam = (_camwebsrv_camera_t *) cam;
 
-  // lock
+  // nothing to do if the caller wants the frame as is
 
-  if (xSemaphoreTake(pcam->mutex1, portMAX_DELAY) != pdTRUE)
+  if (scale == 0 && quality == 0)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(): xSemaphoreTake() failed");
-    return ESP_FAIL;
+    *frame = src;
+    return camwebsrv_camera_frame_retain(cam, src);
   }
 
-  // get sensor
-
-  sensor = esp_camera_sensor_get();
+  quality = quality > 0 ? quality : CAMWEBSRV_CAMERA_VARIANT_QUALITY;
 
-  if (sensor == NULL)
+  if (xSemaphoreTake(pcam->mutex3, portMAX_DELAY) != pdTRUE)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): esp_camera_sensor_get() failed", name, value);
-    xSemaphoreGive(pcam->mutex1);
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_variant_acquire(): xSemaphoreTake(3) failed");
     return ESP_FAIL;
   }
 
-  // set stuff
+  // the encoder only starts once someone wants a variant
 
-  if (strcmp(name, "aec") == 0)
+  if (pcam->vtask == NULL)
   {
-    if (sensor->set_exposure_ctrl(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_exposure_ctrl() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
+    pcam->vdone = xSemaphoreCreateBinary();
+
+    if (pcam->vdone == NULL)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_variant_acquire(): xSemaphoreCreateBinary() failed");
+      xSemaphoreGive(pcam->mutex3);
       return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "aec2") == 0)
-  {
-    if (sensor->set_aec2(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_aec2() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
+    }
+
+    pcam->vrun = true;
+
+    if (xTaskCreatePinnedToCore(_camwebsrv_camera_variant_task, "camera_var", CAMWEBSRV_CAMERA_VARIANT_STACK, pcam, CAMWEBSRV_CAMERA_VARIANT_PRIO, &(pcam->vtask), CAMWEBSRV_CAMERA_VARIANT_CORE) != pdPASS)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_variant_acquire(): xTaskCreatePinnedToCore() failed");
+      vSemaphoreDelete(pcam->vdone);
+      pcam->vdone = NULL;
+      pcam->vtask = NULL;
+      xSemaphoreGive(pcam->mutex3);
       return ESP_FAIL;
-    } 
+    }
   }
-  else if (strcmp(name, "aec_value") == 0)
+
+  // is this variant of this frame ready, or on its way? if not, which is
+  // the newest one of an earlier frame that is, and is the encoder already
+  // busy with this size and quality?
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  for (i = 0; i < CAMWEBSRV_CAMERA_VARIANT_COUNT; i++)
   {
-    if (sensor->set_aec_value(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.aec_value() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    _camwebsrv_camera_frame_t *pslot = &(pcam->variants[i]);
+
+    if ((pslot->jpg == NULL && pslot->src == NULL) || pslot->scale != scale || pslot->quality != quality)
+    {
+      continue;
+    }
+
+    if (pslot->frame.seq == src->seq)
+    {
+      pfound = pslot;
+    }
+    else if (pslot->jpg != NULL && pslot->frame.seq < src->seq && (pbest == NULL || pslot->frame.seq > pbest->frame.seq))
+    {
+      pbest = pslot;
+    }
+
+    pending = pending || pslot->src != NULL;
   }
-  else if (strcmp(name, "ae_level") == 0)
+
+  // hand out the exact one if it's ready, or the best we've got
+
+  pbest = (pfound != NULL && pfound->jpg != NULL) ? pfound : pbest;
+
+  if (pbest != NULL)
   {
-    if (sensor->set_ae_level(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.ae_level() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    pbest->refs++;
   }
-  else if (strcmp(name, "agc") == 0)
+
+  // unless it's already on its way, or the encoder is busy with another
+  // frame at this size and quality, have it encoded; in a free slot or,
+  // failing that, the oldest ready one that only the cache is holding on to
+
+  for (i = 0; pfound == NULL && !pending && i < CAMWEBSRV_CAMERA_VARIANT_COUNT; i++)
   {
-    if (sensor->set_gain_ctrl(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_gain_ctrl() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    _camwebsrv_camera_frame_t *pslot = &(pcam->variants[i]);
+
+    if (pslot->jpg == NULL && pslot->src == NULL && pslot->refs == 0)
+    {
+      pfree = pfree != NULL ? pfree : pslot;
+    }
+    else if (pslot->jpg != NULL && pslot->refs == 1 && (pold == NULL || pslot->frame.seq < pold->frame.seq))
+    {
+      pold = pslot;
+    }
   }
-  else if (strcmp(name, "agc_gain") == 0)
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  pvar = pfree != NULL ? pfree : pold;
+
+  if (pvar != NULL)
   {
-    if (sensor->set_agc_gain(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.agc_gain() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "awb") == 0)
-  {
-    if (sensor->set_whitebal(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_whitebal() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "awb_gain") == 0)
-  {
-    if (sensor->set_awb_gain(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.awb_gain() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "bpc") == 0)
-  {
-    if (sensor->set_bpc(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_bpc() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "brightness") == 0)
-  {
-    if (sensor->set_brightness(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_brightness() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    // evict whatever was there
+
+    if (pvar->jpg != NULL)
+    {
+      _camwebsrv_camera_frame_unref(pcam, pvar);
+    }
+
+    // the slot holds on to the frame until the encoder is done with it
+
+    camwebsrv_camera_frame_retain(cam, src);
+
+    portENTER_CRITICAL(&(pcam->spinlock));
+    pvar->scale = scale;
+    pvar->quality = quality;
+    pvar->frame.seq = src->seq;
+    pvar->src = src;
+    pvar->refs = 1;
+    portEXIT_CRITICAL(&(pcam->spinlock));
+
+    xTaskNotifyGive(pcam->vtask);
   }
-  else if (strcmp(name, "colorbar") == 0)
+  else if (pfound == NULL && !pending)
   {
-    if (sensor->set_colorbar(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_colorbal() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    ESP_LOGD(CAMWEBSRV_TAG, "CAM camwebsrv_camera_variant_acquire(): all variant slots busy");
   }
-  else if (strcmp(name, "contrast") == 0)
+
+  xSemaphoreGive(pcam->mutex3);
+
+  if (pbest == NULL)
   {
-    if (sensor->set_contrast(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_contrast() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    return ESP_ERR_NOT_FOUND;
   }
-  else if (strcmp(name, "dcw") == 0)
+
+  *frame = &(pbest->frame);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_history_acquire(camwebsrv_camera_t cam, int64_t tstamp, const camwebsrv_camera_frame_t **frame)
+{
+  _camwebsrv_camera_t *pcam;
+  _camwebsrv_camera_frame_t *pfound = NULL;
+  uint8_t i;
+
+  if (cam == NULL || frame == NULL)
   {
-    if (sensor->set_dcw(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_dcw() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    return ESP_ERR_INVALID_ARG;
   }
-  else if (strcmp(name, "flash") == 0)
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  // walk back from the newest; the ring only changes under the spinlock, so
+  // this never needs to wait on the capture path
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  for (i = pcam->hcount; i > 0 && pfound == NULL; i--)
   {
-    pcam->flash = value != 0;
+    _camwebsrv_camera_frame_t *pslot = &(pcam->history[(pcam->hfirst + i - 1) % CAMWEBSRV_CAMERA_HISTORY_COUNT]);
 
-    if (gpio_set_level(CAMWEBSRV_PIN_FLASH, pcam->flash) != ESP_OK)
+    if (pslot->frame.tstamp <= tstamp)
     {
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): gpio_set_level() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
+      pslot->refs++;
+      pfound = pslot;
     }
   }
-  else if (strcmp(name, "fps") == 0)
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  if (pfound == NULL)
   {
-    pcam->fps = (value < CAMWEBSRV_CAMERA_FPS_MIN ? CAMWEBSRV_CAMERA_FPS_MIN : (value > CAMWEBSRV_CAMERA_FPS_MAX ? CAMWEBSRV_CAMERA_FPS_MAX : value));
+    return ESP_ERR_NOT_FOUND;
   }
-  else if (strcmp(name, "pixformat") == 0)
+
+  *frame = &(pfound->frame);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_history_range(camwebsrv_camera_t cam, int64_t from, int64_t to, const camwebsrv_camera_frame_t **frames, size_t max, size_t *count)
+{
+  _camwebsrv_camera_t *pcam;
+  size_t n = 0;
+  uint8_t i;
+
+  if (cam == NULL || frames == NULL || count == NULL || from > to)
   {
-    if (sensor->set_pixformat(sensor, (pixformat_t) value))
-    {
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_pixformat() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    }
+    return ESP_ERR_INVALID_ARG;
   }
-  else if (strcmp(name, "framesize") == 0)
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  for (i = 0; i < pcam->hcount && n < max; i++)
   {
-    if (sensor->set_framesize(sensor, (framesize_t) value))
+    _camwebsrv_camera_frame_t *pslot = &(pcam->history[(pcam->hfirst + i) % CAMWEBSRV_CAMERA_HISTORY_COUNT]);
+
+    if (pslot->frame.tstamp >= from && pslot->frame.tstamp <= to)
     {
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_framesize() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
+      pslot->refs++;
+      frames[n++] = &(pslot->frame);
     }
   }
-  else if (strcmp(name, "gainceiling") == 0)
-  {
-    if (sensor->set_gainceiling(sensor, (gainceiling_t) value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_gainceiling() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "hmirror") == 0)
-  {
-    if (sensor->set_hmirror(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_hmirror() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "lenc") == 0)
-  {
-    if (sensor->set_lenc(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_lenc() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "quality") == 0)
-  {
-    if (sensor->set_quality(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_quality() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "raw_gma") == 0)
-  {
-    if (sensor->set_raw_gma(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_raw_gma() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "saturation") == 0)
-  {
-    if (sensor->set_saturation(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_saturation() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
-  }
-  else if (strcmp(name, "sharpness") == 0)
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  *count = n;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_motion_get(camwebsrv_camera_t cam, uint16_t *score, int64_t *tmotion)
+{
+  _camwebsrv_camera_t *pcam;
+
+  if (cam == NULL)
   {
-    if (sensor->set_sharpness(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_sharpness() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    return ESP_ERR_INVALID_ARG;
   }
-  else if (strcmp(name, "special_effect") == 0)
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  if (pcam->motion == 0)
   {
-    if (sensor->set_special_effect(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_special_effect() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    return ESP_ERR_INVALID_STATE;
   }
-  else if (strcmp(name, "vflip") == 0)
+
+  // tmotion is two words, so it needs the spinlock to be read in one piece
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  if (score != NULL)
   {
-    if (sensor->set_vflip(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_vflip() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    *score = pcam->mscore;
   }
-  else if (strcmp(name, "wb_mode") == 0)
+
+  if (tmotion != NULL)
   {
-    if (sensor->set_wb_mode(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_wb_mode() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    *tmotion = pcam->tmotion;
   }
-  else if (strcmp(name, "wpc") == 0)
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_ctrl_set(camwebsrv_camera_t cam, const char *name, int value)
+{
+  camwebsrv_camera_ctrl_t ctrl;
+
+  if (cam == NULL || name == NULL)
   {
-    if (sensor->set_wpc(sensor, value))
-    { 
-      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): sensor.set_wpc() failed", name, value);
-      xSemaphoreGive(pcam->mutex1);
-      return ESP_FAIL;
-    } 
+    return ESP_ERR_INVALID_ARG;
   }
-  else
+
+  ctrl = camwebsrv_camera_ctrl_find(name);
+
+  if (ctrl == CAMWEBSRV_CAMERA_CTRL_MAX)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\"): failed; invalid parameter", name);
-    xSemaphoreGive(pcam->mutex1);
     return ESP_ERR_INVALID_ARG;
   }
 
-  ESP_LOGI(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d)", name, value);
-
-  xSemaphoreGive(pcam->mutex1);
-
-  return ESP_OK;
+  return camwebsrv_camera_ctrl_set_id(cam, ctrl, value);
 }
 
 int camwebsrv_camera_ctrl_get(camwebsrv_camera_t cam, const char *name)
 {
   sensor_t *sensor = NULL;
   _camwebsrv_camera_t *pcam;
+  camwebsrv_camera_ctrl_t ctrl;
   int rv;
 
   if (cam == NULL || name == NULL)
@@ -647,6 +1098,14 @@ int camwebsrv_camera_ctrl_get(camwebsrv_camera_t cam, const char *name)
 
   pcam = (_camwebsrv_camera_t *) cam;
 
+  ctrl = camwebsrv_camera_ctrl_find(name);
+
+  if (ctrl == CAMWEBSRV_CAMERA_CTRL_MAX)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_get(\"%s\"): failed; invalid parameter", name);
+    return -1;
+  }
+
   // lock
 
   if (xSemaphoreTake(pcam->mutex1, portMAX_DELAY) != pdTRUE)
@@ -666,247 +1125,1887 @@ int camwebsrv_camera_ctrl_get(camwebsrv_camera_t cam, const char *name)
     return -1;
   }
 
-  // get stuff
-
-  if (strcmp(name, "aec") == 0)
-  {
-    rv = sensor->status.aec;
-  }
-  else if (strcmp(name, "aec2") == 0)
-  {
-    rv = sensor->status.aec2;
-  }
-  else if (strcmp(name, "aec_value") == 0)
-  {
-    rv = sensor->status.aec_value;
-  }
-  else if (strcmp(name, "ae_level") == 0)
-  {
-    rv = sensor->status.ae_level;
-  }
-  else if (strcmp(name, "agc") == 0)
-  {
-    rv = sensor->status.agc;
-  }
-  else if (strcmp(name, "agc_gain") == 0)
-  {
-    rv = sensor->status.agc_gain;
-  }
-  else if (strcmp(name, "awb") == 0)
-  {
-    rv = sensor->status.awb;
-  }
-  else if (strcmp(name, "awb_gain") == 0)
-  {
-    rv = sensor->status.awb_gain;
-  }
-  else if (strcmp(name, "bpc") == 0)
-  {
-    rv = sensor->status.bpc;
-  }
-  else if (strcmp(name, "brightness") == 0)
-  {
-    rv = sensor->status.brightness;
-  }
-  else if (strcmp(name, "colorbar") == 0)
-  {
-    rv = sensor->status.colorbar;
-  }
-  else if (strcmp(name, "contrast") == 0)
-  {
-    rv = sensor->status.contrast;
-  }
-  else if (strcmp(name, "dcw") == 0)
-  {
-    rv = sensor->status.dcw;
-  }
-  else if (strcmp(name, "flash") == 0)
-  {
-    rv = pcam->flash;
-  }
-  else if (strcmp(name, "fps") == 0)
-  {
-    rv = pcam->fps;
-  }
-  else if (strcmp(name, "pixformat") == 0)
-  {
-    rv = sensor->pixformat;
-  }
-  else if (strcmp(name, "framesize") == 0)
-  {
-    rv = sensor->status.framesize;
-  }
-  else if (strcmp(name, "gainceiling") == 0)
-  {
-    rv = sensor->status.gainceiling;
-  }
-  else if (strcmp(name, "hmirror") == 0)
-  {
-    rv = sensor->status.hmirror;
-  }
-  else if (strcmp(name, "lenc") == 0)
-  {
-    rv = sensor->status.lenc;
-  }
-  else if (strcmp(name, "quality") == 0)
-  {
-    rv = sensor->status.quality;
-  }
-  else if (strcmp(name, "raw_gma") == 0)
-  {
-    rv = sensor->status.raw_gma;
-  }
-  else if (strcmp(name, "saturation") == 0)
-  {
-    rv = sensor->status.saturation;
-  }
-  else if (strcmp(name, "sharpness") == 0)
-  {
-    rv = sensor->status.sharpness;
-  }
-  else if (strcmp(name, "special_effect") == 0)
-  {
-    rv = sensor->status.special_effect;
-  }
-  else if (strcmp(name, "vflip") == 0)
-  {
-    rv = sensor->status.vflip;
-  }
-  else if (strcmp(name, "wb_mode") == 0)
-  {
-    rv = sensor->status.wb_mode;
-  }
-  else if (strcmp(name, "wpc") == 0)
-  {
-    rv = sensor->status.wpc;
-  }
-  else
-  {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_get(\"%s\"): failed; invalid parameter", name);
-    rv = -1;
-  }
+  rv = _camwebsrv_camera_ctrl_read(pcam, sensor, ctrl);
 
   xSemaphoreGive(pcam->mutex1);
 
   return rv;
 }
 
-bool camwebsrv_camera_is_ov3660(camwebsrv_camera_t cam)
+esp_err_t camwebsrv_camera_ctrl_set_id(camwebsrv_camera_t cam, camwebsrv_camera_ctrl_t ctrl, int value)
 {
+  const camwebsrv_camctrl_desc_t *pdesc;
+  sensor_t *sensor = NULL;
   _camwebsrv_camera_t *pcam;
 
-  if (cam == NULL)
+  if (cam == NULL || ctrl >= CAMWEBSRV_CAMERA_CTRL_MAX)
   {
-    return false;
+    return ESP_ERR_INVALID_ARG;
   }
 
   pcam = (_camwebsrv_camera_t *) cam;
+  pdesc = camwebsrv_camctrl_desc(ctrl);
 
-  return pcam->ov3660;
-}
-
-uint8_t camwebsrv_camera_fps_get(camwebsrv_camera_t cam)
-{
-  _camwebsrv_camera_t *pcam;
-
-  if (cam == NULL)
+  if (value < pdesc->min || value > pdesc->max)
   {
-    return 0;
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): failed; out of range [%d, %d]", pdesc->name, value, pdesc->min, pdesc->max);
+    return ESP_ERR_INVALID_ARG;
   }
 
-  pcam = (_camwebsrv_camera_t *) cam;
-
-  return pcam->fps;
-}
-
-static esp_err_t _camwebsrv_camera_init(_camwebsrv_camera_t *pcam)
-{
-  esp_err_t rv;
-  camera_config_t config;
-  sensor_t *sensor;
-
-  memset(&config, 0x00, sizeof(config));
-
-  config.pin_pwdn = CAMWEBSRV_PIN_PWDN;
-  config.pin_reset = CAMWEBSRV_PIN_RESET;
-  config.pin_xclk = CAMWEBSRV_PIN_XCLK;
-  config.pin_sccb_sda = CAMWEBSRV_PIN_SIOD;
-  config.pin_sccb_scl = CAMWEBSRV_PIN_SIOC;
-
-  config.pin_d7 = CAMWEBSRV_PIN_D7;
-  config.pin_d6 = CAMWEBSRV_PIN_D6;
-  config.pin_d5 = CAMWEBSRV_PIN_D5;
-  config.pin_d4 = CAMWEBSRV_PIN_D4;
-  config.pin_d3 = CAMWEBSRV_PIN_D3;
-  config.pin_d2 = CAMWEBSRV_PIN_D2;
-  config.pin_d1 = CAMWEBSRV_PIN_D1;
-  config.pin_d0 = CAMWEBSRV_PIN_D0;
-  config.pin_vsync = CAMWEBSRV_PIN_VSYNC;
-  config.pin_href = CAMWEBSRV_PIN_HREF;
-  config.pin_pclk = CAMWEBSRV_PIN_PCLK;
-
-  config.xclk_freq_hz = 20000000;
-  config.ledc_timer = LEDC_TIMER_0;
-  config.ledc_channel = LEDC_CHANNEL_0;
-
-  config.pixel_format = PIXFORMAT_JPEG;
-  config.frame_size = FRAMESIZE_UXGA;
-
-  config.jpeg_quality = 10;
-  config.fb_count = 1;
-  config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
-
-  rv = esp_camera_init(&config);
+  // lock
 
-  if (rv != ESP_OK)
+  if (xSemaphoreTake(pcam->mutex1, portMAX_DELAY) != pdTRUE)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_init(): _esp_camera_init() failed: [%d]: %s", rv, esp_err_to_name(rv));
-    return rv;
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(): xSemaphoreTake() failed");
+    return ESP_FAIL;
   }
 
-  // this returns a static pointer from the esp32-camera library, so there is
-  // no point in holding on to a reference to that
+  // get sensor
 
   sensor = esp_camera_sensor_get();
 
   if (sensor == NULL)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_init(): esp_camera_sensor_get() failed");
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): esp_camera_sensor_get() failed", pdesc->name, value);
+    xSemaphoreGive(pcam->mutex1);
     return ESP_FAIL;
   }
 
-  pcam->ov3660 = (sensor->id.PID == OV3660_PID);
+  // set stuff
 
-  if (pcam->ov3660)
+  if (_camwebsrv_camera_ctrl_write(pcam, sensor, ctrl, value))
   {
-    sensor->set_vflip(sensor, 1);
-    sensor->set_brightness(sensor, 1);
-    sensor->set_saturation(sensor, -2);
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d): setter failed", pdesc->name, value);
+    xSemaphoreGive(pcam->mutex1);
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set(\"%s\", %d)", pdesc->name, value);
+
+  _camwebsrv_camera_version_bump(pcam);
+  pcam->stats.ctrl_writes++;
+
+  xSemaphoreGive(pcam->mutex1);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_ctrl_queue(camwebsrv_camera_t cam, camwebsrv_camera_ctrl_t ctrl, int value)
+{
+  const camwebsrv_camctrl_desc_t *pdesc;
+  _camwebsrv_camera_t *pcam;
+
+  if (cam == NULL || ctrl >= CAMWEBSRV_CAMERA_CTRL_MAX)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+  pdesc = camwebsrv_camctrl_desc(ctrl);
+
+  // check now, while there is still someone to tell
+
+  if (value < pdesc->min || value > pdesc->max)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_queue(\"%s\", %d): failed; out of range [%d, %d]", pdesc->name, value, pdesc->min, pdesc->max);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // without the capture task, there is nobody to hand it to
+
+  if (pcam->task == NULL)
+  {
+    return camwebsrv_camera_ctrl_set_id(cam, ctrl, value);
+  }
+
+  // a mode change restarts the driver and can fail for reasons the caller
+  // needs to hear about, so it is made here and now, as a batch of one
+
+  if (ctrl == CAMWEBSRV_CAMERA_CTRL_PIXFORMAT || ctrl == CAMWEBSRV_CAMERA_CTRL_FRAMESIZE)
+  {
+    camwebsrv_camera_ctrl_val_t val;
+
+    val.ctrl = ctrl;
+    val.value = value;
+
+    return camwebsrv_camera_ctrl_set_batch(cam, &val, 1, NULL);
+  }
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+  pcam->pending[ctrl] = value;
+  pcam->pmask |= (1UL << ctrl);
+  pcam->stats.ctrl_queued++;
+
+  // readers of the status see the queued value from here on
+
+  pcam->version++;
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  // wake the task, without asking it for a frame
+
+  xTaskNotify(pcam->task, 0, eNoAction);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_ctrl_set_batch(camwebsrv_camera_t cam, const camwebsrv_camera_ctrl_val_t *vals, size_t count, size_t *writes)
+{
+  const camwebsrv_camctrl_desc_t *pdesc;
+  camwebsrv_camera_ctrl_val_t undo[CAMWEBSRV_CAMERA_CTRL_MAX];
+  sensor_t *sensor = NULL;
+  _camwebsrv_camera_t *pcam;
+  pixformat_t pixformat;
+  pixformat_t opixformat;
+  framesize_t framesize;
+  framesize_t oframesize;
+  size_t nwrites = 0;
+  size_t nundo = 0;
+  size_t i;
+  esp_err_t rv;
+
+  if (cam == NULL || (vals == NULL && count > 0))
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  // validate everything up front, so a bad value leaves the sensor untouched
+
+  for (i = 0; i < count; i++)
+  {
+    if (vals[i].ctrl >= CAMWEBSRV_CAMERA_CTRL_MAX)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(): failed; invalid control %d", vals[i].ctrl);
+      return ESP_ERR_INVALID_ARG;
+    }
+
+    pdesc = camwebsrv_camctrl_desc(vals[i].ctrl);
+
+    if (vals[i].value < pdesc->min || vals[i].value > pdesc->max)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(\"%s\", %d): failed; out of range [%d, %d]", pdesc->name, vals[i].value, pdesc->min, pdesc->max);
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  // lock
+
+  if (xSemaphoreTake(pcam->mutex1, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(): xSemaphoreTake() failed");
+    return ESP_FAIL;
+  }
+
+  // get sensor
+
+  sensor = esp_camera_sensor_get();
+
+  if (sensor == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(): esp_camera_sensor_get() failed");
+    xSemaphoreGive(pcam->mutex1);
+    return ESP_FAIL;
+  }
+
+  // pixformat and framesize first, and together, since changing them can
+  // restart the driver, which takes the rest back to their defaults
+
+  opixformat = sensor->pixformat;
+  oframesize = sensor->status.framesize;
+  pixformat = opixformat;
+  framesize = oframesize;
+
+  for (i = 0; i < count; i++)
+  {
+    pixformat = vals[i].ctrl == CAMWEBSRV_CAMERA_CTRL_PIXFORMAT ? (pixformat_t) vals[i].value : pixformat;
+    framesize = vals[i].ctrl == CAMWEBSRV_CAMERA_CTRL_FRAMESIZE ? (framesize_t) vals[i].value : framesize;
+  }
+
+  if (pixformat != opixformat || framesize != oframesize)
+  {
+    rv = _camwebsrv_camera_mode_set(pcam, pixformat, framesize);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(): _camwebsrv_camera_mode_set() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      _camwebsrv_camera_version_bump(pcam);
+      xSemaphoreGive(pcam->mutex1);
+      return ESP_FAIL;
+    }
+
+    nwrites++;
+  }
+
+  // then everything else; the sensor may be a new one by now
+
+  sensor = esp_camera_sensor_get();
+
+  if (sensor == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(): esp_camera_sensor_get() failed after mode change");
+    _camwebsrv_camera_version_bump(pcam);
+    xSemaphoreGive(pcam->mutex1);
+    return ESP_FAIL;
+  }
+
+  rv = ESP_OK;
+
+  for (i = 0; i < count; i++)
+  {
+    if (vals[i].ctrl == CAMWEBSRV_CAMERA_CTRL_PIXFORMAT || vals[i].ctrl == CAMWEBSRV_CAMERA_CTRL_FRAMESIZE)
+    {
+      continue;
+    }
+
+    pdesc = camwebsrv_camctrl_desc(vals[i].ctrl);
+
+    // the getters read the driver's cached status rather than the sensor,
+    // so this costs nothing and saves a bus write; it is also what we put
+    // back if a later write fails
+
+    undo[nundo].ctrl = vals[i].ctrl;
+    undo[nundo].value = _camwebsrv_camera_ctrl_read(pcam, sensor, vals[i].ctrl);
+
+    if (undo[nundo].value == vals[i].value)
+    {
+      continue;
+    }
+
+    if (_camwebsrv_camera_ctrl_write(pcam, sensor, vals[i].ctrl, vals[i].value))
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(\"%s\", %d): setter failed", pdesc->name, vals[i].value);
+      rv = ESP_FAIL;
+      break;
+    }
+
+    nundo = nundo < CAMWEBSRV_CAMERA_CTRL_MAX - 1 ? nundo + 1 : nundo;
+    nwrites++;
+  }
+
+  // on failure, undo what we did, newest first, mode change last
+
+  if (rv != ESP_OK)
+  {
+    while(nundo > 0)
+    {
+      nundo--;
+      pdesc = camwebsrv_camctrl_desc(undo[nundo].ctrl);
+
+      if (_camwebsrv_camera_ctrl_write(pcam, sensor, undo[nundo].ctrl, undo[nundo].value))
+      {
+        ESP_LOGW(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(\"%s\", %d): setter failed while rolling back", pdesc->name, undo[nundo].value);
+      }
+    }
+
+    if ((pixformat != opixformat || framesize != oframesize) && _camwebsrv_camera_mode_set(pcam, opixformat, oframesize) != ESP_OK)
+    {
+      ESP_LOGW(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(): _camwebsrv_camera_mode_set() failed while rolling back");
+    }
+
+    _camwebsrv_camera_version_bump(pcam);
+    xSemaphoreGive(pcam->mutex1);
+    return ESP_FAIL;
+  }
+
+  if (nwrites > 0)
+  {
+    _camwebsrv_camera_version_bump(pcam);
+  }
+
+  pcam->stats.ctrl_writes += nwrites;
+
+  xSemaphoreGive(pcam->mutex1);
+
+  ESP_LOGI(CAMWEBSRV_TAG, "CAM camwebsrv_camera_ctrl_set_batch(): %u of %u controls written", (unsigned) nwrites, (unsigned) count);
+
+  // set output, if supplied
+
+  if (writes != NULL)
+  {
+    *writes = nwrites;
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_camera_roi_set(camwebsrv_camera_t cam, const camwebsrv_camera_roi_t *roi)
+{
+  sensor_t *sensor = NULL;
+  _camwebsrv_camera_t *pcam;
+  esp_err_t rv;
+
+  if (cam == NULL || roi == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  if (xSemaphoreTake(pcam->mutex1, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_roi_set(): xSemaphoreTake() failed");
+    return ESP_FAIL;
+  }
+
+  // recorded frames have no sensor to window, and raw frames have buffers
+  // sized to exactly the frame size
+
+  if (!pcam->source->sensor || pcam->pixformat != PIXFORMAT_JPEG)
+  {
+    xSemaphoreGive(pcam->mutex1);
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  sensor = esp_camera_sensor_get();
+
+  if (sensor == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_roi_set(): esp_camera_sensor_get() failed");
+    xSemaphoreGive(pcam->mutex1);
+    return ESP_FAIL;
+  }
+
+  rv = _camwebsrv_camera_roi_apply(pcam, sensor, roi);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_roi_set(%u, %u, %u, %u): _camwebsrv_camera_roi_apply() failed: [%d]: %s", roi->x, roi->y, roi->w, roi->h, rv, esp_err_to_name(rv));
+  }
+
+  _camwebsrv_camera_version_bump(pcam);
+
+  xSemaphoreGive(pcam->mutex1);
+
+  return rv;
+}
+
+esp_err_t camwebsrv_camera_status_snapshot(camwebsrv_camera_t cam, camwebsrv_camera_status_t *status)
+{
+  sensor_t *sensor = NULL;
+  _camwebsrv_camera_t *pcam;
+  uint8_t i;
+
+  if (cam == NULL || status == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  // all of them under the one lock, from the one sensor lookup, so the
+  // values and the version agree
+
+  if (xSemaphoreTake(pcam->mutex1, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_status_snapshot(): xSemaphoreTake() failed");
+    return ESP_FAIL;
+  }
+
+  sensor = esp_camera_sensor_get();
+
+  if (sensor == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM camwebsrv_camera_status_snapshot(): esp_camera_sensor_get() failed");
+    xSemaphoreGive(pcam->mutex1);
+    return ESP_FAIL;
+  }
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  for (i = 0; i < CAMWEBSRV_CAMERA_CTRL_MAX; i++)
+  {
+    status->values[i] = (pcam->pmask & (1UL << i)) ? pcam->pending[i] : _camwebsrv_camera_ctrl_read(pcam, sensor, (camwebsrv_camera_ctrl_t) i);
+  }
+
+  status->roi = pcam->roi;
+  status->version = pcam->version;
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  xSemaphoreGive(pcam->mutex1);
+
+  return ESP_OK;
+}
+
+uint32_t camwebsrv_camera_status_version(camwebsrv_camera_t cam)
+{
+  _camwebsrv_camera_t *pcam;
+
+  if (cam == NULL)
+  {
+    return 0;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  return pcam->version;
+}
+
+esp_err_t camwebsrv_camera_stats_get(camwebsrv_camera_t cam, camwebsrv_camera_stats_t *stats)
+{
+  _camwebsrv_camera_t *pcam;
+
+  if (cam == NULL || stats == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  // counters are only bumped by whoever holds mutex2, and each is a single
+  // word, so reading them without a lock is good enough for telemetry
+
+  *stats = pcam->stats;
+
+  return ESP_OK;
+}
+
+bool camwebsrv_camera_is_ov3660(camwebsrv_camera_t cam)
+{
+  _camwebsrv_camera_t *pcam;
+
+  if (cam == NULL)
+  {
+    return false;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  return pcam->ov3660;
+}
+
+uint8_t camwebsrv_camera_fps_get(camwebsrv_camera_t cam)
+{
+  _camwebsrv_camera_t *pcam;
+
+  if (cam == NULL)
+  {
+    return 0;
+  }
+
+  pcam = (_camwebsrv_camera_t *) cam;
+
+  return pcam->fps;
+}
+
+static int _camwebsrv_camera_ctrl_set_flash(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value)
+{
+  pcam->flash = value != 0;
+
+  return gpio_set_level(CAMWEBSRV_PIN_FLASH, pcam->flash) != ESP_OK;
+}
+
+static int _camwebsrv_camera_ctrl_get_flash(_camwebsrv_camera_t *pcam, sensor_t *sensor)
+{
+  return pcam->flash;
+}
+
+static int _camwebsrv_camera_ctrl_set_fps(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value)
+{
+  pcam->fps = value;
+
+  return 0;
+}
+
+static int _camwebsrv_camera_ctrl_get_fps(_camwebsrv_camera_t *pcam, sensor_t *sensor)
+{
+  return pcam->fps;
+}
+
+static int _camwebsrv_camera_ctrl_set_framesize(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value)
+{
+  return _camwebsrv_camera_mode_set(pcam, sensor->pixformat, (framesize_t) value) != ESP_OK;
+}
+
+static int _camwebsrv_camera_ctrl_get_framesize(_camwebsrv_camera_t *pcam, sensor_t *sensor)
+{
+  return sensor->status.framesize;
+}
+
+static int _camwebsrv_camera_ctrl_set_motion(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value)
+{
+  pcam->motion = value;
+
+  return 0;
+}
+
+static int _camwebsrv_camera_ctrl_get_motion(_camwebsrv_camera_t *pcam, sensor_t *sensor)
+{
+  return pcam->motion;
+}
+
+static int _camwebsrv_camera_ctrl_set_pixformat(_camwebsrv_camera_t *pcam, sensor_t *sensor, int value)
+{
+  return _camwebsrv_camera_mode_set(pcam, (pixformat_t) value, sensor->status.framesize) != ESP_OK;
+}
+
+static int _camwebsrv_camera_ctrl_get_pixformat(_camwebsrv_camera_t *pcam, sensor_t *sensor)
+{
+  return sensor->pixformat;
+}
+
+static esp_err_t _camwebsrv_camera_init(_camwebsrv_camera_t *pcam)
+{
+  esp_err_t rv;
+  camera_config_t config;
+
+  _camwebsrv_camera_config(pcam, &config);
+
+  rv = pcam->source->start(&(pcam->sctx), &config);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_init(): source.start(%s) failed: [%d]: %s", pcam->source->name, rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  // recorded frames come without a sensor to set up
+
+  if (pcam->source->sensor)
+  {
+    rv = _camwebsrv_camera_sensor_setup(pcam);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_init(): _camwebsrv_camera_sensor_setup() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      return rv;
+    }
+  }
+
+  // set fps
+
+  pcam->fps = CAMWEBSRV_CAMERA_DEFAULT_FPS;
+
+  // set motion threshold
+
+  pcam->motion = CAMWEBSRV_CAMERA_DEFAULT_MOTION;
+
+  // set flash
+
+  pcam->flash = CAMWEBSRV_CAMERA_DEFAULT_FLASH;
+
+  if (gpio_set_level(CAMWEBSRV_PIN_FLASH, pcam->flash) != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_init(): failed to set flash %s", pcam->flash ? "on" : "off");
+    return ESP_FAIL;
+  }
+
+  // wait for exposure to settle, but carry on regardless
+
+  _camwebsrv_camera_warmup(pcam);
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_camera_sensor_setup(_camwebsrv_camera_t *pcam)
+{
+  sensor_t *sensor;
+
+  // this returns a static pointer from the esp32-camera library, so there is
+  // no point in holding on to a reference to that
+
+  sensor = esp_camera_sensor_get();
+
+  if (sensor == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_sensor_setup(): esp_camera_sensor_get() failed");
+    return ESP_FAIL;
+  }
+
+  pcam->ov3660 = (sensor->id.PID == OV3660_PID);
+
+  if (pcam->ov3660)
+  {
+    sensor->set_vflip(sensor, 1);
+    sensor->set_brightness(sensor, 1);
+    sensor->set_saturation(sensor, -2);
   }
 
   // pixformat can be changed at runtime; default is JPEG.
 
-  // set framesize
+  // set framesize
+
+  if (sensor->set_framesize(sensor, (framesize_t) CAMWEBSRV_CAMERA_DEFAULT_FS))
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_sensor_setup(): sensor.set_framesize(%d) failed", CAMWEBSRV_CAMERA_DEFAULT_FS);
+    return ESP_FAIL;
+  }
+
+  // which also undoes any windowing
+
+  _camwebsrv_camera_roi_clear(pcam);
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_camera_restart(_camwebsrv_camera_t *pcam)
+{
+  camera_config_t config;
+  esp_err_t rv;
+
+  // same as esp_camera_reconfigure(), but through whichever source is in use
+
+  rv = pcam->source->stop(&(pcam->sctx));
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_restart(): source.stop(%s) failed: [%d]: %s", pcam->source->name, rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  _camwebsrv_camera_config(pcam, &config);
+
+  return pcam->source->start(&(pcam->sctx), &config);
+}
+
+static esp_err_t _camwebsrv_camera_source_sensor_start(void **ctx, const camera_config_t *config)
+{
+  return esp_camera_init(config);
+}
+
+static esp_err_t _camwebsrv_camera_source_sensor_stop(void **ctx)
+{
+  return esp_camera_deinit();
+}
+
+static camera_fb_t *_camwebsrv_camera_source_sensor_grab(void *ctx)
+{
+  return esp_camera_fb_get();
+}
+
+static void _camwebsrv_camera_source_sensor_dispose(void *ctx, camera_fb_t *fb)
+{
+  esp_camera_fb_return(fb);
+}
+
+static esp_err_t _camwebsrv_camera_source_replay_start(void **ctx, const camera_config_t *config)
+{
+  return camwebsrv_replay_init((camwebsrv_replay_t *) ctx, CAMWEBSRV_CAMERA_REPLAY_DIR, CAMWEBSRV_CAMERA_REPLAY_FPS, CAMWEBSRV_CAMERA_REPLAY_JITTER);
+}
+
+static esp_err_t _camwebsrv_camera_source_replay_stop(void **ctx)
+{
+  return camwebsrv_replay_destroy((camwebsrv_replay_t *) ctx);
+}
+
+static camera_fb_t *_camwebsrv_camera_source_replay_grab(void *ctx)
+{
+  camera_fb_t *fb = NULL;
+
+  return camwebsrv_replay_grab((camwebsrv_replay_t) ctx, &fb) == ESP_OK ? fb : NULL;
+}
+
+static void _camwebsrv_camera_source_replay_dispose(void *ctx, camera_fb_t *fb)
+{
+  camwebsrv_replay_dispose((camwebsrv_replay_t) ctx, fb);
+}
+
+static void _camwebsrv_camera_config(_camwebsrv_camera_t *pcam, camera_config_t *config)
+{
+  memset(config, 0x00, sizeof(camera_config_t));
+
+  config->pin_pwdn = CAMWEBSRV_PIN_PWDN;
+  config->pin_reset = CAMWEBSRV_PIN_RESET;
+  config->pin_xclk = CAMWEBSRV_PIN_XCLK;
+  config->pin_sccb_sda = CAMWEBSRV_PIN_SIOD;
+  config->pin_sccb_scl = CAMWEBSRV_PIN_SIOC;
+
+  config->pin_d7 = CAMWEBSRV_PIN_D7;
+  config->pin_d6 = CAMWEBSRV_PIN_D6;
+  config->pin_d5 = CAMWEBSRV_PIN_D5;
+  config->pin_d4 = CAMWEBSRV_PIN_D4;
+  config->pin_d3 = CAMWEBSRV_PIN_D3;
+  config->pin_d2 = CAMWEBSRV_PIN_D2;
+  config->pin_d1 = CAMWEBSRV_PIN_D1;
+  config->pin_d0 = CAMWEBSRV_PIN_D0;
+  config->pin_vsync = CAMWEBSRV_PIN_VSYNC;
+  config->pin_href = CAMWEBSRV_PIN_HREF;
+  config->pin_pclk = CAMWEBSRV_PIN_PCLK;
+
+  config->xclk_freq_hz = 20000000;
+  config->ledc_timer = LEDC_TIMER_0;
+  config->ledc_channel = LEDC_CHANNEL_0;
+
+  // frame buffers are sized from these
+
+  config->pixel_format = pcam->pixformat;
+  config->frame_size = pcam->fbsize;
+
+  config->jpeg_quality = 10;
+  config->fb_count = CAMWEBSRV_CAMERA_FB_COUNT;
+  config->fb_location = CAMERA_FB_IN_PSRAM;
+  config->grab_mode = CAMWEBSRV_CAMERA_FB_COUNT > 1 ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY;
+}
+
+static esp_err_t _camwebsrv_camera_mode_set(_camwebsrv_camera_t *pcam, pixformat_t pixformat, framesize_t framesize)
+{
+  camwebsrv_camera_ctrl_val_t saved[CAMWEBSRV_CAMERA_CTRL_MAX];
+  sensor_t *sensor;
+  pixformat_t opixformat;
+  framesize_t ofbsize;
+  framesize_t oframesize;
+  int64_t tstart;
+  uint8_t nsaved = 0;
+  uint8_t i;
+  esp_err_t rv;
+
+  // caller holds mutex1
+
+  tstart = esp_timer_get_time();
+
+  sensor = esp_camera_sensor_get();
+
+  if (sensor == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(): esp_camera_sensor_get() failed");
+    return ESP_FAIL;
+  }
+
+  // the driver picks its dma sampling mode and sizes its buffers for the
+  // format and frame size it was started with; a jpeg frame of up to that
+  // size can go in the same buffers, but anything else needs a restart
+
+  if (pixformat == pcam->pixformat && (framesize == pcam->fbsize || (pixformat == PIXFORMAT_JPEG && resolution[framesize].width * resolution[framesize].height <= resolution[pcam->fbsize].width * resolution[pcam->fbsize].height)))
+  {
+    if (sensor->set_framesize(sensor, framesize))
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(%d, %d): sensor.set_framesize() failed", pixformat, framesize);
+      return ESP_FAIL;
+    }
+
+    _camwebsrv_camera_roi_clear(pcam);
+
+    return ESP_OK;
+  }
+
+  // the restart puts the sensor back to its defaults, so note what it has
+  // now, to put back afterwards; the controls kept here aren't affected
+
+  for (i = 0; i < CAMWEBSRV_CAMERA_CTRL_MAX; i++)
+  {
+    if (camwebsrv_camctrl_desc((camwebsrv_camera_ctrl_t) i)->set == NULL)
+    {
+      continue;
+    }
+
+    saved[nsaved].ctrl = (camwebsrv_camera_ctrl_t) i;
+    saved[nsaved].value = _camwebsrv_camera_ctrl_read(pcam, sensor, (camwebsrv_camera_ctrl_t) i);
+    nsaved++;
+  }
+
+  oframesize = sensor->status.framesize;
+
+  // keep the grabbing task out, and let go of every frame
+
+  if (xSemaphoreTake(pcam->mutex2, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(): xSemaphoreTake() failed");
+    return ESP_FAIL;
+  }
+
+  rv = _camwebsrv_camera_frames_drop(pcam, pdMS_TO_TICKS(CAMWEBSRV_CAMERA_DROP_TMOUT));
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(): _camwebsrv_camera_frames_drop() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    xSemaphoreGive(pcam->mutex2);
+    return rv;
+  }
+
+  // jpeg buffers stay big enough to switch between frame sizes without
+  // coming back here; raw ones are sized exactly
+
+  opixformat = pcam->pixformat;
+  ofbsize = pcam->fbsize;
+
+  pcam->pixformat = pixformat;
+  pcam->fbsize = pixformat != PIXFORMAT_JPEG || framesize > FRAMESIZE_UXGA ? framesize : FRAMESIZE_UXGA;
+
+  rv = _camwebsrv_camera_restart(pcam);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(%d, %d): _camwebsrv_camera_restart() failed: [%d]: %s", pixformat, framesize, rv, esp_err_to_name(rv));
+
+    // try to leave things as they were
+
+    pcam->pixformat = opixformat;
+    pcam->fbsize = ofbsize;
+    framesize = oframesize;
+
+    if (_camwebsrv_camera_restart(pcam) != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(): _camwebsrv_camera_restart() failed again; camera needs a reset");
+      xSemaphoreGive(pcam->mutex2);
+      return ESP_FAIL;
+    }
+  }
+
+  // the sensor struct is a new one now
+
+  sensor = esp_camera_sensor_get();
+
+  if (sensor == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(): esp_camera_sensor_get() failed");
+    xSemaphoreGive(pcam->mutex2);
+    return ESP_FAIL;
+  }
+
+  if (sensor->set_framesize(sensor, framesize))
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(%d, %d): sensor.set_framesize() failed", pixformat, framesize);
+    xSemaphoreGive(pcam->mutex2);
+    return ESP_FAIL;
+  }
+
+  _camwebsrv_camera_roi_clear(pcam);
+
+  // put back whatever differs from the defaults
+
+  for (i = 0; i < nsaved; i++)
+  {
+    const camwebsrv_camctrl_desc_t *pdesc = camwebsrv_camctrl_desc(saved[i].ctrl);
+
+    if (_camwebsrv_camera_ctrl_read(pcam, sensor, saved[i].ctrl) == saved[i].value)
+    {
+      continue;
+    }
+
+    if (_camwebsrv_camera_ctrl_write(pcam, sensor, saved[i].ctrl, saved[i].value))
+    {
+      ESP_LOGW(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(): failed to restore \"%s\" to %d", pdesc->name, saved[i].value);
+    }
+
+    pcam->stats.ctrl_writes++;
+  }
+
+  pcam->tstamp = -1;
+
+  pcam->stats.reconfigs++;
+  pcam->stats.reconfig_us = (uint32_t) (esp_timer_get_time() - tstart);
+
+  // a timeout here is not fatal; the frames will just be a bit off for a
+  // while
+
+  _camwebsrv_camera_warmup(pcam);
+
+  xSemaphoreGive(pcam->mutex2);
+
+  ESP_LOGI(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_mode_set(%d, %d): driver restarted in %" PRIu32 " us", pcam->pixformat, framesize, pcam->stats.reconfig_us);
+
+  return rv == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t _camwebsrv_camera_roi_apply(_camwebsrv_camera_t *pcam, sensor_t *sensor, const camwebsrv_camera_roi_t *roi)
+{
+  camwebsrv_camera_roi_t nroi;
+  uint16_t maxw;
+  uint16_t maxh;
+  int rv;
+
+  // caller holds mutex1
+
+  if (sensor->id.PID == OV3660_PID)
+  {
+    maxw = resolution[FRAMESIZE_QXGA].width;
+    maxh = resolution[FRAMESIZE_QXGA].height;
+  }
+  else if (sensor->id.PID == OV2640_PID)
+  {
+    maxw = resolution[FRAMESIZE_UXGA].width;
+    maxh = resolution[FRAMESIZE_UXGA].height;
+  }
+  else
+  {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  // back to the full view; the frame size puts the whole window back
+
+  if (roi->w == 0)
+  {
+    if (sensor->set_framesize(sensor, sensor->status.framesize))
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_roi_apply(): sensor.set_framesize() failed");
+      return ESP_FAIL;
+    }
+
+    _camwebsrv_camera_roi_clear(pcam);
+
+    return ESP_OK;
+  }
+
+  nroi.x = roi->x - (roi->x % CAMWEBSRV_CAMERA_ROI_ALIGN);
+  nroi.y = roi->y - (roi->y % CAMWEBSRV_CAMERA_ROI_ALIGN);
+  nroi.w = roi->w - (roi->w % CAMWEBSRV_CAMERA_ROI_ALIGN);
+  nroi.h = roi->h - (roi->h % CAMWEBSRV_CAMERA_ROI_ALIGN);
+
+  if (nroi.w == 0 || nroi.h == 0 || nroi.x + nroi.w > maxw || nroi.y + nroi.h > maxh)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // the buffers were sized for the frame size the driver was started with
+
+  if ((size_t) nroi.w * nroi.h > (size_t) resolution[pcam->fbsize].width * resolution[pcam->fbsize].height)
+  {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  if (sensor->id.PID == OV3660_PID)
+  {
+    // same margins, offsets and line/frame lengths as the driver's own 4:3
+    // full-array mode, but with the array window around the region and no
+    // scaling or binning
+
+    rv = sensor->set_res_raw(sensor, nroi.x, nroi.y, nroi.x + nroi.w + 31, nroi.y + nroi.h + 11, 16, 6, 2300, 1564, nroi.w, nroi.h, false, false);
+  }
+  else
+  {
+    // the dsp crops the region out of a full uxga readout, without zooming
+
+    rv = sensor->set_res_raw(sensor, _CAMWEBSRV_CAMERA_OV2640_MODE_UXGA, 0, 0, 0, nroi.x, nroi.y, nroi.w, nroi.h, nroi.w, nroi.h, false, false);
+  }
+
+  if (rv)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_roi_apply(%u, %u, %u, %u): sensor.set_res_raw() failed", nroi.x, nroi.y, nroi.w, nroi.h);
+    return ESP_FAIL;
+  }
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+  pcam->roi = nroi;
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  ESP_LOGI(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_roi_apply(%u, %u, %u, %u)", nroi.x, nroi.y, nroi.w, nroi.h);
+
+  return ESP_OK;
+}
+
+static void _camwebsrv_camera_roi_clear(_camwebsrv_camera_t *pcam)
+{
+  // frame_refresh() reads this under the spinlock, without mutex1
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+  memset(&(pcam->roi), 0x00, sizeof(pcam->roi));
+  portEXIT_CRITICAL(&(pcam->spinlock));
+}
+
+static void _camwebsrv_camera_version_bump(_camwebsrv_camera_t *pcam)
+{
+  // ctrl_queue() bumps it without mutex1, so every bump goes under the
+  // spinlock, or two of them can come out as one
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+  pcam->version++;
+  portEXIT_CRITICAL(&(pcam->spinlock));
+}
+
+static esp_err_t _camwebsrv_camera_frames_drop(_camwebsrv_camera_t *pcam, TickType_t timeout)
+{
+  _camwebsrv_camera_frame_t *pframe;
+  TickType_t started;
+  uint8_t i;
+
+  // caller holds mutex2
+
+  // if we're still holding on to the current frame, give it back; take it
+  // out of the slot first, so nobody can pick up a new reference to it
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+  pframe = pcam->current;
+  pcam->current = NULL;
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  if (pframe != NULL)
+  {
+    _camwebsrv_camera_frame_unref(pcam, pframe);
+  }
+
+  // a frame still referenced by someone else would be handed back to a
+  // driver that no longer exists; with the current slot empty and mutex2
+  // held, nobody can pick up a new reference, so wait for the rest to be
+  // released, for up to the given time
+
+  started = xTaskGetTickCount();
+  pcam->draining = true;
+
+  while(1)
+  {
+    pframe = NULL;
+
+    portENTER_CRITICAL(&(pcam->spinlock));
+
+    for (i = 0; i < CAMWEBSRV_CAMERA_FB_COUNT && pframe == NULL; i++)
+    {
+      if (pcam->frames[i].fb != NULL)
+      {
+        pframe = &(pcam->frames[i]);
+      }
+    }
+
+    portEXIT_CRITICAL(&(pcam->spinlock));
+
+    if (pframe == NULL)
+    {
+      break;
+    }
+
+    if (timeout != portMAX_DELAY && (xTaskGetTickCount() - started) > timeout)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_frames_drop(): failed; frame %" PRIu32 " still referenced", pframe->frame.seq);
+      pcam->draining = false;
+      return ESP_ERR_TIMEOUT;
+    }
+
+    xEventGroupWaitBits(pcam->events, _CAMWEBSRV_CAMERA_EVENT_RELEASED, pdTRUE, pdFALSE, pdMS_TO_TICKS(CAMWEBSRV_MAIN_MIN_CYCLE_MSEC));
+  }
+
+  pcam->draining = false;
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_camera_warmup(_camwebsrv_camera_t *pcam)
+{
+  camwebsrv_warmup_t wu;
+  camera_fb_t *fb;
+  sensor_t *sensor;
+  uint32_t exposure;
+  uint32_t gain;
+  int64_t tstart;
+  bool settled = false;
+
+  // caller holds both mutex1 and mutex2, and no frames
+
+  tstart = esp_timer_get_time();
+
+  // there won't be one when replaying
+
+  sensor = pcam->source->sensor ? esp_camera_sensor_get() : NULL;
+
+  camwebsrv_warmup_init(&wu);
+
+  // throw frames away until auto exposure and gain stop moving
+
+  while(!settled)
+  {
+    fb = pcam->source->grab(pcam->sctx);
+
+    if (fb == NULL)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_warmup(): source.grab() failed");
+      pcam->stats.failures++;
+      return ESP_FAIL;
+    }
+
+    pcam->stats.grabs++;
+
+    pcam->source->dispose(pcam->sctx, fb);
+
+    // a sensor whose registers we don't know just gets the minimum number
+    // of frames
+
+    if (_camwebsrv_camera_aec_read(pcam, sensor, &exposure, &gain) != ESP_OK)
+    {
+      exposure = 0;
+      gain = 0;
+    }
+
+    settled = camwebsrv_warmup_update(&wu, exposure, gain);
+
+    if ((esp_timer_get_time() - tstart) > (CAMWEBSRV_CAMERA_WARMUP_TMOUT * 1000))
+    {
+      break;
+    }
+  }
+
+  pcam->stats.warmup_frames = wu.frames;
+  pcam->stats.warmup_us = (uint32_t) (esp_timer_get_time() - tstart);
+
+  if (!settled)
+  {
+    ESP_LOGW(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_warmup(): exposure still moving after %u frames", wu.frames);
+    return ESP_ERR_TIMEOUT;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_warmup(): settled after %u frames, %" PRIu32 " us", wu.frames, pcam->stats.warmup_us);
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_camera_aec_read(_camwebsrv_camera_t *pcam, sensor_t *sensor, uint32_t *exposure, uint32_t *gain)
+{
+  int r1;
+  int r2;
+  int r3;
+
+  if (sensor == NULL)
+  {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  if (pcam->ov3660)
+  {
+    // 0x3500-0x3502: exposure, in 1/16 lines; 0x350a-0x350b: gain
+
+    r1 = sensor->get_reg(sensor, 0x3500, 0xFFFFFF);
+    r2 = sensor->get_reg(sensor, 0x350A, 0x03FF);
+
+    if (r1 < 0 || r2 < 0)
+    {
+      return ESP_FAIL;
+    }
+
+    *exposure = ((uint32_t) r1) >> 4;
+    *gain = (uint32_t) r2;
+
+    return ESP_OK;
+  }
+
+  if (sensor->id.PID == OV2640_PID)
+  {
+    // sensor bank: exposure is spread over 0x45[5:0], 0x10 and 0x04[1:0];
+    // gain is 0x00
+
+    r1 = sensor->get_reg(sensor, 0x145, 0x3F);
+    r2 = sensor->get_reg(sensor, 0x110, 0xFF);
+    r3 = sensor->get_reg(sensor, 0x104, 0x03);
+
+    if (r1 < 0 || r2 < 0 || r3 < 0)
+    {
+      return ESP_FAIL;
+    }
+
+    *exposure = (((uint32_t) r1) << 10) | (((uint32_t) r2) << 2) | ((uint32_t) r3);
+
+    r1 = sensor->get_reg(sensor, 0x100, 0xFF);
+
+    if (r1 < 0)
+    {
+      return ESP_FAIL;
+    }
+
+    *gain = (uint32_t) r1;
+
+    return ESP_OK;
+  }
+
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+static esp_err_t _camwebsrv_camera_frame_refresh(_camwebsrv_camera_t *pcam, bool force, int64_t after)
+{
+  _camwebsrv_camera_frame_t *pframe = NULL;
+  _camwebsrv_camera_frame_t *pold;
+  camera_fb_t *fb = NULL;
+  int64_t now;
+  uint8_t i;
+
+  // is the current frame still fresh enough?
+
+  now = esp_timer_get_time();
+
+  if (!force && pcam->current != NULL && (now - pcam->tstamp) < (1000000 / pcam->fps))
+  {
+    return ESP_OK;
+  }
+
+  // find a slot that is not referenced by anyone
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  for (i = 0; i < CAMWEBSRV_CAMERA_FB_COUNT && pframe == NULL; i++)
+  {
+    if (pcam->frames[i].fb == NULL)
+    {
+      pframe = &(pcam->frames[i]);
+    }
+  }
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  if (pframe == NULL)
+  {
+    // all slots are in use; if we are the only ones holding the current
+    // frame, recycle it, otherwise keep serving it until a slow reader lets
+    // go of an older one
+
+    portENTER_CRITICAL(&(pcam->spinlock));
+
+    if (pcam->current != NULL && pcam->current->refs == 1)
+    {
+      pframe = pcam->current;
+      pcam->current = NULL;
+    }
+
+    portEXIT_CRITICAL(&(pcam->spinlock));
+
+    if (pframe == NULL)
+    {
+      ESP_LOGD(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_frame_refresh(): all frame slots busy");
+      return pcam->current != NULL ? ESP_OK : ESP_ERR_NOT_FOUND;
+    }
+
+    _camwebsrv_camera_frame_unref(pcam, pframe);
+  }
+
+  // get frame; whoever (re)started the driver already waited for exposure
+  // to settle, so the first one is as good as any
+
+  // the driver keeps filling its buffers in the background and hands out
+  // the newest one it has, which may have been exposed before the caller
+  // asked; give those back and take the next, for at most as many as it
+  // could have had queued up
+
+  for (i = 0; ; i++)
+  {
+    fb = pcam->source->grab(pcam->sctx);
+
+    if (fb == NULL)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_frame_refresh(): source.grab() failed");
+      pcam->stats.failures++;
+      return ESP_FAIL;
+    }
+
+    pcam->stats.grabs++;
+
+    if (_camwebsrv_camera_fb_tstamp(fb) >= after || i == CAMWEBSRV_CAMERA_FB_COUNT)
+    {
+      break;
+    }
+
+    ESP_LOGD(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_frame_refresh(): discarding frame exposed %" PRId64 " us early", after - _camwebsrv_camera_fb_tstamp(fb));
+
+    pcam->source->dispose(pcam->sctx, fb);
+  }
+
+  // publish it; the camera itself holds one reference to the current frame,
+  // and readers may pick up references to it without taking any mutex, so
+  // the swap has to happen under the spinlock
+
+  pcam->tstamp = now;
+  pcam->seq++;
+
+  pframe->frame.buf = fb->buf;
+  pframe->frame.len = fb->len;
+  pframe->frame.tstamp = _camwebsrv_camera_fb_tstamp(fb);
+  pframe->frame.seq = pcam->seq;
+  pframe->frame.width = fb->width;
+  pframe->frame.height = fb->height;
+  pframe->refs = 1;
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  // the driver only knows about the frame size, not the window
+
+  if (pcam->roi.w > 0)
+  {
+    pframe->frame.width = pcam->roi.w;
+    pframe->frame.height = pcam->roi.h;
+  }
+
+  pframe->fb = fb;
+  pold = pcam->current;
+  pcam->current = pframe;
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  if (pold != NULL)
+  {
+    _camwebsrv_camera_frame_unref(pcam, pold);
+  }
+
+  // keep a copy for anyone asking about it later
+
+  if (pcam->pixformat == PIXFORMAT_JPEG)
+  {
+    _camwebsrv_camera_history_record(pcam, pframe);
+  }
+
+  // and see if anything moved
+
+  if (pcam->pixformat == PIXFORMAT_JPEG && pcam->motion > 0)
+  {
+    _camwebsrv_camera_motion_detect(pcam, pframe);
+  }
+  else if (pcam->md.bg != NULL)
+  {
+    camwebsrv_motion_destroy(&(pcam->md));
+  }
+
+  // wake anyone waiting in camwebsrv_camera_frame_next()
+
+  xEventGroupSetBits(pcam->events, _CAMWEBSRV_CAMERA_EVENT_FRAME);
+  xEventGroupClearBits(pcam->events, _CAMWEBSRV_CAMERA_EVENT_FRAME);
+
+  return ESP_OK;
+}
+
+static int64_t _camwebsrv_camera_fb_tstamp(const camera_fb_t *fb)
+{
+  // the driver stamps each buffer with esp_timer_get_time() at vsync, as
+  // it starts filling it
+
+  return ((int64_t) fb->timestamp.tv_sec * 1000000) + fb->timestamp.tv_usec;
+}
+
+static _camwebsrv_camera_frame_t *_camwebsrv_camera_frame_current(_camwebsrv_camera_t *pcam)
+{
+  _camwebsrv_camera_frame_t *pframe;
+
+  // take a reference to the current frame, if there is one
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  pframe = pcam->current;
+
+  if (pframe != NULL)
+  {
+    pframe->refs++;
+  }
 
-  if (sensor->set_framesize(sensor, (framesize_t) CAMWEBSRV_CAMERA_DEFAULT_FS))
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  return pframe;
+}
+
+static void _camwebsrv_camera_frame_unref(_camwebsrv_camera_t *pcam, _camwebsrv_camera_frame_t *pframe)
+{
+  camera_fb_t *fb = NULL;
+  uint8_t *jpg = NULL;
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  if (pframe->refs > 0)
+  {
+    pframe->refs--;
+
+    if (pframe->refs == 0)
+    {
+      fb = pframe->fb;
+      jpg = pframe->jpg;
+    }
+  }
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  // variants own their buffer outright
+
+  if (jpg != NULL)
+  {
+    free(jpg);
+
+    portENTER_CRITICAL(&(pcam->spinlock));
+    pframe->jpg = NULL;
+    portEXIT_CRITICAL(&(pcam->spinlock));
+  }
+
+  // last one out hands the buffer back to the driver, then frees the slot
+
+  if (fb != NULL)
+  {
+    pcam->source->dispose(pcam->sctx, fb);
+
+    portENTER_CRITICAL(&(pcam->spinlock));
+    pframe->fb = NULL;
+    portEXIT_CRITICAL(&(pcam->spinlock));
+
+    // in case _camwebsrv_camera_frames_drop() is waiting on it
+
+    xEventGroupSetBits(pcam->events, _CAMWEBSRV_CAMERA_EVENT_RELEASED);
+  }
+}
+
+static void _camwebsrv_camera_history_record(_camwebsrv_camera_t *pcam, const _camwebsrv_camera_frame_t *pframe)
+{
+  _camwebsrv_camera_frame_t *pslot;
+  uint8_t *jpg;
+
+  // caller holds mutex2, which makes it the only one adding to or taking
+  // from the ring
+
+  if (pframe->frame.len > CAMWEBSRV_CAMERA_HISTORY_BYTES)
+  {
+    return;
+  }
+
+  // make room, both in slots and in bytes; frames that readers still hold
+  // on to only go away once they let go, so the budget can be overshot
+  // by those for a while
+
+  while (pcam->hcount > 0 && (pcam->hcount == CAMWEBSRV_CAMERA_HISTORY_COUNT || pcam->hbytes + pframe->frame.len > CAMWEBSRV_CAMERA_HISTORY_BYTES))
+  {
+    _camwebsrv_camera_history_evict(pcam);
+  }
+
+  // the slot after the newest may still be held by a slow reader; if so,
+  // this frame just doesn't make it into the history
+
+  pslot = &(pcam->history[(pcam->hfirst + pcam->hcount) % CAMWEBSRV_CAMERA_HISTORY_COUNT]);
+
+  if (pslot->jpg != NULL || pslot->refs > 0)
+  {
+    ESP_LOGD(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_history_record(): history slot busy");
+    return;
+  }
+
+  // driver buffers are few and precious, so it has to be a copy
+
+  jpg = (uint8_t *) heap_caps_malloc(pframe->frame.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+  if (jpg == NULL)
+  {
+    ESP_LOGW(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_history_record(): heap_caps_malloc(%u) failed", pframe->frame.len);
+    return;
+  }
+
+  memcpy(jpg, pframe->frame.buf, pframe->frame.len);
+
+  pslot->frame = pframe->frame;
+  pslot->frame.buf = jpg;
+  pslot->fb = NULL;
+  pslot->scale = 0;
+  pslot->quality = 0;
+
+  // the ring holds the one reference
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+  pslot->jpg = jpg;
+  pslot->refs = 1;
+  pcam->hcount++;
+  pcam->hbytes += pslot->frame.len;
+  portEXIT_CRITICAL(&(pcam->spinlock));
+}
+
+static void _camwebsrv_camera_history_evict(_camwebsrv_camera_t *pcam)
+{
+  _camwebsrv_camera_frame_t *pslot;
+
+  // take the oldest out of the ring, so nobody can find it any more, then
+  // drop the ring's reference to it
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  pslot = &(pcam->history[pcam->hfirst]);
+
+  pcam->hfirst = (pcam->hfirst + 1) % CAMWEBSRV_CAMERA_HISTORY_COUNT;
+  pcam->hcount--;
+  pcam->hbytes -= pslot->frame.len;
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  _camwebsrv_camera_frame_unref(pcam, pslot);
+}
+
+static void _camwebsrv_camera_motion_detect(_camwebsrv_camera_t *pcam, const _camwebsrv_camera_frame_t *pframe)
+{
+  esp_jpeg_image_cfg_t jcfg;
+  esp_jpeg_image_output_t jout;
+  int64_t tstart;
+  uint16_t score;
+  size_t npix;
+  size_t i;
+  esp_err_t rv;
+
+  // caller holds mutex2, which makes it the only user of the detector
+
+  tstart = esp_timer_get_time();
+
+  // 1/8 scale is nearly free to decode, since only the dc coefficient of
+  // each block is needed, and is still plenty to see motion in
+
+  memset(&jcfg, 0x00, sizeof(jcfg));
+  memset(&jout, 0x00, sizeof(jout));
+
+  jcfg.indata = (uint8_t *) pframe->frame.buf;
+  jcfg.indata_size = pframe->frame.len;
+  jcfg.out_format = JPEG_IMAGE_FORMAT_RGB888;
+  jcfg.out_scale = JPEG_IMAGE_SCALE_1_8;
+
+  rv = esp_jpeg_get_image_info(&jcfg, &jout);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_motion_detect(): esp_jpeg_get_image_info() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return;
+  }
+
+  // hang on to the decode buffer between frames; it only changes size
+  // along with the frame size
+
+  if (pcam->mlen < jout.output_len)
+  {
+    free(pcam->mbuf);
+
+    pcam->mlen = 0;
+    pcam->mbuf = (uint8_t *) heap_caps_malloc(jout.output_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+    if (pcam->mbuf == NULL)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_motion_detect(): heap_caps_malloc(%u) failed", jout.output_len);
+      return;
+    }
+
+    pcam->mlen = jout.output_len;
+  }
+
+  jcfg.outbuf = pcam->mbuf;
+  jcfg.outbuf_size = pcam->mlen;
+
+  rv = esp_jpeg_decode(&jcfg, &jout);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_motion_detect(): esp_jpeg_decode() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return;
+  }
+
+  // squeeze it down to luma in place; each output byte is written behind
+  // the three it is made from
+
+  npix = (size_t) jout.width * jout.height;
+
+  for (i = 0; i < npix; i++)
+  {
+    const uint8_t *p = pcam->mbuf + (i * 3);
+
+    pcam->mbuf[i] = (uint8_t) ((p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8);
+  }
+
+  if (!camwebsrv_motion_update(&(pcam->md), pcam->mbuf, jout.width, jout.height, &score))
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_motion_detect(): camwebsrv_motion_update() failed");
+    return;
+  }
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  pcam->mscore = score;
+
+  if (score >= pcam->motion)
+  {
+    pcam->tmotion = pframe->frame.tstamp;
+  }
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  pcam->stats.motion_us = (uint32_t) (esp_timer_get_time() - tstart);
+}
+
+static esp_err_t _camwebsrv_camera_variant_encode(_camwebsrv_camera_frame_t *pvar, const camwebsrv_camera_frame_t *src)
+{
+  esp_jpeg_image_cfg_t jcfg;
+  esp_jpeg_image_output_t jout;
+  uint8_t *rgb;
+  uint8_t *jpg = NULL;
+  size_t jlen = 0;
+  esp_err_t rv;
+
+  // decode the source straight to the smaller size; the decoder does the
+  // scaling for free, in 1/2, 1/4 and 1/8 steps
+
+  memset(&jcfg, 0x00, sizeof(jcfg));
+  memset(&jout, 0x00, sizeof(jout));
+
+  jcfg.indata = (uint8_t *) src->buf;
+  jcfg.indata_size = src->len;
+  jcfg.out_format = JPEG_IMAGE_FORMAT_RGB565;
+  jcfg.out_scale = pvar->scale;
+  jcfg.flags.swap_color_bytes = 1;
+
+  rv = esp_jpeg_get_image_info(&jcfg, &jout);
+
+  if (rv != ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_init(): sensor.set_framesize(%d) failed", CAMWEBSRV_CAMERA_DEFAULT_FS);
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_variant_encode(): esp_jpeg_get_image_info() failed: [%d]: %s", rv, esp_err_to_name(rv));
     return ESP_FAIL;
   }
 
-  // set fps
+  rgb = (uint8_t *) heap_caps_malloc(jout.output_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
 
-  pcam->fps = CAMWEBSRV_CAMERA_DEFAULT_FPS;
+  if (rgb == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_variant_encode(): heap_caps_malloc(%u) failed", jout.output_len);
+    return ESP_ERR_NO_MEM;
+  }
 
-  // set flash
+  jcfg.outbuf = rgb;
+  jcfg.outbuf_size = jout.output_len;
 
-  pcam->flash = CAMWEBSRV_CAMERA_DEFAULT_FLASH;
+  rv = esp_jpeg_decode(&jcfg, &jout);
 
-  if (gpio_set_level(CAMWEBSRV_PIN_FLASH, pcam->flash) != ESP_OK)
+  if (rv != ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_init(): failed to set flash %s", pcam->flash ? "on" : "off");
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_variant_encode(): esp_jpeg_decode() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    free(rgb);
+    return ESP_FAIL;
+  }
+
+  // then re-encode at the requested quality
+
+  if (!fmt2jpg(rgb, jout.output_len, jout.width, jout.height, PIXFORMAT_RGB565, pvar->quality, &jpg, &jlen))
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_variant_encode(): fmt2jpg() failed");
+    free(rgb);
     return ESP_FAIL;
   }
 
+  free(rgb);
+
+  pvar->jpg = jpg;
+  pvar->frame.buf = jpg;
+  pvar->frame.len = jlen;
+  pvar->frame.tstamp = src->tstamp;
+  pvar->frame.seq = src->seq;
+  pvar->frame.width = jout.width;
+  pvar->frame.height = jout.height;
+
   return ESP_OK;
 }
+
+static void _camwebsrv_camera_variant_task(void *arg)
+{
+  _camwebsrv_camera_t *pcam;
+  _camwebsrv_camera_frame_t *pvar;
+  _camwebsrv_camera_frame_t tmp;
+  const camwebsrv_camera_frame_t *src;
+  esp_err_t rv;
+  uint8_t i;
+
+  pcam = (_camwebsrv_camera_t *) arg;
+
+  while(pcam->vrun)
+  {
+    // find a slot waiting to be encoded; sleep until asked if there are
+    // none; only variant_acquire() takes slots, and it never takes one
+    // that is waiting, so nothing else touches it until we're done
+
+    pvar = NULL;
+
+    portENTER_CRITICAL(&(pcam->spinlock));
+
+    for (i = 0; i < CAMWEBSRV_CAMERA_VARIANT_COUNT && pvar == NULL; i++)
+    {
+      pvar = pcam->variants[i].src != NULL ? &(pcam->variants[i]) : NULL;
+    }
+
+    portEXIT_CRITICAL(&(pcam->spinlock));
+
+    if (pvar == NULL)
+    {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+
+    // encode outside the lock, then publish it in one go
+
+    memset(&tmp, 0x00, sizeof(tmp));
+
+    src = pvar->src;
+    tmp.scale = pvar->scale;
+    tmp.quality = pvar->quality;
+
+    rv = _camwebsrv_camera_variant_encode(&tmp, src);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_variant_task(): _camwebsrv_camera_variant_encode() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    }
+
+    portENTER_CRITICAL(&(pcam->spinlock));
+
+    if (rv == ESP_OK)
+    {
+      pvar->frame = tmp.frame;
+      pvar->jpg = tmp.jpg;
+    }
+    else
+    {
+      pvar->refs = 0;
+    }
+
+    pvar->src = NULL;
+
+    portEXIT_CRITICAL(&(pcam->spinlock));
+
+    camwebsrv_camera_frame_release((camwebsrv_camera_t) pcam, &src);
+  }
+
+  xSemaphoreGive(pcam->vdone);
+
+  vTaskDelete(NULL);
+}
+
+static int _camwebsrv_camera_ctrl_write(_camwebsrv_camera_t *pcam, sensor_t *sensor, camwebsrv_camera_ctrl_t ctrl, int value)
+{
+  const camwebsrv_camctrl_desc_t *pdesc = camwebsrv_camctrl_desc(ctrl);
+
+  // straight to the sensor, unless it is one of ours
+
+  if (pdesc->set != NULL)
+  {
+    return pdesc->set(sensor, value);
+  }
+
+  return _camwebsrv_camera_ctrls_own[ctrl].set(pcam, sensor, value);
+}
+
+static int _camwebsrv_camera_ctrl_read(_camwebsrv_camera_t *pcam, sensor_t *sensor, camwebsrv_camera_ctrl_t ctrl)
+{
+  const camwebsrv_camctrl_desc_t *pdesc = camwebsrv_camctrl_desc(ctrl);
+
+  if (pdesc->get != NULL)
+  {
+    return pdesc->get(sensor);
+  }
+
+  return _camwebsrv_camera_ctrls_own[ctrl].get(pcam, sensor);
+}
+
+static void _camwebsrv_camera_ctrl_flush(_camwebsrv_camera_t *pcam)
+{
+  camwebsrv_camera_ctrl_val_t vals[CAMWEBSRV_CAMERA_CTRL_MAX];
+  size_t count = 0;
+  esp_err_t rv;
+  uint8_t i;
+
+  // take everything queued so far in one go; anything queued from here on
+  // goes in the next batch
+
+  portENTER_CRITICAL(&(pcam->spinlock));
+
+  for (i = 0; i < CAMWEBSRV_CAMERA_CTRL_MAX; i++)
+  {
+    if (pcam->pmask & (1UL << i))
+    {
+      vals[count].ctrl = (camwebsrv_camera_ctrl_t) i;
+      vals[count].value = pcam->pending[i];
+      count++;
+    }
+  }
+
+  pcam->pmask = 0;
+
+  portEXIT_CRITICAL(&(pcam->spinlock));
+
+  pcam->tflush = esp_timer_get_time();
+
+  rv = camwebsrv_camera_ctrl_set_batch((camwebsrv_camera_t) pcam, vals, count, NULL);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_ctrl_flush(): camwebsrv_camera_ctrl_set_batch() failed: [%d]: %s", rv, esp_err_to_name(rv));
+  }
+}
+
+static void _camwebsrv_camera_task(void *arg)
+{
+  _camwebsrv_camera_t *pcam;
+  TickType_t wait;
+  int64_t due;
+  int64_t flush;
+  int64_t now;
+  uint32_t seq;
+  UBaseType_t stack;
+  bool asked;
+  esp_err_t rv;
+
+  pcam = (_camwebsrv_camera_t *) arg;
+
+  pcam->stats.task_stack_free = CAMWEBSRV_CAMERA_TASK_STACK;
+
+  while(pcam->trun)
+  {
+    // sleep until the next frame is due, or until someone asks for one
+    // sooner; or, with control changes queued, until they are due to go out
+
+    now = esp_timer_get_time();
+    due = pcam->tstamp < 0 ? 0 : pcam->tstamp + (1000000 / pcam->fps) - now;
+
+    if (pcam->pmask != 0)
+    {
+      flush = pcam->tflush + ((int64_t) CAMWEBSRV_CAMERA_CTRL_FLUSH * 1000) - now;
+      due = flush < due ? flush : due;
+    }
+
+    wait = due > 0 ? pdMS_TO_TICKS(due / 1000) : 0;
+
+    asked = ulTaskNotifyTake(pdTRUE, wait) > 0;
+
+    if (!pcam->trun)
+    {
+      break;
+    }
+
+    // control changes go out between frames, never more often than every
+    // CAMWEBSRV_CAMERA_CTRL_FLUSH ms, so that a burst of them is one batch
+
+    now = esp_timer_get_time();
+
+    if (pcam->pmask != 0 && now >= pcam->tflush + ((int64_t) CAMWEBSRV_CAMERA_CTRL_FLUSH * 1000))
+    {
+      _camwebsrv_camera_ctrl_flush(pcam);
+    }
+
+    // that may have been all we were woken for; allow for a tick's worth of
+    // rounding in the wait
+
+    if (!asked && pcam->tstamp >= 0 && (now + (portTICK_PERIOD_MS * 1000)) < pcam->tstamp + (1000000 / pcam->fps))
+    {
+      continue;
+    }
+
+    // grab and publish; this blocks while the camera is being reset
+
+    if (xSemaphoreTake(pcam->mutex2, portMAX_DELAY) != pdTRUE)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_task(): xSemaphoreTake() failed");
+      vTaskDelay(pdMS_TO_TICKS(CAMWEBSRV_MAIN_MIN_CYCLE_MSEC));
+      continue;
+    }
+
+    seq = pcam->seq;
+
+    // ask for a frame exposed no earlier than now; with every buffer but
+    // the current frame's queued, the sensor has nowhere to put a new one,
+    // so taking the oldest queued would publish it a few intervals late;
+    // giving back the stale ones frees their buffers for the next vsync
+
+    rv = _camwebsrv_camera_frame_refresh(pcam, true, now > pcam->tafter ? now : pcam->tafter);
+
+    xSemaphoreGive(pcam->mutex2);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_task(): _camwebsrv_camera_frame_refresh() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    }
+
+    // the deepest this task goes is a grab followed by motion detection's
+    // jpeg decode, or a batch of control writes; mode changes are made by
+    // whoever asks for them, not here; keep an eye on how close it gets
+
+    stack = uxTaskGetStackHighWaterMark(NULL);
+
+    if (stack < CAMWEBSRV_CAMERA_TASK_STACK_LOW && pcam->stats.task_stack_free >= CAMWEBSRV_CAMERA_TASK_STACK_LOW)
+    {
+      ESP_LOGW(CAMWEBSRV_TAG, "CAM _camwebsrv_camera_task(): only %u bytes of stack left unused", (unsigned) stack);
+    }
+
+    pcam->stats.task_stack_free = stack;
+
+    // back off for a bit if nothing was published, either because the grab
+    // failed or because readers are holding on to every slot
+
+    if (pcam->seq == seq)
+    {
+      vTaskDelay(pdMS_TO_TICKS(CAMWEBSRV_MAIN_MIN_CYCLE_MSEC));
+    }
+  }
+
+  xSemaphoreGive(pcam->tdone);
+
+  vTaskDelete(NULL);
+}
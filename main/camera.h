@@ -13,14 +13,171 @@
 
 typedef void *camwebsrv_camera_t;
 
+// a captured frame, shared by reference between all of its readers; fields
+// are read-only and remain valid until the reference is released
+
+// frame_acquire() hands out the newest frame, which may have been grabbed
+// up to one frame interval ago; frame_next() waits for one that the sensor
+// started exposing after the call; tstamp is when that exposure started;
+// while the camera is being reconfigured, frame_acquire() returns
+// ESP_ERR_NOT_FOUND rather than blocking, so that readers still holding
+// frames get to let go of them; reset() waits up to
+// CAMWEBSRV_CAMERA_DROP_TMOUT for them, then returns ESP_ERR_TIMEOUT with
+// the camera left as it was
+
+// a frame can also be re-encoded at a smaller size (0: full, 1: 1/2, 2:
+// 1/4, 3: 1/8) and a different jpeg quality (1-100, 0: default); variants
+// are shared between readers that ask for the same one, and released the
+// same way as any other frame; they are encoded by a worker task rather
+// than by the caller, so variant_acquire() hands out the variant of the
+// given frame if it is ready, or else the newest one that is, of an earlier
+// frame, and has the worker start on the given one; ESP_ERR_NOT_FOUND if
+// none is ready yet
+
+// the last few jpeg frames are also kept in a history ring (see
+// CAMWEBSRV_CAMERA_HISTORY_*); history_acquire() hands out the newest one
+// grabbed at or before the given time, history_range() every one grabbed in
+// between the two given times, oldest first, up to max; times are in
+// microseconds since boot, same as tstamp, and all of these are released the
+// same way as any other frame
+
+// with the motion control set to a threshold (1-1000, 0: off), each jpeg
+// frame is also checked for motion; motion_get() returns the score (per
+// mille of the image that changed) of the newest frame checked, and when the
+// score last reached the threshold (-1: never), or ESP_ERR_INVALID_STATE if
+// detection is off
+
+typedef struct
+{
+  const uint8_t *buf;
+  size_t len;
+  int64_t tstamp;
+  uint32_t seq;
+  uint16_t width;
+  uint16_t height;
+} camwebsrv_camera_frame_t;
+
+// camera controls, in the same order as their names sort, which the name
+// lookup relies on
+
+typedef enum
+{
+  CAMWEBSRV_CAMERA_CTRL_AE_LEVEL = 0,
+  CAMWEBSRV_CAMERA_CTRL_AEC,
+  CAMWEBSRV_CAMERA_CTRL_AEC2,
+  CAMWEBSRV_CAMERA_CTRL_AEC_VALUE,
+  CAMWEBSRV_CAMERA_CTRL_AGC,
+  CAMWEBSRV_CAMERA_CTRL_AGC_GAIN,
+  CAMWEBSRV_CAMERA_CTRL_AWB,
+  CAMWEBSRV_CAMERA_CTRL_AWB_GAIN,
+  CAMWEBSRV_CAMERA_CTRL_BPC,
+  CAMWEBSRV_CAMERA_CTRL_BRIGHTNESS,
+  CAMWEBSRV_CAMERA_CTRL_COLORBAR,
+  CAMWEBSRV_CAMERA_CTRL_CONTRAST,
+  CAMWEBSRV_CAMERA_CTRL_DCW,
+  CAMWEBSRV_CAMERA_CTRL_FLASH,
+  CAMWEBSRV_CAMERA_CTRL_FPS,
+  CAMWEBSRV_CAMERA_CTRL_FRAMESIZE,
+  CAMWEBSRV_CAMERA_CTRL_GAINCEILING,
+  CAMWEBSRV_CAMERA_CTRL_HMIRROR,
+  CAMWEBSRV_CAMERA_CTRL_LENC,
+  CAMWEBSRV_CAMERA_CTRL_MOTION,
+  CAMWEBSRV_CAMERA_CTRL_PIXFORMAT,
+  CAMWEBSRV_CAMERA_CTRL_QUALITY,
+  CAMWEBSRV_CAMERA_CTRL_RAW_GMA,
+  CAMWEBSRV_CAMERA_CTRL_SATURATION,
+  CAMWEBSRV_CAMERA_CTRL_SHARPNESS,
+  CAMWEBSRV_CAMERA_CTRL_SPECIAL_EFFECT,
+  CAMWEBSRV_CAMERA_CTRL_VFLIP,
+  CAMWEBSRV_CAMERA_CTRL_WB_MODE,
+  CAMWEBSRV_CAMERA_CTRL_WPC,
+  CAMWEBSRV_CAMERA_CTRL_MAX
+} camwebsrv_camera_ctrl_t;
+
+typedef struct
+{
+  camwebsrv_camera_ctrl_t ctrl;
+  int value;
+} camwebsrv_camera_ctrl_val_t;
+
+// ctrl_queue() takes a control change to be made by the capture task, in
+// one batch with any others queued within CAMWEBSRV_CAMERA_CTRL_FLUSH ms of
+// it; a later value for the same control replaces an earlier one, and values
+// that are already set are skipped, so a burst of them from a slider costs
+// a bus write or two rather than one per step; pixformat and framesize are
+// the exception, and are set before it returns, failures and all
+
+// ctrl_set_batch() makes several control changes in one go: all of them
+// are checked before anything is written, pixformat and framesize go
+// together in a single reconfigure, and values that are already set are
+// skipped; if a write fails, those already made are undone, as far as the
+// sensor lets us, before it returns; writes, if given, is the number of
+// writes made on success
+
+// a region of interest, in pixels of the sensor's full native resolution
+// (1600x1200 on an ov2640, 2048x1536 on an ov3660); roi_set() windows the
+// sensor onto it, so that only that part of the image is read out and
+// encoded, at full resolution; edges are rounded down to a multiple of
+// CAMWEBSRV_CAMERA_ROI_ALIGN, and w == 0 puts back the full view, as does
+// any change of framesize or pixformat; jpeg only, and the region has to fit
+// in the frame buffers that the driver was started with
+
+typedef struct
+{
+  uint16_t x;
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+} camwebsrv_camera_roi_t;
+
+// every control value and the region of interest, along with a version that
+// changes whenever any of them may have
+
+typedef struct
+{
+  uint32_t version;
+  int values[CAMWEBSRV_CAMERA_CTRL_MAX];
+  camwebsrv_camera_roi_t roi;
+} camwebsrv_camera_status_t;
+
+typedef struct
+{
+  uint32_t grabs;
+  uint32_t failures;
+  uint32_t reconfigs;
+  uint32_t reconfig_us;
+  uint32_t warmup_frames;
+  uint32_t warmup_us;
+  uint32_t motion_us;
+  uint32_t ctrl_queued;
+  uint32_t ctrl_writes;
+  uint32_t task_stack_free;
+} camwebsrv_camera_stats_t;
+
 esp_err_t camwebsrv_camera_init(camwebsrv_camera_t *cam);
 esp_err_t camwebsrv_camera_destroy(camwebsrv_camera_t *cam);
 esp_err_t camwebsrv_camera_reset(camwebsrv_camera_t cam);
-esp_err_t camwebsrv_camera_frame_grab(camwebsrv_camera_t cam, uint8_t **fbuf, size_t *flen, int64_t *tstamp);
-esp_err_t camwebsrv_camera_frame_dispose(camwebsrv_camera_t cam);
+esp_err_t camwebsrv_camera_warmup(camwebsrv_camera_t cam);
+esp_err_t camwebsrv_camera_frame_acquire(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t **frame);
+esp_err_t camwebsrv_camera_frame_next(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t **frame);
+esp_err_t camwebsrv_camera_frame_retain(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t *frame);
+esp_err_t camwebsrv_camera_frame_release(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t **frame);
+esp_err_t camwebsrv_camera_variant_acquire(camwebsrv_camera_t cam, const camwebsrv_camera_frame_t *src, uint8_t scale, uint8_t quality, const camwebsrv_camera_frame_t **frame);
+esp_err_t camwebsrv_camera_history_acquire(camwebsrv_camera_t cam, int64_t tstamp, const camwebsrv_camera_frame_t **frame);
+esp_err_t camwebsrv_camera_history_range(camwebsrv_camera_t cam, int64_t from, int64_t to, const camwebsrv_camera_frame_t **frames, size_t max, size_t *count);
+esp_err_t camwebsrv_camera_motion_get(camwebsrv_camera_t cam, uint16_t *score, int64_t *tmotion);
 esp_err_t camwebsrv_camera_ctrl_set(camwebsrv_camera_t cam, const char *name, int value);
 int camwebsrv_camera_ctrl_get(camwebsrv_camera_t cam, const char *name);
+camwebsrv_camera_ctrl_t camwebsrv_camera_ctrl_find(const char *name);
+const char *camwebsrv_camera_ctrl_name(camwebsrv_camera_ctrl_t ctrl);
+esp_err_t camwebsrv_camera_ctrl_set_id(camwebsrv_camera_t cam, camwebsrv_camera_ctrl_t ctrl, int value);
+esp_err_t camwebsrv_camera_ctrl_queue(camwebsrv_camera_t cam, camwebsrv_camera_ctrl_t ctrl, int value);
+esp_err_t camwebsrv_camera_ctrl_set_batch(camwebsrv_camera_t cam, const camwebsrv_camera_ctrl_val_t *vals, size_t count, size_t *writes);
+esp_err_t camwebsrv_camera_roi_set(camwebsrv_camera_t cam, const camwebsrv_camera_roi_t *roi);
+esp_err_t camwebsrv_camera_status_snapshot(camwebsrv_camera_t cam, camwebsrv_camera_status_t *status);
+uint32_t camwebsrv_camera_status_version(camwebsrv_camera_t cam);
 uint8_t camwebsrv_camera_fps_get(camwebsrv_camera_t cam);
+esp_err_t camwebsrv_camera_stats_get(camwebsrv_camera_t cam, camwebsrv_camera_stats_t *stats);
 bool camwebsrv_camera_is_ov3660(camwebsrv_camera_t cam);
 
 #endif
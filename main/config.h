@@ -17,18 +17,76 @@
 #define CAMWEBSRV_CFGMAN_KEY_PAIR_ID "pair_id"
 #define CAMWEBSRV_CFGMAN_KEY_ROLE "role"
 
-#define CAMWEBSRV_CAMERA_INITIAL_FRAME_SKIP 3
+#define CAMWEBSRV_CAMERA_FB_COUNT 3
+#define CAMWEBSRV_CAMERA_VARIANT_COUNT 4
+#define CAMWEBSRV_CAMERA_VARIANT_QUALITY 60
+#define CAMWEBSRV_CAMERA_VARIANT_STACK 6144
+#define CAMWEBSRV_CAMERA_VARIANT_PRIO 3
+#define CAMWEBSRV_CAMERA_VARIANT_CORE 0
 #define CAMWEBSRV_CAMERA_FPS_MIN 1
 #define CAMWEBSRV_CAMERA_FPS_MAX 8
 #define CAMWEBSRV_CAMERA_DEFAULT_FS 10
 #define CAMWEBSRV_CAMERA_DEFAULT_FPS 4
 #define CAMWEBSRV_CAMERA_DEFAULT_FLASH false
+#define CAMWEBSRV_CAMERA_DEFAULT_MOTION 0
+#define CAMWEBSRV_CAMERA_CAPTURE_TASK 1
+#define CAMWEBSRV_CAMERA_TASK_STACK 4096
+#define CAMWEBSRV_CAMERA_TASK_STACK_LOW 512
+#define CAMWEBSRV_CAMERA_TASK_PRIO 6
+#define CAMWEBSRV_CAMERA_TASK_CORE 1
+#define CAMWEBSRV_CAMERA_NEXT_TMOUT 2000
+#define CAMWEBSRV_CAMERA_DROP_TMOUT 4000
+#define CAMWEBSRV_CAMERA_CTRL_FLUSH 100
+#define CAMWEBSRV_CAMERA_ROI_ALIGN 8
+#define CAMWEBSRV_CAMERA_WARMUP_TMOUT 1500
+#define CAMWEBSRV_CAMERA_HISTORY_COUNT 32
+#define CAMWEBSRV_CAMERA_HISTORY_BYTES (2 * 1024 * 1024)
+#define CAMWEBSRV_CAMERA_REPLAY 0
+#define CAMWEBSRV_CAMERA_REPLAY_DIR CAMWEBSRV_SDCARD_MOUNT_PATH "/replay"
+#define CAMWEBSRV_CAMERA_REPLAY_FPS 10
+#define CAMWEBSRV_CAMERA_REPLAY_JITTER 0
+
+#define CAMWEBSRV_WARMUP_MIN_FRAMES 2
+#define CAMWEBSRV_WARMUP_STABLE_FRAMES 2
+#define CAMWEBSRV_WARMUP_TOLERANCE_PCT 4
+#define CAMWEBSRV_WARMUP_TOLERANCE_MIN 2
+
+#define CAMWEBSRV_MOTION_BLOCK 8
+#define CAMWEBSRV_MOTION_PIXEL_DIFF 12
+#define CAMWEBSRV_MOTION_BG_SHIFT 3
+#define CAMWEBSRV_MOTION_HOLD 3000
+
+#define CAMWEBSRV_RECORD_ENABLE 1
+#define CAMWEBSRV_RECORD_DIR CAMWEBSRV_SDCARD_MOUNT_PATH "/motion"
+#define CAMWEBSRV_RECORD_PREROLL 2000
+#define CAMWEBSRV_RECORD_POLL 100
+#define CAMWEBSRV_RECORD_TASK_STACK 4096
+#define CAMWEBSRV_RECORD_TASK_PRIO 4
+#define CAMWEBSRV_RECORD_TASK_CORE 0
+
+#define CAMWEBSRV_SEQCAP_CONTAINER 1
+#define CAMWEBSRV_SEQCAP_PREALLOC 1
+#define CAMWEBSRV_SEQCAP_RAW 0
+#define CAMWEBSRV_SEQCAP_JPEG_DIV 5
+#define CAMWEBSRV_SEQCAP_QUEUE_LEN (CAMWEBSRV_CAMERA_FB_COUNT - 2)
+#define CAMWEBSRV_SEQCAP_WRITER_STACK 8192
+#define CAMWEBSRV_SEQCAP_WRITER_PRIO 4
+#define CAMWEBSRV_SEQCAP_WRITER_CORE 0
+#define CAMWEBSRV_SEQCAP_SYNC_PULSE_US 5000
+#define CAMWEBSRV_SEQCAP_SLAVE_TMOUT 30000
+#define CAMWEBSRV_SEQCAP_STALE_RETRIES 2
 
 #define CAMWEBSRV_VBYTES_BSIZE 16
 
-#define CAMWEBSRV_SCLIENTS_BSIZE 8192
+#define CAMWEBSRV_SCLIENTS_RBUF_SIZE 512
+#define CAMWEBSRV_SCLIENTS_RBUF_HWM 256
+#define CAMWEBSRV_SCLIENTS_BPS_SHIFT 2
+#define CAMWEBSRV_SCLIENTS_MOTION_IDLE_FPS 1
 #define CAMWEBSRV_SCLIENTS_SEND_TMOUT 1000
 #define CAMWEBSRV_SCLIENTS_IDLE_TMOUT 3000
+#define CAMWEBSRV_SCLIENTS_TASK_STACK 4096
+#define CAMWEBSRV_SCLIENTS_TASK_PRIO 5
+#define CAMWEBSRV_SCLIENTS_TASK_CORE 1
 
 #define CAMWEBSRV_PING_TIMEOUT_MAX 3
 #define CAMWEBSRV_PING_TIMEOUT_SEND 5000
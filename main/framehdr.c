@@ -0,0 +1,171 @@
+// 2026-10-16 framehdr.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "framehdr.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// the chunk size, content length, timestamp and sequence number are filled
+// in between these
+
+#define _CAMWEBSRV_FRAMEHDR_RESP_PART_HDR_STR "--" CAMWEBSRV_FRAMEHDR_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: "
+#define _CAMWEBSRV_FRAMEHDR_RESP_PART_TSTAMP_STR "\r\nX-Timestamp: "
+#define _CAMWEBSRV_FRAMEHDR_RESP_PART_SEQ_STR "\r\nX-Frame-Seq: "
+#define _CAMWEBSRV_FRAMEHDR_RESP_PART_END_STR "\r\n\r\n"
+
+#define _CAMWEBSRV_FRAMEHDR_WS_OPCODE_BINARY 0x82
+
+// room for the chunk size in hex and its crlf, ahead of the part headers
+
+#define _CAMWEBSRV_FRAMEHDR_CHUNK_PREFIX_LEN (sizeof(size_t) * 2 + 2)
+
+static char *_camwebsrv_framehdr_put_part(char *p, const camwebsrv_camera_frame_t *frame);
+static char *_camwebsrv_framehdr_put_str(char *p, const char *str, size_t len);
+static char *_camwebsrv_framehdr_put_dec(char *p, uint64_t n, uint8_t width);
+static char *_camwebsrv_framehdr_put_le(char *p, uint64_t n, uint8_t width);
+
+size_t camwebsrv_framehdr_part(char *buf, const camwebsrv_camera_frame_t *frame, const char **hdr)
+{
+  char *p;
+
+  p = _camwebsrv_framehdr_put_part(buf, frame);
+
+  *hdr = buf;
+
+  return p - buf;
+}
+
+size_t camwebsrv_framehdr_chunk(char *buf, const camwebsrv_camera_frame_t *frame, const char **hdr)
+{
+  static const char hex[] = "0123456789abcdef";
+  char *start;
+  char *p;
+  size_t n;
+
+  // part headers go after the space reserved for the chunk size
+
+  p = _camwebsrv_framehdr_put_part(buf + _CAMWEBSRV_FRAMEHDR_CHUNK_PREFIX_LEN, frame);
+
+  // then the chunk size, which covers the part headers and the frame,
+  // written backwards into the reserved space
+
+  n = (p - (buf + _CAMWEBSRV_FRAMEHDR_CHUNK_PREFIX_LEN)) + frame->len;
+  start = buf + _CAMWEBSRV_FRAMEHDR_CHUNK_PREFIX_LEN;
+
+  *--start = '\n';
+  *--start = '\r';
+
+  do
+  {
+    *--start = hex[n & 0x0f];
+    n = n >> 4;
+  }
+  while(n > 0);
+
+  *hdr = start;
+
+  return p - start;
+}
+
+size_t camwebsrv_framehdr_ws(char *buf, const camwebsrv_camera_frame_t *frame, const char **hdr)
+{
+  char *p;
+  uint64_t n;
+  int8_t i;
+
+  // frame header: a single unmasked binary frame, with the payload length
+  // in the shortest form that will hold it, big-endian
+
+  n = CAMWEBSRV_FRAMEHDR_WS_META_LEN + frame->len;
+  p = buf;
+
+  *p++ = (char) _CAMWEBSRV_FRAMEHDR_WS_OPCODE_BINARY;
+
+  if (n < 126)
+  {
+    *p++ = (char) n;
+  }
+  else if (n < 65536)
+  {
+    *p++ = 126;
+    *p++ = (char) (n >> 8);
+    *p++ = (char) (n & 0xff);
+  }
+  else
+  {
+    *p++ = 127;
+
+    for (i = 7; i >= 0; i--)
+    {
+      *p++ = (char) ((n >> (i * 8)) & 0xff);
+    }
+  }
+
+  // then the frame metadata
+
+  p = _camwebsrv_framehdr_put_le(p, frame->seq, 4);
+  p = _camwebsrv_framehdr_put_le(p, (uint64_t) frame->tstamp, 8);
+  p = _camwebsrv_framehdr_put_le(p, frame->width, 2);
+  p = _camwebsrv_framehdr_put_le(p, frame->height, 2);
+
+  *hdr = buf;
+
+  return p - buf;
+}
+
+static char *_camwebsrv_framehdr_put_part(char *p, const camwebsrv_camera_frame_t *frame)
+{
+  p = _camwebsrv_framehdr_put_str(p, _CAMWEBSRV_FRAMEHDR_RESP_PART_HDR_STR, sizeof(_CAMWEBSRV_FRAMEHDR_RESP_PART_HDR_STR) - 1);
+  p = _camwebsrv_framehdr_put_dec(p, frame->len, 0);
+  p = _camwebsrv_framehdr_put_str(p, _CAMWEBSRV_FRAMEHDR_RESP_PART_TSTAMP_STR, sizeof(_CAMWEBSRV_FRAMEHDR_RESP_PART_TSTAMP_STR) - 1);
+  p = _camwebsrv_framehdr_put_dec(p, frame->tstamp / 1000000, 0);
+  *p++ = '.';
+  p = _camwebsrv_framehdr_put_dec(p, frame->tstamp % 1000000, 6);
+  p = _camwebsrv_framehdr_put_str(p, _CAMWEBSRV_FRAMEHDR_RESP_PART_SEQ_STR, sizeof(_CAMWEBSRV_FRAMEHDR_RESP_PART_SEQ_STR) - 1);
+  p = _camwebsrv_framehdr_put_dec(p, frame->seq, 0);
+  p = _camwebsrv_framehdr_put_str(p, _CAMWEBSRV_FRAMEHDR_RESP_PART_END_STR, sizeof(_CAMWEBSRV_FRAMEHDR_RESP_PART_END_STR) - 1);
+
+  return p;
+}
+
+static char *_camwebsrv_framehdr_put_str(char *p, const char *str, size_t len)
+{
+  memcpy(p, str, len);
+
+  return p + len;
+}
+
+static char *_camwebsrv_framehdr_put_dec(char *p, uint64_t n, uint8_t width)
+{
+  char tmp[20];
+  uint8_t i = 0;
+
+  // digits come out backwards; pad with zeros to the requested width
+
+  do
+  {
+    tmp[i++] = '0' + (n % 10);
+    n = n / 10;
+  }
+  while(n > 0 || i < width);
+
+  while(i > 0)
+  {
+    *p++ = tmp[--i];
+  }
+
+  return p;
+}
+
+static char *_camwebsrv_framehdr_put_le(char *p, uint64_t n, uint8_t width)
+{
+  while(width-- > 0)
+  {
+    *p++ = (char) (n & 0xff);
+    n = n >> 8;
+  }
+
+  return p;
+}
@@ -0,0 +1,34 @@
+// 2026-10-16 framehdr.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_FRAMEHDR_H
+#define _CAMWEBSRV_FRAMEHDR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "camera.h"
+
+// What goes out ahead of each frame on a stream, written without stdio.
+//
+// part() writes the multipart part headers that precede a frame's jpeg
+// data, with its capture time as sec.usec; chunk() writes the same, behind
+// the chunk size of an http stream, and the chunk ends with
+// CAMWEBSRV_FRAMEHDR_CHUNK_END_STR after the data. ws() writes the header
+// of a single unmasked binary websocket message, then the frame's sequence
+// number, capture timestamp (us), width and height, all little-endian,
+// which the jpeg data follows.
+//
+// All three write into a buffer of CAMWEBSRV_FRAMEHDR_LEN bytes, point hdr at
+// where the header starts in it, and return its length.
+
+#define CAMWEBSRV_FRAMEHDR_BOUNDARY "0123456789ABCDEF"
+#define CAMWEBSRV_FRAMEHDR_CHUNK_END_STR "\r\n"
+#define CAMWEBSRV_FRAMEHDR_WS_META_LEN 16
+#define CAMWEBSRV_FRAMEHDR_LEN 192
+
+size_t camwebsrv_framehdr_part(char *buf, const camwebsrv_camera_frame_t *frame, const char **hdr);
+size_t camwebsrv_framehdr_chunk(char *buf, const camwebsrv_camera_frame_t *frame, const char **hdr);
+size_t camwebsrv_framehdr_ws(char *buf, const camwebsrv_camera_frame_t *frame, const char **hdr);
+
+#endif
@@ -9,6 +9,9 @@
 #include "storage.h"
 #include "vbytes.h"
 #include "seqcap.h"
+#include "record.h"
+#include "sdraw.h"
+#include "framehdr.h"
 
 #include <stddef.h>
 #include <stdlib.h>
@@ -16,11 +19,15 @@
 #include <stdbool.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 
 #include <esp_log.h>
+#include <esp_random.h>
+#include <esp_timer.h>
 #include <esp_http_server.h>
 
 #include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 
 #define _CAMWEBSRV_HTTPD_SERVER_PORT 80
@@ -33,56 +40,55 @@
 #define _CAMWEBSRV_HTTPD_PATH_RESET   "/reset"
 #define _CAMWEBSRV_HTTPD_PATH_CONTROL "/control"
 #define _CAMWEBSRV_HTTPD_PATH_CAPTURE "/capture"
+#define _CAMWEBSRV_HTTPD_PATH_HISTORY "/history"
 #define _CAMWEBSRV_HTTPD_PATH_STREAM  "/stream"
+#define _CAMWEBSRV_HTTPD_PATH_STREAM_STATS "/stream/stats"
+#define _CAMWEBSRV_HTTPD_PATH_WS_STREAM "/ws/stream"
 #define _CAMWEBSRV_HTTPD_PATH_SEQ_CAP "/seq_cap"
 #define _CAMWEBSRV_HTTPD_PATH_CAP_SEQ_INIT "/cap_seq_init"
+#define _CAMWEBSRV_HTTPD_PATH_SEQ_EXPORT "/seq_export"
 
-#define _CAMWEBSRV_HTTPD_RESP_STATUS_STR "\
+#define _CAMWEBSRV_HTTPD_RESP_STREAM_STATS_STR "\
 {\n\
-  \"aec\": %u,\n\
-  \"aec2\": %u,\n\
-  \"aec_value\": %u,\n\
-  \"ae_level\": %d,\n\
-  \"agc\": %u,\n\
-  \"agc_gain\": %u,\n\
-  \"awb\": %u,\n\
-  \"awb_gain\": %u,\n\
-  \"bpc\": %u,\n\
-  \"brightness\": %d,\n\
-  \"colorbar\": %u,\n\
-  \"contrast\": %d,\n\
-  \"dcw\": %u,\n\
-  \"flash\": %d,\n\
-  \"fps\": %d,\n\
-  \"framesize\": %u,\n\
-  \"gainceiling\": %u,\n\
-  \"hmirror\": %u,\n\
-  \"lenc\": %u,\n\
-  \"quality\": %u,\n\
-  \"raw_gma\": %u,\n\
-  \"saturation\": %d,\n\
-  \"sharpness\": %d,\n\
-  \"special_effect\": %u,\n\
-  \"vflip\": %u,\n\
-  \"wb_mode\": %u,\n\
-  \"wpc\": %u\n\
-}\n \
+  \"grabs\": %" PRIu32 ",\n\
+  \"grab_failures\": %" PRIu32 ",\n\
+  \"reconfigs\": %" PRIu32 ",\n\
+  \"reconfig_us\": %" PRIu32 ",\n\
+  \"warmup_frames\": %" PRIu32 ",\n\
+  \"warmup_us\": %" PRIu32 ",\n\
+  \"motion_us\": %" PRIu32 ",\n\
+  \"ctrl_queued\": %" PRIu32 ",\n\
+  \"ctrl_writes\": %" PRIu32 ",\n\
+  \"task_stack_free\": %" PRIu32 ",\n\
+  \"clients\": \
 "
 
+#define _CAMWEBSRV_HTTPD_RESP_HISTORY_END_STR "--" CAMWEBSRV_FRAMEHDR_BOUNDARY "--\r\n"
+
 #define _CAMWEBSRV_HTTPD_PARAM_LEN 32
+#define _CAMWEBSRV_HTTPD_QUERY_LEN 64
+#define _CAMWEBSRV_HTTPD_ETAG_LEN 24
+#define _CAMWEBSRV_HTTPD_WS_CTRL_LEN 125
 
 typedef struct
 {
   httpd_handle_t handle;
-  SemaphoreHandle_t sema;
   camwebsrv_camera_t cam;
   camwebsrv_sclients_t sclients;
+  camwebsrv_record_t record;
   camwebsrv_cfgman_t cfgman;
+  camwebsrv_vbytes_t status;
+  uint32_t statusver;
+  uint32_t bootid;
+  TaskHandle_t stask;
+  SemaphoreHandle_t sdone;
+  volatile bool srun;
 } _camwebsrv_httpd_t;
 
 typedef struct
 {
   int sockfd;
+  camwebsrv_sclients_params_t params;
   _camwebsrv_httpd_t *phttpd;
 } _camwebsrv_httpd_worker_arg_t;
 
@@ -91,19 +97,26 @@ static esp_err_t _camwebsrv_httpd_handler_status(httpd_req_t *req);
 static esp_err_t _camwebsrv_httpd_handler_reset(httpd_req_t *req);
 static esp_err_t _camwebsrv_httpd_handler_control(httpd_req_t *req);
 static esp_err_t _camwebsrv_httpd_handler_capture(httpd_req_t *req);
+static esp_err_t _camwebsrv_httpd_handler_history(httpd_req_t *req);
 static esp_err_t _camwebsrv_httpd_handler_stream(httpd_req_t *req);
+static esp_err_t _camwebsrv_httpd_handler_stream_stats(httpd_req_t *req);
+static esp_err_t _camwebsrv_httpd_handler_ws_stream(httpd_req_t *req);
+static esp_err_t _camwebsrv_httpd_stream_queue(httpd_req_t *req, bool ws);
 static esp_err_t _camwebsrv_httpd_handler_seq_cap(httpd_req_t *req);
 static esp_err_t _camwebsrv_httpd_handler_cap_seq_init(httpd_req_t *req);
+static esp_err_t _camwebsrv_httpd_handler_seq_export(httpd_req_t *req);
 static bool _camwebsrv_httpd_static_cb(const char *buf, size_t len, void *arg);
 static void _camwebsrv_httpd_worker(void *arg);
+static void _camwebsrv_httpd_streamer(void *arg);
 static void _camwebsrv_httpd_noop(void *arg);
+static bool _qv_int(const char *qs, const char *key, int *out);
 
-esp_err_t camwebsrv_httpd_init(camwebsrv_httpd_t *httpd, SemaphoreHandle_t sema, camwebsrv_cfgman_t cfgman)
+esp_err_t camwebsrv_httpd_init(camwebsrv_httpd_t *httpd, camwebsrv_cfgman_t cfgman)
 {
   _camwebsrv_httpd_t *phttpd;
   esp_err_t rv;
 
-  if (httpd == NULL || sema == NULL || cfgman == NULL)
+  if (httpd == NULL || cfgman == NULL)
   {
     return ESP_ERR_INVALID_ARG;
   }
@@ -119,9 +132,13 @@ esp_err_t camwebsrv_httpd_init(camwebsrv_httpd_t *httpd, SemaphoreHandle_t sema,
 
   memset(phttpd, 0x00, sizeof(_camwebsrv_httpd_t));
 
-  phttpd->sema = sema;
   phttpd->cfgman = cfgman;
 
+  // tags are only unique within a boot, so mix in something that is not
+  // going to survive one
+
+  phttpd->bootid = esp_random();
+
   rv = camwebsrv_camera_init(&(phttpd->cam));
 
   if (rv != ESP_OK)
@@ -141,6 +158,47 @@ esp_err_t camwebsrv_httpd_init(camwebsrv_httpd_t *httpd, SemaphoreHandle_t sema,
     return ESP_FAIL;
   }
 
+  // motion recording is a nice-to-have; carry on without it if the sd card
+  // is not there
+
+  if (CAMWEBSRV_RECORD_ENABLE)
+  {
+    rv = camwebsrv_record_init(&(phttpd->record), phttpd->cam);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGW(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_init(): camwebsrv_record_init() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      phttpd->record = NULL;
+    }
+  }
+
+  // start streaming task
+
+  phttpd->sdone = xSemaphoreCreateBinary();
+
+  if (phttpd->sdone == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_init(): xSemaphoreCreateBinary() failed");
+    camwebsrv_record_destroy(&(phttpd->record));
+    camwebsrv_sclients_destroy(&(phttpd->sclients), phttpd->cam, NULL);
+    camwebsrv_camera_destroy(&(phttpd->cam));
+    free(phttpd);
+    return ESP_FAIL;
+  }
+
+  phttpd->srun = true;
+
+  if (xTaskCreatePinnedToCore(_camwebsrv_httpd_streamer, "httpd_stream", CAMWEBSRV_SCLIENTS_TASK_STACK, phttpd, CAMWEBSRV_SCLIENTS_TASK_PRIO, &(phttpd->stask), CAMWEBSRV_SCLIENTS_TASK_CORE) != pdPASS)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_init(): xTaskCreatePinnedToCore() failed");
+    vSemaphoreDelete(phttpd->sdone);
+    camwebsrv_record_destroy(&(phttpd->record));
+    camwebsrv_sclients_destroy(&(phttpd->sclients), phttpd->cam, NULL);
+    camwebsrv_camera_destroy(&(phttpd->cam));
+    free(phttpd);
+    return ESP_FAIL;
+  }
+
   *httpd = (camwebsrv_httpd_t) phttpd;
 
   return ESP_OK;
@@ -159,7 +217,15 @@ esp_err_t camwebsrv_httpd_stop(camwebsrv_httpd_t httpd)
     return ESP_OK;
   }
 
-  esp_err_t rv = httpd_stop(phttpd->handle);
+  // the streaming task stops serving once the server is down, so its
+  // clients would never let go of the frames they are sending
+  esp_err_t rv = camwebsrv_sclients_purge(phttpd->sclients, phttpd->cam, phttpd->handle);
+  if (rv != ESP_OK)
+  {
+    ESP_LOGW(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_stop(): camwebsrv_sclients_purge() failed: [%d]: %s", rv, esp_err_to_name(rv));
+  }
+
+  rv = httpd_stop(phttpd->handle);
   if (rv != ESP_OK)
   {
     ESP_LOGW(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_stop(): httpd_stop() failed: [%d]: %s", rv, esp_err_to_name(rv));
@@ -180,13 +246,30 @@ esp_err_t camwebsrv_httpd_destroy(camwebsrv_httpd_t *httpd)
 
   phttpd = (_camwebsrv_httpd_t *) *httpd;
 
-  rv = camwebsrv_sclients_destroy(&(phttpd->sclients), phttpd->handle);
+  // stop streaming task, and wait for it to finish its current pass
+
+  phttpd->srun = false;
+
+  camwebsrv_sclients_wake(phttpd->sclients);
+  xSemaphoreTake(phttpd->sdone, portMAX_DELAY);
+  vSemaphoreDelete(phttpd->sdone);
+
+  rv = camwebsrv_sclients_destroy(&(phttpd->sclients), phttpd->cam, phttpd->handle);
 
   if (rv != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_destroy(): camwebsrv_sclients_destroy() failed: [%d]: %s", rv, esp_err_to_name(rv));
   }
 
+  if (phttpd->status != NULL)
+  {
+    camwebsrv_vbytes_destroy(&(phttpd->status));
+  }
+
+  // the recorder holds frames too, so it has to go before the camera
+
+  camwebsrv_record_destroy(&(phttpd->record));
+
   rv = camwebsrv_camera_destroy(&(phttpd->cam));
 
   if (rv != ESP_OK)
@@ -311,6 +394,16 @@ esp_err_t camwebsrv_httpd_start(camwebsrv_httpd_t httpd)
 
   httpd_register_uri_handler(phttpd->handle, &uri);
 
+  // history
+
+  memset(&uri, 0x00, sizeof(uri));
+
+  uri.uri     = _CAMWEBSRV_HTTPD_PATH_HISTORY;
+  uri.method  = HTTP_GET;
+  uri.handler = _camwebsrv_httpd_handler_history;
+
+  httpd_register_uri_handler(phttpd->handle, &uri);
+
   // register stream
 
   memset(&uri, 0x00, sizeof(uri));
@@ -321,6 +414,26 @@ esp_err_t camwebsrv_httpd_start(camwebsrv_httpd_t httpd)
 
   httpd_register_uri_handler(phttpd->handle, &uri);
 
+  // register stream stats
+
+  memset(&uri, 0x00, sizeof(uri));
+  uri.uri     = _CAMWEBSRV_HTTPD_PATH_STREAM_STATS;
+  uri.method  = HTTP_GET;
+  uri.handler = _camwebsrv_httpd_handler_stream_stats;
+  httpd_register_uri_handler(phttpd->handle, &uri);
+
+  // register websocket stream
+
+  memset(&uri, 0x00, sizeof(uri));
+
+  uri.uri     = _CAMWEBSRV_HTTPD_PATH_WS_STREAM;
+  uri.method  = HTTP_GET;
+  uri.handler = _camwebsrv_httpd_handler_ws_stream;
+  uri.is_websocket = true;
+  uri.handle_ws_control_frames = true;
+
+  httpd_register_uri_handler(phttpd->handle, &uri);
+
   // register sequence capture (master)
 
   memset(&uri, 0x00, sizeof(uri));
@@ -341,36 +454,17 @@ esp_err_t camwebsrv_httpd_start(camwebsrv_httpd_t httpd)
 
   httpd_register_uri_handler(phttpd->handle, &uri);
 
-  ESP_LOGI(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_start(): started server on port %d", _CAMWEBSRV_HTTPD_SERVER_PORT);
-
-  return ESP_OK;
-}
-
-esp_err_t camwebsrv_httpd_process(camwebsrv_httpd_t httpd, uint16_t *nextevent)
-{
-  _camwebsrv_httpd_t *phttpd;
-  esp_err_t rv;
+  // register raw sequence export
 
-  if (httpd == NULL)
-  {
-    return ESP_ERR_INVALID_ARG;
-  }
-
-  phttpd = (_camwebsrv_httpd_t *) httpd;
+  memset(&uri, 0x00, sizeof(uri));
 
-  // If the HTTP server is stopped (sequence capture mode), nothing to do.
-  if (phttpd->handle == NULL)
-  {
-    return ESP_OK;
-  }
+  uri.uri     = _CAMWEBSRV_HTTPD_PATH_SEQ_EXPORT;
+  uri.method  = HTTP_GET;
+  uri.handler = _camwebsrv_httpd_handler_seq_export;
 
-  rv = camwebsrv_sclients_process(phttpd->sclients, phttpd->cam, phttpd->handle, nextevent);
+  httpd_register_uri_handler(phttpd->handle, &uri);
 
-  if (rv != ESP_OK)
-  {
-    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_process(): camwebsrv_sclients_process() failed: [%d]: %s", rv, esp_err_to_name(rv));
-    return rv;
-  }
+  ESP_LOGI(CAMWEBSRV_TAG, "HTTPD camwebsrv_httpd_start(): started server on port %d", _CAMWEBSRV_HTTPD_SERVER_PORT);
 
   return ESP_OK;
 }
@@ -419,77 +513,120 @@ static esp_err_t _camwebsrv_httpd_handler_status(httpd_req_t *req)
 {
   esp_err_t rv = ESP_OK;
   _camwebsrv_httpd_t *phttpd;
-  camwebsrv_vbytes_t vb;
+  camwebsrv_camera_status_t status;
   const uint8_t *buf;
+  uint32_t version;
+  char etag[_CAMWEBSRV_HTTPD_ETAG_LEN];
+  char inm[_CAMWEBSRV_HTTPD_ETAG_LEN];
+  uint8_t c;
 
   phttpd = (_camwebsrv_httpd_t *) httpd_get_global_user_ctx(req->handle);
 
-  // response type/header status
+  // response type/header status; the client has to check back every time,
+  // but usually gets a 304
 
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
   httpd_resp_set_type(req, "application/json");
-  httpd_resp_set_status(req, "200 OK");
 
-  // initialise and compose response buffer
+  version = camwebsrv_camera_status_version(phttpd->cam);
 
-  rv = camwebsrv_vbytes_init(&vb);
+  snprintf(etag, sizeof(etag), "\"%08" PRIx32 "-%08" PRIx32 "\"", phttpd->bootid, version);
 
-  if (rv != ESP_OK)
+  // nothing has changed since the client last looked
+
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK && strcmp(inm, etag) == 0)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_status(): camwebsrv_vbytes_init() failed: [%d]: %s", rv, esp_err_to_name(rv));
-    return rv;
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_status(req, "304 Not Modified");
+
+    rv = httpd_resp_send(req, NULL, 0);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_status(): httpd_resp_send() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      return rv;
+    }
+
+    return ESP_OK;
   }
 
-  rv = camwebsrv_vbytes_set_str(
-    vb,
-    _CAMWEBSRV_HTTPD_RESP_STATUS_STR,
-    camwebsrv_camera_ctrl_get(phttpd->cam, "aec"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "aec2"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "aec_value"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "ae_level"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "agc"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "agc_gain"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "awb"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "awb_gain"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "bpc"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "brightness"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "colorbar"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "contrast"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "dcw"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "flash"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "fps"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "framesize"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "gainceiling"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "hmirror"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "lenc"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "quality"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "raw_gma"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "saturation"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "sharpness"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "special_effect"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "vflip"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "wb_mode"),
-    camwebsrv_camera_ctrl_get(phttpd->cam, "wpc")
-  );
+  // render only if something has changed since the last render; this all
+  // happens in the one server task, so the cache needs no lock
 
-  if (rv != ESP_OK)
+  if (phttpd->status == NULL || phttpd->statusver != version)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_status(): camwebsrv_vbytes_set_str() failed: [%d]: %s", rv, esp_err_to_name(rv));
-    camwebsrv_vbytes_destroy(&vb);
-    return rv;
+    if (phttpd->status == NULL)
+    {
+      rv = camwebsrv_vbytes_init(&(phttpd->status));
+
+      if (rv != ESP_OK)
+      {
+        ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_status(): camwebsrv_vbytes_init() failed: [%d]: %s", rv, esp_err_to_name(rv));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+        return rv;
+      }
+    }
+
+    rv = camwebsrv_camera_status_snapshot(phttpd->cam, &status);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_status(): camwebsrv_camera_status_snapshot() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+      return rv;
+    }
+
+    rv = camwebsrv_vbytes_set_str(phttpd->status, "{\n");
+
+    for (c = 0; rv == ESP_OK && c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+    {
+      rv = camwebsrv_vbytes_append_str(
+        phttpd->status,
+        "  \"%s\": %d,\n",
+        camwebsrv_camera_ctrl_name(c),
+        status.values[c]
+      );
+    }
+
+    rv = rv == ESP_OK ? camwebsrv_vbytes_append_str(
+      phttpd->status,
+      "  \"roi_x\": %u,\n  \"roi_y\": %u,\n  \"roi_w\": %u,\n  \"roi_h\": %u\n}\n",
+      status.roi.x,
+      status.roi.y,
+      status.roi.w,
+      status.roi.h
+    ) : rv;
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_status(): camwebsrv_vbytes_append_str() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      camwebsrv_vbytes_destroy(&(phttpd->status));
+      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+      return rv;
+    }
+
+    // the snapshot may be newer than the version read above
+
+    phttpd->statusver = status.version;
+
+    snprintf(etag, sizeof(etag), "\"%08" PRIx32 "-%08" PRIx32 "\"", phttpd->bootid, status.version);
   }
 
-  rv  = camwebsrv_vbytes_get_bytes(vb, &buf, NULL);
+  rv = camwebsrv_vbytes_get_bytes(phttpd->status, &buf, NULL);
 
   if (rv != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_status(): camwebsrv_vbytes_get_bytes() failed: [%d]: %s", rv, esp_err_to_name(rv));
-    camwebsrv_vbytes_destroy(&vb);
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
     return rv;
   }
 
   // send response
 
+  httpd_resp_set_hdr(req, "ETag", etag);
+  httpd_resp_set_status(req, "200 OK");
+
   rv = httpd_resp_sendstr(req, (char *) buf);
 
   if (rv != ESP_OK)
@@ -499,8 +636,6 @@ static esp_err_t _camwebsrv_httpd_handler_status(httpd_req_t *req)
     return rv;
   }
 
-  camwebsrv_vbytes_destroy(&vb);
-
   ESP_LOGI(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_status(%d): served %s", httpd_req_to_sockfd(req), req->uri);
 
   return ESP_OK;
@@ -521,7 +656,7 @@ static esp_err_t _camwebsrv_httpd_handler_reset(httpd_req_t *req)
 
   // boot out all clients
 
-  rv = camwebsrv_sclients_purge(phttpd->sclients, phttpd->handle);
+  rv = camwebsrv_sclients_purge(phttpd->sclients, phttpd->cam, phttpd->handle);
 
   if (rv != ESP_OK)
   {
@@ -537,6 +672,16 @@ static esp_err_t _camwebsrv_httpd_handler_reset(httpd_req_t *req)
   if (rv != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_reset(): camwebsrv_camera_reset() failed: [%d]: %s", rv, esp_err_to_name(rv));
+
+    // someone is still holding on to a frame; worth trying again later
+
+    if (rv == ESP_ERR_TIMEOUT)
+    {
+      httpd_resp_set_status(req, "503 Service Unavailable");
+      httpd_resp_set_hdr(req, "Retry-After", "1");
+      return httpd_resp_send(req, NULL, 0);
+    }
+
     httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
     return rv;
   }
@@ -564,6 +709,11 @@ static esp_err_t _camwebsrv_httpd_handler_control(httpd_req_t *req)
   char *buf;
   char bvar[_CAMWEBSRV_HTTPD_PARAM_LEN];
   char bval[_CAMWEBSRV_HTTPD_PARAM_LEN];
+  camwebsrv_camera_roi_t roi;
+  int x = 0;
+  int y = 0;
+  int w = 0;
+  int h = 0;
   _camwebsrv_httpd_t *phttpd;
 
   phttpd = (_camwebsrv_httpd_t *) httpd_get_global_user_ctx(req->handle);
@@ -625,40 +775,78 @@ static esp_err_t _camwebsrv_httpd_handler_control(httpd_req_t *req)
     return rv;
   }
 
-  // get variable value from query string
+  // the region of interest takes four values rather than one, and goes
+  // straight to the sensor rather than through the queue
 
-  rv = httpd_query_key_value(buf, "val", bval, sizeof(bval) - 1);
-
-  if (rv != ESP_OK)
+  if (strcmp(bvar, "roi") == 0)
   {
-    free(buf);
-    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_control(): httpd_query_key_value(\"val\") failed: [%d]: %s", rv, esp_err_to_name(rv));
-    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
-    return rv;
-  }
+    _qv_int(buf, "x", &x);
+    _qv_int(buf, "y", &y);
+    _qv_int(buf, "w", &w);
+    _qv_int(buf, "h", &h);
 
-  // we don't need the query string buffer anymore
+    free(buf);
 
-  free(buf);
+    if (x < 0 || y < 0 || w < 0 || h < 0 || x > UINT16_MAX || y > UINT16_MAX || w > UINT16_MAX || h > UINT16_MAX)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_control(): failed; invalid roi %d, %d, %d, %d", x, y, w, h);
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+      return ESP_ERR_INVALID_ARG;
+    }
 
-  // set camera variable
+    roi.x = (uint16_t) x;
+    roi.y = (uint16_t) y;
+    roi.w = (uint16_t) w;
+    roi.h = (uint16_t) h;
 
-  rv = camwebsrv_camera_ctrl_set(phttpd->cam, bvar, atoi(bval));
+    rv = camwebsrv_camera_roi_set(phttpd->cam, &roi);
 
-  if (rv != ESP_OK)
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_control(): camwebsrv_camera_roi_set(%d, %d, %d, %d) failed: [%d]: %s", x, y, w, h, rv, esp_err_to_name(rv));
+      httpd_resp_send_err(req, rv == ESP_FAIL ? HTTPD_500_INTERNAL_SERVER_ERROR : HTTPD_400_BAD_REQUEST, NULL);
+      return rv;
+    }
+  }
+  else
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_control(): camwebsrv_camera_ctrl_set(\"%s\", %s) failed", bvar, bval);
+    // get variable value from query string
+
+    rv = httpd_query_key_value(buf, "val", bval, sizeof(bval) - 1);
 
-    if (rv == ESP_ERR_INVALID_ARG)
+    if (rv != ESP_OK)
     {
+      free(buf);
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_control(): httpd_query_key_value(\"val\") failed: [%d]: %s", rv, esp_err_to_name(rv));
       httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+      return rv;
     }
-    else
+
+    // we don't need the query string buffer anymore
+
+    free(buf);
+
+    // set camera variable; queued, so that a slider being dragged about
+    // does not turn into a bus write per step, except for mode changes,
+    // which are made before this returns
+
+    rv = camwebsrv_camera_ctrl_queue(phttpd->cam, camwebsrv_camera_ctrl_find(bvar), atoi(bval));
+
+    if (rv != ESP_OK)
     {
-      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_control(): camwebsrv_camera_ctrl_queue(\"%s\", %s) failed", bvar, bval);
+
+      if (rv == ESP_ERR_INVALID_ARG)
+      {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+      }
+      else
+      {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+      }
+
+      return rv;
     }
-
-    return rv;
   }
 
   // send response
@@ -680,9 +868,10 @@ static esp_err_t _camwebsrv_httpd_handler_control(httpd_req_t *req)
 static esp_err_t _camwebsrv_httpd_handler_capture(httpd_req_t *req)
 {
   esp_err_t rv;
-  uint8_t *fbuf = NULL;
-  size_t flen = 0;
+  const camwebsrv_camera_frame_t *frame = NULL;
   _camwebsrv_httpd_t *phttpd;
+  char qs[_CAMWEBSRV_HTTPD_QUERY_LEN];
+  int age = 0;
 
   phttpd = (_camwebsrv_httpd_t *) httpd_get_global_user_ctx(req->handle);
 
@@ -693,18 +882,46 @@ static esp_err_t _camwebsrv_httpd_handler_capture(httpd_req_t *req)
   httpd_resp_set_type(req, "image/jpeg");
   httpd_resp_set_status(req, "200 OK");
 
-  rv = camwebsrv_camera_frame_grab(phttpd->cam, &fbuf, &flen, NULL);
+  // age_ms asks for what the camera saw that long ago, out of the history,
+  // rather than for the current frame
 
-  if (rv != ESP_OK)
+  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_capture(): camwebsrv_camera_frame_grab() failed: [%d]: %s", rv, esp_err_to_name(rv));
-    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
-    return rv;
+    _qv_int(qs, "age_ms", &age);
+  }
+
+  if (age > 0)
+  {
+    rv = camwebsrv_camera_history_acquire(phttpd->cam, esp_timer_get_time() - ((int64_t) age * 1000), &frame);
+
+    if (rv == ESP_ERR_NOT_FOUND)
+    {
+      httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No frame that old");
+      return ESP_OK;
+    }
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_capture(): camwebsrv_camera_history_acquire() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+      return rv;
+    }
+  }
+  else
+  {
+    rv = camwebsrv_camera_frame_acquire(phttpd->cam, &frame);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_capture(): camwebsrv_camera_frame_acquire() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+      return rv;
+    }
   }
 
-  rv = httpd_resp_send(req, (const char *) fbuf, (ssize_t) flen);
+  rv = httpd_resp_send(req, (const char *) frame->buf, (ssize_t) frame->len);
 
-  camwebsrv_camera_frame_dispose(phttpd->cam);
+  camwebsrv_camera_frame_release(phttpd->cam, &frame);
 
   if (rv != ESP_OK)
   {
@@ -718,11 +935,318 @@ static esp_err_t _camwebsrv_httpd_handler_capture(httpd_req_t *req)
   return ESP_OK;
 }
 
+static esp_err_t _camwebsrv_httpd_handler_history(httpd_req_t *req)
+{
+  esp_err_t rv = ESP_OK;
+  const camwebsrv_camera_frame_t *frames[CAMWEBSRV_CAMERA_HISTORY_COUNT];
+  _camwebsrv_httpd_t *phttpd;
+  char qs[_CAMWEBSRV_HTTPD_QUERY_LEN];
+  char part[CAMWEBSRV_FRAMEHDR_LEN];
+  const char *hdr;
+  int from = -1;
+  int to = 0;
+  int64_t now;
+  size_t count;
+  size_t i;
+  size_t plen;
+
+  phttpd = (_camwebsrv_httpd_t *) httpd_get_global_user_ctx(req->handle);
+
+  // from and to are ages in ms, so from=5000&to=0 is the last five seconds;
+  // without from, it is everything in the history
+
+  if (httpd_req_get_url_query_str(req, qs, sizeof(qs)) == ESP_OK)
+  {
+    _qv_int(qs, "from", &from);
+    _qv_int(qs, "to", &to);
+  }
+
+  now = esp_timer_get_time();
+
+  rv = camwebsrv_camera_history_range(
+    phttpd->cam,
+    from < 0 ? 0 : now - ((int64_t) from * 1000),
+    now - ((int64_t) (to < 0 ? 0 : to) * 1000),
+    frames,
+    CAMWEBSRV_CAMERA_HISTORY_COUNT,
+    &count
+  );
+
+  if (rv != ESP_OK)
+  {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad range");
+    return ESP_OK;
+  }
+
+  if (count == 0)
+  {
+    httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No frames in range");
+    return ESP_OK;
+  }
+
+  // response type/header status
+
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_set_type(req, "multipart/mixed;boundary=" CAMWEBSRV_FRAMEHDR_BOUNDARY);
+  httpd_resp_set_status(req, "200 OK");
+
+  // one part per frame, oldest first, each carrying its capture time, in
+  // the same headers as a /stream part
+
+  for (i = 0; i < count && rv == ESP_OK; i++)
+  {
+    plen = camwebsrv_framehdr_part(part, frames[i], &hdr);
+
+    rv = httpd_resp_send_chunk(req, hdr, (ssize_t) plen);
+
+    if (rv == ESP_OK)
+    {
+      rv = httpd_resp_send_chunk(req, (const char *) frames[i]->buf, (ssize_t) frames[i]->len);
+    }
+
+    if (rv == ESP_OK)
+    {
+      rv = httpd_resp_send_chunk(req, "\r\n", 2);
+    }
+  }
+
+  if (rv == ESP_OK)
+  {
+    rv = httpd_resp_send_chunk(req, _CAMWEBSRV_HTTPD_RESP_HISTORY_END_STR, sizeof(_CAMWEBSRV_HTTPD_RESP_HISTORY_END_STR) - 1);
+  }
+
+  if (rv == ESP_OK)
+  {
+    rv = httpd_resp_send_chunk(req, NULL, 0);
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    camwebsrv_camera_frame_release(phttpd->cam, &(frames[i]));
+  }
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_history(): httpd_resp_send_chunk() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_history(%d): served %u frames", httpd_req_to_sockfd(req), count);
+
+  return ESP_OK;
+}
+
 static esp_err_t _camwebsrv_httpd_handler_stream(httpd_req_t *req)
+{
+  esp_err_t rv;
+
+  rv = _camwebsrv_httpd_stream_queue(req, false);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream(): _camwebsrv_httpd_stream_queue() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream(%d): served %s", httpd_req_to_sockfd(req), req->uri);
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_httpd_handler_stream_stats(httpd_req_t *req)
+{
+  esp_err_t rv = ESP_OK;
+  _camwebsrv_httpd_t *phttpd;
+  camwebsrv_camera_stats_t cstats;
+  camwebsrv_vbytes_t vb;
+  const uint8_t *buf;
+
+  phttpd = (_camwebsrv_httpd_t *) httpd_get_global_user_ctx(req->handle);
+
+  // response type/header status
+
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_status(req, "200 OK");
+
+  // initialise and compose response buffer
+
+  rv = camwebsrv_camera_stats_get(phttpd->cam, &cstats);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream_stats(): camwebsrv_camera_stats_get() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    return rv;
+  }
+
+  rv = camwebsrv_vbytes_init(&vb);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream_stats(): camwebsrv_vbytes_init() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    return rv;
+  }
+
+  rv = camwebsrv_vbytes_set_str(vb, _CAMWEBSRV_HTTPD_RESP_STREAM_STATS_STR, cstats.grabs, cstats.failures, cstats.reconfigs, cstats.reconfig_us, cstats.warmup_frames, cstats.warmup_us, cstats.motion_us, cstats.ctrl_queued, cstats.ctrl_writes, cstats.task_stack_free);
+
+  if (rv == ESP_OK)
+  {
+    rv = camwebsrv_sclients_stats(phttpd->sclients, vb);
+  }
+
+  if (rv == ESP_OK)
+  {
+    rv = camwebsrv_vbytes_append_str(vb, "\n}\n");
+  }
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream_stats(): failed to compose response: [%d]: %s", rv, esp_err_to_name(rv));
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    camwebsrv_vbytes_destroy(&vb);
+    return rv;
+  }
+
+  rv  = camwebsrv_vbytes_get_bytes(vb, &buf, NULL);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream_stats(): camwebsrv_vbytes_get_bytes() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    camwebsrv_vbytes_destroy(&vb);
+    return rv;
+  }
+
+  // send response
+
+  rv = httpd_resp_sendstr(req, (char *) buf);
+
+  camwebsrv_vbytes_destroy(&vb);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream_stats(): httpd_resp_sendstr() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream_stats(%d): served %s", httpd_req_to_sockfd(req), req->uri);
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_httpd_handler_ws_stream(httpd_req_t *req)
+{
+  esp_err_t rv;
+  _camwebsrv_httpd_t *phttpd;
+  httpd_ws_frame_t pkt;
+  uint8_t buf[_CAMWEBSRV_HTTPD_WS_CTRL_LEN];
+  uint32_t seq;
+
+  phttpd = (_camwebsrv_httpd_t *) httpd_get_global_user_ctx(req->handle);
+
+  // the server has already done the handshake by the time we see the GET;
+  // from here on, the socket is handed over just like a /stream one
+
+  if (req->method == HTTP_GET)
+  {
+    rv = _camwebsrv_httpd_stream_queue(req, true);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_ws_stream(): _camwebsrv_httpd_stream_queue() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      return ESP_FAIL;
+    }
+
+    ESP_LOGI(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_ws_stream(%d): served %s", httpd_req_to_sockfd(req), req->uri);
+
+    return ESP_OK;
+  }
+
+  // anything else is a message from the client: control frames, which we
+  // answer ourselves, through the streaming task, since it is the only one
+  // writing to the socket; and acknowledgements, carrying the little-endian
+  // sequence number of the frame the client has just received
+
+  memset(&pkt, 0x00, sizeof(pkt));
+
+  rv = httpd_ws_recv_frame(req, &pkt, 0);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_ws_stream(%d): httpd_ws_recv_frame() failed: [%d]: %s", httpd_req_to_sockfd(req), rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  if (pkt.len > sizeof(buf))
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_ws_stream(%d): failed; unexpected %u byte message", httpd_req_to_sockfd(req), pkt.len);
+    return ESP_FAIL;
+  }
+
+  // pings and closes may come without a payload
+
+  pkt.payload = buf;
+
+  rv = pkt.len > 0 ? httpd_ws_recv_frame(req, &pkt, sizeof(buf)) : ESP_OK;
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_ws_stream(%d): httpd_ws_recv_frame() failed: [%d]: %s", httpd_req_to_sockfd(req), rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  if (pkt.type == HTTPD_WS_TYPE_PING || pkt.type == HTTPD_WS_TYPE_CLOSE)
+  {
+    rv = camwebsrv_sclients_ws_control(phttpd->sclients, httpd_req_to_sockfd(req), pkt.type, buf, pkt.len);
+
+    // if the streaming task doesn't know about it, there is nobody to
+    // answer a close but us, and no reason to keep the socket open
+
+    if (rv == ESP_ERR_NOT_FOUND && pkt.type == HTTPD_WS_TYPE_CLOSE)
+    {
+      return ESP_FAIL;
+    }
+
+    if (rv != ESP_OK && rv != ESP_ERR_NOT_FOUND)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_ws_stream(%d): camwebsrv_sclients_ws_control() failed: [%d]: %s", httpd_req_to_sockfd(req), rv, esp_err_to_name(rv));
+      return rv;
+    }
+
+    return ESP_OK;
+  }
+
+  if (pkt.type != HTTPD_WS_TYPE_BINARY || pkt.len != 4)
+  {
+    return ESP_OK;
+  }
+
+  seq = (uint32_t) buf[0] | ((uint32_t) buf[1] << 8) | ((uint32_t) buf[2] << 16) | ((uint32_t) buf[3] << 24);
+
+  // the client may already have been dropped by the streaming task
+
+  rv = camwebsrv_sclients_ack(phttpd->sclients, httpd_req_to_sockfd(req), seq);
+
+  if (rv != ESP_OK && rv != ESP_ERR_NOT_FOUND)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_ws_stream(%d): camwebsrv_sclients_ack() failed: [%d]: %s", httpd_req_to_sockfd(req), rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_httpd_stream_queue(httpd_req_t *req, bool ws)
 {
   esp_err_t rv;
   _camwebsrv_httpd_t *phttpd;
   _camwebsrv_httpd_worker_arg_t *parg;
+  char qs[_CAMWEBSRV_HTTPD_PARAM_LEN * 4];
+  size_t len;
 
   phttpd = (_camwebsrv_httpd_t *) httpd_get_global_user_ctx(req->handle);
 
@@ -731,26 +1255,57 @@ static esp_err_t _camwebsrv_httpd_handler_stream(httpd_req_t *req)
   if (parg == NULL)
   {
     int e = errno;
-    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream(): malloc() failed: [%d]: %s", e, strerror(e));
-    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_stream_queue(): malloc() failed: [%d]: %s", e, strerror(e));
     return ESP_FAIL;
   }
 
   parg->phttpd = phttpd;
   parg->sockfd = httpd_req_to_sockfd(req);
 
+  // optional per-client parameters: fps cap, size divisor (1, 2, 4 or 8)
+  // and jpeg quality (1-100), plus, for websocket clients only, the credit
+  // window (1-255); anything else is ignored
+
+  memset(&(parg->params), 0x00, sizeof(parg->params));
+
+  parg->params.ws = ws;
+
+  len = httpd_req_get_url_query_len(req) + 1;
+
+  if (len > 1 && len <= sizeof(qs) && httpd_req_get_url_query_str(req, qs, len) == ESP_OK)
+  {
+    int v;
+
+    if (_qv_int(qs, "fps", &v) && v >= CAMWEBSRV_CAMERA_FPS_MIN && v <= CAMWEBSRV_CAMERA_FPS_MAX)
+    {
+      parg->params.fps = v;
+    }
+
+    if (_qv_int(qs, "size", &v))
+    {
+      parg->params.scale = (v == 2) ? 1 : (v == 4) ? 2 : (v == 8) ? 3 : 0;
+    }
+
+    if (_qv_int(qs, "quality", &v) && v >= 1 && v <= 100)
+    {
+      parg->params.quality = v;
+    }
+
+    if (ws && _qv_int(qs, "credits", &v) && v >= 1 && v <= UINT8_MAX)
+    {
+      parg->params.credits = v;
+    }
+  }
+
   rv = httpd_queue_work(req->handle, _camwebsrv_httpd_worker, parg);
 
   if (rv != ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream(): httpd_queue_work() failed: [%d]: %s", rv, esp_err_to_name(rv));
-    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_stream_queue(): httpd_queue_work() failed: [%d]: %s", rv, esp_err_to_name(rv));
     free(parg);
-    return ESP_FAIL;
+    return rv;
   }
 
-  ESP_LOGI(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_stream(%d): served %s", httpd_req_to_sockfd(req), req->uri);
-
   return ESP_OK;
 }
 
@@ -915,34 +1470,19 @@ static esp_err_t _camwebsrv_httpd_handler_seq_cap(httpd_req_t *req)
   // optional timing
   seqcap_cfg.slave_prepare_delay_ms = 200;
   seqcap_cfg.inter_frame_delay_ms = 0;
+  seqcap_cfg.target_fps = 0;
   _qv_int(qs, "slave_prepare_delay_ms", &seqcap_cfg.slave_prepare_delay_ms);
   _qv_int(qs, "inter_frame_delay_ms", &seqcap_cfg.inter_frame_delay_ms);
+  _qv_int(qs, "target_fps", &seqcap_cfg.target_fps);
 
   // optional camera settings
-  _cfg_try_int(qs, "quality", &seqcap_cfg.has_quality, &seqcap_cfg.quality);
-  _cfg_try_int(qs, "brightness", &seqcap_cfg.has_brightness, &seqcap_cfg.brightness);
-  _cfg_try_int(qs, "contrast", &seqcap_cfg.has_contrast, &seqcap_cfg.contrast);
-  _cfg_try_int(qs, "saturation", &seqcap_cfg.has_saturation, &seqcap_cfg.saturation);
-  _cfg_try_int(qs, "sharpness", &seqcap_cfg.has_sharpness, &seqcap_cfg.sharpness);
-  _cfg_try_int(qs, "special_effect", &seqcap_cfg.has_special_effect, &seqcap_cfg.special_effect);
-  _cfg_try_int(qs, "wb_mode", &seqcap_cfg.has_wb_mode, &seqcap_cfg.wb_mode);
-  _cfg_try_int(qs, "aec", &seqcap_cfg.has_aec, &seqcap_cfg.aec);
-  _cfg_try_int(qs, "aec2", &seqcap_cfg.has_aec2, &seqcap_cfg.aec2);
-  _cfg_try_int(qs, "aec_value", &seqcap_cfg.has_aec_value, &seqcap_cfg.aec_value);
-  _cfg_try_int(qs, "ae_level", &seqcap_cfg.has_ae_level, &seqcap_cfg.ae_level);
-  _cfg_try_int(qs, "agc", &seqcap_cfg.has_agc, &seqcap_cfg.agc);
-  _cfg_try_int(qs, "agc_gain", &seqcap_cfg.has_agc_gain, &seqcap_cfg.agc_gain);
-  _cfg_try_int(qs, "gainceiling", &seqcap_cfg.has_gainceiling, &seqcap_cfg.gainceiling);
-  _cfg_try_int(qs, "awb", &seqcap_cfg.has_awb, &seqcap_cfg.awb);
-  _cfg_try_int(qs, "awb_gain", &seqcap_cfg.has_awb_gain, &seqcap_cfg.awb_gain);
-  _cfg_try_int(qs, "dcw", &seqcap_cfg.has_dcw, &seqcap_cfg.dcw);
-  _cfg_try_int(qs, "bpc", &seqcap_cfg.has_bpc, &seqcap_cfg.bpc);
-  _cfg_try_int(qs, "wpc", &seqcap_cfg.has_wpc, &seqcap_cfg.wpc);
-  _cfg_try_int(qs, "hmirror", &seqcap_cfg.has_hmirror, &seqcap_cfg.hmirror);
-  _cfg_try_int(qs, "vflip", &seqcap_cfg.has_vflip, &seqcap_cfg.vflip);
-  _cfg_try_int(qs, "lenc", &seqcap_cfg.has_lenc, &seqcap_cfg.lenc);
-  _cfg_try_int(qs, "raw_gma", &seqcap_cfg.has_raw_gma, &seqcap_cfg.raw_gma);
-  _cfg_try_int(qs, "colorbar", &seqcap_cfg.has_colorbar, &seqcap_cfg.colorbar);
+  for (camwebsrv_camera_ctrl_t c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+  {
+    if (c == CAMWEBSRV_CAMERA_CTRL_PIXFORMAT || c == CAMWEBSRV_CAMERA_CTRL_FRAMESIZE ||
+        c == CAMWEBSRV_CAMERA_CTRL_FLASH || c == CAMWEBSRV_CAMERA_CTRL_FPS)
+      continue;
+    _cfg_try_int(qs, camwebsrv_camera_ctrl_name(c), &seqcap_cfg.has_ctrl[c], &seqcap_cfg.ctrl[c]);
+  }
 
   // Determine slave host
   char slave_host[96] = {0};
@@ -970,10 +1510,11 @@ static esp_err_t _camwebsrv_httpd_handler_seq_cap(httpd_req_t *req)
   ESP_LOGI(CAMWEBSRV_TAG, "  cap_amount: %d", seqcap_cfg.cap_amount);
   ESP_LOGI(CAMWEBSRV_TAG, "  slave_prepare_delay_ms: %d", seqcap_cfg.slave_prepare_delay_ms);
   ESP_LOGI(CAMWEBSRV_TAG, "  inter_frame_delay_ms: %d", seqcap_cfg.inter_frame_delay_ms);
-  if (seqcap_cfg.has_quality) ESP_LOGI(CAMWEBSRV_TAG, "  quality: %d", seqcap_cfg.quality);
-  if (seqcap_cfg.has_brightness) ESP_LOGI(CAMWEBSRV_TAG, "  brightness: %d", seqcap_cfg.brightness);
-  if (seqcap_cfg.has_contrast) ESP_LOGI(CAMWEBSRV_TAG, "  contrast: %d", seqcap_cfg.contrast);
-  if (seqcap_cfg.has_saturation) ESP_LOGI(CAMWEBSRV_TAG, "  saturation: %d", seqcap_cfg.saturation);
+  ESP_LOGI(CAMWEBSRV_TAG, "  target_fps: %d", seqcap_cfg.target_fps);
+  for (camwebsrv_camera_ctrl_t c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+  {
+    if (seqcap_cfg.has_ctrl[c]) ESP_LOGI(CAMWEBSRV_TAG, "  %s: %d", camwebsrv_camera_ctrl_name(c), seqcap_cfg.ctrl[c]);
+  }
 
   rv = camwebsrv_seqcap_start_master(phttpd->cam, (camwebsrv_httpd_t)phttpd, &seqcap_cfg, slave_host);
   if (rv != ESP_OK)
@@ -1081,7 +1622,7 @@ static void _camwebsrv_httpd_worker(void *arg)
 
   parg = (_camwebsrv_httpd_worker_arg_t *) arg;
 
-  rv = camwebsrv_sclients_add(parg->phttpd->sclients, parg->sockfd);
+  rv = camwebsrv_sclients_add(parg->phttpd->sclients, parg->sockfd, &(parg->params));
 
   if (rv != ESP_OK)
   {
@@ -1089,13 +1630,93 @@ static void _camwebsrv_httpd_worker(void *arg)
     httpd_sess_trigger_close(parg->phttpd->handle, parg->sockfd);
   }
 
-  // trigger new event
-  
-  xSemaphoreGive(parg->phttpd->sema);
-
   free(parg);
 }
 
+static void _camwebsrv_httpd_streamer(void *arg)
+{
+  _camwebsrv_httpd_t *phttpd;
+  esp_err_t rv;
+
+  phttpd = (_camwebsrv_httpd_t *) arg;
+
+  while(phttpd->srun)
+  {
+    uint16_t nextevent = UINT16_MAX;
+
+    // nothing to do while sequence capture has the camera, or while the
+    // server is stopped
+
+    if (camwebsrv_seqcap_is_active() || phttpd->handle == NULL)
+    {
+      vTaskDelay(pdMS_TO_TICKS(50));
+      continue;
+    }
+
+    // send whatever the clients are ready for
+
+    rv = camwebsrv_sclients_process(phttpd->sclients, phttpd->cam, phttpd->handle, &nextevent);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_streamer(): camwebsrv_sclients_process() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      nextevent = CAMWEBSRV_MAIN_MIN_CYCLE_MSEC;
+    }
+
+    // then block until a socket drains, a client arrives, or the next frame
+    // is due
+
+    rv = camwebsrv_sclients_wait(phttpd->sclients, nextevent);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_streamer(): camwebsrv_sclients_wait() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      vTaskDelay(pdMS_TO_TICKS(CAMWEBSRV_MAIN_MIN_CYCLE_MSEC));
+    }
+  }
+
+  xSemaphoreGive(phttpd->sdone);
+
+  vTaskDelete(NULL);
+}
+
 static void _camwebsrv_httpd_noop(void *arg)
 {
 }
+
+static esp_err_t _camwebsrv_httpd_handler_seq_export(httpd_req_t *req)
+{
+  esp_err_t rv;
+  char path[CAMWEBSRV_SEQFILE_PATH_LEN];
+  char buf[_CAMWEBSRV_HTTPD_PARAM_LEN + sizeof(path)];
+  uint64_t length;
+
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_set_type(req, "application/json");
+
+  // copies the last raw recording into its file; this holds up the server
+  // for as long as the copy takes, which is the price of keeping it simple
+
+  rv = camwebsrv_sdraw_export(path, sizeof(path), &length);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_seq_export(): camwebsrv_sdraw_export() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    httpd_resp_send_err(req, rv == ESP_ERR_NOT_FOUND ? HTTPD_404_NOT_FOUND : HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+    return rv;
+  }
+
+  snprintf(buf, sizeof(buf), "{\"path\": \"%s\", \"length\": %" PRIu64 "}", path, length);
+
+  rv = httpd_resp_sendstr(req, buf);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_seq_export(): httpd_resp_sendstr() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "HTTPD _camwebsrv_httpd_handler_seq_export(%d): served %s", httpd_req_to_sockfd(req), req->uri);
+
+  return ESP_OK;
+}
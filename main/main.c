@@ -30,7 +30,6 @@
 #include <nvs_flash.h>
 
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
 #include <freertos/task.h>
 
 static void camwebsrv_mdns_start(camwebsrv_cfgman_t cfgman)
@@ -96,7 +95,6 @@ static void camwebsrv_mdns_start(camwebsrv_cfgman_t cfgman)
 void app_main()
 {
   esp_err_t rv;
-  SemaphoreHandle_t sema;
   camwebsrv_cfgman_t cfgman = NULL;
   camwebsrv_httpd_t httpd = NULL;
   camwebsrv_ping_t ping = NULL;
@@ -188,16 +186,6 @@ void app_main()
     goto camwebsrv_main_error;
   }
 
-  // initialise sema
-
-  sema = xSemaphoreCreateBinary();
-
-  if (sema == NULL)
-  {
-    ESP_LOGE(CAMWEBSRV_TAG, "MAIN app_main(): xSemaphoreCreateBinary() failed: [%d]: %s", rv, esp_err_to_name(rv));
-    goto camwebsrv_main_error;
-  }
-
   // mount sdcard
 
   
@@ -211,7 +199,7 @@ void app_main()
 
   // initialise web server
 
-  rv = camwebsrv_httpd_init(&httpd, sema, cfgman);
+  rv = camwebsrv_httpd_init(&httpd, cfgman);
 
   if (rv != ESP_OK)
   {
@@ -229,7 +217,7 @@ void app_main()
     goto camwebsrv_main_error;
   }
 
-  // process stream requests indefinitely
+  // streaming runs in its own task; all that is left here is ping
 
   while(1)
   {
@@ -252,19 +240,9 @@ void app_main()
       goto camwebsrv_main_error;
     }
 
-    // httpd
-
-    rv = camwebsrv_httpd_process(httpd, &nextevent);
-
-    if (rv != ESP_OK)
-    {
-      ESP_LOGE(CAMWEBSRV_TAG, "MAIN app_main(): camwebsrv_httpd_process() failed: [%d]: %s", rv, esp_err_to_name(rv));
-      goto camwebsrv_main_error;
-    }
-
     // block until there is actually something to do
 
-    xSemaphoreTake(sema, (nextevent == UINT16_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(nextevent));
+    vTaskDelay((nextevent == UINT16_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(nextevent));
   }
 
   camwebsrv_main_error:
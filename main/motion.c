@@ -0,0 +1,122 @@
+// 2026-10-16 motion.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "motion.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void camwebsrv_motion_init(camwebsrv_motion_t *md)
+{
+  if (md == NULL)
+  {
+    return;
+  }
+
+  memset(md, 0x00, sizeof(camwebsrv_motion_t));
+}
+
+void camwebsrv_motion_destroy(camwebsrv_motion_t *md)
+{
+  if (md == NULL)
+  {
+    return;
+  }
+
+  free(md->bg);
+
+  memset(md, 0x00, sizeof(camwebsrv_motion_t));
+}
+
+bool camwebsrv_motion_update(camwebsrv_motion_t *md, const uint8_t *luma, uint16_t width, uint16_t height, uint16_t *score)
+{
+  uint32_t blocks = 0;
+  uint32_t moved = 0;
+  uint32_t sad;
+  uint32_t n;
+  uint16_t bx;
+  uint16_t by;
+  uint16_t x;
+  uint16_t y;
+  uint16_t xe;
+  uint16_t ye;
+  size_t i;
+
+  if (md == NULL || luma == NULL || width == 0 || height == 0)
+  {
+    return false;
+  }
+
+  // the first image, or the first after a size change, becomes the
+  // background; nothing to compare it against yet
+
+  if (md->bg == NULL || md->width != width || md->height != height)
+  {
+    camwebsrv_motion_destroy(md);
+
+    md->bg = (uint16_t *) malloc((size_t) width * height * sizeof(uint16_t));
+
+    if (md->bg == NULL)
+    {
+      return false;
+    }
+
+    for (i = 0; i < (size_t) width * height; i++)
+    {
+      md->bg[i] = (uint16_t) luma[i] << 8;
+    }
+
+    md->width = width;
+    md->height = height;
+
+    if (score != NULL)
+    {
+      *score = 0;
+    }
+
+    return true;
+  }
+
+  // one pass does both: block sums against the background, and pulling the
+  // background towards the image; it is kept in 8.8 fixed point, so that
+  // small changes are not rounded away
+
+  for (by = 0; by < height; by += CAMWEBSRV_MOTION_BLOCK)
+  {
+    ye = (height - by) > CAMWEBSRV_MOTION_BLOCK ? by + CAMWEBSRV_MOTION_BLOCK : height;
+
+    for (bx = 0; bx < width; bx += CAMWEBSRV_MOTION_BLOCK)
+    {
+      xe = (width - bx) > CAMWEBSRV_MOTION_BLOCK ? bx + CAMWEBSRV_MOTION_BLOCK : width;
+
+      sad = 0;
+
+      for (y = by; y < ye; y++)
+      {
+        const uint8_t *pl = luma + (size_t) y * width;
+        uint16_t *pb = md->bg + (size_t) y * width;
+
+        for (x = bx; x < xe; x++)
+        {
+          int32_t d = ((int32_t) pl[x] << 8) - pb[x];
+
+          sad += (uint32_t) (d < 0 ? -d : d) >> 8;
+          pb[x] = (uint16_t) (pb[x] + (d >> CAMWEBSRV_MOTION_BG_SHIFT));
+        }
+      }
+
+      n = (uint32_t) (ye - by) * (xe - bx);
+
+      blocks++;
+      moved += sad > n * CAMWEBSRV_MOTION_PIXEL_DIFF ? 1 : 0;
+    }
+  }
+
+  if (score != NULL)
+  {
+    *score = (uint16_t) ((moved * 1000) / blocks);
+  }
+
+  return true;
+}
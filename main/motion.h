@@ -0,0 +1,27 @@
+// 2026-10-16 motion.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_MOTION_H
+#define _CAMWEBSRV_MOTION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Scores how much of a small luma image differs from a running average of
+// the ones before it. The image is cut into square blocks, and the score is
+// how many of them (per mille) differ by more than a set amount on average,
+// by sum of absolute differences. Knows nothing about cameras otherwise, so
+// it runs just as well against a recorded sequence.
+
+typedef struct
+{
+  uint16_t *bg;
+  uint16_t width;
+  uint16_t height;
+} camwebsrv_motion_t;
+
+void camwebsrv_motion_init(camwebsrv_motion_t *md);
+void camwebsrv_motion_destroy(camwebsrv_motion_t *md);
+bool camwebsrv_motion_update(camwebsrv_motion_t *md, const uint8_t *luma, uint16_t width, uint16_t height, uint16_t *score);
+
+#endif
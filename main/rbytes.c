@@ -0,0 +1,173 @@
+// 2026-10-16 rbytes.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "rbytes.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <esp_log.h>
+#include <esp_err.h>
+
+typedef struct
+{
+  size_t size;
+  size_t head;
+  size_t len;
+  uint8_t rbs[];
+} _camwebsrv_rbytes_t;
+
+esp_err_t camwebsrv_rbytes_init(camwebsrv_rbytes_t *rb, size_t size)
+{
+  _camwebsrv_rbytes_t *nrb;
+
+  if (rb == NULL || size == 0)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  nrb = (_camwebsrv_rbytes_t *) malloc(sizeof(_camwebsrv_rbytes_t) + size);
+
+  if (nrb == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "RBYTES camwebsrv_rbytes_init(): malloc() failed: [%d]: %s", e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  nrb->size = size;
+  nrb->head = 0;
+  nrb->len = 0;
+
+  *rb = nrb;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_rbytes_destroy(camwebsrv_rbytes_t *rb)
+{
+  if (rb == NULL || *rb == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  free(*rb);
+
+  *rb = NULL;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_rbytes_get_bytes(camwebsrv_rbytes_t rb, const uint8_t **bytes, size_t *len, const uint8_t **wbytes, size_t *wlen)
+{
+  _camwebsrv_rbytes_t *nrb;
+  size_t first;
+
+  if (rb == NULL || bytes == NULL || len == NULL || wbytes == NULL || wlen == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  nrb = (_camwebsrv_rbytes_t *) rb;
+
+  // contents are in at most two pieces: from the head to the end of the
+  // array, then whatever wrapped around to the start
+
+  first = nrb->size - nrb->head;
+  first = nrb->len < first ? nrb->len : first;
+
+  *bytes = nrb->rbs + nrb->head;
+  *len = first;
+  *wbytes = nrb->rbs;
+  *wlen = nrb->len - first;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_rbytes_append_bytes(camwebsrv_rbytes_t rb, const uint8_t *bytes, size_t len)
+{
+  _camwebsrv_rbytes_t *nrb;
+  size_t tail;
+  size_t first;
+
+  if (rb == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (bytes == NULL && len != 0)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  nrb = (_camwebsrv_rbytes_t *) rb;
+
+  // all or nothing; the caller decides what to do with a full ring
+
+  if (len > nrb->size - nrb->len)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+
+  tail = (nrb->head + nrb->len) % nrb->size;
+  first = nrb->size - tail;
+  first = len < first ? len : first;
+
+  memcpy(nrb->rbs + tail, bytes, first);
+  memcpy(nrb->rbs, bytes + first, len - first);
+
+  nrb->len = nrb->len + len;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_rbytes_consume(camwebsrv_rbytes_t rb, size_t len)
+{
+  _camwebsrv_rbytes_t *nrb;
+
+  if (rb == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  nrb = (_camwebsrv_rbytes_t *) rb;
+
+  if (len > nrb->len)
+  {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  nrb->len = nrb->len - len;
+
+  // rewind when empty so the next append is contiguous
+
+  nrb->head = nrb->len == 0 ? 0 : (nrb->head + len) % nrb->size;
+
+  return ESP_OK;
+}
+
+size_t camwebsrv_rbytes_length(camwebsrv_rbytes_t rb)
+{
+  if (rb == NULL)
+  {
+    return 0;
+  }
+
+  return ((_camwebsrv_rbytes_t *) rb)->len;
+}
+
+size_t camwebsrv_rbytes_space(camwebsrv_rbytes_t rb)
+{
+  _camwebsrv_rbytes_t *nrb;
+
+  if (rb == NULL)
+  {
+    return 0;
+  }
+
+  nrb = (_camwebsrv_rbytes_t *) rb;
+
+  return nrb->size - nrb->len;
+}
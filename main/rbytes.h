@@ -0,0 +1,25 @@
+// 2026-10-16 rbytes.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_RBYTES_H
+#define _CAMWEBSRV_RBYTES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+
+// Fixed-capacity byte ring. Unlike vbytes, consuming from the front only
+// advances a cursor, so draining a backlog in pieces never moves data.
+
+typedef void *camwebsrv_rbytes_t;
+
+esp_err_t camwebsrv_rbytes_init(camwebsrv_rbytes_t *rb, size_t size);
+esp_err_t camwebsrv_rbytes_destroy(camwebsrv_rbytes_t *rb);
+esp_err_t camwebsrv_rbytes_get_bytes(camwebsrv_rbytes_t rb, const uint8_t **bytes, size_t *len, const uint8_t **wbytes, size_t *wlen);
+esp_err_t camwebsrv_rbytes_append_bytes(camwebsrv_rbytes_t rb, const uint8_t *bytes, size_t len);
+esp_err_t camwebsrv_rbytes_consume(camwebsrv_rbytes_t rb, size_t len);
+size_t camwebsrv_rbytes_length(camwebsrv_rbytes_t rb);
+size_t camwebsrv_rbytes_space(camwebsrv_rbytes_t rb);
+
+#endif
@@ -0,0 +1,360 @@
+// 2026-10-16 record.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "record.h"
+#include "seqcap.h"
+#include "sdcard_utils.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#define _CAMWEBSRV_RECORD_PATH_LEN 64
+#define _CAMWEBSRV_RECORD_BOOT_MAX 9999
+
+typedef struct
+{
+  camwebsrv_camera_t cam;
+  char dir[_CAMWEBSRV_RECORD_PATH_LEN];
+  int64_t tlast;
+  uint32_t written;
+  TaskHandle_t task;
+  SemaphoreHandle_t tdone;
+  volatile bool trun;
+} _camwebsrv_record_t;
+
+static esp_err_t _camwebsrv_record_boot_dir(_camwebsrv_record_t *prec);
+static bool _camwebsrv_record_active(_camwebsrv_record_t *prec);
+static esp_err_t _camwebsrv_record_preroll(_camwebsrv_record_t *prec);
+static esp_err_t _camwebsrv_record_write(_camwebsrv_record_t *prec, const camwebsrv_camera_frame_t *frame);
+static void _camwebsrv_record_task(void *arg);
+
+esp_err_t camwebsrv_record_init(camwebsrv_record_t *rec, camwebsrv_camera_t cam)
+{
+  _camwebsrv_record_t *prec;
+  esp_err_t rv;
+
+  if (rec == NULL || cam == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  rv = sdcard_mkdir_p(CAMWEBSRV_RECORD_DIR);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "RECORD camwebsrv_record_init(): sdcard_mkdir_p(%s) failed: [%d]: %s", CAMWEBSRV_RECORD_DIR, rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  prec = (_camwebsrv_record_t *) malloc(sizeof(_camwebsrv_record_t));
+
+  if (prec == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "RECORD camwebsrv_record_init(): malloc() failed: [%d]: %s", e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  memset(prec, 0x00, sizeof(_camwebsrv_record_t));
+
+  prec->cam = cam;
+  prec->tlast = -1;
+
+  // file names come from the uptime, which starts over on every boot, so
+  // each boot records into a directory of its own
+
+  rv = _camwebsrv_record_boot_dir(prec);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "RECORD camwebsrv_record_init(): _camwebsrv_record_boot_dir() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    free(prec);
+    return rv;
+  }
+
+  prec->tdone = xSemaphoreCreateBinary();
+
+  if (prec->tdone == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "RECORD camwebsrv_record_init(): xSemaphoreCreateBinary() failed");
+    free(prec);
+    return ESP_FAIL;
+  }
+
+  prec->trun = true;
+
+  if (xTaskCreatePinnedToCore(_camwebsrv_record_task, "record", CAMWEBSRV_RECORD_TASK_STACK, prec, CAMWEBSRV_RECORD_TASK_PRIO, &(prec->task), CAMWEBSRV_RECORD_TASK_CORE) != pdPASS)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "RECORD camwebsrv_record_init(): xTaskCreatePinnedToCore() failed");
+    vSemaphoreDelete(prec->tdone);
+    free(prec);
+    return ESP_FAIL;
+  }
+
+  *rec = (camwebsrv_record_t) prec;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_record_destroy(camwebsrv_record_t *rec)
+{
+  _camwebsrv_record_t *prec;
+
+  if (rec == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  prec = (_camwebsrv_record_t *) *rec;
+
+  if (prec == NULL)
+  {
+    return ESP_OK;
+  }
+
+  // stop the task, and wait for it to finish whatever it is writing
+
+  prec->trun = false;
+
+  xTaskNotifyGive(prec->task);
+  xSemaphoreTake(prec->tdone, portMAX_DELAY);
+  vSemaphoreDelete(prec->tdone);
+
+  free(prec);
+
+  *rec = NULL;
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_record_boot_dir(_camwebsrv_record_t *prec)
+{
+  struct dirent *de;
+  unsigned long id;
+  unsigned long last = 0;
+  char *end;
+  DIR *dh;
+  int n;
+
+  // the next one after the highest numbered one already there
+
+  dh = opendir(CAMWEBSRV_RECORD_DIR);
+
+  if (dh == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_boot_dir(): opendir(%s) failed: [%d]: %s", CAMWEBSRV_RECORD_DIR, e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  while((de = readdir(dh)) != NULL)
+  {
+    id = strtoul(de->d_name, &end, 10);
+
+    if (end != de->d_name && *end == '\0' && id > last && id <= _CAMWEBSRV_RECORD_BOOT_MAX)
+    {
+      last = id;
+    }
+  }
+
+  closedir(dh);
+
+  // mkdir() fails on one that is already there, so this never reuses one,
+  // even if the listing missed it
+
+  for (id = last + 1; id <= _CAMWEBSRV_RECORD_BOOT_MAX; id++)
+  {
+    n = snprintf(prec->dir, sizeof(prec->dir), "%s/%04lu", CAMWEBSRV_RECORD_DIR, id);
+
+    if (n < 0 || n >= sizeof(prec->dir))
+    {
+      return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (mkdir(prec->dir, 0775) == 0)
+    {
+      ESP_LOGI(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_boot_dir(): recording to %s", prec->dir);
+      return ESP_OK;
+    }
+
+    if (errno != EEXIST)
+    {
+      int e = errno;
+      ESP_LOGE(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_boot_dir(): mkdir(%s) failed: [%d]: %s", prec->dir, e, strerror(e));
+      return ESP_FAIL;
+    }
+  }
+
+  ESP_LOGE(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_boot_dir(): no directory numbers left in %s", CAMWEBSRV_RECORD_DIR);
+
+  return ESP_ERR_NOT_FOUND;
+}
+
+static bool _camwebsrv_record_active(_camwebsrv_record_t *prec)
+{
+  int64_t tmotion;
+
+  // the sd card belongs to seqcap while it runs
+
+  if (camwebsrv_seqcap_is_active())
+  {
+    return false;
+  }
+
+  if (camwebsrv_camera_motion_get(prec->cam, NULL, &tmotion) != ESP_OK || tmotion < 0)
+  {
+    return false;
+  }
+
+  return (esp_timer_get_time() - tmotion) <= ((int64_t) CAMWEBSRV_MOTION_HOLD * 1000);
+}
+
+static esp_err_t _camwebsrv_record_preroll(_camwebsrv_record_t *prec)
+{
+  const camwebsrv_camera_frame_t *frames[CAMWEBSRV_CAMERA_HISTORY_COUNT];
+  esp_err_t rv = ESP_OK;
+  int64_t now;
+  size_t count;
+  size_t i;
+
+  // whatever led up to the motion is still in the history
+
+  now = esp_timer_get_time();
+
+  if (camwebsrv_camera_history_range(prec->cam, now - ((int64_t) CAMWEBSRV_RECORD_PREROLL * 1000), now, frames, CAMWEBSRV_CAMERA_HISTORY_COUNT, &count) != ESP_OK)
+  {
+    return ESP_OK;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    if (rv == ESP_OK)
+    {
+      rv = _camwebsrv_record_write(prec, frames[i]);
+    }
+
+    camwebsrv_camera_frame_release(prec->cam, &(frames[i]));
+  }
+
+  return rv;
+}
+
+static esp_err_t _camwebsrv_record_write(_camwebsrv_record_t *prec, const camwebsrv_camera_frame_t *frame)
+{
+  char path[_CAMWEBSRV_RECORD_PATH_LEN];
+  esp_err_t rv;
+  int n;
+
+  // pre-roll and live frames can overlap
+
+  if (frame->tstamp <= prec->tlast)
+  {
+    return ESP_OK;
+  }
+
+  n = snprintf(path, sizeof(path), "%s/%" PRId64 ".jpg", prec->dir, frame->tstamp / 1000);
+
+  if (n < 0 || n >= sizeof(path))
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_write(): snprintf() failed");
+    return ESP_FAIL;
+  }
+
+  rv = sdcard_write_file(path, frame->buf, frame->len, false);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_write(%s): sdcard_write_file() failed: [%d]: %s", path, rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  prec->tlast = frame->tstamp;
+  prec->written++;
+
+  return ESP_OK;
+}
+
+static void _camwebsrv_record_task(void *arg)
+{
+  _camwebsrv_record_t *prec;
+  const camwebsrv_camera_frame_t *frame = NULL;
+  bool recording = false;
+  esp_err_t rv;
+
+  prec = (_camwebsrv_record_t *) arg;
+
+  while(prec->trun)
+  {
+    // idle until something moves
+
+    if (!_camwebsrv_record_active(prec))
+    {
+      if (recording)
+      {
+        ESP_LOGI(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_task(): stopped; %" PRIu32 " frames written", prec->written);
+        recording = false;
+      }
+
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CAMWEBSRV_RECORD_POLL));
+      continue;
+    }
+
+    if (!recording)
+    {
+      ESP_LOGI(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_task(): motion; recording to %s", prec->dir);
+
+      recording = true;
+      prec->written = 0;
+
+      rv = _camwebsrv_record_preroll(prec);
+
+      if (rv != ESP_OK)
+      {
+        ESP_LOGE(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_task(): _camwebsrv_record_preroll() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      }
+    }
+
+    // then every new frame, for as long as it lasts; at the camera's own
+    // pace, so that recording never makes it grab any faster
+
+    rv = camwebsrv_camera_frame_acquire(prec->cam, &frame);
+
+    if (rv == ESP_ERR_NOT_FOUND)
+    {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CAMWEBSRV_RECORD_POLL));
+      continue;
+    }
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "RECORD _camwebsrv_record_task(): camwebsrv_camera_frame_acquire() failed: [%d]: %s", rv, esp_err_to_name(rv));
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CAMWEBSRV_RECORD_POLL));
+      continue;
+    }
+
+    _camwebsrv_record_write(prec, frame);
+
+    camwebsrv_camera_frame_release(prec->cam, &frame);
+
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000 / camwebsrv_camera_fps_get(prec->cam)));
+  }
+
+  xSemaphoreGive(prec->tdone);
+
+  vTaskDelete(NULL);
+}
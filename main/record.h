@@ -0,0 +1,21 @@
+// 2026-10-16 record.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_RECORD_H
+#define _CAMWEBSRV_RECORD_H
+
+#include <esp_err.h>
+
+#include "camera.h"
+
+// Writes frames to the sd card for as long as the camera's motion detector
+// has seen something move in the last CAMWEBSRV_MOTION_HOLD ms, starting
+// with whatever the history still holds from just before it did. Files are
+// named by capture time in ms, so a recording can be replayed as is.
+
+typedef void *camwebsrv_record_t;
+
+esp_err_t camwebsrv_record_init(camwebsrv_record_t *rec, camwebsrv_camera_t cam);
+esp_err_t camwebsrv_record_destroy(camwebsrv_record_t *rec);
+
+#endif
@@ -0,0 +1,558 @@
+// 2026-10-16 replay.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "replay.h"
+#include "seqfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_random.h>
+#include <esp_heap_caps.h>
+#include <jpeg_decoder.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define _CAMWEBSRV_REPLAY_PATH_LEN 256
+
+// a .seq file's header and index, loaded once; index is NULL for a file
+// that holds a frame of its own
+
+typedef struct
+{
+  camwebsrv_seqfile_header_t header;
+  camwebsrv_seqfile_entry_t *index;
+  uint32_t count;
+} _camwebsrv_replay_seq_t;
+
+// one frame to play back: a file of its own, or an entry in a .seq file
+
+typedef struct
+{
+  const char *name;
+  const camwebsrv_seqfile_header_t *header;
+  const camwebsrv_seqfile_entry_t *entry;
+} _camwebsrv_replay_item_t;
+
+typedef struct
+{
+  char dir[_CAMWEBSRV_REPLAY_PATH_LEN];
+  char **names;
+  size_t count;
+  _camwebsrv_replay_seq_t *seqs;
+  _camwebsrv_replay_item_t *items;
+  size_t nitems;
+  size_t next;
+  uint8_t fps;
+  uint16_t jitter;
+  int64_t tdue;
+} _camwebsrv_replay_t;
+
+static bool _camwebsrv_replay_match(const char *name);
+static int _camwebsrv_replay_compare(const void *a, const void *b);
+static esp_err_t _camwebsrv_replay_items(_camwebsrv_replay_t *prep);
+static esp_err_t _camwebsrv_replay_load(const char *path, const _camwebsrv_replay_item_t *item, camera_fb_t *fb);
+static esp_err_t _camwebsrv_replay_detect(camera_fb_t *fb);
+static void _camwebsrv_replay_free_names(_camwebsrv_replay_t *prep);
+
+esp_err_t camwebsrv_replay_init(camwebsrv_replay_t *replay, const char *dir, uint8_t fps, uint16_t jitter)
+{
+  _camwebsrv_replay_t *prep;
+  struct dirent *de;
+  DIR *dh;
+  char **names;
+
+  if (replay == NULL || dir == NULL || fps == 0)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  prep = (_camwebsrv_replay_t *) malloc(sizeof(_camwebsrv_replay_t));
+
+  if (prep == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_init(): malloc() failed: [%d]: %s", e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  memset(prep, 0x00, sizeof(_camwebsrv_replay_t));
+
+  strncpy(prep->dir, dir, sizeof(prep->dir) - 1);
+
+  prep->fps = fps;
+  prep->jitter = jitter;
+  prep->tdue = 0;
+
+  // collect the names of everything that looks like a frame
+
+  dh = opendir(dir);
+
+  if (dh == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_init(%s): opendir() failed: [%d]: %s", dir, e, strerror(e));
+    free(prep);
+    return ESP_FAIL;
+  }
+
+  while((de = readdir(dh)) != NULL)
+  {
+    if (!_camwebsrv_replay_match(de->d_name))
+    {
+      continue;
+    }
+
+    names = (char **) realloc(prep->names, (prep->count + 1) * sizeof(char *));
+
+    if (names == NULL)
+    {
+      int e = errno;
+      ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_init(%s): realloc() failed: [%d]: %s", dir, e, strerror(e));
+      closedir(dh);
+      _camwebsrv_replay_free_names(prep);
+      free(prep);
+      return ESP_FAIL;
+    }
+
+    prep->names = names;
+    prep->names[prep->count] = strdup(de->d_name);
+
+    if (prep->names[prep->count] == NULL)
+    {
+      int e = errno;
+      ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_init(%s): strdup() failed: [%d]: %s", dir, e, strerror(e));
+      closedir(dh);
+      _camwebsrv_replay_free_names(prep);
+      free(prep);
+      return ESP_FAIL;
+    }
+
+    prep->count++;
+  }
+
+  closedir(dh);
+
+  if (prep->count == 0)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_init(%s): failed; no frames found", dir);
+    free(prep);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  // play back in capture order, with each .seq file's frames in the order
+  // its index has them
+
+  qsort(prep->names, prep->count, sizeof(char *), _camwebsrv_replay_compare);
+
+  if (_camwebsrv_replay_items(prep) != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_init(%s): _camwebsrv_replay_items() failed", dir);
+    _camwebsrv_replay_free_names(prep);
+    free(prep);
+    return ESP_FAIL;
+  }
+
+  if (prep->nitems == 0)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_init(%s): failed; no frames found", dir);
+    _camwebsrv_replay_free_names(prep);
+    free(prep);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_init(%s): %u frames from %u files at %u fps, +/- %u ms", dir, (unsigned) prep->nitems, (unsigned) prep->count, fps, jitter);
+
+  *replay = prep;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_replay_destroy(camwebsrv_replay_t *replay)
+{
+  _camwebsrv_replay_t *prep;
+
+  if (replay == NULL || *replay == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  prep = (_camwebsrv_replay_t *) *replay;
+
+  _camwebsrv_replay_free_names(prep);
+
+  free(prep);
+
+  *replay = NULL;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_replay_grab(camwebsrv_replay_t replay, camera_fb_t **fb)
+{
+  _camwebsrv_replay_t *prep;
+  char path[_CAMWEBSRV_REPLAY_PATH_LEN * 2];
+  camera_fb_t *nfb;
+  int64_t now;
+  int64_t period;
+  esp_err_t rv;
+
+  if (replay == NULL || fb == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  prep = (_camwebsrv_replay_t *) replay;
+
+  // pace it like a sensor would: block until the next frame is due
+
+  now = esp_timer_get_time();
+
+  if (prep->tdue > now)
+  {
+    vTaskDelay(pdMS_TO_TICKS((prep->tdue - now) / 1000));
+    now = esp_timer_get_time();
+  }
+
+  period = 1000000 / prep->fps;
+
+  if (prep->jitter > 0)
+  {
+    period = period + ((int64_t) (esp_random() % (2 * prep->jitter + 1)) - prep->jitter) * 1000;
+  }
+
+  prep->tdue = now + period;
+
+  // load the next one
+
+  snprintf(path, sizeof(path), "%s/%s", prep->dir, prep->items[prep->next].name);
+
+  nfb = (camera_fb_t *) calloc(1, sizeof(camera_fb_t));
+
+  if (nfb == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_grab(): calloc() failed: [%d]: %s", e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  rv = _camwebsrv_replay_load(path, &(prep->items[prep->next]), nfb);
+
+  prep->next = (prep->next + 1) % prep->nitems;
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY camwebsrv_replay_grab(%s): _camwebsrv_replay_load() failed: [%d]: %s", path, rv, esp_err_to_name(rv));
+    camwebsrv_replay_dispose(replay, nfb);
+    return rv;
+  }
+
+  nfb->timestamp.tv_sec = now / 1000000;
+  nfb->timestamp.tv_usec = now % 1000000;
+
+  *fb = nfb;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_replay_dispose(camwebsrv_replay_t replay, camera_fb_t *fb)
+{
+  if (replay == NULL || fb == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (fb->buf != NULL)
+  {
+    heap_caps_free(fb->buf);
+  }
+
+  free(fb);
+
+  return ESP_OK;
+}
+
+static bool _camwebsrv_replay_match(const char *name)
+{
+  const char *ext;
+
+  ext = strrchr(name, '.');
+
+  if (ext == NULL)
+  {
+    return false;
+  }
+
+  return strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0 || strcasecmp(ext, ".raw") == 0 || strcasecmp(ext, ".seq") == 0;
+}
+
+static int _camwebsrv_replay_compare(const void *a, const void *b)
+{
+  const char *na = *((const char **) a);
+  const char *nb = *((const char **) b);
+  unsigned long ta;
+  unsigned long tb;
+
+  // seqcap names start with a millisecond timestamp that is not zero
+  // padded, so order by that first
+
+  ta = strtoul(na, NULL, 10);
+  tb = strtoul(nb, NULL, 10);
+
+  if (ta != tb)
+  {
+    return ta < tb ? -1 : 1;
+  }
+
+  return strcmp(na, nb);
+}
+
+static esp_err_t _camwebsrv_replay_items(_camwebsrv_replay_t *prep)
+{
+  char path[_CAMWEBSRV_REPLAY_PATH_LEN * 2];
+  const char *ext;
+  size_t i;
+  size_t n;
+  uint32_t j;
+  esp_err_t rv;
+
+  prep->seqs = (_camwebsrv_replay_seq_t *) calloc(prep->count, sizeof(_camwebsrv_replay_seq_t));
+
+  if (prep->seqs == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_items(): calloc() failed: [%d]: %s", e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  // read each .seq file's index; one that can't be read, such as a capture
+  // that never got to write it, is left out rather than failing the lot
+
+  n = 0;
+
+  for (i = 0; i < prep->count; i++)
+  {
+    ext = strrchr(prep->names[i], '.');
+
+    if (strcasecmp(ext, ".seq") != 0)
+    {
+      n++;
+      continue;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", prep->dir, prep->names[i]);
+
+    rv = camwebsrv_seqfile_load(path, &(prep->seqs[i].header), &(prep->seqs[i].index), &(prep->seqs[i].count));
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGW(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_items(%s): camwebsrv_seqfile_load() failed: [%d]: %s; skipping", path, rv, esp_err_to_name(rv));
+      continue;
+    }
+
+    n = n + prep->seqs[i].count;
+  }
+
+  if (n == 0)
+  {
+    return ESP_OK;
+  }
+
+  prep->items = (_camwebsrv_replay_item_t *) calloc(n, sizeof(_camwebsrv_replay_item_t));
+
+  if (prep->items == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_items(): calloc(%u) failed: [%d]: %s", (unsigned) n, e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  for (i = 0; i < prep->count; i++)
+  {
+    ext = strrchr(prep->names[i], '.');
+
+    if (strcasecmp(ext, ".seq") != 0)
+    {
+      prep->items[prep->nitems].name = prep->names[i];
+      prep->nitems++;
+      continue;
+    }
+
+    for (j = 0; prep->seqs[i].index != NULL && j < prep->seqs[i].count; j++)
+    {
+      prep->items[prep->nitems].name = prep->names[i];
+      prep->items[prep->nitems].header = &(prep->seqs[i].header);
+      prep->items[prep->nitems].entry = &(prep->seqs[i].index[j]);
+      prep->nitems++;
+    }
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_replay_load(const char *path, const _camwebsrv_replay_item_t *item, camera_fb_t *fb)
+{
+  camwebsrv_seqfile_record_t record;
+  struct stat st;
+  FILE *fh;
+  esp_err_t rv;
+
+  if (item->entry != NULL)
+  {
+    fb->len = item->entry->len;
+  }
+  else if (stat(path, &st) == 0 && st.st_size > 0)
+  {
+    fb->len = st.st_size;
+  }
+  else
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_load(%s): stat() failed: [%d]: %s", path, e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  // frames live in psram, same as the driver's
+
+  fb->buf = (uint8_t *) heap_caps_malloc(fb->len > 0 ? fb->len : 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+  if (fb->buf == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_load(): heap_caps_malloc(%u) failed", (unsigned) fb->len);
+    return ESP_ERR_NO_MEM;
+  }
+
+  // a frame out of a .seq file comes with what it is, and is checked
+  // against its crc on the way
+
+  if (item->entry != NULL)
+  {
+    rv = camwebsrv_seqfile_read(path, item->entry, &record, fb->buf);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_load(%s): camwebsrv_seqfile_read(%" PRIu32 ") failed: [%d]: %s", path, item->entry->number, rv, esp_err_to_name(rv));
+      return rv;
+    }
+
+    fb->format = (pixformat_t) item->header->pixformat;
+    fb->width = record.width;
+    fb->height = record.height;
+
+    return ESP_OK;
+  }
+
+  fh = fopen(path, "rb");
+
+  if (fh == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_load(%s): fopen() failed: [%d]: %s", path, e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  if (fread(fb->buf, 1, fb->len, fh) != fb->len)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_load(%s): fread() failed", path);
+    fclose(fh);
+    return ESP_FAIL;
+  }
+
+  fclose(fh);
+
+  rv = _camwebsrv_replay_detect(fb);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "REPLAY _camwebsrv_replay_load(%s): unrecognised frame of %u bytes", path, (unsigned) fb->len);
+    return rv;
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_replay_detect(camera_fb_t *fb)
+{
+  esp_jpeg_image_cfg_t jcfg;
+  esp_jpeg_image_output_t jout;
+  size_t pixels;
+  int fs;
+
+  // jpeg says how big it is
+
+  if (fb->len > 2 && fb->buf[0] == 0xFF && fb->buf[1] == 0xD8)
+  {
+    memset(&jcfg, 0x00, sizeof(jcfg));
+    memset(&jout, 0x00, sizeof(jout));
+
+    jcfg.indata = fb->buf;
+    jcfg.indata_size = fb->len;
+
+    if (esp_jpeg_get_image_info(&jcfg, &jout) != ESP_OK)
+    {
+      return ESP_FAIL;
+    }
+
+    fb->format = PIXFORMAT_JPEG;
+    fb->width = jout.width;
+    fb->height = jout.height;
+
+    return ESP_OK;
+  }
+
+  // raw frames carry no header, so go by which frame size and pixel depth
+  // the length matches
+
+  for (fs = 0; fs < FRAMESIZE_INVALID; fs++)
+  {
+    pixels = resolution[fs].width * resolution[fs].height;
+
+    if (fb->len == pixels * 2 || fb->len == pixels || fb->len == pixels * 3)
+    {
+      fb->format = fb->len == pixels * 2 ? PIXFORMAT_RGB565 : (fb->len == pixels ? PIXFORMAT_GRAYSCALE : PIXFORMAT_RGB888);
+      fb->width = resolution[fs].width;
+      fb->height = resolution[fs].height;
+
+      return ESP_OK;
+    }
+  }
+
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+static void _camwebsrv_replay_free_names(_camwebsrv_replay_t *prep)
+{
+  size_t i;
+
+  for (i = 0; i < prep->count; i++)
+  {
+    free(prep->names[i]);
+
+    if (prep->seqs != NULL)
+    {
+      free(prep->seqs[i].index);
+    }
+  }
+
+  free(prep->names);
+  free(prep->seqs);
+  free(prep->items);
+
+  prep->names = NULL;
+  prep->seqs = NULL;
+  prep->items = NULL;
+  prep->count = 0;
+  prep->nitems = 0;
+}
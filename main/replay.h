@@ -0,0 +1,25 @@
+// 2026-10-16 replay.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_REPLAY_H
+#define _CAMWEBSRV_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <esp_camera.h>
+
+// Frame source that plays back a directory of previously captured frames
+// (*.jpg, the *.raw files seqcap used to write, or the frames in the *.seq
+// files it writes now) in place of the sensor, paced at a fixed rate with
+// optional jitter, looping at the end.
+
+typedef void *camwebsrv_replay_t;
+
+esp_err_t camwebsrv_replay_init(camwebsrv_replay_t *replay, const char *dir, uint8_t fps, uint16_t jitter);
+esp_err_t camwebsrv_replay_destroy(camwebsrv_replay_t *replay);
+esp_err_t camwebsrv_replay_grab(camwebsrv_replay_t replay, camera_fb_t **fb);
+esp_err_t camwebsrv_replay_dispose(camwebsrv_replay_t replay, camera_fb_t *fb);
+
+#endif
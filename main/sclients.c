@@ -4,19 +4,23 @@
 
 #include "config.h"
 #include "sclients.h"
+#include "framehdr.h"
+#include "rbytes.h"
+#include "ssock.h"
 #include "vbytes.h"
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
-#include <stdarg.h>
 #include <string.h>
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <sys/socket.h>
+#include <sys/select.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -29,19 +33,20 @@
 
 #define _CAMWEBSRV_SCLIENTS_RESP_HDR_MAIN_STR "\
 HTTP/1.1 200 OK\r\n\
-Content-Type: multipart/x-mixed-replace;boundary=0123456789ABCDEF\r\n\
+Content-Type: multipart/x-mixed-replace;boundary=" CAMWEBSRV_FRAMEHDR_BOUNDARY "\r\n\
 Transfer-Encoding: chunked\r\n\
 Access-Control-Allow-Origin: *\r\n\
 \r\n\
 "
 
-#define _CAMWEBSRV_SCLIENTS_RESP_HDR_CHUNK_STR "\
-14\r\n--0123456789ABCDEF\r\n\r\n\
-1A\r\nContent-Type: image/jpeg\r\n\r\n\
-%x\r\nContent-Length: %u\r\n\r\n\
-2\r\n\r\n\r\n\
-%x\r\n\
-"
+// each frame goes out as a single chunk, or as a binary message to
+// websocket clients; see framehdr.h for what precedes the jpeg data
+
+// control frames, sent in answer to the client's, carry at most 125 bytes
+
+#define _CAMWEBSRV_SCLIENTS_WS_OPCODE_CLOSE 0x88
+#define _CAMWEBSRV_SCLIENTS_WS_OPCODE_PONG 0x8A
+#define _CAMWEBSRV_SCLIENTS_WS_CTRL_LEN 125
 
 #if CONFIG_LWIP_IPV6
   #define _CAMWEBSRV_SCLIIENTS_SOCKADDR_IN_T   struct sockaddr_in6
@@ -60,32 +65,47 @@ Access-Control-Allow-Origin: *\r\n\
 typedef struct _camwebsrv_sclients_node_t
 {
   int sockfd;
-  camwebsrv_vbytes_t sockbuf;
+  camwebsrv_sclients_params_t params;
+  camwebsrv_rbytes_t sockbuf;
+  const camwebsrv_camera_frame_t *frame;
+  size_t foffset;
+  uint32_t fseq;
+  size_t fbytes;
+  uint32_t bps;
   struct _camwebsrv_sclients_node_t *next;
   int64_t tframelast;
   int64_t twritelast;
+  int64_t tfstart;
+  int64_t tfready;
+  camwebsrv_ssock_stats_t stats;
+  uint8_t credits;
+  uint32_t rttavg;
+  uint8_t wsctl[2 + _CAMWEBSRV_SCLIENTS_WS_CTRL_LEN];
+  uint8_t wsctllen;
+  bool closing;
 } _camwebsrv_sclients_node_t;
 
 typedef struct
 {
   _camwebsrv_sclients_node_t *list;
   SemaphoreHandle_t mutex;
+  int ctrlfd;
+  struct sockaddr_in ctrladdr;
 } _camwebsrv_sclients_t;
 
-size_t _camwebsrv_sclients_count_digits(size_t n);
 bool _camwebsrv_sclients_sock_exists(_camwebsrv_sclients_node_t *pnode, int sockfd);
-ssize_t _camwebsrv_sclients_sock_send_bytes(int sockfd, uint8_t *bytes, size_t len);
-esp_err_t _camwebsrv_sclients_node_send_bytes(_camwebsrv_sclients_node_t *pnode, uint8_t *bytes, size_t len);
-esp_err_t _camwebsrv_sclients_node_send_vbytes(_camwebsrv_sclients_node_t *pnode, camwebsrv_vbytes_t *vbytes);
-esp_err_t _camwebsrv_sclients_node_send_str(_camwebsrv_sclients_node_t *pnode, const char *fmt, ...);
-esp_err_t _camwebsrv_sclients_node_flush(_camwebsrv_sclients_node_t *pnode, bool *flushed);
-esp_err_t _camwebsrv_sclients_node_frame(_camwebsrv_sclients_node_t *pnode, uint8_t *fbuf, size_t flen);
+esp_err_t _camwebsrv_sclients_node_flush(_camwebsrv_sclients_node_t *pnode, camwebsrv_camera_t cam, bool *flushed);
+esp_err_t _camwebsrv_sclients_node_frame(_camwebsrv_sclients_node_t *pnode, camwebsrv_camera_t cam, const camwebsrv_camera_frame_t *frame);
+int64_t _camwebsrv_sclients_node_tnext(_camwebsrv_sclients_node_t *pnode, camwebsrv_camera_t cam);
+bool _camwebsrv_sclients_node_ready(_camwebsrv_sclients_node_t *pnode);
+void _camwebsrv_sclients_node_sample(_camwebsrv_sclients_node_t *pnode, int64_t tnow);
 esp_err_t _camwebsrv_sclients_sock_get_peer(int sockfd, char *caddr);
-esp_err_t _camwebsrv_sclients_purge(_camwebsrv_sclients_node_t **plist, httpd_handle_t handle);
+esp_err_t _camwebsrv_sclients_purge(_camwebsrv_sclients_node_t **plist, camwebsrv_camera_t cam, httpd_handle_t handle);
 
 esp_err_t camwebsrv_sclients_init(camwebsrv_sclients_t *clients)
 {
   _camwebsrv_sclients_t *pclients;
+  socklen_t alen;
 
   if (clients == NULL)
   {
@@ -110,6 +130,37 @@ esp_err_t camwebsrv_sclients_init(camwebsrv_sclients_t *clients)
     return ESP_FAIL;
   }
 
+  // a loopback datagram socket that the streaming task waits on alongside
+  // the clients, so that new clients get picked up straight away
+
+  pclients->ctrlfd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  if (pclients->ctrlfd < 0)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_init(): socket() failed: [%d]: %s", e, strerror(e));
+    vSemaphoreDelete(pclients->mutex);
+    free(pclients);
+    return ESP_FAIL;
+  }
+
+  memset(&(pclients->ctrladdr), 0x00, sizeof(pclients->ctrladdr));
+  pclients->ctrladdr.sin_family = AF_INET;
+  pclients->ctrladdr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  pclients->ctrladdr.sin_port = 0;
+
+  alen = sizeof(pclients->ctrladdr);
+
+  if (bind(pclients->ctrlfd, (struct sockaddr *) &(pclients->ctrladdr), alen) != 0 || getsockname(pclients->ctrlfd, (struct sockaddr *) &(pclients->ctrladdr), &alen) != 0)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_init(): bind() failed: [%d]: %s", e, strerror(e));
+    close(pclients->ctrlfd);
+    vSemaphoreDelete(pclients->mutex);
+    free(pclients);
+    return ESP_FAIL;
+  }
+
   pclients->list = NULL;
 
   *clients = pclients;
@@ -117,7 +168,7 @@ esp_err_t camwebsrv_sclients_init(camwebsrv_sclients_t *clients)
   return ESP_OK;
 }
 
-esp_err_t camwebsrv_sclients_destroy(camwebsrv_sclients_t *clients, httpd_handle_t handle)
+esp_err_t camwebsrv_sclients_destroy(camwebsrv_sclients_t *clients, camwebsrv_camera_t cam, httpd_handle_t handle)
 {
   _camwebsrv_sclients_t *pclients;
   esp_err_t rv;
@@ -136,7 +187,7 @@ esp_err_t camwebsrv_sclients_destroy(camwebsrv_sclients_t *clients, httpd_handle
 
   xSemaphoreTake(pclients->mutex, portMAX_DELAY);
 
-  rv = _camwebsrv_sclients_purge(&(pclients->list), handle);
+  rv = _camwebsrv_sclients_purge(&(pclients->list), cam, handle);
 
   if (rv != ESP_OK)
   {
@@ -148,19 +199,21 @@ esp_err_t camwebsrv_sclients_destroy(camwebsrv_sclients_t *clients, httpd_handle
   xSemaphoreGive(pclients->mutex);
   vSemaphoreDelete(pclients->mutex);
 
+  close(pclients->ctrlfd);
+
   free(pclients);
 
   return ESP_OK;
 }
 
-esp_err_t camwebsrv_sclients_add(camwebsrv_sclients_t clients, int sockfd)
+esp_err_t camwebsrv_sclients_add(camwebsrv_sclients_t clients, int sockfd, const camwebsrv_sclients_params_t *params)
 {
   _camwebsrv_sclients_t *pclients;
   _camwebsrv_sclients_node_t *pnode;
   char caddr[_CAMWEBSRV_SCLIENTS_ADDRSTRLEN + 6];
   esp_err_t rv;
 
-  if (clients == NULL)
+  if (clients == NULL || params == NULL)
   {
     return ESP_ERR_INVALID_ARG;
   }
@@ -205,29 +258,44 @@ esp_err_t camwebsrv_sclients_add(camwebsrv_sclients_t clients, int sockfd)
   }
 
   pnode->sockfd = sockfd;
+  pnode->params = *params;
+  pnode->frame = NULL;
+  pnode->foffset = 0;
+  pnode->fseq = 0;
+  pnode->fbytes = 0;
+  pnode->bps = 0;
   pnode->next = pclients->list;
   pnode->tframelast = 0;
   pnode->twritelast = esp_timer_get_time();
+  pnode->tfstart = 0;
+  pnode->tfready = 0;
+  pnode->credits = params->credits;
+  pnode->rttavg = 0;
+  pnode->wsctllen = 0;
+  pnode->closing = false;
+
+  camwebsrv_ssock_init(&(pnode->stats));
 
-  rv = camwebsrv_vbytes_init(&(pnode->sockbuf));
+  rv = camwebsrv_rbytes_init(&(pnode->sockbuf), CAMWEBSRV_SCLIENTS_RBUF_SIZE);
 
   if (rv != ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_add(%d): camwebsrv_vbytes_init() failed: [%d]: %s", sockfd, rv, esp_err_to_name(rv));
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_add(%d): camwebsrv_rbytes_init() failed: [%d]: %s", sockfd, rv, esp_err_to_name(rv));
     free(pnode);
     xSemaphoreGive(pclients->mutex);
     return rv;
   }
 
-  // load http headers in buffer
+  // load http headers in buffer; the http server has already completed the
+  // handshake for websocket clients
   // XXX: instead of loading into the buffer, consider attempting to write to the socket instead
 
-  rv = camwebsrv_vbytes_append_str(pnode->sockbuf, _CAMWEBSRV_SCLIENTS_RESP_HDR_MAIN_STR);
+  rv = params->ws ? ESP_OK : camwebsrv_rbytes_append_bytes(pnode->sockbuf, (const uint8_t *) _CAMWEBSRV_SCLIENTS_RESP_HDR_MAIN_STR, sizeof(_CAMWEBSRV_SCLIENTS_RESP_HDR_MAIN_STR) - 1);
 
   if (rv != ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_add(%d): camwebsrv_vbytes_append_str() failed: [%d]: %s", sockfd, rv, esp_err_to_name(rv));
-    camwebsrv_vbytes_destroy(&(pnode->sockbuf));
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_add(%d): camwebsrv_rbytes_append_bytes() failed: [%d]: %s", sockfd, rv, esp_err_to_name(rv));
+    camwebsrv_rbytes_destroy(&(pnode->sockbuf));
     free(pnode);
     xSemaphoreGive(pclients->mutex);
     return rv;
@@ -241,14 +309,126 @@ esp_err_t camwebsrv_sclients_add(camwebsrv_sclients_t clients, int sockfd)
 
   xSemaphoreGive(pclients->mutex);
 
+  // wake up the streaming task
+
+  camwebsrv_sclients_wake(clients);
+
   // done
 
-  ESP_LOGI(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_add(%d): Added client %s", sockfd, caddr);
+  ESP_LOGI(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_add(%d): Added %s client %s; fps %u, scale %u, quality %u, credits %u", sockfd, params->ws ? "websocket" : "mjpeg", caddr, params->fps, params->scale, params->quality, params->credits);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_sclients_ack(camwebsrv_sclients_t clients, int sockfd, uint32_t seq)
+{
+  _camwebsrv_sclients_t *pclients;
+  _camwebsrv_sclients_node_t *curr;
+  uint32_t rtt;
+
+  if (clients == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pclients = (_camwebsrv_sclients_t *) clients;
+
+  if (xSemaphoreTake(pclients->mutex, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_ack(%d): xSemaphoreTake() failed", sockfd);
+    return ESP_FAIL;
+  }
+
+  for (curr = pclients->list; curr != NULL && curr->sockfd != sockfd; curr = curr->next);
+
+  if (curr == NULL)
+  {
+    xSemaphoreGive(pclients->mutex);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  // each acknowledgement is worth another frame, up to the window the
+  // client asked for
+
+  if (curr->credits < curr->params.credits)
+  {
+    curr->credits++;
+  }
+
+  // round trip, from the frame starting to go out to the client having
+  // received and acknowledged it; only the latest frame's start time is
+  // kept, so older acknowledgements don't count
+
+  if (seq == curr->fseq)
+  {
+    int64_t elapsed = esp_timer_get_time() - curr->tfstart;
+
+    rtt = elapsed < UINT32_MAX ? (uint32_t) elapsed : UINT32_MAX;
+    curr->rttavg = curr->rttavg == 0 ? rtt : curr->rttavg - (curr->rttavg >> CAMWEBSRV_SCLIENTS_BPS_SHIFT) + (rtt >> CAMWEBSRV_SCLIENTS_BPS_SHIFT);
+  }
+
+  xSemaphoreGive(pclients->mutex);
+
+  // the client may have been waiting on credit
+
+  camwebsrv_sclients_wake(clients);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_sclients_ws_control(camwebsrv_sclients_t clients, int sockfd, httpd_ws_type_t type, const uint8_t *payload, size_t len)
+{
+  _camwebsrv_sclients_t *pclients;
+  _camwebsrv_sclients_node_t *curr;
+
+  if (clients == NULL || (payload == NULL && len > 0) || len > _CAMWEBSRV_SCLIENTS_WS_CTRL_LEN || (type != HTTPD_WS_TYPE_PING && type != HTTPD_WS_TYPE_CLOSE))
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pclients = (_camwebsrv_sclients_t *) clients;
+
+  if (xSemaphoreTake(pclients->mutex, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_ws_control(%d): xSemaphoreTake() failed", sockfd);
+    return ESP_FAIL;
+  }
+
+  for (curr = pclients->list; curr != NULL && curr->sockfd != sockfd; curr = curr->next);
+
+  if (curr == NULL || !curr->params.ws)
+  {
+    xSemaphoreGive(pclients->mutex);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  // only the latest ping needs a pong, and nothing needs one once we're
+  // closing; a close echoes the client's status code, if it sent one
+
+  if (!curr->closing)
+  {
+    if (type == HTTPD_WS_TYPE_CLOSE)
+    {
+      len = len < 2 ? 0 : 2;
+      curr->closing = true;
+    }
+
+    curr->wsctl[0] = type == HTTPD_WS_TYPE_CLOSE ? _CAMWEBSRV_SCLIENTS_WS_OPCODE_CLOSE : _CAMWEBSRV_SCLIENTS_WS_OPCODE_PONG;
+    curr->wsctl[1] = (uint8_t) len;
+
+    memcpy(curr->wsctl + 2, payload, len);
+
+    curr->wsctllen = (uint8_t) (2 + len);
+  }
+
+  xSemaphoreGive(pclients->mutex);
+
+  camwebsrv_sclients_wake(clients);
 
   return ESP_OK;
 }
 
-esp_err_t camwebsrv_sclients_purge(camwebsrv_sclients_t clients, httpd_handle_t handle)
+esp_err_t camwebsrv_sclients_purge(camwebsrv_sclients_t clients, camwebsrv_camera_t cam, httpd_handle_t handle)
 {
   _camwebsrv_sclients_t *pclients;
   esp_err_t rv;
@@ -262,7 +442,7 @@ esp_err_t camwebsrv_sclients_purge(camwebsrv_sclients_t clients, httpd_handle_t
 
   xSemaphoreTake(pclients->mutex, portMAX_DELAY);
 
-  rv = _camwebsrv_sclients_purge(&(pclients->list), handle);
+  rv = _camwebsrv_sclients_purge(&(pclients->list), cam, handle);
 
   xSemaphoreGive(pclients->mutex);
 
@@ -284,6 +464,8 @@ esp_err_t camwebsrv_sclients_process(camwebsrv_sclients_t clients, camwebsrv_cam
   _camwebsrv_sclients_node_t *curr;
   _camwebsrv_sclients_node_t *prev;
   _camwebsrv_sclients_node_t *temp;
+  const camwebsrv_camera_frame_t *frame = NULL;
+  bool busy = false;
 
   if (clients == NULL || cam == NULL)
   {
@@ -307,7 +489,6 @@ esp_err_t camwebsrv_sclients_process(camwebsrv_sclients_t clients, camwebsrv_cam
 
   while(curr != NULL)
   {
-    bool flushed = false;
     int sockfd = curr->sockfd;
     int64_t tnow = esp_timer_get_time();
 
@@ -321,7 +502,7 @@ esp_err_t camwebsrv_sclients_process(camwebsrv_sclients_t clients, camwebsrv_cam
 
     // attempt to flush out the socket buffer
 
-    rv = _camwebsrv_sclients_node_flush(curr, &flushed);
+    rv = _camwebsrv_sclients_node_flush(curr, cam, NULL);
 
     if (rv != ESP_OK)
     {
@@ -329,54 +510,89 @@ esp_err_t camwebsrv_sclients_process(camwebsrv_sclients_t clients, camwebsrv_cam
       goto rm_client;
     }
 
-    // is the buffer empty?
+    // websocket control replies go out between frames, never in the middle
+    // of one; and once a close has gone out, so does the client
 
-    if (flushed)
+    if (curr->wsctllen > 0 && curr->frame == NULL && camwebsrv_rbytes_space(curr->sockbuf) >= curr->wsctllen)
     {
-      // has enough time lapsed since the last frame?
+      rv = camwebsrv_rbytes_append_bytes(curr->sockbuf, curr->wsctl, curr->wsctllen);
+
+      if (rv == ESP_OK)
+      {
+        curr->wsctllen = 0;
+        rv = _camwebsrv_sclients_node_flush(curr, cam, NULL);
+      }
 
-      if (tnow > (curr->tframelast + (1000000 / camwebsrv_camera_fps_get(cam))))
+      if (rv != ESP_OK)
       {
-        uint8_t *fbuf = NULL;
-        size_t flen = 0;
-        int64_t ftstamp = 0;
+        ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_process(%d): failed to send control frame: [%d]: %s", sockfd, rv, esp_err_to_name(rv));
+        goto rm_client;
+      }
+    }
+
+    if (curr->closing && curr->wsctllen == 0 && curr->frame == NULL && camwebsrv_rbytes_length(curr->sockbuf) == 0)
+    {
+      ESP_LOGI(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_process(%d): closed by client", sockfd);
+      goto rm_client;
+    }
+
+    // is this client due for another frame, given both the frame rate and
+    // how fast it has been draining frames so far?
 
-        // get, send and dispose new frame
+    if (tnow > _camwebsrv_sclients_node_tnext(curr, cam))
+    {
+      // grab at most one frame per pass, and share it between all clients;
+      // it is always the newest one, so a lagging client never works
+      // through a queue of stale frames
+
+      if (frame == NULL && !busy)
+      {
+        rv = camwebsrv_camera_frame_acquire(cam, &frame);
 
-        rv = camwebsrv_camera_frame_grab(cam, &fbuf, &flen, &ftstamp);
+        // the camera is waiting for frames to be let go of, so keep
+        // flushing the others rather than taking a new one
 
-        if (rv != ESP_OK)
+        if (rv == ESP_ERR_NOT_FOUND)
         {
-          ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_process(%d): camwebsrv_camera_frame_grab() failed: [%d]: %s", sockfd, rv, esp_err_to_name(rv));
+          busy = true;
+        }
+        else if (rv != ESP_OK)
+        {
+          ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_process(%d): camwebsrv_camera_frame_acquire() failed: [%d]: %s", sockfd, rv, esp_err_to_name(rv));
           goto rm_client;
         }
+      }
 
-        rv = _camwebsrv_sclients_node_frame(curr, fbuf, flen);
+      // don't send the same frame twice, and don't pile a new frame on top
+      // of one the client hasn't finished with; it gets the newest one once
+      // it is ready again
 
-        camwebsrv_camera_frame_dispose(cam);
+      if (frame != NULL && frame->seq != curr->fseq && _camwebsrv_sclients_node_ready(curr))
+      {
+        rv = _camwebsrv_sclients_node_frame(curr, cam, frame);
 
-        if (rv != ESP_OK)
+        if (rv != ESP_OK && rv != ESP_ERR_NO_MEM)
         {
           ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_process(%d): _camwebsrv_sclients_node_frame() failed: [%d]: %s", sockfd, rv, esp_err_to_name(rv));
           goto rm_client;
         }
-
-        curr->tframelast = ftstamp;
       }
     }
 
-    // the next event for this client is ASAP if there is something in the
-    // buffer, or whenever the next frame is due, otherwise
+    // anything still queued goes out as soon as the socket drains, which
+    // the caller waits on; otherwise, the next event for this client is
+    // when its next frame is due, and the caller wakes up for the earliest
+    // of those across all clients
 
     if (nextevent != NULL)
     {
-      if (camwebsrv_vbytes_length(curr->sockbuf) > 0)
-      {
-        *nextevent = CAMWEBSRV_MAIN_MIN_CYCLE_MSEC;
-      }
-      else
+      int64_t tnext = (_camwebsrv_sclients_node_tnext(curr, cam) - tnow) / 1000;
+
+      tnext = tnext > CAMWEBSRV_MAIN_MIN_CYCLE_MSEC ? tnext : CAMWEBSRV_MAIN_MIN_CYCLE_MSEC;
+
+      if (tnext < *nextevent)
       {
-        *nextevent = 1000 / camwebsrv_camera_fps_get(cam);
+        *nextevent = tnext;
       }
     }
 
@@ -390,7 +606,8 @@ esp_err_t camwebsrv_sclients_process(camwebsrv_sclients_t clients, camwebsrv_cam
     rm_client:
 
       httpd_sess_trigger_close(handle, sockfd);
-      camwebsrv_vbytes_destroy(&(curr->sockbuf));
+      camwebsrv_camera_frame_release(cam, &(curr->frame));
+      camwebsrv_rbytes_destroy(&(curr->sockbuf));
 
       temp = curr;
 
@@ -405,11 +622,15 @@ esp_err_t camwebsrv_sclients_process(camwebsrv_sclients_t clients, camwebsrv_cam
         curr = prev->next;
       }
 
-      free(temp);
+      ESP_LOGI(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_process(%d): Removed client; sent %" PRIu32 ", dropped %" PRIu32 " frame(s); latency avg %" PRIu32 " us, max %" PRIu32 " us", sockfd, temp->stats.fsent, temp->stats.fdropped, temp->stats.latavg, temp->stats.latmax);
 
-      ESP_LOGI(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_process(%d): Removed client", sockfd);
+      free(temp);
   }
 
+  // drop this pass's reference; clients still sending the frame hold theirs
+
+  camwebsrv_camera_frame_release(cam, &frame);
+
   // release mutex
 
   xSemaphoreGive(pclients->mutex);
@@ -417,16 +638,171 @@ esp_err_t camwebsrv_sclients_process(camwebsrv_sclients_t clients, camwebsrv_cam
   return ESP_OK;
 }
 
-size_t _camwebsrv_sclients_count_digits(size_t n)
+esp_err_t camwebsrv_sclients_wait(camwebsrv_sclients_t clients, uint16_t timeout)
+{
+  _camwebsrv_sclients_t *pclients;
+  _camwebsrv_sclients_node_t *curr;
+  fd_set rfds;
+  fd_set wfds;
+  struct timeval tv;
+  int maxfd;
+  int rv;
+
+  if (clients == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pclients = (_camwebsrv_sclients_t *) clients;
+
+  FD_ZERO(&rfds);
+  FD_ZERO(&wfds);
+
+  // always listen for new clients
+
+  FD_SET(pclients->ctrlfd, &rfds);
+  maxfd = pclients->ctrlfd;
+
+  // and wait for writability on those with something left to send
+
+  if (xSemaphoreTake(pclients->mutex, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_wait(): xSemaphoreTake(mutex) failed");
+    return ESP_FAIL;
+  }
+
+  for (curr = pclients->list; curr != NULL; curr = curr->next)
+  {
+    if (camwebsrv_rbytes_length(curr->sockbuf) > 0 || curr->frame != NULL)
+    {
+      FD_SET(curr->sockfd, &wfds);
+      maxfd = curr->sockfd > maxfd ? curr->sockfd : maxfd;
+    }
+  }
+
+  xSemaphoreGive(pclients->mutex);
+
+  // block until a socket drains, a client arrives, or the timeout expires
+
+  tv.tv_sec = timeout / 1000;
+  tv.tv_usec = (timeout % 1000) * 1000;
+
+  rv = select(maxfd + 1, &rfds, &wfds, NULL, timeout == UINT16_MAX ? NULL : &tv);
+
+  if (rv < 0)
+  {
+    int e = errno;
+
+    if (e == EINTR)
+    {
+      return ESP_OK;
+    }
+
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_wait(): select() failed: [%d]: %s", e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  // drain wake-ups
+
+  if (rv > 0 && FD_ISSET(pclients->ctrlfd, &rfds))
+  {
+    uint8_t b[8];
+
+    while(recv(pclients->ctrlfd, b, sizeof(b), MSG_DONTWAIT) > 0);
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_sclients_wake(camwebsrv_sclients_t clients)
 {
-  size_t i;
+  _camwebsrv_sclients_t *pclients;
+
+  if (clients == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pclients = (_camwebsrv_sclients_t *) clients;
 
-  for(i = 0; n > 0; i++)
+  if (sendto(pclients->ctrlfd, "", 1, MSG_DONTWAIT, (struct sockaddr *) &(pclients->ctrladdr), sizeof(pclients->ctrladdr)) < 0)
   {
-    n = n / 10;
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_wake(): sendto() failed: [%d]: %s", e, strerror(e));
+    return ESP_FAIL;
   }
 
-  return i;
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_sclients_stats(camwebsrv_sclients_t clients, camwebsrv_vbytes_t vb)
+{
+  _camwebsrv_sclients_t *pclients;
+  _camwebsrv_sclients_node_t *curr;
+  esp_err_t rv = ESP_OK;
+
+  if (clients == NULL || vb == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pclients = (_camwebsrv_sclients_t *) clients;
+
+  // counters are only ever written by the streaming task, under the mutex,
+  // so holding it here is enough for a consistent snapshot
+
+  if (xSemaphoreTake(pclients->mutex, portMAX_DELAY) != pdTRUE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_stats(): xSemaphoreTake(mutex) failed");
+    return ESP_FAIL;
+  }
+
+  rv = camwebsrv_vbytes_append_str(vb, "[");
+
+  for (curr = pclients->list; curr != NULL && rv == ESP_OK; curr = curr->next)
+  {
+    rv = camwebsrv_vbytes_append_str(
+      vb,
+      "%s\n    {\n"
+      "      \"sockfd\": %d,\n"
+      "      \"transport\": \"%s\",\n"
+      "      \"fps\": %u,\n"
+      "      \"scale\": %u,\n"
+      "      \"quality\": %u,\n"
+      "      \"backlog\": %u,\n"
+      "      \"bps\": %" PRIu32 ",\n"
+      "      \"credits\": %u,\n"
+      "      \"ack_rtt_us\": %" PRIu32 ",\n",
+      curr == pclients->list ? "" : ",",
+      curr->sockfd,
+      curr->params.ws ? "ws" : "mjpeg",
+      curr->params.fps,
+      curr->params.scale,
+      curr->params.quality,
+      camwebsrv_rbytes_length(curr->sockbuf) + (curr->frame != NULL ? curr->frame->len - curr->foffset : 0),
+      curr->bps,
+      curr->credits,
+      curr->rttavg
+    );
+
+    rv = rv == ESP_OK ? camwebsrv_ssock_json(&(curr->stats), vb) : rv;
+    rv = rv == ESP_OK ? camwebsrv_vbytes_append_str(vb, "\n    }") : rv;
+  }
+
+  if (rv == ESP_OK)
+  {
+    rv = camwebsrv_vbytes_append_str(vb, pclients->list != NULL ? "\n  ]" : "]");
+  }
+
+  xSemaphoreGive(pclients->mutex);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS camwebsrv_sclients_stats(): camwebsrv_vbytes_append_str() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  return ESP_OK;
 }
 
 bool _camwebsrv_sclients_sock_exists(_camwebsrv_sclients_node_t *pnode, int sockfd)
@@ -442,271 +818,285 @@ bool _camwebsrv_sclients_sock_exists(_camwebsrv_sclients_node_t *pnode, int sock
   return false;
 }
 
-ssize_t _camwebsrv_sclients_sock_send_bytes(int sockfd, uint8_t *bytes, size_t len)
+esp_err_t _camwebsrv_sclients_node_flush(_camwebsrv_sclients_node_t *pnode, camwebsrv_camera_t cam, bool *flushed)
 {
-  size_t bytes_left = len;
-  size_t bytes_sent = 0;
-  size_t bytes_blck;
-  TickType_t started = xTaskGetTickCount();
+  esp_err_t rv;
+  int64_t tnow;
+  ssize_t sent;
+  size_t slen;
+  size_t qlen;
+  struct iovec iov[3];
 
-  while(bytes_left > 0)
+  while(1)
   {
-    ssize_t rv;
+    // queue up, in order: buffered bytes (which may wrap around the end of
+    // the ring), then what is left of the frame
 
-    // have we exceeded the time limit?
+    rv = camwebsrv_rbytes_get_bytes(pnode->sockbuf, (const uint8_t **) &(iov[0].iov_base), &(iov[0].iov_len), (const uint8_t **) &(iov[1].iov_base), &(iov[1].iov_len));
 
-    if ((xTaskGetTickCount() - started) > pdMS_TO_TICKS(CAMWEBSRV_SCLIENTS_SEND_TMOUT))
+    if (rv != ESP_OK)
     {
-      ESP_LOGW(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_send_bytes(%d): exceeded send time limit", sockfd);
-      break;
+      ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_flush(%d): camwebsrv_rbytes_get_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
+      return ESP_FAIL;
     }
 
-    // how much to send this time?
+    iov[2].iov_base = pnode->frame != NULL ? (uint8_t *) pnode->frame->buf + pnode->foffset : NULL;
+    iov[2].iov_len = pnode->frame != NULL ? pnode->frame->len - pnode->foffset : 0;
 
-    bytes_blck = bytes_left < CAMWEBSRV_SCLIENTS_BSIZE ? bytes_left : CAMWEBSRV_SCLIENTS_BSIZE;
+    qlen = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
 
-    // send a block at a time
-    // XXX we really should use httpd_socket_send() here, but we can't until
-    // IDFGH-9275 is fixed
+    // nothing to do if the queue is empty
 
-    rv = send(sockfd, (const void *) bytes, bytes_blck, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (qlen == 0)
+    {
+      break;
+    }
 
-    // error?
+    // make one attempt to send everything that's queued
 
-    if (rv < 0)
+    sent = camwebsrv_ssock_send(&(pnode->stats), pnode->sockfd, iov, 3);
+
+    if (sent < 0)
     {
-      int e = errno;
+      ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_flush(%d): camwebsrv_ssock_send() failed", pnode->sockfd);
+      return ESP_FAIL;
+    }
 
-      if (e == EAGAIN || e == EWOULDBLOCK)
-      {
-        ESP_LOGD(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_send_bytes(%d): send() would block", sockfd);
-        break;
-      }
+    // update the idle timer only if anything went; a client that stops
+    // reading holds on to a driver frame, so it has to time out
+
+    tnow = esp_timer_get_time();
 
-      ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_send_bytes(%d): send() failed: [%d]: %s", sockfd, e, strerror(e));
-      return -1;
+    if (sent > 0)
+    {
+      pnode->twritelast = tnow;
     }
 
-    // this should never happen, given that we're sendig with the NONBLOCK flag
+    // first bytes of a new frame?
 
-    if (rv == 0)
+    if (sent > 0 && pnode->tfready != 0)
     {
-      ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_send_bytes(%d): send() failed", sockfd);
-      return -2;
+      camwebsrv_ssock_latency(&(pnode->stats), tnow - pnode->tfready);
+      pnode->tfready = 0;
     }
 
-    // success!
+    // consuming from the ring only moves its read cursor
 
-    bytes_left = bytes_left - rv;
-    bytes_sent = bytes_sent + rv;
-    bytes = bytes + rv;
-  }
+    slen = camwebsrv_rbytes_length(pnode->sockbuf);
+    slen = (size_t) sent < slen ? (size_t) sent : slen;
 
-  ESP_LOGD(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_send_bytes(%d): sent %u bytes", sockfd, bytes_sent);
+    camwebsrv_rbytes_consume(pnode->sockbuf, slen);
 
-  return bytes_sent;
-}
+    // then the frame; once it has all gone out, let go of it and queue the
+    // chunk end behind it, if there is one
 
-esp_err_t _camwebsrv_sclients_node_send_bytes(_camwebsrv_sclients_node_t *pnode, uint8_t *bytes, size_t len)
-{
-  esp_err_t rv;
+    if (pnode->frame == NULL)
+    {
+      break;
+    }
 
-  // if the buffer is empty, make one attempt to send data to the socket first
+    pnode->foffset = pnode->foffset + (sent - slen);
 
-  if (camwebsrv_vbytes_length(pnode->sockbuf) == 0)
-  {
-    ssize_t sent;
+    if (pnode->foffset < pnode->frame->len)
+    {
+      break;
+    }
 
-    sent = _camwebsrv_sclients_sock_send_bytes(pnode->sockfd, bytes, len);
+    _camwebsrv_sclients_node_sample(pnode, tnow);
 
-    if (sent < 0)
+    camwebsrv_camera_frame_release(cam, &(pnode->frame));
+    pnode->foffset = 0;
+
+    rv = pnode->params.ws ? ESP_OK : camwebsrv_rbytes_append_bytes(pnode->sockbuf, (const uint8_t *) CAMWEBSRV_FRAMEHDR_CHUNK_END_STR, sizeof(CAMWEBSRV_FRAMEHDR_CHUNK_END_STR) - 1);
+
+    if (rv != ESP_OK)
     {
-      ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_send_bytes(%d): _camwebsrv_sclients_sock_send_bytes() failed", pnode->sockfd);
+      ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_flush(%d): camwebsrv_rbytes_append_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
       return ESP_FAIL;
     }
 
-    // update idle timer
-
-    pnode->twritelast = esp_timer_get_time();
+    // go around again only if the socket took everything we gave it
 
-    // increment stuff
-
-    bytes = bytes + sent;
-    len = len - sent;
+    if ((size_t) sent < qlen)
+    {
+      break;
+    }
   }
 
-  // enbuffer unsent data
-
-  rv = camwebsrv_vbytes_append_bytes(pnode->sockbuf, bytes, len);
+  // set flag, if supplied
 
-  if (rv != ESP_OK)
+  if (flushed != NULL)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_send_bytes(%d): camwebsrv_vbytes_append_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-    return ESP_FAIL;
+    *flushed = (camwebsrv_rbytes_length(pnode->sockbuf) == 0 && pnode->frame == NULL);
   }
 
   return ESP_OK;
 }
 
-esp_err_t _camwebsrv_sclients_node_send_vbytes(_camwebsrv_sclients_node_t *pnode, camwebsrv_vbytes_t *vbytes)
+esp_err_t _camwebsrv_sclients_node_frame(_camwebsrv_sclients_node_t *pnode, camwebsrv_camera_t cam, const camwebsrv_camera_frame_t *frame)
 {
   esp_err_t rv;
-  uint8_t *bbytes = NULL;
-  size_t blen = 0;
+  char hbuf[CAMWEBSRV_FRAMEHDR_LEN];
+  const camwebsrv_camera_frame_t *vframe = NULL;
+  const char *hdr;
+  size_t hlen;
+  size_t tlen;
 
-  rv = camwebsrv_vbytes_get_bytes(vbytes, (const uint8_t **) &bbytes, &blen);
+  // chunk data is sent straight out of the shared frame, or the variant of
+  // it that this client asked for, so hold on to a reference until it has
+  // all gone out
 
-  if (rv != ESP_OK)
+  rv = camwebsrv_camera_variant_acquire(cam, frame, pnode->params.scale, pnode->params.quality, &vframe);
+
+  if (rv == ESP_ERR_NOT_FOUND)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_send_vbytes(%d): camwebsrv_vbytes_get_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-    return ESP_FAIL;
+    return ESP_ERR_NO_MEM;
   }
 
-  rv = _camwebsrv_sclients_node_send_bytes(pnode, bbytes, blen);
-
   if (rv != ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_send_vbytes(%d): _camwebsrv_sclients_node_send_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_frame(%d): camwebsrv_camera_variant_acquire() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
     return ESP_FAIL;
   }
 
-  return ESP_OK;
-}
+  // a variant may be of an earlier frame, while the newest one is being
+  // encoded; it may even be the one this client already has
 
-esp_err_t _camwebsrv_sclients_node_send_str(_camwebsrv_sclients_node_t *pnode, const char *fmt, ...)
-{
-  va_list vlist;
-  esp_err_t rv;
-  camwebsrv_vbytes_t vbytes;
+  if (pnode->fseq != 0 && vframe->seq <= pnode->fseq)
+  {
+    camwebsrv_camera_frame_release(cam, &vframe);
+    return ESP_ERR_NO_MEM;
+  }
 
-  rv = camwebsrv_vbytes_init(&vbytes);
+  // chunk or websocket frame header; only the chunk has a trailer
 
-  if (rv != ESP_OK)
+  if (pnode->params.ws)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_send_str(%d): camwebsrv_vbytes_init() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-    return ESP_FAIL;
+    hlen = camwebsrv_framehdr_ws(hbuf, vframe, &hdr);
+    tlen = 0;
+  }
+  else
+  {
+    hlen = camwebsrv_framehdr_chunk(hbuf, vframe, &hdr);
+    tlen = sizeof(CAMWEBSRV_FRAMEHDR_CHUNK_END_STR) - 1;
   }
 
-  va_start(vlist, fmt);
-  rv = camwebsrv_vbytes_set_vlist(vbytes, fmt, vlist);
-  va_end(vlist);
+  // make sure the header and the chunk end that follows the frame will both
+  // fit; if not, this client is too far behind to take another frame
 
-  if (rv != ESP_OK)
+  if (camwebsrv_rbytes_space(pnode->sockbuf) < hlen + tlen)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_send_str(%d): camwebsrv_vbytes_set_vlist() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-    return ESP_FAIL;
+    camwebsrv_camera_frame_release(cam, &vframe);
+    return ESP_ERR_NO_MEM;
   }
 
-  rv = _camwebsrv_sclients_node_send_vbytes(pnode, vbytes);
+  rv = camwebsrv_rbytes_append_bytes(pnode->sockbuf, (const uint8_t *) hdr, hlen);
 
   if (rv != ESP_OK)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_send_str(%d): _camwebsrv_sclients_node_send_vbytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_frame(%d): camwebsrv_rbytes_append_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
+    camwebsrv_camera_frame_release(cam, &vframe);
     return ESP_FAIL;
   }
 
-  camwebsrv_vbytes_destroy(&vbytes);
-
-  return ESP_OK;
-}
+  camwebsrv_ssock_frame(&(pnode->stats), pnode->fseq, vframe->seq);
 
-esp_err_t _camwebsrv_sclients_node_flush(_camwebsrv_sclients_node_t *pnode, bool *flushed)
-{
-  esp_err_t rv;
-  ssize_t sent = 0;
-  uint8_t *bbytes = NULL;
-  size_t blen = 0;
+  pnode->tframelast = vframe->tstamp;
+  pnode->fseq = vframe->seq;
 
-  // get internal buffer
+  pnode->frame = vframe;
+  pnode->foffset = 0;
+  pnode->fbytes = hlen + vframe->len + tlen;
+  pnode->tfstart = esp_timer_get_time();
+  pnode->tfready = vframe->tstamp;
 
-  rv = camwebsrv_vbytes_get_bytes(pnode->sockbuf, (const uint8_t **) &bbytes, &blen);
+  // spend a credit, if the client is using them
 
-  if (rv != ESP_OK)
+  if (pnode->params.credits > 0)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_flush(%d): camwebsrv_vbytes_get_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-    return ESP_FAIL;
+    pnode->credits--;
   }
 
-  // nothing to do if the buffer is empty
+  // send as much of it as the socket will take
 
-  if (blen > 0)
-  {
-    // make one attempt to send buffered data to socket
+  rv = _camwebsrv_sclients_node_flush(pnode, cam, NULL);
 
-    sent = _camwebsrv_sclients_sock_send_bytes(pnode->sockfd, bbytes, blen);
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_frame(%d): _camwebsrv_sclients_node_flush() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
+    return ESP_FAIL;
+  }
 
-    if (sent < 0)
-    {
-      ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_flush(%d): _camwebsrv_sclients_sock_send_bytes() failed", pnode->sockfd);
-      return ESP_FAIL;
-    }
+  return ESP_OK;
+}
 
-    // update idle timer
+int64_t _camwebsrv_sclients_node_tnext(_camwebsrv_sclients_node_t *pnode, camwebsrv_camera_t cam)
+{
+  int64_t interval;
+  int64_t tsend;
+  int64_t tmotion;
+  uint8_t fps;
 
-    pnode->twritelast = esp_timer_get_time();
+  // never faster than the configured frame rate, or the rate this client
+  // asked for, whichever is lower
 
-    // reset buffer to whatever remains unsent
+  fps = camwebsrv_camera_fps_get(cam);
+  fps = (pnode->params.fps > 0 && pnode->params.fps < fps) ? pnode->params.fps : fps;
 
-    rv = camwebsrv_vbytes_set_bytes(pnode->sockbuf, bbytes + sent, blen - sent);
+  // with motion detection on, drop to a trickle once nothing has moved for
+  // a while; the next frame with motion in it brings the rate straight back
 
-    if (rv != ESP_OK)
-    {
-      ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_flush(%d): camwebsrv_vbytes_set_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-      return ESP_FAIL;
-    }
+  if (camwebsrv_camera_motion_get(cam, NULL, &tmotion) == ESP_OK && (tmotion < 0 || (esp_timer_get_time() - tmotion) > ((int64_t) CAMWEBSRV_MOTION_HOLD * 1000)))
+  {
+    fps = fps < CAMWEBSRV_SCLIENTS_MOTION_IDLE_FPS ? fps : CAMWEBSRV_SCLIENTS_MOTION_IDLE_FPS;
   }
 
-  // set flag, if supplied
+  interval = 1000000 / fps;
 
-  if (flushed != NULL)
+  // and never faster than the client has been taking frames; a slow link
+  // then skips straight to whatever is newest when it is next due, instead
+  // of having a backlog build up in the socket
+
+  if (pnode->bps > 0)
   {
-    *flushed = (blen == sent);
+    tsend = ((int64_t) pnode->fbytes * 1000000) / pnode->bps;
+    interval = tsend > interval ? tsend : interval;
   }
 
-  return ESP_OK;
+  return pnode->tframelast + interval;
 }
 
-esp_err_t _camwebsrv_sclients_node_frame(_camwebsrv_sclients_node_t *pnode, uint8_t *fbuf, size_t flen)
+bool _camwebsrv_sclients_node_ready(_camwebsrv_sclients_node_t *pnode)
 {
-  esp_err_t rv;
+  // not while a frame is in flight, nor while the backlog is above the
+  // high-water mark, nor while the client is out of credit, nor once it has
+  // asked to close
 
-  // chunk header
+  return !pnode->closing && pnode->frame == NULL && camwebsrv_rbytes_length(pnode->sockbuf) <= CAMWEBSRV_SCLIENTS_RBUF_HWM && (pnode->params.credits == 0 || pnode->credits > 0);
+}
 
-  rv = _camwebsrv_sclients_node_send_str(
-    pnode,
-    _CAMWEBSRV_SCLIENTS_RESP_HDR_CHUNK_STR,
-    18 + _camwebsrv_sclients_count_digits(flen),
-    flen,
-    flen
-  );
+void _camwebsrv_sclients_node_sample(_camwebsrv_sclients_node_t *pnode, int64_t tnow)
+{
+  int64_t elapsed;
+  int64_t bps;
 
-  if (rv != ESP_OK)
-  {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_frame(%d): _camwebsrv_sclients_node_send_str(1) failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-    return ESP_FAIL;
-  }
+  // throughput for the frame that just went out, folded into a moving
+  // average
 
-  // chunk data
+  elapsed = tnow - pnode->tfstart;
+  elapsed = elapsed > 0 ? elapsed : 1;
 
-  rv = _camwebsrv_sclients_node_send_bytes(pnode, fbuf, flen);
+  bps = ((int64_t) pnode->fbytes * 1000000) / elapsed;
+  bps = bps < UINT32_MAX ? bps : UINT32_MAX;
 
-  if (rv != ESP_OK)
+  if (pnode->bps == 0)
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_frame(%d): _camwebsrv_sclients_node_send_bytes() failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-    return ESP_FAIL;
+    pnode->bps = (uint32_t) bps;
   }
-
-  // chunk end
-
-  rv = _camwebsrv_sclients_node_send_str(pnode, "\r\n");
-
-  if (rv != ESP_OK)
+  else
   {
-    ESP_LOGE(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_node_frame(%d): _camwebsrv_sclients_node_send_str(1) failed: [%d]: %s", pnode->sockfd, rv, esp_err_to_name(rv));
-    return ESP_FAIL;
+    pnode->bps = pnode->bps - (pnode->bps >> CAMWEBSRV_SCLIENTS_BPS_SHIFT) + ((uint32_t) bps >> CAMWEBSRV_SCLIENTS_BPS_SHIFT);
   }
-
-  return ESP_OK;
 }
 
 esp_err_t _camwebsrv_sclients_sock_get_peer(int sockfd, char *caddr)
@@ -736,7 +1126,7 @@ esp_err_t _camwebsrv_sclients_sock_get_peer(int sockfd, char *caddr)
   return ESP_OK;
 }
 
-esp_err_t _camwebsrv_sclients_purge(_camwebsrv_sclients_node_t **plist, httpd_handle_t handle)
+esp_err_t _camwebsrv_sclients_purge(_camwebsrv_sclients_node_t **plist, camwebsrv_camera_t cam, httpd_handle_t handle)
 {
   _camwebsrv_sclients_node_t *cnode;
   _camwebsrv_sclients_node_t *tnode;
@@ -748,7 +1138,7 @@ esp_err_t _camwebsrv_sclients_purge(_camwebsrv_sclients_node_t **plist, httpd_ha
   {
     // be graceful and try to flush out the buffer first
 
-    rv = _camwebsrv_sclients_node_flush(cnode, NULL);
+    rv = _camwebsrv_sclients_node_flush(cnode, cam, NULL);
 
     if (rv != ESP_OK)
     {
@@ -762,17 +1152,21 @@ esp_err_t _camwebsrv_sclients_purge(_camwebsrv_sclients_node_t **plist, httpd_ha
       httpd_sess_trigger_close(handle, cnode->sockfd);
     }
 
+    // let go of any frame still being sent
+
+    camwebsrv_camera_frame_release(cam, &(cnode->frame));
+
     // destroy buffer
 
     if (cnode->sockbuf != NULL)
     {
-      camwebsrv_vbytes_destroy(&(cnode->sockbuf));
+      camwebsrv_rbytes_destroy(&(cnode->sockbuf));
     }
 
     tnode = cnode;
     cnode = cnode->next;
 
-    ESP_LOGI(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_purge(%d): Removed client", tnode->sockfd);
+    ESP_LOGI(CAMWEBSRV_TAG, "SCLIENTS _camwebsrv_sclients_purge(%d): Removed client; sent %" PRIu32 ", dropped %" PRIu32 " frame(s); latency avg %" PRIu32 " us, max %" PRIu32 " us", tnode->sockfd, tnode->stats.fsent, tnode->stats.fdropped, tnode->stats.latavg, tnode->stats.latmax);
 
     free(tnode);
   }
@@ -6,18 +6,45 @@
 #define _CAMWEBSRV_SCLIENTS_H
 
 #include "camera.h"
+#include "vbytes.h"
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include <esp_err.h>
 #include <esp_http_server.h>
 
 typedef void *camwebsrv_sclients_t;
 
+// what each client asked for; zero means "same as the camera"
+
+// websocket clients get each frame as one binary message, and may also ask
+// for credit-based flow control: at most this many frames are sent ahead
+// of the client's acknowledgements (zero means no limit)
+
+// ws_control() takes a ping or a close from a websocket client; the pong or
+// close that answers it is sent by the streaming task, between frames, so
+// that nothing else writes to the socket; after a close, the client is
+// dropped once the answer has gone out
+
+typedef struct
+{
+  uint8_t fps;
+  uint8_t scale;
+  uint8_t quality;
+  bool ws;
+  uint8_t credits;
+} camwebsrv_sclients_params_t;
+
 esp_err_t camwebsrv_sclients_init(camwebsrv_sclients_t *clients);
-esp_err_t camwebsrv_sclients_destroy(camwebsrv_sclients_t *clients, httpd_handle_t handle);
-esp_err_t camwebsrv_sclients_add(camwebsrv_sclients_t clients, int sockfd);
-esp_err_t camwebsrv_sclients_purge(camwebsrv_sclients_t clients, httpd_handle_t handle);
+esp_err_t camwebsrv_sclients_destroy(camwebsrv_sclients_t *clients, camwebsrv_camera_t cam, httpd_handle_t handle);
+esp_err_t camwebsrv_sclients_add(camwebsrv_sclients_t clients, int sockfd, const camwebsrv_sclients_params_t *params);
+esp_err_t camwebsrv_sclients_ack(camwebsrv_sclients_t clients, int sockfd, uint32_t seq);
+esp_err_t camwebsrv_sclients_ws_control(camwebsrv_sclients_t clients, int sockfd, httpd_ws_type_t type, const uint8_t *payload, size_t len);
+esp_err_t camwebsrv_sclients_purge(camwebsrv_sclients_t clients, camwebsrv_camera_t cam, httpd_handle_t handle);
 esp_err_t camwebsrv_sclients_process(camwebsrv_sclients_t clients, camwebsrv_camera_t cam, httpd_handle_t handle, uint16_t *nextevent);
+esp_err_t camwebsrv_sclients_wait(camwebsrv_sclients_t clients, uint16_t timeout);
+esp_err_t camwebsrv_sclients_wake(camwebsrv_sclients_t clients);
+esp_err_t camwebsrv_sclients_stats(camwebsrv_sclients_t clients, camwebsrv_vbytes_t vb);
 
 #endif
@@ -0,0 +1,331 @@
+// 2026-10-16 sdraw.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "sdraw.h"
+#include "sdcard_utils.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_heap_caps.h>
+#include <sdmmc_cmd.h>
+
+#define _CAMWEBSRV_SDRAW_SECTOR 512
+#define _CAMWEBSRV_SDRAW_MBR_SIG 0x1FE
+#define _CAMWEBSRV_SDRAW_MBR_PART 0x1BE
+#define _CAMWEBSRV_SDRAW_MBR_PARTS 4
+#define _CAMWEBSRV_SDRAW_MBR_GPT 0xEE
+#define _CAMWEBSRV_SDRAW_COPY_BYTES (CAMWEBSRV_SEQFILE_BLK_CHUNK * _CAMWEBSRV_SDRAW_SECTOR)
+
+typedef struct
+{
+  sdmmc_card_t *card;
+  size_t start;
+  camwebsrv_seqfile_blkdev_t blk;
+} _camwebsrv_sdraw_t;
+
+static _camwebsrv_sdraw_t _camwebsrv_sdraw;
+
+static esp_err_t _camwebsrv_sdraw_find(sdmmc_card_t *c, size_t *start, size_t *sectors);
+static esp_err_t _camwebsrv_sdraw_write(void *ctx, const void *buf, size_t sector, size_t count);
+static uint32_t _camwebsrv_sdraw_le32(const uint8_t *p);
+
+esp_err_t camwebsrv_sdraw_open(const camwebsrv_seqfile_blkdev_t **blk)
+{
+  _camwebsrv_sdraw_t *psr = &_camwebsrv_sdraw;
+  esp_err_t rv;
+
+  if (blk == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (card == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_open(): failed; card not mounted");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // looked up every time, since the card may have been swapped or
+  // repartitioned since the last run
+
+  memset(psr, 0x00, sizeof(_camwebsrv_sdraw_t));
+
+  rv = _camwebsrv_sdraw_find(card, &(psr->start), &(psr->blk.sectors));
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_open(): _camwebsrv_sdraw_find() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  psr->card = card;
+  psr->blk.ctx = psr;
+  psr->blk.write = _camwebsrv_sdraw_write;
+
+  ESP_LOGI(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_open(): using sectors %u to %u", (unsigned) psr->start, (unsigned) (psr->start + psr->blk.sectors - 1));
+
+  *blk = &(psr->blk);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_sdraw_export(char *path, size_t len, uint64_t *length)
+{
+  camwebsrv_seqfile_super_t super;
+  size_t start;
+  size_t sectors;
+  size_t sector;
+  size_t count;
+  uint64_t left;
+  uint8_t *buf;
+  char *dir;
+  ssize_t n;
+  int fd;
+  esp_err_t rv;
+
+  if (path == NULL || len == 0 || length == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (card == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(): failed; card not mounted");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  rv = _camwebsrv_sdraw_find(card, &start, &sectors);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(): _camwebsrv_sdraw_find() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  buf = (uint8_t *) heap_caps_malloc(_CAMWEBSRV_SDRAW_COPY_BYTES, MALLOC_CAP_DMA);
+
+  if (buf == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(): heap_caps_malloc(%d) failed", _CAMWEBSRV_SDRAW_COPY_BYTES);
+    return ESP_FAIL;
+  }
+
+  // superblock first; a zero length means the recording never finished
+
+  rv = sdmmc_read_sectors(card, buf, start, 1);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(): sdmmc_read_sectors(%u) failed: [%d]: %s", (unsigned) start, rv, esp_err_to_name(rv));
+    heap_caps_free(buf);
+    return rv;
+  }
+
+  memcpy(&super, buf, sizeof(super));
+  super.path[sizeof(super.path) - 1] = '\0';
+
+  if (memcmp(super.magic, CAMWEBSRV_SEQFILE_MAGIC_SUPER, sizeof(super.magic)) != 0 || super.length == 0)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(): failed; no finished sequence on the card");
+    heap_caps_free(buf);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  if (super.length > (uint64_t) (sectors - 1) * _CAMWEBSRV_SDRAW_SECTOR || strlen(super.path) >= len)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(): failed; bad superblock");
+    heap_caps_free(buf);
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  strcpy(path, super.path);
+
+  // make sure the directory it goes in is there
+
+  dir = strrchr(path, '/');
+
+  if (dir != NULL && dir != path)
+  {
+    *dir = '\0';
+    rv = sdcard_mkdir_p(path);
+    *dir = '/';
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(%s): sdcard_mkdir_p() failed: [%d]: %s", path, rv, esp_err_to_name(rv));
+      heap_caps_free(buf);
+      return rv;
+    }
+  }
+
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+  if (fd < 0)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(%s): open() failed: [%d]: %s", path, e, strerror(e));
+    heap_caps_free(buf);
+    return ESP_FAIL;
+  }
+
+  // the sequence is laid out exactly as it would be in the file, one sector
+  // past the superblock
+
+  sector = start + 1;
+  left = super.length;
+
+  while (left > 0)
+  {
+    count = left < _CAMWEBSRV_SDRAW_COPY_BYTES ? (size_t) ((left + _CAMWEBSRV_SDRAW_SECTOR - 1) / _CAMWEBSRV_SDRAW_SECTOR) : CAMWEBSRV_SEQFILE_BLK_CHUNK;
+
+    rv = sdmmc_read_sectors(card, buf, sector, count);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(%s): sdmmc_read_sectors(%u, %u) failed: [%d]: %s", path, (unsigned) sector, (unsigned) count, rv, esp_err_to_name(rv));
+      break;
+    }
+
+    n = write(fd, buf, left < count * _CAMWEBSRV_SDRAW_SECTOR ? (size_t) left : count * _CAMWEBSRV_SDRAW_SECTOR);
+
+    if (n <= 0)
+    {
+      int e = errno;
+      ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(%s): write() failed: [%d]: %s", path, e, strerror(e));
+      rv = ESP_FAIL;
+      break;
+    }
+
+    // a short write just means the next read starts over at the sector it
+    // stopped in
+
+    sector += n / _CAMWEBSRV_SDRAW_SECTOR;
+    left -= n;
+
+    if (n % _CAMWEBSRV_SDRAW_SECTOR != 0 && left > 0)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(%s): write() failed; short write of %d bytes", path, (int) n);
+      rv = ESP_FAIL;
+      break;
+    }
+  }
+
+  if (close(fd) != 0 && rv == ESP_OK)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(%s): close() failed: [%d]: %s", path, e, strerror(e));
+    rv = ESP_FAIL;
+  }
+
+  heap_caps_free(buf);
+
+  if (rv != ESP_OK)
+  {
+    return rv;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "SDRAW camwebsrv_sdraw_export(%s): %" PRIu32 " frames, %" PRIu64 " bytes", path, super.count, super.length);
+
+  *length = super.length;
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_sdraw_find(sdmmc_card_t *c, size_t *start, size_t *sectors)
+{
+  uint8_t *mbr;
+  const uint8_t *part;
+  uint64_t end;
+  uint64_t pend;
+  size_t i;
+  esp_err_t rv;
+
+  if (c->csd.sector_size != _CAMWEBSRV_SDRAW_SECTOR)
+  {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  mbr = (uint8_t *) heap_caps_malloc(_CAMWEBSRV_SDRAW_SECTOR, MALLOC_CAP_DMA);
+
+  if (mbr == NULL)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+
+  rv = sdmmc_read_sectors(c, mbr, 0, 1);
+
+  if (rv != ESP_OK)
+  {
+    heap_caps_free(mbr);
+    return rv;
+  }
+
+  // a superfloppy, with no partition table, has no room left over either
+
+  if (mbr[_CAMWEBSRV_SDRAW_MBR_SIG] != 0x55 || mbr[_CAMWEBSRV_SDRAW_MBR_SIG + 1] != 0xAA)
+  {
+    heap_caps_free(mbr);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  // start after the end of the last partition, wherever it is
+
+  end = 0;
+
+  for (i = 0; i < _CAMWEBSRV_SDRAW_MBR_PARTS; i++)
+  {
+    part = mbr + _CAMWEBSRV_SDRAW_MBR_PART + i * 16;
+
+    if (part[4] == 0x00)
+    {
+      continue;
+    }
+
+    if (part[4] == _CAMWEBSRV_SDRAW_MBR_GPT)
+    {
+      heap_caps_free(mbr);
+      return ESP_ERR_NOT_FOUND;
+    }
+
+    pend = (uint64_t) _camwebsrv_sdraw_le32(part + 8) + _camwebsrv_sdraw_le32(part + 12);
+    end = pend > end ? pend : end;
+  }
+
+  heap_caps_free(mbr);
+
+  // the superblock, and at least one chunk
+
+  if (end + 1 + CAMWEBSRV_SEQFILE_BLK_CHUNK > (uint64_t) c->csd.capacity)
+  {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  *start = (size_t) end;
+  *sectors = (size_t) (c->csd.capacity - end);
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_sdraw_write(void *ctx, const void *buf, size_t sector, size_t count)
+{
+  _camwebsrv_sdraw_t *psr = (_camwebsrv_sdraw_t *) ctx;
+
+  // one command for the lot; buf is always dma-capable, so the driver
+  // doesn't bounce it through its own buffer a sector at a time
+
+  return sdmmc_write_sectors(psr->card, buf, psr->start + sector, count);
+}
+
+static uint32_t _camwebsrv_sdraw_le32(const uint8_t *p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
@@ -0,0 +1,29 @@
+// 2026-10-16 sdraw.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_SDRAW_H
+#define _CAMWEBSRV_SDRAW_H
+
+#include "seqfile.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+
+// raw sequence recording, straight to the card with sdmmc_write_sectors()
+// and no fatfs in between. The region used is whatever follows the last
+// partition in the card's MBR, so the card has to be partitioned with some
+// space left unallocated at the end; a GPT or a partition that runs to the
+// end of the card leaves nothing, and open() then fails with
+// ESP_ERR_NOT_FOUND.
+//
+// open() hands back a block device for camwebsrv_seqfile_open_blk(); it
+// stays valid until the card is next unmounted. export() copies the last
+// finished sequence out of the region into the FAT file it was meant to be
+// (see camwebsrv_seqfile_super_t), and reports its path and length.
+
+esp_err_t camwebsrv_sdraw_open(const camwebsrv_seqfile_blkdev_t **blk);
+esp_err_t camwebsrv_sdraw_export(char *path, size_t len, uint64_t *length);
+
+#endif
@@ -5,10 +5,14 @@
 #include "seqcap.h"
 #include "httpd.h"
 #include "sdcard_utils.h"
+#include "seqfile.h"
+#include "sdraw.h"
+#include "syncgen.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <inttypes.h>
 
 #include <esp_log.h>
 #include <esp_timer.h>
@@ -18,6 +22,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <freertos/queue.h>
 
 #include <driver/gpio.h>
 #include <rom/ets_sys.h>
@@ -149,65 +154,45 @@ static const char *framesize_to_str(framesize_t fs)
   }
 }
 
+static bool _seqcap_ctrl_optional(camwebsrv_camera_ctrl_t c)
+{
+  // the required ones are applied separately, and flash/fps only matter
+  // while streaming
+  return c != CAMWEBSRV_CAMERA_CTRL_PIXFORMAT && c != CAMWEBSRV_CAMERA_CTRL_FRAMESIZE &&
+         c != CAMWEBSRV_CAMERA_CTRL_FLASH && c != CAMWEBSRV_CAMERA_CTRL_FPS;
+}
+
 static esp_err_t apply_cfg(camwebsrv_camera_t cam, const camwebsrv_seqcap_cfg_t *cfg)
 {
-  // pixformat and framesize first
-  esp_err_t rv = camwebsrv_camera_ctrl_set(cam, "pixformat", (int)cfg->pixformat);
-  if (rv != ESP_OK)
-    return rv;
-  rv = camwebsrv_camera_ctrl_set(cam, "framesize", (int)cfg->framesize);
+  camwebsrv_camera_ctrl_val_t vals[CAMWEBSRV_CAMERA_CTRL_MAX];
+  size_t count = 0;
+  size_t writes = 0;
+
+  // pixformat and framesize are required; the batch applies them first
+  vals[count].ctrl = CAMWEBSRV_CAMERA_CTRL_PIXFORMAT;
+  vals[count++].value = (int)cfg->pixformat;
+  vals[count].ctrl = CAMWEBSRV_CAMERA_CTRL_FRAMESIZE;
+  vals[count++].value = (int)cfg->framesize;
+
+  // Optional controls
+  for (int c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+  {
+    if (cfg->has_ctrl[c] && _seqcap_ctrl_optional(c))
+    {
+      vals[count].ctrl = c;
+      vals[count++].value = cfg->ctrl[c];
+    }
+  }
+
+  // one lock, and only the controls that actually change get written
+  esp_err_t rv = camwebsrv_camera_ctrl_set_batch(cam, vals, count, &writes);
   if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP apply_cfg(): camwebsrv_camera_ctrl_set_batch() failed: [%d]: %s", rv, esp_err_to_name(rv));
     return rv;
+  }
 
-  // Optional controls
-  if (cfg->has_quality)
-    camwebsrv_camera_ctrl_set(cam, "quality", cfg->quality);
-  if (cfg->has_brightness)
-    camwebsrv_camera_ctrl_set(cam, "brightness", cfg->brightness);
-  if (cfg->has_contrast)
-    camwebsrv_camera_ctrl_set(cam, "contrast", cfg->contrast);
-  if (cfg->has_saturation)
-    camwebsrv_camera_ctrl_set(cam, "saturation", cfg->saturation);
-  if (cfg->has_sharpness)
-    camwebsrv_camera_ctrl_set(cam, "sharpness", cfg->sharpness);
-  if (cfg->has_special_effect)
-    camwebsrv_camera_ctrl_set(cam, "special_effect", cfg->special_effect);
-  if (cfg->has_wb_mode)
-    camwebsrv_camera_ctrl_set(cam, "wb_mode", cfg->wb_mode);
-  if (cfg->has_aec)
-    camwebsrv_camera_ctrl_set(cam, "aec", cfg->aec);
-  if (cfg->has_aec2)
-    camwebsrv_camera_ctrl_set(cam, "aec2", cfg->aec2);
-  if (cfg->has_aec_value)
-    camwebsrv_camera_ctrl_set(cam, "aec_value", cfg->aec_value);
-  if (cfg->has_ae_level)
-    camwebsrv_camera_ctrl_set(cam, "ae_level", cfg->ae_level);
-  if (cfg->has_agc)
-    camwebsrv_camera_ctrl_set(cam, "agc", cfg->agc);
-  if (cfg->has_agc_gain)
-    camwebsrv_camera_ctrl_set(cam, "agc_gain", cfg->agc_gain);
-  if (cfg->has_gainceiling)
-    camwebsrv_camera_ctrl_set(cam, "gainceiling", cfg->gainceiling);
-  if (cfg->has_awb)
-    camwebsrv_camera_ctrl_set(cam, "awb", cfg->awb);
-  if (cfg->has_awb_gain)
-    camwebsrv_camera_ctrl_set(cam, "awb_gain", cfg->awb_gain);
-  if (cfg->has_dcw)
-    camwebsrv_camera_ctrl_set(cam, "dcw", cfg->dcw);
-  if (cfg->has_bpc)
-    camwebsrv_camera_ctrl_set(cam, "bpc", cfg->bpc);
-  if (cfg->has_wpc)
-    camwebsrv_camera_ctrl_set(cam, "wpc", cfg->wpc);
-  if (cfg->has_hmirror)
-    camwebsrv_camera_ctrl_set(cam, "hmirror", cfg->hmirror);
-  if (cfg->has_vflip)
-    camwebsrv_camera_ctrl_set(cam, "vflip", cfg->vflip);
-  if (cfg->has_lenc)
-    camwebsrv_camera_ctrl_set(cam, "lenc", cfg->lenc);
-  if (cfg->has_raw_gma)
-    camwebsrv_camera_ctrl_set(cam, "raw_gma", cfg->raw_gma);
-  if (cfg->has_colorbar)
-    camwebsrv_camera_ctrl_set(cam, "colorbar", cfg->colorbar);
+  ESP_LOGI(CAMWEBSRV_TAG, "SEQCAP apply_cfg(): %u of %u controls needed writing", (unsigned)writes, (unsigned)count);
 
   return ESP_OK;
 }
@@ -226,10 +211,11 @@ esp_err_t ensure_capture_dir(const char *cap_seq_name)
 
 char write_frame_to_sd_path[512];
 
-static esp_err_t write_frame_to_sd(const uint8_t *buf, size_t len)
+static esp_err_t write_frame_to_sd(const camwebsrv_camera_frame_t *frame)
 {
+  // capture time, not write time, since the write now trails the capture;
   // convert us -> ms, keep only 32-bit
-  uint32_t ts_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+  uint32_t ts_ms = (uint32_t)(frame->tstamp / 1000ULL);
 
   const char *fs = framesize_to_str(seqcap_cfg.framesize);
   if (!fs)
@@ -254,7 +240,320 @@ static esp_err_t write_frame_to_sd(const uint8_t *buf, size_t len)
   //ESP_LOGI(CAMWEBSRV_TAG, "SEQCAP: writing frame to SD: %s", write_frame_to_sd_path);
   ets_printf("SEQCAP: writing frame to SD: %s\n", write_frame_to_sd_path);
 
-  return sdcard_write_file(write_frame_to_sd_path, buf, len, false);
+  return sdcard_write_file(write_frame_to_sd_path, frame->buf, frame->len, false);
+}
+
+// with CAMWEBSRV_SEQCAP_CONTAINER, the whole sequence goes into one
+// <name>-<fs>.seq file in the capture dir instead (see seqfile.h)
+static esp_err_t open_container(const camwebsrv_seqcap_cfg_t *cfg, camwebsrv_seqfile_t *sf)
+{
+  char path[512];
+
+  int n = snprintf(path, sizeof(path),
+                   "%s/captures/%s/%s-%s.seq",
+                   CAMWEBSRV_SDCARD_MOUNT_PATH,
+                   cfg->cap_seq_name,
+                   cfg->cap_seq_name,
+                   framesize_to_str(cfg->framesize));
+
+  if (n < 0 || n >= (int)sizeof(path))
+  {
+    return ESP_ERR_INVALID_SIZE; // path too long
+  }
+
+  // with CAMWEBSRV_SEQCAP_PREALLOC, reserve room for the whole sequence up
+  // front; raw frames are exactly w*h*bpp, jpeg ones get the same allowance
+  // as the driver's own buffers, and the file simply grows past the end of
+  // the reserve if they outgrow it; with CAMWEBSRV_SEQCAP_RAW the same
+  // estimate is only checked against the size of the raw region
+  uint64_t reserve = 0;
+
+  if (CAMWEBSRV_SEQCAP_PREALLOC || CAMWEBSRV_SEQCAP_RAW)
+  {
+    size_t px = (size_t)resolution[cfg->framesize].width * resolution[cfg->framesize].height;
+    size_t frame_bytes;
+
+    switch (cfg->pixformat)
+    {
+    case PIXFORMAT_JPEG:
+      frame_bytes = px / CAMWEBSRV_SEQCAP_JPEG_DIV;
+      break;
+    case PIXFORMAT_GRAYSCALE:
+      frame_bytes = px;
+      break;
+    case PIXFORMAT_RGB888:
+      frame_bytes = px * 3;
+      break;
+    default:
+      frame_bytes = px * 2;
+      break;
+    }
+
+    reserve = camwebsrv_seqfile_estimate(frame_bytes, (uint32_t)cfg->cap_amount);
+  }
+
+  // with CAMWEBSRV_SEQCAP_RAW, the sequence goes to the unpartitioned end
+  // of the card instead, bypassing fatfs, and /seq_export copies it to path
+  // afterwards (see sdraw.h)
+  if (CAMWEBSRV_SEQCAP_RAW)
+  {
+    const camwebsrv_seqfile_blkdev_t *blk;
+    esp_err_t rv = camwebsrv_sdraw_open(&blk);
+
+    if (rv != ESP_OK)
+    {
+      return rv;
+    }
+
+    ESP_LOGI(CAMWEBSRV_TAG, "SEQCAP: writing sequence to raw SD sectors, for %s (%llu bytes estimated)", path, (unsigned long long)reserve);
+
+    return camwebsrv_seqfile_open_blk(sf, blk, path, (uint32_t)cfg->pixformat, (uint32_t)cfg->framesize, (uint32_t)cfg->cap_amount, reserve);
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "SEQCAP: writing sequence to SD: %s (%llu bytes reserved)", path, (unsigned long long)reserve);
+
+  return camwebsrv_seqfile_open(sf, path, (uint32_t)cfg->pixformat, (uint32_t)cfg->framesize, (uint32_t)cfg->cap_amount, reserve);
+}
+
+// ---------------- Pipelined writer ----------------
+// frames go from the capture loop to a writer task through a bounded queue,
+// so the sd write of one frame overlaps the readout of the next, and the
+// rate is bound by the slower of the two rather than by their sum; every
+// frame in flight holds one of the camera's CAMWEBSRV_CAMERA_FB_COUNT
+// buffers, which bounds CAMWEBSRV_SEQCAP_QUEUE_LEN
+
+typedef struct
+{
+  camwebsrv_camera_t cam;
+  QueueHandle_t queue;
+  SemaphoreHandle_t done;
+  camwebsrv_seqfile_t sf;
+  volatile bool failed;
+  uint32_t queued;
+  uint32_t written;
+  uint32_t qfull;
+  int64_t qfull_us;
+  int64_t tstart;
+} seqcap_writer_t;
+
+static seqcap_writer_t s_writer;
+
+static void seqcap_task_writer(void *arg)
+{
+  seqcap_writer_t *w = (seqcap_writer_t *)arg;
+  const camwebsrv_camera_frame_t *frame = NULL;
+
+  // NULL marks the end of the run; after a failed write, keep draining so
+  // that every reference still gets released
+  while (xQueueReceive(w->queue, &frame, portMAX_DELAY) == pdTRUE && frame != NULL)
+  {
+    if (!w->failed)
+    {
+      log_sanity_check_nolog(417);
+
+      esp_err_t rv = w->sf != NULL ? camwebsrv_seqfile_append(w->sf, frame) : write_frame_to_sd(frame);
+
+      if (rv == ESP_OK)
+      {
+        w->written++;
+      }
+      else
+      {
+        w->failed = true;
+      }
+    }
+
+    camwebsrv_camera_frame_release(w->cam, &frame);
+  }
+
+  xSemaphoreGive(w->done);
+  vTaskDelete(NULL);
+}
+
+static esp_err_t seqcap_writer_start(camwebsrv_camera_t cam, const camwebsrv_seqcap_cfg_t *cfg)
+{
+  seqcap_writer_t *w = &s_writer;
+
+  memset(w, 0x00, sizeof(*w));
+  w->cam = cam;
+  w->tstart = esp_timer_get_time();
+
+  if ((CAMWEBSRV_SEQCAP_CONTAINER || CAMWEBSRV_SEQCAP_RAW) && open_container(cfg, &(w->sf)) != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP seqcap_writer_start(): open_container() failed");
+    return ESP_FAIL;
+  }
+
+  w->queue = xQueueCreate(CAMWEBSRV_SEQCAP_QUEUE_LEN, sizeof(const camwebsrv_camera_frame_t *));
+  w->done = xSemaphoreCreateBinary();
+
+  if (w->queue == NULL || w->done == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP seqcap_writer_start(): xQueueCreate()/xSemaphoreCreateBinary() failed");
+    goto fail;
+  }
+
+  if (xTaskCreatePinnedToCore(seqcap_task_writer, "seqcap_writer", CAMWEBSRV_SEQCAP_WRITER_STACK, w, CAMWEBSRV_SEQCAP_WRITER_PRIO, NULL, CAMWEBSRV_SEQCAP_WRITER_CORE) != pdPASS)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP seqcap_writer_start(): xTaskCreatePinnedToCore() failed");
+    goto fail;
+  }
+
+  return ESP_OK;
+
+fail:
+  if (w->sf)
+    camwebsrv_seqfile_close(&(w->sf));
+  if (w->queue)
+    vQueueDelete(w->queue);
+  if (w->done)
+    vSemaphoreDelete(w->done);
+  w->queue = NULL;
+  w->done = NULL;
+  return ESP_FAIL;
+}
+
+// hands the frame reference over to the writer; a full queue means the card
+// is slower than the sensor, which is reported, and then waited out, since
+// dropping the frame would put master and slave sequences out of step
+static esp_err_t seqcap_writer_push(const camwebsrv_camera_frame_t *frame)
+{
+  seqcap_writer_t *w = &s_writer;
+
+  if (w->failed)
+  {
+    camwebsrv_camera_frame_release(w->cam, &frame);
+    return ESP_FAIL;
+  }
+
+  if (xQueueSend(w->queue, &frame, 0) != pdTRUE)
+  {
+    int64_t t0 = esp_timer_get_time();
+
+    w->qfull++;
+    ets_printf("SEQCAP: writer queue full at frame %" PRIu32 "; waiting\n", w->queued);
+
+    xQueueSend(w->queue, &frame, portMAX_DELAY);
+
+    w->qfull_us += esp_timer_get_time() - t0;
+  }
+
+  w->queued++;
+
+  return ESP_OK;
+}
+
+// waits for everything queued to be written, then reports how it went
+static esp_err_t seqcap_writer_finish(void)
+{
+  seqcap_writer_t *w = &s_writer;
+  const camwebsrv_camera_frame_t *end = NULL;
+  int64_t elapsed;
+
+  xQueueSend(w->queue, &end, portMAX_DELAY);
+  xSemaphoreTake(w->done, portMAX_DELAY);
+
+  vQueueDelete(w->queue);
+  vSemaphoreDelete(w->done);
+  w->queue = NULL;
+  w->done = NULL;
+
+  // the index goes in at the end, after the last frame
+  if (w->sf != NULL && camwebsrv_seqfile_close(&(w->sf)) != ESP_OK)
+  {
+    w->failed = true;
+  }
+
+  elapsed = esp_timer_get_time() - w->tstart;
+  elapsed = elapsed > 0 ? elapsed : 1;
+
+  ESP_LOGI(CAMWEBSRV_TAG, "SEQCAP writer: %" PRIu32 "/%" PRIu32 " frames written in %lld ms (%.2f fps); queue full %" PRIu32 " times, %lld ms waiting",
+           w->written,
+           w->queued,
+           (long long)(elapsed / 1000),
+           (double)w->written * 1000000.0 / (double)elapsed,
+           w->qfull,
+           (long long)(w->qfull_us / 1000));
+
+  return w->failed ? ESP_FAIL : ESP_OK;
+}
+
+// ---------------- Hardware-timed sync ----------------
+// with target_fps, the master's pulses come from syncgen.h at a fixed
+// period, whatever the capture loop and the card are doing, and the master
+// follows them; the slave takes a frame on every pulse, so the run lasts
+// cap_amount pulses rather than cap_amount master frames, and any pulse the
+// master was too slow to catch is a gap in its frame's pulse numbers. Each
+// master frame's pulse goes into <name>-<fs>.sync next to the sequence,
+// where pulse n pairs with the slave's n-th frame; frame_us is when the
+// driver saw that frame's vsync, never earlier than pulse_us
+
+typedef struct
+{
+  uint32_t pulse;
+  int64_t pulse_us;
+  int64_t frame_us;
+} seqcap_sync_t;
+
+static esp_err_t write_sync_manifest(const camwebsrv_seqcap_cfg_t *cfg, const seqcap_sync_t *recs, int count)
+{
+  char path[512];
+  int64_t period = 1000000 / cfg->target_fps;
+  int64_t err_max = 0;
+  uint32_t missed = 0;
+
+  int n = snprintf(path, sizeof(path),
+                   "%s/captures/%s/%s-%s.sync",
+                   CAMWEBSRV_SDCARD_MOUNT_PATH,
+                   cfg->cap_seq_name,
+                   cfg->cap_seq_name,
+                   framesize_to_str(cfg->framesize));
+
+  if (n < 0 || n >= (int)sizeof(path))
+  {
+    return ESP_ERR_INVALID_SIZE; // path too long
+  }
+
+  FILE *f = fopen(path, "w");
+
+  if (f == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP write_sync_manifest(%s): fopen() failed", path);
+    return ESP_FAIL;
+  }
+
+  fprintf(f, "frame,pulse,pulse_us,frame_us\n");
+
+  for (int i = 0; i < count; i++)
+  {
+    fprintf(f, "%d,%" PRIu32 ",%lld,%lld\n", i, recs[i].pulse, (long long)recs[i].pulse_us, (long long)recs[i].frame_us);
+
+    // how far each pulse strayed from where the nominal period puts it
+    if (i > 0)
+    {
+      uint32_t dn = recs[i].pulse - recs[i - 1].pulse;
+      int64_t err = (recs[i].pulse_us - recs[i - 1].pulse_us) - (int64_t)dn * period;
+
+      err = err < 0 ? -err : err;
+      err_max = err > err_max ? err : err_max;
+      missed += dn - 1;
+    }
+  }
+
+  if (fclose(f) != 0)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP write_sync_manifest(%s): fclose() failed", path);
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "SEQCAP: sync manifest %s: %d frames, %" PRIu32 " pulses missed, period %lld us, off by at most %lld us",
+           path,
+           count,
+           missed,
+           (long long)period,
+           (long long)err_max);
+
+  return ESP_OK;
 }
 
 static esp_err_t slave_http_prepare(const camwebsrv_seqcap_cfg_t *cfg, const char *slave_host)
@@ -296,10 +595,45 @@ static esp_err_t slave_http_prepare(const camwebsrv_seqcap_cfg_t *cfg, const cha
 }
 
 static SemaphoreHandle_t s_slave_trig = NULL;
+static volatile int64_t s_slave_tstamp = 0;
+
+// frame_next(), but giving back any frame that started exposing before
+// after (the pulse that asked for it) and trying again, a bounded number of
+// times; frame->tstamp is the driver's capture time, not when it got here
+static esp_err_t seqcap_frame_after(camwebsrv_camera_t cam, int64_t after, const camwebsrv_camera_frame_t **frame)
+{
+  esp_err_t rv;
+
+  for (int i = 0;; i++)
+  {
+    rv = camwebsrv_camera_frame_next(cam, frame);
+
+    if (rv != ESP_OK)
+    {
+      return rv;
+    }
+
+    if ((*frame)->tstamp >= after)
+    {
+      return ESP_OK;
+    }
+
+    if (i == CAMWEBSRV_SEQCAP_STALE_RETRIES)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP seqcap_frame_after(): still exposed %lld us before the pulse after %d retries", (long long)(after - (*frame)->tstamp), i);
+      camwebsrv_camera_frame_release(cam, frame);
+      return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGW(CAMWEBSRV_TAG, "SEQCAP seqcap_frame_after(): discarding frame exposed %lld us before the pulse", (long long)(after - (*frame)->tstamp));
+    camwebsrv_camera_frame_release(cam, frame);
+  }
+}
 
 static void IRAM_ATTR slave_isr(void *arg)
 {
   BaseType_t hp = pdFALSE;
+  s_slave_tstamp = esp_timer_get_time();
   if (s_slave_trig)
   {
     xSemaphoreGiveFromISR(s_slave_trig, &hp);
@@ -307,17 +641,6 @@ static void IRAM_ATTR slave_isr(void *arg)
   if (hp)
     portYIELD_FROM_ISR();
 }
-#include "esp_camera.h"
-
-// helper: grab+return (drop) frame safely
-static inline void drop_one_frame(uint32_t delay_us)
-{
-    camera_fb_t *fb = esp_camera_fb_get();
-    if (fb) {
-        esp_camera_fb_return(fb);
-    }
-    if (delay_us) ets_delay_us(delay_us);
-}
 
 static void seqcap_task_master(void *arg)
 {
@@ -366,7 +689,7 @@ static void seqcap_task_master(void *arg)
   if (ensure_capture_dir(a->cfg->cap_seq_name) != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: failed to create capture dir");
-    goto out_sd;
+    goto out_net;
   }
 
   log_sanity_check(343);
@@ -375,58 +698,142 @@ static void seqcap_task_master(void *arg)
   if (apply_cfg(a->cam, a->cfg) != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: failed to apply camera cfg");
-    goto out_sd;
+    goto out_net;
   }
 
   log_sanity_check(352);
 
-  // OPTIONAL but recommended: stop any streaming task before capture
-  // (if you have one) to ensure only this task uses esp_camera_fb_get().
+  // frames come from the camera module (capture task or on-demand grab),
+  // so nothing else is competing for esp_camera_fb_get() here
 
-  // drop 5 frames to stabilize (RAW: fb_get + fb_return)
-  for (int i = 0; i < 5; i++)
+  // wait for exposure to settle on the new settings; carry on regardless
+  if (camwebsrv_camera_warmup(a->cam) != ESP_OK)
   {
-    drop_one_frame(30000); // 30ms
+    ESP_LOGW(CAMWEBSRV_TAG, "SEQCAP master: camera warm-up did not settle");
   }
 
   log_sanity_check(367);
-  vTaskDelay(pdMS_TO_TICKS(1000));
 
-  // 5) Configure sync pin
+  // 5) Configure sync pin (syncgen.h takes it over with target_fps)
   gpio_set_direction(CAMWEBSRV_PIN_SYNC, GPIO_MODE_OUTPUT);
   gpio_set_level(CAMWEBSRV_PIN_SYNC, 0);
 
   log_sanity_check(366);
 
-  // 6) Capture loop (RAW fb ownership: get -> write -> return)
-  for (int i = 0; i < a->cfg->cap_amount; i++)
+  // 6) Capture loop (frame reference: next -> writer queue; the writer
+  // releases it once it is on the card)
+  if (seqcap_writer_start(a->cam, a->cfg) != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: failed to start writer");
+    goto out_net;
+  }
+
+  if (a->cfg->target_fps > 0)
+  {
+    seqcap_sync_t *sync = calloc(a->cfg->cap_amount, sizeof(seqcap_sync_t));
+    int synced = 0;
+
+    // no pulses means no slave frames either, so this run is over; no blink,
+    // which is what says a run went through
+
+    if (sync == NULL || camwebsrv_syncgen_start((uint32_t)a->cfg->target_fps) != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: failed to start sync generator at %d fps; nothing captured", a->cfg->target_fps);
+      free(sync);
+      seqcap_writer_finish();
+      goto out_net;
+    }
+
+    // two periods without a pulse means the generator has stopped
+    TickType_t timeout = pdMS_TO_TICKS(2000 / a->cfg->target_fps + 100);
+
+    while (synced < a->cfg->cap_amount)
+    {
+      camwebsrv_syncgen_pulse_t pulse;
+
+      log_sanity_check(380);
+
+      esp_err_t rv = camwebsrv_syncgen_wait(&pulse, timeout);
+
+      if (rv != ESP_OK)
+      {
+        ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: syncgen_wait failed: %s", esp_err_to_name(rv));
+        break;
+      }
+
+      if (pulse.number > (uint32_t)a->cfg->cap_amount)
+      {
+        break;
+      }
+
+      // no more once the slave has had its cap_amount
+      if (pulse.number == (uint32_t)a->cfg->cap_amount)
+      {
+        camwebsrv_syncgen_stop();
+      }
+
+      const camwebsrv_camera_frame_t *frame = NULL;
+      rv = seqcap_frame_after(a->cam, pulse.tstamp, &frame);
+
+      if (rv != ESP_OK)
+      {
+        ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: frame_next failed: %s", esp_err_to_name(rv));
+        break;
+      }
+
+      sync[synced].pulse = pulse.number;
+      sync[synced].pulse_us = pulse.tstamp;
+      sync[synced].frame_us = frame->tstamp;
+      synced++;
+
+      // the writer owns the reference from here, even on failure
+      rv = seqcap_writer_push(frame);
+
+      if (rv != ESP_OK)
+      {
+        ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: write failed");
+        break;
+      }
+
+      if (pulse.number == (uint32_t)a->cfg->cap_amount)
+      {
+        break;
+      }
+    }
+
+    camwebsrv_syncgen_stop();
+
+    if (synced > 0 && write_sync_manifest(a->cfg, sync, synced) != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: failed to write sync manifest");
+    }
+
+    free(sync);
+  }
+
+  for (int i = 0; a->cfg->target_fps <= 0 && i < a->cfg->cap_amount; i++)
   {
     log_sanity_check(380);
 
     gpio_set_level(CAMWEBSRV_PIN_SYNC, 1);
 
-    camera_fb_t *fb = esp_camera_fb_get();   // <-- OWNERSHIP HERE
+    const camwebsrv_camera_frame_t *frame = NULL;
+    esp_err_t rv = camwebsrv_camera_frame_next(a->cam, &frame);   // <-- REFERENCE HERE
 
     ets_delay_us(5000);
     gpio_set_level(CAMWEBSRV_PIN_SYNC, 0);
 
-    if (!fb)
+    if (rv != ESP_OK)
     {
-      ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: esp_camera_fb_get failed");
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: frame_next failed: %s", esp_err_to_name(rv));
       break;
     }
 
-    // If you care about enforcing RAW/JPEG etc, you can sanity check:
-    // if (fb->format != a->cfg->pixformat) { ... }
 
     vTaskDelay(pdMS_TO_TICKS(5));
-    log_sanity_check_nolog(417);
-
-    esp_err_t rv = write_frame_to_sd(fb->buf, fb->len);
 
-    // IMPORTANT: return buffer no matter what
-    esp_camera_fb_return(fb);
-    fb = NULL;
+    // the writer owns the reference from here, even on failure
+    rv = seqcap_writer_push(frame);
 
     if (rv != ESP_OK)
     {
@@ -440,12 +847,19 @@ static void seqcap_task_master(void *arg)
     }
   }
 
+  if (seqcap_writer_finish() != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP master: write failed");
+  }
+
   // 7) Optional blink: unmount SD before blinking (GPIO4 conflict)
   ESP_ERROR_CHECK(sdcard_unmount(sd_cfg.mount_point, card));
   blink_pattern();
   ESP_ERROR_CHECK(sdcard_mount(&sd_cfg, &card));
 
-  // 8) Restore Wi-Fi + HTTPD ONCE
+  // 8) Restore Wi-Fi + HTTPD ONCE; failures come straight here too, since
+  // the card stays mounted and nothing else brings the network back
+out_net:
   esp_wifi_start();
   esp_wifi_connect();
   if (a->httpd)
@@ -453,12 +867,7 @@ static void seqcap_task_master(void *arg)
     camwebsrv_httpd_start(a->httpd);
   }
 
-  free(a);
-  goto out;
-
-out_sd:
-  ESP_ERROR_CHECK(sdcard_unmount(sd_cfg.mount_point, card));
-out:
+  // a points at seqcap_task_arg, so there is nothing to free
   s_active = false;
   vTaskDelete(NULL);
 }
@@ -478,12 +887,19 @@ static void seqcap_task_slave(void *arg)
   if (ensure_capture_dir(a->cfg->cap_seq_name) != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP slave: failed to create capture dir");
-    goto out_sd;
+    goto out_net;
   }
   if (apply_cfg(a->cam, a->cfg) != ESP_OK)
   {
     ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP slave: failed to apply camera cfg");
-    goto out_sd;
+    goto out_net;
+  }
+
+  // the master no longer sits out a fixed second before triggering, so be
+  // settled before arming
+  if (camwebsrv_camera_warmup(a->cam) != ESP_OK)
+  {
+    ESP_LOGW(CAMWEBSRV_TAG, "SEQCAP slave: camera warm-up did not settle");
   }
 
   // Prepare GPIO interrupt on sync pin
@@ -509,22 +925,29 @@ static void seqcap_task_slave(void *arg)
   }
   gpio_isr_handler_add(CAMWEBSRV_PIN_SYNC, slave_isr, NULL);
 
+  if (seqcap_writer_start(a->cam, a->cfg) != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP slave: failed to start writer");
+    gpio_isr_handler_remove(CAMWEBSRV_PIN_SYNC);
+    goto out_net;
+  }
+
   for (int i = 0; i < a->cfg->cap_amount; i++)
   {
-    if (xSemaphoreTake(s_slave_trig, portMAX_DELAY) != pdTRUE)
+    // a master that never gets going mustn't leave this one offline
+    if (xSemaphoreTake(s_slave_trig, pdMS_TO_TICKS(CAMWEBSRV_SEQCAP_SLAVE_TMOUT)) != pdTRUE)
     {
-      continue;
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP slave: no trigger after %d of %d frames", i, a->cfg->cap_amount);
+      break;
     }
-    uint8_t *fbuf = NULL;
-    size_t flen = 0;
-    esp_err_t rv = camwebsrv_camera_frame_grab(a->cam, &fbuf, &flen, NULL);
+    const camwebsrv_camera_frame_t *frame = NULL;
+    esp_err_t rv = seqcap_frame_after(a->cam, s_slave_tstamp, &frame);
     if (rv != ESP_OK)
     {
-      ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP slave: frame_grab failed: %s", esp_err_to_name(rv));
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP slave: frame_next failed: %s", esp_err_to_name(rv));
       break;
     }
-    rv = write_frame_to_sd(fbuf, flen);
-    camwebsrv_camera_frame_dispose(a->cam);
+    rv = seqcap_writer_push(frame);
     if (rv != ESP_OK)
     {
       ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP slave: write failed");
@@ -532,13 +955,19 @@ static void seqcap_task_slave(void *arg)
     }
   }
 
+  if (seqcap_writer_finish() != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQCAP slave: write failed");
+  }
+
   gpio_isr_handler_remove(CAMWEBSRV_PIN_SYNC);
 
   ESP_ERROR_CHECK(sdcard_unmount(sd_cfg.mount_point, card));
   blink_pattern();
   ESP_ERROR_CHECK(sdcard_mount(&sd_cfg, &card));
 
-  // Bring Wi-Fi + web server back
+  // Bring Wi-Fi + web server back, failures included
+out_net:
   esp_wifi_start();
   esp_wifi_connect();
   if (a->httpd)
@@ -546,11 +975,6 @@ static void seqcap_task_slave(void *arg)
     camwebsrv_httpd_start(a->httpd);
   }
 
-  goto out;
-
-out_sd:
-  ESP_ERROR_CHECK(sdcard_unmount(sd_cfg.mount_point, card));
-out:
   s_active = false;
   free(a);
   vTaskDelete(NULL);
@@ -25,34 +25,14 @@ typedef struct
   int cap_amount;
 
   // Optional: pass-through camera controls (set only if present)
-  bool has_quality; int quality;
-  bool has_brightness; int brightness;
-  bool has_contrast; int contrast;
-  bool has_saturation; int saturation;
-  bool has_sharpness; int sharpness;
-  bool has_special_effect; int special_effect;
-  bool has_wb_mode; int wb_mode;
-  bool has_aec; int aec;
-  bool has_aec2; int aec2;
-  bool has_aec_value; int aec_value;
-  bool has_ae_level; int ae_level;
-  bool has_agc; int agc;
-  bool has_agc_gain; int agc_gain;
-  bool has_gainceiling; int gainceiling;
-  bool has_awb; int awb;
-  bool has_awb_gain; int awb_gain;
-  bool has_dcw; int dcw;
-  bool has_bpc; int bpc;
-  bool has_wpc; int wpc;
-  bool has_hmirror; int hmirror;
-  bool has_vflip; int vflip;
-  bool has_lenc; int lenc;
-  bool has_raw_gma; int raw_gma;
-  bool has_colorbar; int colorbar;
+  // (pixformat, framesize, flash and fps are never taken from here)
+  bool has_ctrl[CAMWEBSRV_CAMERA_CTRL_MAX];
+  int ctrl[CAMWEBSRV_CAMERA_CTRL_MAX];
 
   // Timing
   int slave_prepare_delay_ms; // master waits after init request
   int inter_frame_delay_ms;   // master waits between frames
+  int target_fps;             // master pulses at this rate (syncgen.h), if > 0
 } camwebsrv_seqcap_cfg_t;
 
 
@@ -0,0 +1,737 @@
+// 2026-10-16 seqfile.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "seqfile.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <esp_vfs_fat.h>
+
+#define _CAMWEBSRV_SEQFILE_BLK_BYTES (CAMWEBSRV_SEQFILE_BLK_CHUNK * CAMWEBSRV_SEQFILE_ALIGN)
+
+typedef struct
+{
+  int fd;
+  uint64_t offset;
+  uint32_t count;
+  uint32_t capacity;
+  camwebsrv_seqfile_entry_t *index;
+  const camwebsrv_seqfile_blkdev_t *blk;
+  uint8_t *dma;
+  size_t dfill;
+  size_t dsector;
+  camwebsrv_seqfile_super_t super;
+  uint8_t sector[CAMWEBSRV_SEQFILE_ALIGN];
+} _camwebsrv_seqfile_t;
+
+static _camwebsrv_seqfile_t *_camwebsrv_seqfile_alloc(uint32_t capacity);
+static void _camwebsrv_seqfile_free(_camwebsrv_seqfile_t *psf);
+static esp_err_t _camwebsrv_seqfile_header(_camwebsrv_seqfile_t *psf, uint32_t pixformat, uint32_t framesize);
+static esp_err_t _camwebsrv_seqfile_reserve(const char *path, uint64_t reserve);
+static esp_err_t _camwebsrv_seqfile_write(_camwebsrv_seqfile_t *psf, const void *buf, size_t len);
+static esp_err_t _camwebsrv_seqfile_flush(_camwebsrv_seqfile_t *psf);
+static esp_err_t _camwebsrv_seqfile_super(_camwebsrv_seqfile_t *psf);
+static esp_err_t _camwebsrv_seqfile_read_at(int fd, uint64_t offset, void *buf, size_t len);
+
+uint64_t camwebsrv_seqfile_estimate(size_t frame_bytes, uint32_t capacity)
+{
+  uint64_t record;
+
+  record = sizeof(camwebsrv_seqfile_record_t) + frame_bytes;
+  record = ((record + CAMWEBSRV_SEQFILE_ALIGN - 1) / CAMWEBSRV_SEQFILE_ALIGN) * CAMWEBSRV_SEQFILE_ALIGN;
+
+  return CAMWEBSRV_SEQFILE_ALIGN + (record + sizeof(camwebsrv_seqfile_entry_t)) * capacity + sizeof(camwebsrv_seqfile_footer_t);
+}
+
+esp_err_t camwebsrv_seqfile_open(camwebsrv_seqfile_t *sf, const char *path, uint32_t pixformat, uint32_t framesize, uint32_t capacity, uint64_t reserve)
+{
+  _camwebsrv_seqfile_t *psf;
+  esp_err_t rv;
+
+  if (sf == NULL || path == NULL || capacity == 0)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // a file that has to grow as it goes is slower, but still better than no
+  // sequence at all, so a reserve that can't be had is only a warning
+
+  if (reserve > 0)
+  {
+    rv = _camwebsrv_seqfile_reserve(path, reserve);
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGW(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open(%s): _camwebsrv_seqfile_reserve(%" PRIu64 ") failed: [%d]: %s; carrying on without", path, reserve, rv, esp_err_to_name(rv));
+      reserve = 0;
+    }
+  }
+
+  psf = _camwebsrv_seqfile_alloc(capacity);
+
+  if (psf == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open(): _camwebsrv_seqfile_alloc() failed");
+    return ESP_FAIL;
+  }
+
+  // straight through the vfs to fatfs, without stdio buffering in between,
+  // so that sector-aligned runs go out as multi-sector writes; truncating
+  // would give back the clusters that were just reserved
+
+  psf->fd = open(path, reserve > 0 ? O_WRONLY : O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+  if (psf->fd < 0)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open(%s): open() failed: [%d]: %s", path, e, strerror(e));
+    _camwebsrv_seqfile_free(psf);
+    return ESP_FAIL;
+  }
+
+  rv = _camwebsrv_seqfile_header(psf, pixformat, framesize);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open(%s): _camwebsrv_seqfile_header() failed: [%d]: %s", path, rv, esp_err_to_name(rv));
+    close(psf->fd);
+    _camwebsrv_seqfile_free(psf);
+    return rv;
+  }
+
+  *sf = (camwebsrv_seqfile_t) psf;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_seqfile_open_blk(camwebsrv_seqfile_t *sf, const camwebsrv_seqfile_blkdev_t *blk, const char *path, uint32_t pixformat, uint32_t framesize, uint32_t capacity, uint64_t reserve)
+{
+  _camwebsrv_seqfile_t *psf;
+  esp_err_t rv;
+
+  if (sf == NULL || blk == NULL || blk->write == NULL || path == NULL || capacity == 0 || blk->sectors < 2)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // the path goes in the super block for the export to use; cut short, it
+  // would name some other file
+
+  if (strlen(path) >= CAMWEBSRV_SEQFILE_PATH_LEN)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open_blk(%s): failed; path longer than %d", path, CAMWEBSRV_SEQFILE_PATH_LEN - 1);
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  // the whole range is ours, so the only question is whether it is enough
+
+  if (reserve > (uint64_t) (blk->sectors - 1) * CAMWEBSRV_SEQFILE_ALIGN)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open_blk(): failed; %" PRIu64 " bytes needed, %" PRIu64 " available", reserve, (uint64_t) (blk->sectors - 1) * CAMWEBSRV_SEQFILE_ALIGN);
+    return ESP_ERR_NO_MEM;
+  }
+
+  psf = _camwebsrv_seqfile_alloc(capacity);
+
+  if (psf == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open_blk(): _camwebsrv_seqfile_alloc() failed");
+    return ESP_FAIL;
+  }
+
+  // psram is not dma-capable, so everything is copied through this on its
+  // way to the card
+
+  psf->dma = (uint8_t *) heap_caps_malloc(_CAMWEBSRV_SEQFILE_BLK_BYTES, MALLOC_CAP_DMA);
+
+  if (psf->dma == NULL)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open_blk(): heap_caps_malloc(%d) failed", _CAMWEBSRV_SEQFILE_BLK_BYTES);
+    _camwebsrv_seqfile_free(psf);
+    return ESP_FAIL;
+  }
+
+  psf->blk = blk;
+  psf->dsector = 1;
+
+  memcpy(psf->super.magic, CAMWEBSRV_SEQFILE_MAGIC_SUPER, sizeof(psf->super.magic));
+  psf->super.version = CAMWEBSRV_SEQFILE_VERSION;
+  strcpy(psf->super.path, path);
+
+  // a zero length marks it as unfinished, and whatever was there before as
+  // gone
+
+  rv = _camwebsrv_seqfile_super(psf);
+
+  if (rv == ESP_OK)
+  {
+    rv = _camwebsrv_seqfile_header(psf, pixformat, framesize);
+  }
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_open_blk(%s): failed: [%d]: %s", path, rv, esp_err_to_name(rv));
+    _camwebsrv_seqfile_free(psf);
+    return rv;
+  }
+
+  *sf = (camwebsrv_seqfile_t) psf;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_seqfile_append(camwebsrv_seqfile_t sf, const camwebsrv_camera_frame_t *frame)
+{
+  _camwebsrv_seqfile_t *psf;
+  camwebsrv_seqfile_record_t record;
+  camwebsrv_seqfile_entry_t *pentry;
+  size_t head;
+  size_t body;
+  size_t tail;
+  uint64_t offset;
+  esp_err_t rv;
+
+  if (sf == NULL || frame == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  psf = (_camwebsrv_seqfile_t *) sf;
+
+  if (psf->count >= psf->capacity)
+  {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  offset = psf->offset;
+
+  memset(&record, 0x00, sizeof(record));
+  memcpy(record.magic, CAMWEBSRV_SEQFILE_MAGIC_RECORD, sizeof(record.magic));
+  record.number = psf->count;
+  record.tstamp = frame->tstamp;
+  record.len = frame->len;
+  record.crc = esp_rom_crc32_le(0, frame->buf, frame->len);
+  record.width = frame->width;
+  record.height = frame->height;
+  record.seq = frame->seq;
+
+  // the first sector holds the record header and the start of the frame;
+  // the bulk of the frame then goes out straight from its own buffer, in
+  // whole sectors, and what is left over goes in one last padded sector
+
+  head = CAMWEBSRV_SEQFILE_ALIGN - sizeof(record);
+  head = frame->len < head ? frame->len : head;
+  body = ((frame->len - head) / CAMWEBSRV_SEQFILE_ALIGN) * CAMWEBSRV_SEQFILE_ALIGN;
+  tail = frame->len - head - body;
+
+  memset(psf->sector, 0x00, sizeof(psf->sector));
+  memcpy(psf->sector, &record, sizeof(record));
+  memcpy(psf->sector + sizeof(record), frame->buf, head);
+
+  rv = _camwebsrv_seqfile_write(psf, psf->sector, sizeof(psf->sector));
+
+  if (rv == ESP_OK && body > 0)
+  {
+    rv = _camwebsrv_seqfile_write(psf, frame->buf + head, body);
+  }
+
+  if (rv == ESP_OK && tail > 0)
+  {
+    memset(psf->sector, 0x00, sizeof(psf->sector));
+    memcpy(psf->sector, frame->buf + head + body, tail);
+
+    rv = _camwebsrv_seqfile_write(psf, psf->sector, sizeof(psf->sector));
+  }
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_append(%" PRIu32 "): _camwebsrv_seqfile_write() failed: [%d]: %s", psf->count, rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  pentry = &(psf->index[psf->count]);
+
+  pentry->offset = offset;
+  pentry->tstamp = record.tstamp;
+  pentry->len = record.len;
+  pentry->number = record.number;
+  pentry->crc = record.crc;
+  pentry->seq = record.seq;
+
+  psf->count++;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_seqfile_close(camwebsrv_seqfile_t *sf)
+{
+  _camwebsrv_seqfile_t *psf;
+  camwebsrv_seqfile_footer_t footer;
+  esp_err_t rv;
+
+  if (sf == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  psf = (_camwebsrv_seqfile_t *) *sf;
+
+  if (psf == NULL)
+  {
+    return ESP_OK;
+  }
+
+  // index, then the footer that points at it
+
+  memset(&footer, 0x00, sizeof(footer));
+  memcpy(footer.magic, CAMWEBSRV_SEQFILE_MAGIC_FOOTER, sizeof(footer.magic));
+  footer.count = psf->count;
+  footer.offset = psf->offset;
+
+  rv = _camwebsrv_seqfile_write(psf, psf->index, psf->count * sizeof(camwebsrv_seqfile_entry_t));
+
+  if (rv == ESP_OK)
+  {
+    rv = _camwebsrv_seqfile_write(psf, &footer, sizeof(footer));
+  }
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_close(): _camwebsrv_seqfile_write() failed: [%d]: %s", rv, esp_err_to_name(rv));
+  }
+
+  if (psf->blk != NULL)
+  {
+    // out with the last partial chunk, then say how long it all is
+
+    rv = rv == ESP_OK ? _camwebsrv_seqfile_flush(psf) : rv;
+
+    if (rv == ESP_OK)
+    {
+      psf->super.length = psf->offset;
+      psf->super.count = psf->count;
+
+      rv = _camwebsrv_seqfile_super(psf);
+    }
+
+    if (rv != ESP_OK)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_close(): failed to finish on the block device: [%d]: %s", rv, esp_err_to_name(rv));
+    }
+  }
+  else
+  {
+    // drop whatever is left of the reserve; a no-op if there was none, or
+    // if the frames outgrew it
+
+    if (ftruncate(psf->fd, (off_t) psf->offset) != 0)
+    {
+      int e = errno;
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_close(): ftruncate(%" PRIu64 ") failed: [%d]: %s", psf->offset, e, strerror(e));
+      rv = ESP_FAIL;
+    }
+
+    if (close(psf->fd) != 0)
+    {
+      int e = errno;
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_close(): close() failed: [%d]: %s", e, strerror(e));
+      rv = ESP_FAIL;
+    }
+  }
+
+  ESP_LOGI(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_close(): %" PRIu32 " frames, %" PRIu64 " bytes", psf->count, psf->offset);
+
+  _camwebsrv_seqfile_free(psf);
+
+  *sf = NULL;
+
+  return rv;
+}
+
+esp_err_t camwebsrv_seqfile_load(const char *path, camwebsrv_seqfile_header_t *header, camwebsrv_seqfile_entry_t **index, uint32_t *count)
+{
+  camwebsrv_seqfile_footer_t footer;
+  camwebsrv_seqfile_entry_t *pindex;
+  off_t size;
+  int fd;
+  esp_err_t rv;
+
+  if (path == NULL || header == NULL || index == NULL || count == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  fd = open(path, O_RDONLY);
+
+  if (fd < 0)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_load(%s): open() failed: [%d]: %s", path, e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  size = lseek(fd, 0, SEEK_END);
+
+  if (size < (off_t) (CAMWEBSRV_SEQFILE_ALIGN + sizeof(footer)))
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_load(%s): failed; too short to be a sequence", path);
+    close(fd);
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  // the header at the start, the footer as the last thing in the file
+
+  rv = _camwebsrv_seqfile_read_at(fd, 0, header, sizeof(*header));
+
+  if (rv == ESP_OK)
+  {
+    rv = _camwebsrv_seqfile_read_at(fd, (uint64_t) size - sizeof(footer), &footer, sizeof(footer));
+  }
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_load(%s): _camwebsrv_seqfile_read_at() failed: [%d]: %s", path, rv, esp_err_to_name(rv));
+    close(fd);
+    return rv;
+  }
+
+  if (memcmp(header->magic, CAMWEBSRV_SEQFILE_MAGIC_HEADER, sizeof(header->magic)) != 0 || header->version != CAMWEBSRV_SEQFILE_VERSION || header->align != CAMWEBSRV_SEQFILE_ALIGN)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_load(%s): failed; not a version %d sequence", path, CAMWEBSRV_SEQFILE_VERSION);
+    close(fd);
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  // a capture that never got to close() has no index to read back
+
+  if (memcmp(footer.magic, CAMWEBSRV_SEQFILE_MAGIC_FOOTER, sizeof(footer.magic)) != 0 || footer.offset + (uint64_t) footer.count * sizeof(camwebsrv_seqfile_entry_t) + sizeof(footer) != (uint64_t) size)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_load(%s): failed; no index", path);
+    close(fd);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  pindex = (camwebsrv_seqfile_entry_t *) calloc(footer.count > 0 ? footer.count : 1, sizeof(camwebsrv_seqfile_entry_t));
+
+  if (pindex == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_load(%s): calloc(%" PRIu32 ") failed: [%d]: %s", path, footer.count, e, strerror(e));
+    close(fd);
+    return ESP_FAIL;
+  }
+
+  rv = _camwebsrv_seqfile_read_at(fd, footer.offset, pindex, footer.count * sizeof(camwebsrv_seqfile_entry_t));
+
+  close(fd);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_load(%s): _camwebsrv_seqfile_read_at() failed: [%d]: %s", path, rv, esp_err_to_name(rv));
+    free(pindex);
+    return rv;
+  }
+
+  *index = pindex;
+  *count = footer.count;
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_seqfile_read(const char *path, const camwebsrv_seqfile_entry_t *entry, camwebsrv_seqfile_record_t *record, uint8_t *buf)
+{
+  int fd;
+  esp_err_t rv;
+
+  if (path == NULL || entry == NULL || record == NULL || buf == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  fd = open(path, O_RDONLY);
+
+  if (fd < 0)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_read(%s): open() failed: [%d]: %s", path, e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  // the frame follows its record without a break, whatever sectors it
+  // was written out in
+
+  rv = _camwebsrv_seqfile_read_at(fd, entry->offset, record, sizeof(*record));
+
+  if (rv == ESP_OK)
+  {
+    rv = _camwebsrv_seqfile_read_at(fd, entry->offset + sizeof(*record), buf, entry->len);
+  }
+
+  close(fd);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_read(%s, %" PRIu32 "): _camwebsrv_seqfile_read_at() failed: [%d]: %s", path, entry->number, rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  if (memcmp(record->magic, CAMWEBSRV_SEQFILE_MAGIC_RECORD, sizeof(record->magic)) != 0 || record->number != entry->number || record->len != entry->len)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_read(%s, %" PRIu32 "): failed; record does not match the index", path, entry->number);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (esp_rom_crc32_le(0, buf, entry->len) != entry->crc)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE camwebsrv_seqfile_read(%s, %" PRIu32 "): failed; bad crc", path, entry->number);
+    return ESP_ERR_INVALID_CRC;
+  }
+
+  return ESP_OK;
+}
+
+static _camwebsrv_seqfile_t *_camwebsrv_seqfile_alloc(uint32_t capacity)
+{
+  _camwebsrv_seqfile_t *psf;
+
+  psf = (_camwebsrv_seqfile_t *) malloc(sizeof(_camwebsrv_seqfile_t));
+
+  if (psf == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_alloc(): malloc() failed: [%d]: %s", e, strerror(e));
+    return NULL;
+  }
+
+  memset(psf, 0x00, sizeof(_camwebsrv_seqfile_t));
+
+  psf->fd = -1;
+  psf->capacity = capacity;
+
+  // the index is kept in memory until close(), so it costs nothing per frame
+
+  psf->index = (camwebsrv_seqfile_entry_t *) calloc(capacity, sizeof(camwebsrv_seqfile_entry_t));
+
+  if (psf->index == NULL)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_alloc(): calloc(%" PRIu32 ") failed: [%d]: %s", capacity, e, strerror(e));
+    free(psf);
+    return NULL;
+  }
+
+  return psf;
+}
+
+static void _camwebsrv_seqfile_free(_camwebsrv_seqfile_t *psf)
+{
+  if (psf->dma != NULL)
+  {
+    heap_caps_free(psf->dma);
+  }
+
+  free(psf->index);
+  free(psf);
+}
+
+static esp_err_t _camwebsrv_seqfile_header(_camwebsrv_seqfile_t *psf, uint32_t pixformat, uint32_t framesize)
+{
+  camwebsrv_seqfile_header_t header;
+
+  memset(&header, 0x00, sizeof(header));
+  memcpy(header.magic, CAMWEBSRV_SEQFILE_MAGIC_HEADER, sizeof(header.magic));
+  header.version = CAMWEBSRV_SEQFILE_VERSION;
+  header.align = CAMWEBSRV_SEQFILE_ALIGN;
+  header.pixformat = pixformat;
+  header.framesize = framesize;
+  header.capacity = psf->capacity;
+
+  memset(psf->sector, 0x00, sizeof(psf->sector));
+  memcpy(psf->sector, &header, sizeof(header));
+
+  return _camwebsrv_seqfile_write(psf, psf->sector, sizeof(psf->sector));
+}
+
+static esp_err_t _camwebsrv_seqfile_reserve(const char *path, uint64_t reserve)
+{
+  uint64_t total;
+  uint64_t avail;
+  esp_err_t rv;
+
+  rv = esp_vfs_fat_info(CAMWEBSRV_SDCARD_MOUNT_PATH, &total, &avail);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_reserve(): esp_vfs_fat_info() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  if (reserve > avail)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_reserve(): failed; %" PRIu64 " bytes needed, %" PRIu64 " free", reserve, avail);
+    return ESP_ERR_NO_MEM;
+  }
+
+  // f_expand() only works on an empty file, so start from nothing
+
+  if (unlink(path) != 0 && errno != ENOENT)
+  {
+    int e = errno;
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_reserve(): unlink(%s) failed: [%d]: %s", path, e, strerror(e));
+    return ESP_FAIL;
+  }
+
+  // one contiguous run, with the FAT written now rather than during capture
+
+  rv = esp_vfs_fat_create_contiguous_file(CAMWEBSRV_SDCARD_MOUNT_PATH, path, reserve, true);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_reserve(): esp_vfs_fat_create_contiguous_file() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_seqfile_write(_camwebsrv_seqfile_t *psf, const void *buf, size_t len)
+{
+  const uint8_t *p = (const uint8_t *) buf;
+  ssize_t n;
+  esp_err_t rv;
+
+  // on a block device, fill the staging buffer and send it off whenever it
+  // is full; everything but the index comes in whole sectors, so only
+  // close() ever leaves a partial one
+
+  while (psf->blk != NULL && len > 0)
+  {
+    n = _CAMWEBSRV_SEQFILE_BLK_BYTES - psf->dfill;
+    n = (size_t) n < len ? n : (ssize_t) len;
+
+    memcpy(psf->dma + psf->dfill, p, n);
+
+    p += n;
+    len -= n;
+    psf->dfill += n;
+    psf->offset += n;
+
+    if (psf->dfill == _CAMWEBSRV_SEQFILE_BLK_BYTES)
+    {
+      rv = _camwebsrv_seqfile_flush(psf);
+
+      if (rv != ESP_OK)
+      {
+        return rv;
+      }
+    }
+  }
+
+  while (len > 0)
+  {
+    n = write(psf->fd, p, len);
+
+    if (n <= 0)
+    {
+      int e = errno;
+      ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_write(): write() failed: [%d]: %s", e, strerror(e));
+      return ESP_FAIL;
+    }
+
+    p += n;
+    len -= n;
+    psf->offset += n;
+  }
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_seqfile_flush(_camwebsrv_seqfile_t *psf)
+{
+  size_t count;
+  esp_err_t rv;
+
+  count = (psf->dfill + CAMWEBSRV_SEQFILE_ALIGN - 1) / CAMWEBSRV_SEQFILE_ALIGN;
+
+  if (count == 0)
+  {
+    return ESP_OK;
+  }
+
+  if (psf->dsector + count > psf->blk->sectors)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_flush(): failed; out of sectors at %u", (unsigned) psf->dsector);
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  memset(psf->dma + psf->dfill, 0x00, count * CAMWEBSRV_SEQFILE_ALIGN - psf->dfill);
+
+  rv = psf->blk->write(psf->blk->ctx, psf->dma, psf->dsector, count);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_flush(): blk.write(%u, %u) failed: [%d]: %s", (unsigned) psf->dsector, (unsigned) count, rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  psf->dsector += count;
+  psf->dfill = 0;
+
+  return ESP_OK;
+}
+
+static esp_err_t _camwebsrv_seqfile_super(_camwebsrv_seqfile_t *psf)
+{
+  esp_err_t rv;
+
+  // only ever called with nothing staged
+
+  memset(psf->dma, 0x00, CAMWEBSRV_SEQFILE_ALIGN);
+  memcpy(psf->dma, &(psf->super), sizeof(psf->super));
+
+  rv = psf->blk->write(psf->blk->ctx, psf->dma, 0, 1);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SEQFILE _camwebsrv_seqfile_super(): blk.write() failed: [%d]: %s", rv, esp_err_to_name(rv));
+  }
+
+  return rv;
+}
+
+static esp_err_t _camwebsrv_seqfile_read_at(int fd, uint64_t offset, void *buf, size_t len)
+{
+  uint8_t *p = (uint8_t *) buf;
+  ssize_t n;
+
+  if (lseek(fd, (off_t) offset, SEEK_SET) != (off_t) offset)
+  {
+    return ESP_FAIL;
+  }
+
+  while (len > 0)
+  {
+    n = read(fd, p, len);
+
+    if (n <= 0)
+    {
+      return n == 0 ? ESP_ERR_INVALID_SIZE : ESP_FAIL;
+    }
+
+    p += n;
+    len -= n;
+  }
+
+  return ESP_OK;
+}
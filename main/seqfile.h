@@ -0,0 +1,126 @@
+// 2026-10-16 seqfile.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_SEQFILE_H
+#define _CAMWEBSRV_SEQFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#include "camera.h"
+
+// A whole capture sequence in one file, so that each frame costs a write
+// rather than a directory entry, a new cluster chain and an open/close.
+//
+// Layout, all little-endian, every part starting on a 512-byte boundary:
+//
+//   header  one sector: camwebsrv_seqfile_header_t, zero padded
+//   records one per frame: camwebsrv_seqfile_record_t, then the frame
+//           data, zero padded to the next sector
+//   index   one camwebsrv_seqfile_entry_t per frame, in capture order,
+//           followed by camwebsrv_seqfile_footer_t as the last 16 bytes of
+//           the file
+//
+// The index is only written by close(); records carry enough to be found
+// and checked by scanning the sectors if it never got there.
+//
+// Given a reserve (see estimate() for one), open() lays the file out as one
+// contiguous run of clusters up front, so that appending never has to
+// touch the FAT; close() trims it back to what was written. If the card
+// hasn't that much free, or the run can't be had, open() logs a warning
+// and carries on with an ordinary file that grows as it is written.
+//
+// open_blk() writes the same layout to a range of raw sectors instead, one
+// sector in: sector 0 holds camwebsrv_seqfile_super_t, which says how long
+// the sequence is once close() has written it, and where it would go as a
+// file (shorter than CAMWEBSRV_SEQFILE_PATH_LEN, or open_blk() returns
+// ESP_ERR_INVALID_SIZE);
+// exporting it is then a straight copy. Writes are staged through a
+// DMA-capable buffer and go out CAMWEBSRV_SEQFILE_BLK_CHUNK sectors at a
+// time.
+//
+// load() reads the header and index back from a file that close() has
+// finished, into an index it allocates and the caller frees; read() then
+// reads the frame an entry points at into buf, which must hold entry->len
+// bytes, and checks it against its record and crc.
+
+#define CAMWEBSRV_SEQFILE_ALIGN 512
+#define CAMWEBSRV_SEQFILE_VERSION 1
+#define CAMWEBSRV_SEQFILE_MAGIC_HEADER "CWSQ"
+#define CAMWEBSRV_SEQFILE_MAGIC_RECORD "CWFR"
+#define CAMWEBSRV_SEQFILE_MAGIC_FOOTER "CWIX"
+#define CAMWEBSRV_SEQFILE_MAGIC_SUPER "CWRB"
+#define CAMWEBSRV_SEQFILE_BLK_CHUNK 32
+#define CAMWEBSRV_SEQFILE_PATH_LEN 128
+
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t align;
+  uint32_t pixformat;
+  uint32_t framesize;
+  uint32_t capacity;
+} camwebsrv_seqfile_header_t;
+
+typedef struct
+{
+  char magic[4];
+  uint32_t number;
+  int64_t tstamp;
+  uint32_t len;
+  uint32_t crc;
+  uint16_t width;
+  uint16_t height;
+  uint32_t seq;
+} camwebsrv_seqfile_record_t;
+
+typedef struct
+{
+  uint64_t offset;
+  int64_t tstamp;
+  uint32_t len;
+  uint32_t number;
+  uint32_t crc;
+  uint32_t seq;
+} camwebsrv_seqfile_entry_t;
+
+typedef struct
+{
+  char magic[4];
+  uint32_t count;
+  uint64_t offset;
+} camwebsrv_seqfile_footer_t;
+
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t length;
+  uint32_t count;
+  uint32_t reserved;
+  char path[CAMWEBSRV_SEQFILE_PATH_LEN];
+} camwebsrv_seqfile_super_t;
+
+// sectors are counted from the start of the range the device stands for
+
+typedef struct
+{
+  void *ctx;
+  size_t sectors;
+  esp_err_t (*write)(void *ctx, const void *buf, size_t sector, size_t count);
+} camwebsrv_seqfile_blkdev_t;
+
+typedef void *camwebsrv_seqfile_t;
+
+uint64_t camwebsrv_seqfile_estimate(size_t frame_bytes, uint32_t capacity);
+esp_err_t camwebsrv_seqfile_open(camwebsrv_seqfile_t *sf, const char *path, uint32_t pixformat, uint32_t framesize, uint32_t capacity, uint64_t reserve);
+esp_err_t camwebsrv_seqfile_open_blk(camwebsrv_seqfile_t *sf, const camwebsrv_seqfile_blkdev_t *blk, const char *path, uint32_t pixformat, uint32_t framesize, uint32_t capacity, uint64_t reserve);
+esp_err_t camwebsrv_seqfile_append(camwebsrv_seqfile_t sf, const camwebsrv_camera_frame_t *frame);
+esp_err_t camwebsrv_seqfile_close(camwebsrv_seqfile_t *sf);
+esp_err_t camwebsrv_seqfile_load(const char *path, camwebsrv_seqfile_header_t *header, camwebsrv_seqfile_entry_t **index, uint32_t *count);
+esp_err_t camwebsrv_seqfile_read(const char *path, const camwebsrv_seqfile_entry_t *entry, camwebsrv_seqfile_record_t *record, uint8_t *buf);
+
+#endif
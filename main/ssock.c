@@ -0,0 +1,193 @@
+// 2026-10-16 ssock.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "ssock.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+// upper bounds of the frame delivery latency histogram buckets, in ms; the
+// last bucket catches everything above
+
+static const uint16_t _camwebsrv_ssock_lat_bounds[CAMWEBSRV_SSOCK_LAT_BUCKETS - 1] = { 10, 20, 50, 100, 200, 500, 1000 };
+
+void camwebsrv_ssock_init(camwebsrv_ssock_stats_t *stats)
+{
+  if (stats == NULL)
+  {
+    return;
+  }
+
+  memset(stats, 0x00, sizeof(camwebsrv_ssock_stats_t));
+}
+
+ssize_t camwebsrv_ssock_send(camwebsrv_ssock_stats_t *stats, int sockfd, struct iovec *iov, int iovcnt)
+{
+  struct msghdr msg;
+  size_t bytes_sent = 0;
+  bool blocked = false;
+  int64_t started;
+
+  memset(&msg, 0x00, sizeof(msg));
+
+  started = esp_timer_get_time();
+
+  // skip leading empty segments
+
+  while(iovcnt > 0 && iov->iov_len == 0)
+  {
+    iov++;
+    iovcnt--;
+  }
+
+  while(iovcnt > 0)
+  {
+    ssize_t rv;
+
+    // have we exceeded the time limit?
+
+    if ((esp_timer_get_time() - started) > ((int64_t) CAMWEBSRV_SCLIENTS_SEND_TMOUT * 1000))
+    {
+      ESP_LOGW(CAMWEBSRV_TAG, "SSOCK camwebsrv_ssock_send(%d): exceeded send time limit", sockfd);
+      break;
+    }
+
+    // hand all remaining segments to the stack in one go
+    // XXX we really should use httpd_socket_send() here, but we can't until
+    // IDFGH-9275 is fixed, and it doesn't do scatter-gather anyway
+
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    rv = sendmsg(sockfd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    // error?
+
+    if (rv < 0)
+    {
+      int e = errno;
+
+      if (e == EAGAIN || e == EWOULDBLOCK)
+      {
+        ESP_LOGD(CAMWEBSRV_TAG, "SSOCK camwebsrv_ssock_send(%d): sendmsg() would block", sockfd);
+        blocked = true;
+        break;
+      }
+
+      ESP_LOGE(CAMWEBSRV_TAG, "SSOCK camwebsrv_ssock_send(%d): sendmsg() failed: [%d]: %s", sockfd, e, strerror(e));
+      return -1;
+    }
+
+    // this should never happen, given that we're sending with the NONBLOCK flag
+
+    if (rv == 0)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SSOCK camwebsrv_ssock_send(%d): sendmsg() failed", sockfd);
+      return -1;
+    }
+
+    // success! step over whatever went out
+
+    bytes_sent = bytes_sent + rv;
+
+    while(iovcnt > 0 && (size_t) rv >= iov->iov_len)
+    {
+      rv = rv - iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+
+    if (iovcnt > 0)
+    {
+      iov->iov_base = (uint8_t *) iov->iov_base + rv;
+      iov->iov_len = iov->iov_len - rv;
+    }
+  }
+
+  // only the streaming task sends, and only it writes these
+
+  stats->tsend = stats->tsend + (esp_timer_get_time() - started);
+  stats->bsent = stats->bsent + bytes_sent;
+  stats->eagain = stats->eagain + (blocked ? 1 : 0);
+
+  ESP_LOGD(CAMWEBSRV_TAG, "SSOCK camwebsrv_ssock_send(%d): sent %u bytes", sockfd, (unsigned) bytes_sent);
+
+  return bytes_sent;
+}
+
+void camwebsrv_ssock_frame(camwebsrv_ssock_stats_t *stats, uint32_t seqlast, uint32_t seq)
+{
+  // every frame published since the last one this client got was
+  // dropped for it
+
+  if (seqlast != 0 && seq - seqlast > 1)
+  {
+    stats->fdropped = stats->fdropped + (seq - seqlast - 1);
+  }
+
+  stats->fsent++;
+}
+
+void camwebsrv_ssock_latency(camwebsrv_ssock_stats_t *stats, int64_t lat)
+{
+  uint32_t ulat;
+  uint8_t i;
+
+  ulat = lat < 0 ? 0 : (lat < UINT32_MAX ? (uint32_t) lat : UINT32_MAX);
+
+  stats->latavg = stats->latavg == 0 ? ulat : stats->latavg - (stats->latavg >> CAMWEBSRV_SCLIENTS_BPS_SHIFT) + (ulat >> CAMWEBSRV_SCLIENTS_BPS_SHIFT);
+  stats->latmax = ulat > stats->latmax ? ulat : stats->latmax;
+
+  for (i = 0; i < CAMWEBSRV_SSOCK_LAT_BUCKETS - 1 && ulat >= (uint32_t) _camwebsrv_ssock_lat_bounds[i] * 1000; i++);
+
+  stats->lathist[i]++;
+}
+
+esp_err_t camwebsrv_ssock_json(const camwebsrv_ssock_stats_t *stats, camwebsrv_vbytes_t vb)
+{
+  esp_err_t rv;
+  uint8_t i;
+
+  if (stats == NULL || vb == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  rv = camwebsrv_vbytes_append_str(
+    vb,
+    "      \"bytes_sent\": %" PRIu64 ",\n"
+    "      \"frames_sent\": %" PRIu32 ",\n"
+    "      \"frames_skipped\": %" PRIu32 ",\n"
+    "      \"eagain\": %" PRIu32 ",\n"
+    "      \"send_us\": %" PRIu64 ",\n"
+    "      \"latency_avg_us\": %" PRIu32 ",\n"
+    "      \"latency_max_us\": %" PRIu32 ",\n"
+    "      \"latency_hist_ms\": {",
+    stats->bsent,
+    stats->fsent,
+    stats->fdropped,
+    stats->eagain,
+    stats->tsend,
+    stats->latavg,
+    stats->latmax
+  );
+
+  for (i = 0; i < CAMWEBSRV_SSOCK_LAT_BUCKETS && rv == ESP_OK; i++)
+  {
+    if (i < CAMWEBSRV_SSOCK_LAT_BUCKETS - 1)
+    {
+      rv = camwebsrv_vbytes_append_str(vb, "%s\"%u\": %" PRIu32, i == 0 ? "" : ", ", _camwebsrv_ssock_lat_bounds[i], stats->lathist[i]);
+    }
+    else
+    {
+      rv = camwebsrv_vbytes_append_str(vb, ", \"inf\": %" PRIu32 "}", stats->lathist[i]);
+    }
+  }
+
+  return rv;
+}
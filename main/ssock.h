@@ -0,0 +1,50 @@
+// 2026-10-16 ssock.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_SSOCK_H
+#define _CAMWEBSRV_SSOCK_H
+
+#include "vbytes.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <esp_err.h>
+
+// Sends to a streaming client's socket, and keeps the counters that
+// /stream/stats reports for it. Nothing but sendmsg() and esp_timer
+// underneath, so it can be run against a fake socket on the host.
+
+// send() hands all of iov to the socket without blocking, for up to
+// CAMWEBSRV_SCLIENTS_SEND_TMOUT ms, and returns how much of it went, which
+// may be none; -1 on a socket error; iov is used up as it goes, so callers
+// lay it out afresh each time
+
+// frame() counts a frame about to go out, and any published since the one
+// before it (seqlast, zero for none) as skipped; latency() files the time
+// from a frame's capture to its first byte going out
+
+#define CAMWEBSRV_SSOCK_LAT_BUCKETS 8
+
+typedef struct
+{
+  uint64_t bsent;
+  uint64_t tsend;
+  uint32_t eagain;
+  uint32_t fsent;
+  uint32_t fdropped;
+  uint32_t latavg;
+  uint32_t latmax;
+  uint32_t lathist[CAMWEBSRV_SSOCK_LAT_BUCKETS];
+} camwebsrv_ssock_stats_t;
+
+void camwebsrv_ssock_init(camwebsrv_ssock_stats_t *stats);
+ssize_t camwebsrv_ssock_send(camwebsrv_ssock_stats_t *stats, int sockfd, struct iovec *iov, int iovcnt);
+void camwebsrv_ssock_frame(camwebsrv_ssock_stats_t *stats, uint32_t seqlast, uint32_t seq);
+void camwebsrv_ssock_latency(camwebsrv_ssock_stats_t *stats, int64_t lat);
+esp_err_t camwebsrv_ssock_json(const camwebsrv_ssock_stats_t *stats, camwebsrv_vbytes_t vb);
+
+#endif
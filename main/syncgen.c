@@ -0,0 +1,238 @@
+// 2026-10-16 syncgen.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "syncgen.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <rom/ets_sys.h>
+
+// timer and channel 0 drive the camera's xclk
+
+#define _CAMWEBSRV_SYNCGEN_LEDC_MODE LEDC_LOW_SPEED_MODE
+#define _CAMWEBSRV_SYNCGEN_LEDC_TIMER LEDC_TIMER_1
+#define _CAMWEBSRV_SYNCGEN_LEDC_CHANNEL LEDC_CHANNEL_1
+#define _CAMWEBSRV_SYNCGEN_LEDC_CLK_HZ 80000000
+
+typedef struct
+{
+  SemaphoreHandle_t pulsed;
+  portMUX_TYPE spinlock;
+  camwebsrv_syncgen_pulse_t last;
+  bool running;
+} _camwebsrv_syncgen_t;
+
+static _camwebsrv_syncgen_t _camwebsrv_syncgen = { .pulsed = NULL, .spinlock = portMUX_INITIALIZER_UNLOCKED };
+
+static void _camwebsrv_syncgen_isr(void *arg);
+
+esp_err_t camwebsrv_syncgen_start(uint32_t fps)
+{
+  _camwebsrv_syncgen_t *psg = &_camwebsrv_syncgen;
+  ledc_timer_config_t tcfg;
+  ledc_channel_config_t ccfg;
+  uint32_t bits;
+  esp_err_t rv;
+
+  if (fps == 0 || (uint64_t) fps * CAMWEBSRV_SEQCAP_SYNC_PULSE_US >= 1000000)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (psg->running)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (psg->pulsed == NULL)
+  {
+    psg->pulsed = xSemaphoreCreateBinary();
+
+    if (psg->pulsed == NULL)
+    {
+      ESP_LOGE(CAMWEBSRV_TAG, "SYNCGEN camwebsrv_syncgen_start(): xSemaphoreCreateBinary() failed");
+      return ESP_FAIL;
+    }
+  }
+
+  xSemaphoreTake(psg->pulsed, 0);
+  memset(&(psg->last), 0x00, sizeof(psg->last));
+
+  // as fine a duty resolution as the divider allows at this rate; the
+  // divider is fractional, so the period comes out within a fraction of an
+  // apb cycle
+
+  bits = ledc_find_suitable_duty_resolution(_CAMWEBSRV_SYNCGEN_LEDC_CLK_HZ, fps);
+
+  if (bits == 0)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SYNCGEN camwebsrv_syncgen_start(): ledc_find_suitable_duty_resolution(%" PRIu32 ") failed", fps);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(&tcfg, 0x00, sizeof(tcfg));
+  tcfg.speed_mode = _CAMWEBSRV_SYNCGEN_LEDC_MODE;
+  tcfg.duty_resolution = (ledc_timer_bit_t) bits;
+  tcfg.timer_num = _CAMWEBSRV_SYNCGEN_LEDC_TIMER;
+  tcfg.freq_hz = fps;
+  tcfg.clk_cfg = LEDC_USE_APB_CLK;
+
+  rv = ledc_timer_config(&tcfg);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SYNCGEN camwebsrv_syncgen_start(): ledc_timer_config(%" PRIu32 ") failed: [%d]: %s", fps, rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  // held until everything is wired up, so that the first pulse is counted
+
+  ledc_timer_pause(_CAMWEBSRV_SYNCGEN_LEDC_MODE, _CAMWEBSRV_SYNCGEN_LEDC_TIMER);
+
+  memset(&ccfg, 0x00, sizeof(ccfg));
+  ccfg.gpio_num = CAMWEBSRV_PIN_SYNC;
+  ccfg.speed_mode = _CAMWEBSRV_SYNCGEN_LEDC_MODE;
+  ccfg.channel = _CAMWEBSRV_SYNCGEN_LEDC_CHANNEL;
+  ccfg.intr_type = LEDC_INTR_DISABLE;
+  ccfg.timer_sel = _CAMWEBSRV_SYNCGEN_LEDC_TIMER;
+  ccfg.duty = (uint32_t) ((((uint64_t) CAMWEBSRV_SEQCAP_SYNC_PULSE_US * fps) << bits) / 1000000);
+  ccfg.hpoint = 0;
+
+  rv = ledc_channel_config(&ccfg);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SYNCGEN camwebsrv_syncgen_start(): ledc_channel_config() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    return rv;
+  }
+
+  // the pin is routed to the ledc as an output, and read back as an input
+  // for the edge interrupt
+
+  gpio_input_enable(CAMWEBSRV_PIN_SYNC);
+  gpio_set_intr_type(CAMWEBSRV_PIN_SYNC, GPIO_INTR_POSEDGE);
+
+  rv = gpio_install_isr_service(0);
+
+  if (rv != ESP_OK && rv != ESP_ERR_INVALID_STATE)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SYNCGEN camwebsrv_syncgen_start(): gpio_install_isr_service() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    ledc_stop(_CAMWEBSRV_SYNCGEN_LEDC_MODE, _CAMWEBSRV_SYNCGEN_LEDC_CHANNEL, 0);
+    return rv;
+  }
+
+  rv = gpio_isr_handler_add(CAMWEBSRV_PIN_SYNC, _camwebsrv_syncgen_isr, psg);
+
+  if (rv != ESP_OK)
+  {
+    ESP_LOGE(CAMWEBSRV_TAG, "SYNCGEN camwebsrv_syncgen_start(): gpio_isr_handler_add() failed: [%d]: %s", rv, esp_err_to_name(rv));
+    ledc_stop(_CAMWEBSRV_SYNCGEN_LEDC_MODE, _CAMWEBSRV_SYNCGEN_LEDC_CHANNEL, 0);
+    return rv;
+  }
+
+  gpio_intr_enable(CAMWEBSRV_PIN_SYNC);
+
+  psg->running = true;
+
+  ledc_timer_rst(_CAMWEBSRV_SYNCGEN_LEDC_MODE, _CAMWEBSRV_SYNCGEN_LEDC_TIMER);
+  ledc_timer_resume(_CAMWEBSRV_SYNCGEN_LEDC_MODE, _CAMWEBSRV_SYNCGEN_LEDC_TIMER);
+
+  ESP_LOGI(CAMWEBSRV_TAG, "SYNCGEN camwebsrv_syncgen_start(): %" PRIu32 " Hz, %d us pulses, %" PRIu32 "-bit duty", ledc_get_freq(_CAMWEBSRV_SYNCGEN_LEDC_MODE, _CAMWEBSRV_SYNCGEN_LEDC_TIMER), CAMWEBSRV_SEQCAP_SYNC_PULSE_US, bits);
+
+  return ESP_OK;
+}
+
+esp_err_t camwebsrv_syncgen_wait(camwebsrv_syncgen_pulse_t *pulse, TickType_t timeout)
+{
+  _camwebsrv_syncgen_t *psg = &_camwebsrv_syncgen;
+
+  if (pulse == NULL)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (!psg->running)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (xSemaphoreTake(psg->pulsed, timeout) != pdTRUE)
+  {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  portENTER_CRITICAL(&(psg->spinlock));
+  *pulse = psg->last;
+  portEXIT_CRITICAL(&(psg->spinlock));
+
+  return ESP_OK;
+}
+
+void camwebsrv_syncgen_stop(void)
+{
+  _camwebsrv_syncgen_t *psg = &_camwebsrv_syncgen;
+  camwebsrv_syncgen_pulse_t last;
+  int64_t left;
+
+  if (!psg->running)
+  {
+    return;
+  }
+
+  // let the last pulse run its full length, then idle low, as the pin was
+  // before
+
+  portENTER_CRITICAL(&(psg->spinlock));
+  last = psg->last;
+  portEXIT_CRITICAL(&(psg->spinlock));
+
+  left = last.number > 0 ? last.tstamp + CAMWEBSRV_SEQCAP_SYNC_PULSE_US - esp_timer_get_time() : 0;
+
+  if (left > 0 && left <= CAMWEBSRV_SEQCAP_SYNC_PULSE_US)
+  {
+    ets_delay_us((uint32_t) left);
+  }
+
+  gpio_intr_disable(CAMWEBSRV_PIN_SYNC);
+  gpio_isr_handler_remove(CAMWEBSRV_PIN_SYNC);
+
+  ledc_stop(_CAMWEBSRV_SYNCGEN_LEDC_MODE, _CAMWEBSRV_SYNCGEN_LEDC_CHANNEL, 0);
+  ledc_timer_pause(_CAMWEBSRV_SYNCGEN_LEDC_MODE, _CAMWEBSRV_SYNCGEN_LEDC_TIMER);
+
+  psg->running = false;
+
+  ESP_LOGI(CAMWEBSRV_TAG, "SYNCGEN camwebsrv_syncgen_stop(): stopped after %" PRIu32 " pulses", psg->last.number);
+}
+
+static void IRAM_ATTR _camwebsrv_syncgen_isr(void *arg)
+{
+  _camwebsrv_syncgen_t *psg = (_camwebsrv_syncgen_t *) arg;
+  BaseType_t hp = pdFALSE;
+  int64_t tnow;
+
+  // stamped on the edge itself, so the only jitter is interrupt latency
+
+  tnow = esp_timer_get_time();
+
+  portENTER_CRITICAL_ISR(&(psg->spinlock));
+  psg->last.number++;
+  psg->last.tstamp = tnow;
+  portEXIT_CRITICAL_ISR(&(psg->spinlock));
+
+  xSemaphoreGiveFromISR(psg->pulsed, &hp);
+
+  if (hp)
+  {
+    portYIELD_FROM_ISR();
+  }
+}
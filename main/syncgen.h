@@ -0,0 +1,31 @@
+// 2026-10-16 syncgen.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_SYNCGEN_H
+#define _CAMWEBSRV_SYNCGEN_H
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+
+// sync pulses on CAMWEBSRV_PIN_SYNC at a fixed rate, generated by an LEDC
+// timer, so that the period is set by the hardware and not by how long the
+// capture loop took to get round. The pin's own rising edges are read back
+// through a GPIO interrupt, which numbers and timestamps them as they go
+// out; wait() blocks until the next one and reports it. Pulses that went
+// by while nobody was waiting show up as a gap in the numbers. stop() lets
+// the pulse in progress finish, so stopping right after wait() returns the
+// last one wanted means no more go out.
+
+typedef struct
+{
+  uint32_t number;
+  int64_t tstamp;
+} camwebsrv_syncgen_pulse_t;
+
+esp_err_t camwebsrv_syncgen_start(uint32_t fps);
+esp_err_t camwebsrv_syncgen_wait(camwebsrv_syncgen_pulse_t *pulse, TickType_t timeout);
+void camwebsrv_syncgen_stop(void);
+
+#endif
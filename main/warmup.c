@@ -0,0 +1,63 @@
+// 2026-10-16 warmup.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "config.h"
+#include "warmup.h"
+
+#include <string.h>
+
+static bool _camwebsrv_warmup_close(uint32_t a, uint32_t b);
+
+void camwebsrv_warmup_init(camwebsrv_warmup_t *wu)
+{
+  if (wu == NULL)
+  {
+    return;
+  }
+
+  memset(wu, 0x00, sizeof(camwebsrv_warmup_t));
+}
+
+bool camwebsrv_warmup_update(camwebsrv_warmup_t *wu, uint32_t exposure, uint32_t gain)
+{
+  if (wu == NULL)
+  {
+    return true;
+  }
+
+  // the first reading has nothing to compare against
+
+  if (wu->frames > 0 && _camwebsrv_warmup_close(wu->exposure, exposure) && _camwebsrv_warmup_close(wu->gain, gain))
+  {
+    wu->stable = wu->stable < UINT8_MAX ? wu->stable + 1 : wu->stable;
+  }
+  else
+  {
+    wu->stable = 0;
+  }
+
+  wu->frames = wu->frames < UINT8_MAX ? wu->frames + 1 : wu->frames;
+  wu->exposure = exposure;
+  wu->gain = gain;
+
+  // the first frame or two after a restart are no good regardless of what
+  // the registers say
+
+  return wu->frames >= CAMWEBSRV_WARMUP_MIN_FRAMES && wu->stable >= CAMWEBSRV_WARMUP_STABLE_FRAMES;
+}
+
+static bool _camwebsrv_warmup_close(uint32_t a, uint32_t b)
+{
+  uint32_t diff;
+  uint32_t tol;
+
+  diff = a > b ? a - b : b - a;
+
+  // relative to the larger of the two, but never so tight that the odd
+  // count of jitter at low values resets the run
+
+  tol = ((a > b ? a : b) * CAMWEBSRV_WARMUP_TOLERANCE_PCT) / 100;
+  tol = tol > CAMWEBSRV_WARMUP_TOLERANCE_MIN ? tol : CAMWEBSRV_WARMUP_TOLERANCE_MIN;
+
+  return diff <= tol;
+}
@@ -0,0 +1,25 @@
+// 2026-10-16 warmup.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_WARMUP_H
+#define _CAMWEBSRV_WARMUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Decides when the sensor's auto exposure and gain have stopped moving.
+// Fed one (exposure, gain) reading per frame; knows nothing about cameras
+// otherwise, so it runs just as well against a recorded trace.
+
+typedef struct
+{
+  uint32_t exposure;
+  uint32_t gain;
+  uint8_t frames;
+  uint8_t stable;
+} camwebsrv_warmup_t;
+
+void camwebsrv_warmup_init(camwebsrv_warmup_t *wu);
+bool camwebsrv_warmup_update(camwebsrv_warmup_t *wu, uint32_t exposure, uint32_t gain);
+
+#endif
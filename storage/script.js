@@ -27,6 +27,9 @@ function onContentLoaded(event)
   let url_base = document.location.origin;
 
   let is_streaming = false;
+  let ws = null;
+  let ws_url = null;
+  let ws_delay_min = null;
 
   function id_generate()
   {
@@ -134,8 +137,49 @@ function onContentLoaded(event)
     );
   }
 
+  function ws_frame(event)
+  {
+    // 16 byte header: sequence number, capture timestamp (us), width and
+    // height, all little-endian, followed by the jpeg
+
+    const meta = new DataView(event.data, 0, 16);
+    const seq = meta.getUint32(0, true);
+    const tstamp = meta.getUint32(4, true) + meta.getUint32(8, true) * 4294967296;
+    const width = meta.getUint16(12, true);
+    const height = meta.getUint16(14, true);
+
+    // acknowledge it straight away, so the server can send the next one
+
+    const ack = new DataView(new ArrayBuffer(4));
+    ack.setUint32(0, seq, true);
+    ws.send(ack.buffer);
+
+    // the two clocks are unrelated, so measure delay relative to the
+    // quickest frame seen so far
+
+    const delay = performance.now() * 1000 - tstamp;
+    ws_delay_min = (ws_delay_min === null || delay < ws_delay_min) ? delay : ws_delay_min;
+
+    view.title = `frame ${seq}, ${width}x${height}, +${((delay - ws_delay_min) / 1000).toFixed(1)} ms`;
+
+    if (ws_url !== null)
+    {
+      URL.revokeObjectURL(ws_url);
+    }
+
+    ws_url = URL.createObjectURL(new Blob([event.data.slice(16)], { type: 'image/jpeg' }));
+    view.setAttribute("src", ws_url);
+  }
+
   function stream_stop()
   {
+    if (ws !== null)
+    {
+      ws.onclose = null;
+      ws.close();
+      ws = null;
+    }
+
     window.stop();
     streamButton.innerHTML = 'Start Stream';
     is_streaming = false;
@@ -143,7 +187,32 @@ function onContentLoaded(event)
 
   function stream_start()
   {
-    view.setAttribute("src", url_base + "/stream?id=" + id_generate());
+    // prefer the websocket stream; fall back to mjpeg if it can't connect
+
+    if (window.WebSocket)
+    {
+      let opened = false;
+
+      ws_delay_min = null;
+      ws = new WebSocket(url_base.replace(/^http/, 'ws') + "/ws/stream?credits=2");
+      ws.binaryType = 'arraybuffer';
+      ws.onopen = () => { opened = true; };
+      ws.onmessage = ws_frame;
+      ws.onclose = () =>
+      {
+        ws = null;
+
+        if (!opened && is_streaming)
+        {
+          view.setAttribute("src", url_base + "/stream?id=" + id_generate());
+        }
+      };
+    }
+    else
+    {
+      view.setAttribute("src", url_base + "/stream?id=" + id_generate());
+    }
+
     element_set_visible(viewContainer, true);
     streamButton.innerHTML = 'Stop Stream';
     is_streaming = true;
@@ -0,0 +1,24 @@
+// 2026-10-16 esp_heap_caps.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_ESP_HEAP_CAPS_H
+#define _CAMWEBSRV_TEST_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+static inline void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+  return malloc(size);
+}
+
+static inline void heap_caps_free(void *ptr)
+{
+  free(ptr);
+}
+
+#endif
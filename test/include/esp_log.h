@@ -0,0 +1,17 @@
+// 2026-10-16 esp_log.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_ESP_LOG_H
+#define _CAMWEBSRV_TEST_ESP_LOG_H
+
+#include <stdio.h>
+
+// errors and warnings go to stderr, so that ctest shows them for a failing
+// test; the rest is noise here
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { } while(0)
+#define ESP_LOGD(tag, fmt, ...) do { } while(0)
+
+#endif
@@ -0,0 +1,13 @@
+// 2026-10-16 esp_random.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_ESP_RANDOM_H
+#define _CAMWEBSRV_TEST_ESP_RANDOM_H
+
+#include <stdint.h>
+
+// the c library's, seeded however the test likes
+
+uint32_t esp_random(void);
+
+#endif
@@ -0,0 +1,11 @@
+// 2026-10-16 esp_rom_crc.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_ESP_ROM_CRC_H
+#define _CAMWEBSRV_TEST_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif
@@ -0,0 +1,16 @@
+// 2026-10-16 esp_timer.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_ESP_TIMER_H
+#define _CAMWEBSRV_TEST_ESP_TIMER_H
+
+#include <stdint.h>
+
+// the host's monotonic clock, plus however far a test has wound it on to
+// stand in for time spent somewhere it wasn't
+
+extern int64_t shim_timer_offset;
+
+int64_t esp_timer_get_time(void);
+
+#endif
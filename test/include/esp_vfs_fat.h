@@ -0,0 +1,20 @@
+// 2026-10-16 esp_vfs_fat.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_ESP_VFS_FAT_H
+#define _CAMWEBSRV_TEST_ESP_VFS_FAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_err.h>
+
+// the card is whatever the host filesystem is; tests say how much of it is
+// free, and a contiguous file is just one of that size
+
+extern uint64_t shim_vfs_fat_free;
+
+esp_err_t esp_vfs_fat_info(const char *base_path, uint64_t *out_total_bytes, uint64_t *out_free_bytes);
+esp_err_t esp_vfs_fat_create_contiguous_file(const char *base_path, const char *full_path, uint64_t size, bool alloc_now);
+
+#endif
@@ -0,0 +1,16 @@
+// 2026-10-16 FreeRTOS.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_FREERTOS_H
+#define _CAMWEBSRV_TEST_FREERTOS_H
+
+#include <stdint.h>
+
+// the tick rate sdkconfig.defaults sets, CONFIG_FREERTOS_HZ=100
+
+typedef uint32_t TickType_t;
+
+#define portTICK_PERIOD_MS 10
+#define pdMS_TO_TICKS(X) ((TickType_t) ((X) / portTICK_PERIOD_MS))
+
+#endif
@@ -0,0 +1,14 @@
+// 2026-10-16 task.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_FREERTOS_TASK_H
+#define _CAMWEBSRV_TEST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+// doesn't sleep; winds esp_timer on by as long instead, so that anything
+// paced with it runs as fast as the host can go
+
+void vTaskDelay(TickType_t ticks);
+
+#endif
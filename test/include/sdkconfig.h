@@ -0,0 +1,9 @@
+// 2026-10-16 sdkconfig.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_SDKCONFIG_H
+#define _CAMWEBSRV_TEST_SDKCONFIG_H
+
+// no target, and none of the camera component's options
+
+#endif
@@ -0,0 +1,162 @@
+// 2026-10-16 shim.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <esp_err.h>
+#include <esp_rom_crc.h>
+#include <esp_vfs_fat.h>
+#include <esp_timer.h>
+#include <esp_random.h>
+#include <jpeg_decoder.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+uint64_t shim_vfs_fat_free = UINT64_MAX;
+int64_t shim_timer_offset = 0;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+  switch(code)
+  {
+    case ESP_OK:
+      return "ESP_OK";
+    case ESP_FAIL:
+      return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+      return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+      return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+      return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+      return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+      return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+      return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_CRC:
+      return "ESP_ERR_INVALID_CRC";
+    default:
+      return "UNKNOWN ERROR";
+  }
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+  static uint32_t table[256];
+  uint32_t i;
+  uint32_t c;
+  uint8_t b;
+
+  // the rom's: reflected, 0xedb88320, inverted on the way in and out; a
+  // byte at a time off a table, as the rom does it, so that benchmarks
+  // aren't measuring a slower crc than the board's
+
+  if (table[1] == 0)
+  {
+    for (i = 0; i < 256; i++)
+    {
+      c = i;
+
+      for (b = 0; b < 8; b++)
+      {
+        c = (c >> 1) ^ (0xedb88320 & -(c & 1));
+      }
+
+      table[i] = c;
+    }
+  }
+
+  crc = ~crc;
+
+  for (i = 0; i < len; i++)
+  {
+    crc = table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+esp_err_t esp_vfs_fat_info(const char *base_path, uint64_t *out_total_bytes, uint64_t *out_free_bytes)
+{
+  *out_total_bytes = shim_vfs_fat_free;
+  *out_free_bytes = shim_vfs_fat_free;
+
+  return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_create_contiguous_file(const char *base_path, const char *full_path, uint64_t size, bool alloc_now)
+{
+  int fd;
+  int rv;
+
+  fd = open(full_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+  if (fd < 0)
+  {
+    return ESP_FAIL;
+  }
+
+  rv = ftruncate(fd, (off_t) size);
+
+  close(fd);
+
+  return rv == 0 ? ESP_OK : ESP_FAIL;
+}
+
+int64_t esp_timer_get_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ((int64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000) + shim_timer_offset;
+}
+
+uint32_t esp_random(void)
+{
+  return (uint32_t) random();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  shim_timer_offset = shim_timer_offset + (int64_t) ticks * portTICK_PERIOD_MS * 1000;
+}
+
+esp_err_t esp_jpeg_get_image_info(esp_jpeg_image_cfg_t *cfg, esp_jpeg_image_output_t *img)
+{
+  const uint8_t *p = cfg->indata;
+  size_t len = cfg->indata_size;
+  size_t i;
+
+  // walk the segments after SOI as far as the frame header, which has the
+  // height and then the width
+
+  if (len < 4 || p[0] != 0xFF || p[1] != 0xD8)
+  {
+    return ESP_FAIL;
+  }
+
+  for (i = 2; i + 9 <= len && p[i] == 0xFF; i = i + 2 + ((p[i + 2] << 8) | p[i + 3]))
+  {
+    if (p[i + 1] >= 0xC0 && p[i + 1] <= 0xC2)
+    {
+      img->height = (uint16_t) ((p[i + 5] << 8) | p[i + 6]);
+      img->width = (uint16_t) ((p[i + 7] << 8) | p[i + 8]);
+      img->output_len = (size_t) img->width * img->height * 2;
+
+      return ESP_OK;
+    }
+  }
+
+  return ESP_FAIL;
+}
@@ -0,0 +1,48 @@
+// 2026-10-16 test.h
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef _CAMWEBSRV_TEST_H
+#define _CAMWEBSRV_TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+// each test is a function returning non-zero on the first check that
+// fails; main() runs them in turn and fails if any did
+
+#define TEST_CHECK(X) \
+  do \
+  { \
+    if (!(X)) \
+    { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #X); \
+      return 1; \
+    } \
+  } \
+  while(0)
+
+#define TEST_RUN(F) \
+  do \
+  { \
+    if ((F)() != 0) \
+    { \
+      fprintf(stderr, "%s: FAILED\n", #F); \
+      failed++; \
+    } \
+  } \
+  while(0)
+
+// benchmarks time themselves with this and print what they measured;
+// they only fail on wrong output, never on speed
+
+static inline int64_t test_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ((int64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+#endif
@@ -0,0 +1,331 @@
+// 2026-10-16 test_camctrl.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "config.h"
+#include "camctrl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define _TEST_CAMCTRL_BENCH_ROUNDS 200000
+
+// a sensor that does what the ov2640 and ov3660 drivers do with a value:
+// leave it in the status field that goes with the setter
+
+#define _TEST_CAMCTRL_FAKE(SETTER, FIELD, TYPE) \
+  static int _test_camctrl_fake_##SETTER(sensor_t *sensor, TYPE value) \
+  { \
+    _test_camctrl_calls++; \
+    sensor->status.FIELD = value; \
+    return 0; \
+  }
+
+static int _test_camctrl_calls;
+
+_TEST_CAMCTRL_FAKE(set_ae_level, ae_level, int)
+_TEST_CAMCTRL_FAKE(set_exposure_ctrl, aec, int)
+_TEST_CAMCTRL_FAKE(set_aec2, aec2, int)
+_TEST_CAMCTRL_FAKE(set_aec_value, aec_value, int)
+_TEST_CAMCTRL_FAKE(set_gain_ctrl, agc, int)
+_TEST_CAMCTRL_FAKE(set_agc_gain, agc_gain, int)
+_TEST_CAMCTRL_FAKE(set_whitebal, awb, int)
+_TEST_CAMCTRL_FAKE(set_awb_gain, awb_gain, int)
+_TEST_CAMCTRL_FAKE(set_bpc, bpc, int)
+_TEST_CAMCTRL_FAKE(set_brightness, brightness, int)
+_TEST_CAMCTRL_FAKE(set_colorbar, colorbar, int)
+_TEST_CAMCTRL_FAKE(set_contrast, contrast, int)
+_TEST_CAMCTRL_FAKE(set_dcw, dcw, int)
+_TEST_CAMCTRL_FAKE(set_gainceiling, gainceiling, gainceiling_t)
+_TEST_CAMCTRL_FAKE(set_hmirror, hmirror, int)
+_TEST_CAMCTRL_FAKE(set_lenc, lenc, int)
+_TEST_CAMCTRL_FAKE(set_quality, quality, int)
+_TEST_CAMCTRL_FAKE(set_raw_gma, raw_gma, int)
+_TEST_CAMCTRL_FAKE(set_saturation, saturation, int)
+_TEST_CAMCTRL_FAKE(set_sharpness, sharpness, int)
+_TEST_CAMCTRL_FAKE(set_special_effect, special_effect, int)
+_TEST_CAMCTRL_FAKE(set_vflip, vflip, int)
+_TEST_CAMCTRL_FAKE(set_wb_mode, wb_mode, int)
+_TEST_CAMCTRL_FAKE(set_wpc, wpc, int)
+
+// what each control is called, by enum, independently of the table
+
+static const char *_test_camctrl_names[CAMWEBSRV_CAMERA_CTRL_MAX] =
+{
+  [CAMWEBSRV_CAMERA_CTRL_AE_LEVEL] = "ae_level",
+  [CAMWEBSRV_CAMERA_CTRL_AEC] = "aec",
+  [CAMWEBSRV_CAMERA_CTRL_AEC2] = "aec2",
+  [CAMWEBSRV_CAMERA_CTRL_AEC_VALUE] = "aec_value",
+  [CAMWEBSRV_CAMERA_CTRL_AGC] = "agc",
+  [CAMWEBSRV_CAMERA_CTRL_AGC_GAIN] = "agc_gain",
+  [CAMWEBSRV_CAMERA_CTRL_AWB] = "awb",
+  [CAMWEBSRV_CAMERA_CTRL_AWB_GAIN] = "awb_gain",
+  [CAMWEBSRV_CAMERA_CTRL_BPC] = "bpc",
+  [CAMWEBSRV_CAMERA_CTRL_BRIGHTNESS] = "brightness",
+  [CAMWEBSRV_CAMERA_CTRL_COLORBAR] = "colorbar",
+  [CAMWEBSRV_CAMERA_CTRL_CONTRAST] = "contrast",
+  [CAMWEBSRV_CAMERA_CTRL_DCW] = "dcw",
+  [CAMWEBSRV_CAMERA_CTRL_FLASH] = "flash",
+  [CAMWEBSRV_CAMERA_CTRL_FPS] = "fps",
+  [CAMWEBSRV_CAMERA_CTRL_FRAMESIZE] = "framesize",
+  [CAMWEBSRV_CAMERA_CTRL_GAINCEILING] = "gainceiling",
+  [CAMWEBSRV_CAMERA_CTRL_HMIRROR] = "hmirror",
+  [CAMWEBSRV_CAMERA_CTRL_LENC] = "lenc",
+  [CAMWEBSRV_CAMERA_CTRL_MOTION] = "motion",
+  [CAMWEBSRV_CAMERA_CTRL_PIXFORMAT] = "pixformat",
+  [CAMWEBSRV_CAMERA_CTRL_QUALITY] = "quality",
+  [CAMWEBSRV_CAMERA_CTRL_RAW_GMA] = "raw_gma",
+  [CAMWEBSRV_CAMERA_CTRL_SATURATION] = "saturation",
+  [CAMWEBSRV_CAMERA_CTRL_SHARPNESS] = "sharpness",
+  [CAMWEBSRV_CAMERA_CTRL_SPECIAL_EFFECT] = "special_effect",
+  [CAMWEBSRV_CAMERA_CTRL_VFLIP] = "vflip",
+  [CAMWEBSRV_CAMERA_CTRL_WB_MODE] = "wb_mode",
+  [CAMWEBSRV_CAMERA_CTRL_WPC] = "wpc"
+};
+
+static int _test_camctrl_names_check(void);
+static int _test_camctrl_find(void);
+static int _test_camctrl_own(void);
+static int _test_camctrl_roundtrip(void);
+static int _test_camctrl_bench(void);
+static void _test_camctrl_sensor(sensor_t *sensor);
+static camwebsrv_camera_ctrl_t _test_camctrl_chain(const char *name);
+
+int main(void)
+{
+  int failed = 0;
+
+  TEST_RUN(_test_camctrl_names_check);
+  TEST_RUN(_test_camctrl_find);
+  TEST_RUN(_test_camctrl_own);
+  TEST_RUN(_test_camctrl_roundtrip);
+  TEST_RUN(_test_camctrl_bench);
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_camctrl_names_check(void)
+{
+  const camwebsrv_camctrl_desc_t *pdesc;
+  int c;
+
+  // every control has a table entry under its own name, in name order,
+  // with a range that has something in it
+
+  for (c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+  {
+    pdesc = camwebsrv_camctrl_desc((camwebsrv_camera_ctrl_t) c);
+
+    TEST_CHECK(pdesc != NULL);
+    TEST_CHECK(_test_camctrl_names[c] != NULL);
+    TEST_CHECK(strcmp(pdesc->name, _test_camctrl_names[c]) == 0);
+    TEST_CHECK(camwebsrv_camera_ctrl_name((camwebsrv_camera_ctrl_t) c) == pdesc->name);
+    TEST_CHECK(pdesc->min < pdesc->max);
+
+    if (c > 0)
+    {
+      TEST_CHECK(strcmp(camwebsrv_camctrl_desc((camwebsrv_camera_ctrl_t) (c - 1))->name, pdesc->name) < 0);
+    }
+  }
+
+  TEST_CHECK(camwebsrv_camctrl_desc(CAMWEBSRV_CAMERA_CTRL_MAX) == NULL);
+  TEST_CHECK(camwebsrv_camera_ctrl_name(CAMWEBSRV_CAMERA_CTRL_MAX) == NULL);
+
+  return 0;
+}
+
+static int _test_camctrl_find(void)
+{
+  int c;
+
+  for (c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+  {
+    TEST_CHECK(camwebsrv_camera_ctrl_find(_test_camctrl_names[c]) == (camwebsrv_camera_ctrl_t) c);
+  }
+
+  // near misses, either side of the ends, and nothing at all
+
+  TEST_CHECK(camwebsrv_camera_ctrl_find("aec_valu") == CAMWEBSRV_CAMERA_CTRL_MAX);
+  TEST_CHECK(camwebsrv_camera_ctrl_find("aec_value2") == CAMWEBSRV_CAMERA_CTRL_MAX);
+  TEST_CHECK(camwebsrv_camera_ctrl_find("AEC") == CAMWEBSRV_CAMERA_CTRL_MAX);
+  TEST_CHECK(camwebsrv_camera_ctrl_find("a") == CAMWEBSRV_CAMERA_CTRL_MAX);
+  TEST_CHECK(camwebsrv_camera_ctrl_find("zz") == CAMWEBSRV_CAMERA_CTRL_MAX);
+  TEST_CHECK(camwebsrv_camera_ctrl_find("") == CAMWEBSRV_CAMERA_CTRL_MAX);
+  TEST_CHECK(camwebsrv_camera_ctrl_find(NULL) == CAMWEBSRV_CAMERA_CTRL_MAX);
+
+  return 0;
+}
+
+static int _test_camctrl_own(void)
+{
+  const camwebsrv_camctrl_desc_t *pdesc;
+  bool own;
+  int c;
+
+  // the ones camera.c keeps have no sensor accessors; all the others have
+  // both
+
+  for (c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+  {
+    pdesc = camwebsrv_camctrl_desc((camwebsrv_camera_ctrl_t) c);
+
+    own = c == CAMWEBSRV_CAMERA_CTRL_FLASH || c == CAMWEBSRV_CAMERA_CTRL_FPS || c == CAMWEBSRV_CAMERA_CTRL_FRAMESIZE || c == CAMWEBSRV_CAMERA_CTRL_MOTION || c == CAMWEBSRV_CAMERA_CTRL_PIXFORMAT;
+
+    TEST_CHECK((pdesc->set == NULL) == own);
+    TEST_CHECK((pdesc->get == NULL) == own);
+  }
+
+  pdesc = camwebsrv_camctrl_desc(CAMWEBSRV_CAMERA_CTRL_FPS);
+  TEST_CHECK(pdesc->min == CAMWEBSRV_CAMERA_FPS_MIN && pdesc->max == CAMWEBSRV_CAMERA_FPS_MAX);
+
+  pdesc = camwebsrv_camctrl_desc(CAMWEBSRV_CAMERA_CTRL_FRAMESIZE);
+  TEST_CHECK(pdesc->min == 0 && pdesc->max == FRAMESIZE_INVALID - 1);
+
+  return 0;
+}
+
+static int _test_camctrl_roundtrip(void)
+{
+  const camwebsrv_camctrl_desc_t *pdesc;
+  sensor_t sensor;
+  int values[3];
+  int c;
+  int o;
+  int v;
+
+  // each value set through the table reads back the same through it, with
+  // one call to the sensor, and no other control reading any different
+
+  for (c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+  {
+    pdesc = camwebsrv_camctrl_desc((camwebsrv_camera_ctrl_t) c);
+
+    if (pdesc->set == NULL)
+    {
+      continue;
+    }
+
+    values[0] = pdesc->min;
+    values[1] = pdesc->max;
+    values[2] = pdesc->min + (pdesc->max - pdesc->min) / 2;
+
+    for (v = 0; v < 3; v++)
+    {
+      _test_camctrl_sensor(&sensor);
+      _test_camctrl_calls = 0;
+
+      TEST_CHECK(pdesc->set(&sensor, values[v]) == 0);
+      TEST_CHECK(_test_camctrl_calls == 1);
+
+      if (pdesc->get(&sensor) != values[v])
+      {
+        fprintf(stderr, "%s: set %d, got %d back\n", pdesc->name, values[v], pdesc->get(&sensor));
+        return 1;
+      }
+
+      for (o = 0; o < CAMWEBSRV_CAMERA_CTRL_MAX; o++)
+      {
+        const camwebsrv_camctrl_desc_t *podesc = camwebsrv_camctrl_desc((camwebsrv_camera_ctrl_t) o);
+
+        if (o != c && podesc->get != NULL && podesc->get(&sensor) != 0)
+        {
+          fprintf(stderr, "%s: set %d, and %s changed too\n", pdesc->name, values[v], podesc->name);
+          return 1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int _test_camctrl_bench(void)
+{
+  volatile camwebsrv_camera_ctrl_t sink;
+  int64_t t0;
+  int64_t t1;
+  int64_t t2;
+  int r;
+  int c;
+
+  // every name in turn, through the table's binary search and through a
+  // strcmp() chain in the same order, as ctrl_set()/ctrl_get() used to do
+
+  t0 = test_now_us();
+
+  for (r = 0; r < _TEST_CAMCTRL_BENCH_ROUNDS; r++)
+  {
+    for (c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+    {
+      sink = camwebsrv_camera_ctrl_find(_test_camctrl_names[c]);
+      TEST_CHECK(sink == (camwebsrv_camera_ctrl_t) c);
+    }
+  }
+
+  t1 = test_now_us();
+
+  for (r = 0; r < _TEST_CAMCTRL_BENCH_ROUNDS; r++)
+  {
+    for (c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+    {
+      sink = _test_camctrl_chain(_test_camctrl_names[c]);
+      TEST_CHECK(sink == (camwebsrv_camera_ctrl_t) c);
+    }
+  }
+
+  t2 = test_now_us();
+
+  printf("camctrl: %d lookups: binary search %lld us (%.1f ns each), strcmp chain %lld us (%.1f ns each)\n",
+    _TEST_CAMCTRL_BENCH_ROUNDS * CAMWEBSRV_CAMERA_CTRL_MAX,
+    (long long) (t1 - t0),
+    (double) (t1 - t0) * 1000.0 / (_TEST_CAMCTRL_BENCH_ROUNDS * CAMWEBSRV_CAMERA_CTRL_MAX),
+    (long long) (t2 - t1),
+    (double) (t2 - t1) * 1000.0 / (_TEST_CAMCTRL_BENCH_ROUNDS * CAMWEBSRV_CAMERA_CTRL_MAX));
+
+  return 0;
+}
+
+static void _test_camctrl_sensor(sensor_t *sensor)
+{
+  memset(sensor, 0x00, sizeof(*sensor));
+
+  sensor->set_ae_level = _test_camctrl_fake_set_ae_level;
+  sensor->set_exposure_ctrl = _test_camctrl_fake_set_exposure_ctrl;
+  sensor->set_aec2 = _test_camctrl_fake_set_aec2;
+  sensor->set_aec_value = _test_camctrl_fake_set_aec_value;
+  sensor->set_gain_ctrl = _test_camctrl_fake_set_gain_ctrl;
+  sensor->set_agc_gain = _test_camctrl_fake_set_agc_gain;
+  sensor->set_whitebal = _test_camctrl_fake_set_whitebal;
+  sensor->set_awb_gain = _test_camctrl_fake_set_awb_gain;
+  sensor->set_bpc = _test_camctrl_fake_set_bpc;
+  sensor->set_brightness = _test_camctrl_fake_set_brightness;
+  sensor->set_colorbar = _test_camctrl_fake_set_colorbar;
+  sensor->set_contrast = _test_camctrl_fake_set_contrast;
+  sensor->set_dcw = _test_camctrl_fake_set_dcw;
+  sensor->set_gainceiling = _test_camctrl_fake_set_gainceiling;
+  sensor->set_hmirror = _test_camctrl_fake_set_hmirror;
+  sensor->set_lenc = _test_camctrl_fake_set_lenc;
+  sensor->set_quality = _test_camctrl_fake_set_quality;
+  sensor->set_raw_gma = _test_camctrl_fake_set_raw_gma;
+  sensor->set_saturation = _test_camctrl_fake_set_saturation;
+  sensor->set_sharpness = _test_camctrl_fake_set_sharpness;
+  sensor->set_special_effect = _test_camctrl_fake_set_special_effect;
+  sensor->set_vflip = _test_camctrl_fake_set_vflip;
+  sensor->set_wb_mode = _test_camctrl_fake_set_wb_mode;
+  sensor->set_wpc = _test_camctrl_fake_set_wpc;
+}
+
+static camwebsrv_camera_ctrl_t _test_camctrl_chain(const char *name)
+{
+  int c;
+
+  for (c = 0; c < CAMWEBSRV_CAMERA_CTRL_MAX; c++)
+  {
+    if (strcmp(name, _test_camctrl_names[c]) == 0)
+    {
+      return (camwebsrv_camera_ctrl_t) c;
+    }
+  }
+
+  return CAMWEBSRV_CAMERA_CTRL_MAX;
+}
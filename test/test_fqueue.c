@@ -0,0 +1,608 @@
+// 2026-10-16 test_fqueue.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "config.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+
+// a model of how frames get from the sensor to readers in camera.c, run
+// against a scripted sensor and scripted readers. camera.c needs the
+// driver and freertos, so it is modelled here as it behaves:
+//
+//   - each slot holds one driver buffer while it is in use; a slot is free
+//     once its last reference is dropped, which gives the buffer back
+//   - frame_refresh() takes a free slot, or else recycles the current
+//     frame if the camera holds the only reference to it, or else keeps
+//     serving the current frame as it is
+//   - with the capture task, it is called at the configured rate from the
+//     task, and frame_acquire() only takes a reference to the current
+//     frame; without it, readers call it themselves, one at a time under
+//     mutex2, whenever the current frame is older than a frame interval
+//   - it gives back grabbed frames exposed before a given time, at most
+//     CAMWEBSRV_CAMERA_FB_COUNT of them; the task asks for one exposed
+//     after it started the refresh, and is also modelled as it was, taking
+//     whatever the driver had
+//
+// and the driver as configured for each:
+//
+//   - one buffer, CAMERA_GRAB_WHEN_EMPTY, as it was before the task:
+//     nothing is captured until a grab asks for it, which then waits for
+//     the next vsync and a whole frame
+//   - CAMWEBSRV_CAMERA_FB_COUNT buffers, CAMERA_GRAB_LATEST: as cam_hal.c
+//     does it, the sensor fills whichever buffer is neither held nor
+//     queued, or skips the frame if there is none; complete frames queue
+//     up to one fewer than there are buffers, the newest pushing the
+//     oldest out when it is full; a grab takes the oldest, or waits
+
+#define _TEST_FQUEUE_SENSOR (1000000 / 12)
+#define _TEST_FQUEUE_FPS CAMWEBSRV_CAMERA_DEFAULT_FPS
+#define _TEST_FQUEUE_INTERVAL (1000000 / _TEST_FQUEUE_FPS)
+#define _TEST_FQUEUE_BACKOFF (CAMWEBSRV_MAIN_MIN_CYCLE_MSEC * 1000)
+#define _TEST_FQUEUE_START 1000000
+#define _TEST_FQUEUE_RUN 60000000
+#define _TEST_FQUEUE_SLOTS_MAX 4
+#define _TEST_FQUEUE_READERS_MAX 4
+
+// who wants frames, how often, and for how long they hold on to each;
+// /capture's are the ones whose latency counts
+
+typedef struct
+{
+  bool capture;
+  int64_t every_us;
+  int64_t hold_us;
+} _test_fqueue_reader_t;
+
+typedef struct
+{
+  const char *name;
+  int nreaders;
+  _test_fqueue_reader_t readers[_TEST_FQUEUE_READERS_MAX];
+} _test_fqueue_script_t;
+
+typedef struct
+{
+  uint32_t published;
+  uint32_t captures;
+  int64_t lat_sum;
+  int64_t lat_max;
+  int64_t age_sum;
+  int64_t age_max;
+  uint32_t busy;
+  uint32_t recycled;
+} _test_fqueue_stats_t;
+
+typedef struct
+{
+  bool used;
+  uint16_t refs;
+  uint32_t seq;
+  int64_t tstamp;
+} _test_fqueue_slot_t;
+
+typedef enum
+{
+  _TEST_FQUEUE_IDLE,
+  _TEST_FQUEUE_MUTEX,
+  _TEST_FQUEUE_GRAB,
+  _TEST_FQUEUE_HOLD
+} _test_fqueue_state_t;
+
+typedef struct
+{
+  _test_fqueue_state_t state;
+  int64_t tnext;
+  int64_t tasked;
+  int slot;
+  uint32_t seq;
+} _test_fqueue_actor_t;
+
+typedef struct
+{
+  // the run
+
+  const _test_fqueue_script_t *script;
+  bool task;
+  bool fresh;
+  int nbufs;
+  _test_fqueue_stats_t *stats;
+
+  // the driver
+
+  int64_t vnext;
+  int app;
+  bool wanted;
+  bool filling;
+  int64_t fstamp;
+  int qlen;
+  int64_t queue[_TEST_FQUEUE_SLOTS_MAX];
+
+  // the camera
+
+  _test_fqueue_slot_t slots[_TEST_FQUEUE_SLOTS_MAX];
+  int current;
+  uint32_t seq;
+  int64_t tstamp;
+  int grabber;
+  int pending;
+  int64_t after;
+  int discards;
+
+  // the task is actor 0, the readers follow
+
+  _test_fqueue_actor_t actors[1 + _TEST_FQUEUE_READERS_MAX];
+} _test_fqueue_t;
+
+static const _test_fqueue_script_t _test_fqueue_scripts[] =
+{
+  { "capture", 1, { { true, 700000, 20000 } } },
+  { "streams", 3, { { true, 700000, 20000 }, { false, 250000, 100000 }, { false, 250000, 400000 } } },
+  { "hoarders", 4, { { true, 700000, 20000 }, { false, 250000, 1500000 }, { false, 250000, 1100000 }, { false, 250000, 900000 } } }
+};
+
+static int _test_fqueue_task(void);
+static int _test_fqueue_inline(void);
+static int _test_fqueue_hoarders(void);
+static int _test_fqueue_compare(void);
+static int _test_fqueue_run(const _test_fqueue_script_t *script, bool task, bool fresh, _test_fqueue_stats_t *stats);
+static void _test_fqueue_vsync(_test_fqueue_t *m, int64_t t);
+static void _test_fqueue_ask(_test_fqueue_t *m, int a, int64_t t);
+static bool _test_fqueue_refresh(_test_fqueue_t *m, int a, int64_t t, bool force);
+static bool _test_fqueue_take(_test_fqueue_t *m, int a, int64_t t);
+static void _test_fqueue_acquire(_test_fqueue_t *m, int a, int64_t t);
+static void _test_fqueue_unref(_test_fqueue_t *m, int slot);
+
+int main(void)
+{
+  int failed = 0;
+
+  TEST_RUN(_test_fqueue_task);
+  TEST_RUN(_test_fqueue_inline);
+  TEST_RUN(_test_fqueue_hoarders);
+  TEST_RUN(_test_fqueue_compare);
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_fqueue_task(void)
+{
+  _test_fqueue_stats_t stats;
+
+  // with the capture task, /capture never waits, gets a frame no older
+  // than an interval and a sensor frame, and the task keeps to its rate
+  // however long the streams take over each frame
+
+  for (int n = 0; n < 2; n++)
+  {
+    TEST_CHECK(_test_fqueue_run(&_test_fqueue_scripts[n], true, true, &stats) == 0);
+    TEST_CHECK(stats.captures > 0);
+    TEST_CHECK(stats.lat_max == 0);
+    TEST_CHECK(stats.age_max <= _TEST_FQUEUE_INTERVAL + 2 * _TEST_FQUEUE_SENSOR);
+    TEST_CHECK(stats.published >= (uint32_t) ((_TEST_FQUEUE_RUN / _TEST_FQUEUE_INTERVAL) * 9 / 10));
+    TEST_CHECK(stats.busy == 0);
+    TEST_CHECK(stats.recycled == 0);
+  }
+
+  return 0;
+}
+
+static int _test_fqueue_inline(void)
+{
+  _test_fqueue_stats_t stats;
+
+  // without it, /capture on its own finds the frame stale and waits for
+  // the next vsync and a whole frame on top
+
+  TEST_CHECK(_test_fqueue_run(&_test_fqueue_scripts[0], false, false, &stats) == 0);
+  TEST_CHECK(stats.lat_sum / stats.captures >= _TEST_FQUEUE_SENSOR);
+  TEST_CHECK(stats.lat_max <= 2 * _TEST_FQUEUE_SENSOR);
+  TEST_CHECK(stats.recycled == 0);
+
+  // streams keep it fresh more often than not, but /capture still waits
+  // out their grabs when it comes in behind one
+
+  TEST_CHECK(_test_fqueue_run(&_test_fqueue_scripts[1], false, false, &stats) == 0);
+  TEST_CHECK(stats.lat_max > 0);
+  TEST_CHECK(stats.lat_max <= 2 * _TEST_FQUEUE_SENSOR);
+  TEST_CHECK(stats.recycled == 0);
+
+  return 0;
+}
+
+static int _test_fqueue_hoarders(void)
+{
+  _test_fqueue_stats_t stats;
+
+  // readers that hold on to frames for longer than the slots can cover
+  // make the task skip publishing, and /capture gets older frames; but it
+  // still never waits, and nobody's frame is recycled from under them
+
+  TEST_CHECK(_test_fqueue_run(&_test_fqueue_scripts[2], true, true, &stats) == 0);
+  TEST_CHECK(stats.busy > 0);
+  TEST_CHECK(stats.lat_max == 0);
+  TEST_CHECK(stats.age_max > _TEST_FQUEUE_INTERVAL + 2 * _TEST_FQUEUE_SENSOR);
+  TEST_CHECK(stats.recycled == 0);
+
+  TEST_CHECK(_test_fqueue_run(&_test_fqueue_scripts[2], false, false, &stats) == 0);
+  TEST_CHECK(stats.recycled == 0);
+
+  return 0;
+}
+
+static int _test_fqueue_compare(void)
+{
+  _test_fqueue_stats_t task;
+  _test_fqueue_stats_t stale;
+  _test_fqueue_stats_t inl;
+
+  printf("fqueue: sensor %d us, %d fps, %d slots, %d s; what /capture waits for, and how old the frame it gets is, avg/max in ms\n", _TEST_FQUEUE_SENSOR, _TEST_FQUEUE_FPS, CAMWEBSRV_CAMERA_FB_COUNT, _TEST_FQUEUE_RUN / 1000000);
+
+  for (size_t i = 0; i < sizeof(_test_fqueue_scripts) / sizeof(_test_fqueue_scripts[0]); i++)
+  {
+    TEST_CHECK(_test_fqueue_run(&_test_fqueue_scripts[i], true, true, &task) == 0);
+    TEST_CHECK(_test_fqueue_run(&_test_fqueue_scripts[i], true, false, &stale) == 0);
+    TEST_CHECK(_test_fqueue_run(&_test_fqueue_scripts[i], false, false, &inl) == 0);
+
+    printf("  %-8s task: waits %3" PRId64 "/%3" PRId64 ", %3" PRId64 "/%4" PRId64 " old, %3" PRIu32 " busy;"
+      " taking any: %3" PRId64 "/%4" PRId64 " old; inline: waits %3" PRId64 "/%3" PRId64 ", %3" PRId64 "/%4" PRId64 " old\n",
+      _test_fqueue_scripts[i].name,
+      task.lat_sum / task.captures / 1000,
+      task.lat_max / 1000,
+      task.age_sum / task.captures / 1000,
+      task.age_max / 1000,
+      task.busy,
+      stale.age_sum / stale.captures / 1000,
+      stale.age_max / 1000,
+      inl.lat_sum / inl.captures / 1000,
+      inl.lat_max / 1000,
+      inl.age_sum / inl.captures / 1000,
+      inl.age_max / 1000);
+
+    TEST_CHECK(task.lat_sum < inl.lat_sum);
+    TEST_CHECK(task.age_sum < stale.age_sum);
+  }
+
+  return 0;
+}
+
+static int _test_fqueue_run(const _test_fqueue_script_t *script, bool task, bool fresh, _test_fqueue_stats_t *stats)
+{
+  _test_fqueue_t m;
+  _test_fqueue_actor_t *pa;
+  int64_t t;
+  int n;
+  int a;
+
+  memset(&m, 0x00, sizeof(m));
+  memset(stats, 0x00, sizeof(*stats));
+
+  m.script = script;
+  m.task = task;
+  m.fresh = fresh;
+  m.nbufs = task ? CAMWEBSRV_CAMERA_FB_COUNT : 1;
+  m.stats = stats;
+  m.vnext = _TEST_FQUEUE_SENSOR;
+  m.current = -1;
+  m.grabber = -1;
+  m.pending = -1;
+
+  if (m.nbufs > _TEST_FQUEUE_SLOTS_MAX || script->nreaders > _TEST_FQUEUE_READERS_MAX)
+  {
+    return 1;
+  }
+
+  // the task starts straight away, the readers once it has had time to
+  // publish something, each a little out of step with the others
+
+  n = 1 + script->nreaders;
+
+  for (a = 0; a < n; a++)
+  {
+    m.actors[a].state = _TEST_FQUEUE_IDLE;
+    m.actors[a].tnext = a == 0 ? (task ? 0 : INT64_MAX) : _TEST_FQUEUE_START + a * 37000;
+    m.actors[a].slot = -1;
+  }
+
+  while (1)
+  {
+    // the next thing to happen: a vsync, or an actor that is due
+
+    t = m.vnext;
+
+    for (a = 0; a < n; a++)
+    {
+      if (m.actors[a].state != _TEST_FQUEUE_GRAB && m.actors[a].state != _TEST_FQUEUE_MUTEX && m.actors[a].tnext < t)
+      {
+        t = m.actors[a].tnext;
+      }
+    }
+
+    if (t > _TEST_FQUEUE_START + _TEST_FQUEUE_RUN)
+    {
+      break;
+    }
+
+    // the sensor first, then whoever was waiting on it, then the rest
+
+    if (t == m.vnext)
+    {
+      _test_fqueue_vsync(&m, t);
+      m.vnext = m.vnext + _TEST_FQUEUE_SENSOR;
+
+      if (m.grabber >= 0 && _test_fqueue_take(&m, m.grabber, t))
+      {
+        a = m.grabber;
+        m.grabber = -1;
+
+        if (a > 0)
+        {
+          _test_fqueue_acquire(&m, a, t);
+        }
+
+        // readers queued on mutex2 get it in turn, and most likely find
+        // the frame that was just published
+
+        for (int w = 1; w < n && m.grabber < 0; w++)
+        {
+          if (m.actors[w].state == _TEST_FQUEUE_MUTEX)
+          {
+            m.actors[w].state = _TEST_FQUEUE_IDLE;
+            _test_fqueue_ask(&m, w, t);
+          }
+        }
+      }
+    }
+
+    for (a = 0; a < n; a++)
+    {
+      pa = &(m.actors[a]);
+
+      if (pa->tnext != t || pa->state == _TEST_FQUEUE_GRAB || pa->state == _TEST_FQUEUE_MUTEX)
+      {
+        continue;
+      }
+
+      if (a == 0)
+      {
+        // the task: refresh when due, or back off if every slot is taken
+
+        if (!_test_fqueue_refresh(&m, 0, t, true) && pa->state != _TEST_FQUEUE_GRAB)
+        {
+          pa->tnext = t + _TEST_FQUEUE_BACKOFF;
+        }
+
+        continue;
+      }
+
+      if (pa->state == _TEST_FQUEUE_HOLD)
+      {
+        // done with it; its slot must still hold the frame it was given
+
+        if (m.slots[pa->slot].seq != pa->seq || !m.slots[pa->slot].used)
+        {
+          stats->recycled++;
+        }
+
+        _test_fqueue_unref(&m, pa->slot);
+
+        pa->slot = -1;
+        pa->state = _TEST_FQUEUE_IDLE;
+        pa->tnext = pa->tasked + script->readers[a - 1].every_us > t ? pa->tasked + script->readers[a - 1].every_us : t;
+
+        continue;
+      }
+
+      // a reader asking for a frame
+
+      pa->tasked = t;
+
+      _test_fqueue_ask(&m, a, t);
+    }
+  }
+
+  return stats->captures > 0 ? 0 : 1;
+}
+
+static void _test_fqueue_vsync(_test_fqueue_t *m, int64_t t)
+{
+  int free;
+
+  // the frame being read out is complete, and joins the queue; if that
+  // is full, the oldest in it goes back to being a free buffer
+
+  if (m->filling)
+  {
+    m->filling = false;
+
+    if (m->qlen == (m->nbufs > 1 ? m->nbufs - 1 : 1))
+    {
+      memmove(m->queue, m->queue + 1, (m->qlen - 1) * sizeof(m->queue[0]));
+      m->qlen--;
+    }
+
+    m->queue[m->qlen++] = m->fstamp;
+  }
+
+  // start on the next one if there is a buffer that is neither held nor
+  // queued; otherwise the sensor's frame goes nowhere; with a single
+  // buffer, only if a grab is waiting for it
+
+  free = m->nbufs - m->app - m->qlen;
+
+  if (free > 0 && (m->nbufs > 1 || m->wanted))
+  {
+    m->filling = true;
+    m->fstamp = t;
+  }
+}
+
+static void _test_fqueue_ask(_test_fqueue_t *m, int a, int64_t t)
+{
+  // frame_acquire(): with the task, a reference to whatever is current;
+  // without it, a turn at mutex2 and a refresh first
+
+  if (m->task && m->current >= 0)
+  {
+    _test_fqueue_acquire(m, a, t);
+  }
+  else if (m->task)
+  {
+    m->actors[a].tnext = t + _TEST_FQUEUE_BACKOFF;
+  }
+  else if (m->grabber >= 0)
+  {
+    m->actors[a].state = _TEST_FQUEUE_MUTEX;
+  }
+  else if (_test_fqueue_refresh(m, a, t, false))
+  {
+    _test_fqueue_acquire(m, a, t);
+  }
+  else if (m->actors[a].state != _TEST_FQUEUE_GRAB)
+  {
+    m->actors[a].tnext = t + _TEST_FQUEUE_BACKOFF;
+  }
+}
+
+static bool _test_fqueue_refresh(_test_fqueue_t *m, int a, int64_t t, bool force)
+{
+  int slot = -1;
+
+  // is the current frame still fresh enough?
+
+  if (!force && m->current >= 0 && (t - m->tstamp) < _TEST_FQUEUE_INTERVAL)
+  {
+    return true;
+  }
+
+  // a free slot, or else the current one if nobody else holds it
+
+  for (int i = 0; i < m->nbufs && slot < 0; i++)
+  {
+    slot = m->slots[i].used ? -1 : i;
+  }
+
+  if (slot < 0)
+  {
+    if (m->current < 0 || m->slots[m->current].refs != 1)
+    {
+      m->stats->busy++;
+      return m->current >= 0 && a > 0;
+    }
+
+    slot = m->current;
+    m->current = -1;
+    _test_fqueue_unref(m, slot);
+  }
+
+  // then grab; this is where the caller waits
+
+  m->tstamp = t;
+  m->after = (a == 0 && m->fresh) ? t : 0;
+  m->discards = 0;
+  m->pending = slot;
+  m->grabber = a;
+  m->wanted = true;
+  m->actors[a].state = _TEST_FQUEUE_GRAB;
+
+  if (_test_fqueue_take(m, a, t))
+  {
+    m->grabber = -1;
+    return true;
+  }
+
+  return false;
+}
+
+static bool _test_fqueue_take(_test_fqueue_t *m, int a, int64_t t)
+{
+  _test_fqueue_slot_t *pslot;
+  int old;
+
+  // give back the ones exposed too early, which frees their buffers for
+  // the sensor to fill
+
+  while (m->qlen > 0 && m->queue[0] < m->after && m->discards < CAMWEBSRV_CAMERA_FB_COUNT)
+  {
+    memmove(m->queue, m->queue + 1, (m->qlen - 1) * sizeof(m->queue[0]));
+    m->qlen--;
+    m->discards++;
+  }
+
+  if (m->qlen == 0)
+  {
+    return false;
+  }
+
+  // take the oldest complete frame, and publish it in the slot set aside
+
+  pslot = &(m->slots[m->pending]);
+  pslot->used = true;
+  pslot->refs = 1;
+  pslot->seq = ++(m->seq);
+  pslot->tstamp = m->queue[0];
+
+  memmove(m->queue, m->queue + 1, (m->qlen - 1) * sizeof(m->queue[0]));
+  m->qlen--;
+  m->wanted = false;
+  m->app++;
+
+  old = m->current;
+  m->current = m->pending;
+  m->pending = -1;
+
+  if (old >= 0)
+  {
+    _test_fqueue_unref(m, old);
+  }
+
+  m->stats->published++;
+  m->actors[a].state = _TEST_FQUEUE_IDLE;
+
+  if (a == 0)
+  {
+    m->actors[0].tnext = m->tstamp + _TEST_FQUEUE_INTERVAL;
+  }
+
+  return true;
+}
+
+static void _test_fqueue_acquire(_test_fqueue_t *m, int a, int64_t t)
+{
+  _test_fqueue_actor_t *pa = &(m->actors[a]);
+  _test_fqueue_slot_t *pslot = &(m->slots[m->current]);
+
+  // a counted reference to the current frame, held for as long as this
+  // reader takes over it
+
+  pslot->refs++;
+
+  pa->slot = m->current;
+  pa->seq = pslot->seq;
+  pa->state = _TEST_FQUEUE_HOLD;
+  pa->tnext = t + m->script->readers[a - 1].hold_us;
+
+  if (m->script->readers[a - 1].capture)
+  {
+    m->stats->captures++;
+    m->stats->lat_sum += t - pa->tasked;
+    m->stats->lat_max = t - pa->tasked > m->stats->lat_max ? t - pa->tasked : m->stats->lat_max;
+    m->stats->age_sum += t - pslot->tstamp;
+    m->stats->age_max = t - pslot->tstamp > m->stats->age_max ? t - pslot->tstamp : m->stats->age_max;
+  }
+}
+
+static void _test_fqueue_unref(_test_fqueue_t *m, int slot)
+{
+  _test_fqueue_slot_t *pslot = &(m->slots[slot]);
+
+  // last one out gives the buffer back to the driver, and frees the slot
+
+  if (pslot->refs > 0 && --(pslot->refs) == 0)
+  {
+    pslot->used = false;
+    m->app--;
+  }
+}
@@ -0,0 +1,280 @@
+// 2026-10-16 test_motion.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "config.h"
+#include "motion.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// uxga at the 1/8 scale the camera decodes at for the detector
+
+#define _TEST_MOTION_WIDTH 200
+#define _TEST_MOTION_HEIGHT 150
+#define _TEST_MOTION_BENCH_ROUNDS 1000
+
+static int _test_motion_first(void);
+static int _test_motion_resize(void);
+static int _test_motion_step(void);
+static int _test_motion_partial(void);
+static int _test_motion_adapt(void);
+static int _test_motion_bench(void);
+static uint16_t _test_motion_score(camwebsrv_motion_t *md, const uint8_t *luma, uint16_t width, uint16_t height);
+
+int main(void)
+{
+  int failed = 0;
+
+  TEST_RUN(_test_motion_first);
+  TEST_RUN(_test_motion_resize);
+  TEST_RUN(_test_motion_step);
+  TEST_RUN(_test_motion_partial);
+  TEST_RUN(_test_motion_adapt);
+  TEST_RUN(_test_motion_bench);
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_motion_first(void)
+{
+  camwebsrv_motion_t md;
+  uint8_t luma[_TEST_MOTION_WIDTH * _TEST_MOTION_HEIGHT];
+  uint16_t score = 0xffff;
+  size_t i;
+
+  for (i = 0; i < sizeof(luma); i++)
+  {
+    luma[i] = (uint8_t) (i * 7);
+  }
+
+  // the first image is the background, in 8.8, and scores nothing
+
+  camwebsrv_motion_init(&md);
+
+  TEST_CHECK(camwebsrv_motion_update(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT, &score));
+  TEST_CHECK(score == 0);
+  TEST_CHECK(md.bg != NULL);
+  TEST_CHECK(md.width == _TEST_MOTION_WIDTH && md.height == _TEST_MOTION_HEIGHT);
+
+  for (i = 0; i < sizeof(luma); i++)
+  {
+    TEST_CHECK(md.bg[i] == (uint16_t) (luma[i] << 8));
+  }
+
+  // the same image again matches it exactly, and leaves it alone
+
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 0);
+
+  for (i = 0; i < sizeof(luma); i++)
+  {
+    TEST_CHECK(md.bg[i] == (uint16_t) (luma[i] << 8));
+  }
+
+  // bad arguments are refused, and the background kept
+
+  TEST_CHECK(!camwebsrv_motion_update(NULL, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT, &score));
+  TEST_CHECK(!camwebsrv_motion_update(&md, NULL, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT, &score));
+  TEST_CHECK(!camwebsrv_motion_update(&md, luma, 0, _TEST_MOTION_HEIGHT, &score));
+  TEST_CHECK(md.bg != NULL);
+
+  camwebsrv_motion_destroy(&md);
+
+  TEST_CHECK(md.bg == NULL && md.width == 0 && md.height == 0);
+
+  return 0;
+}
+
+static int _test_motion_resize(void)
+{
+  camwebsrv_motion_t md;
+  uint8_t luma[_TEST_MOTION_WIDTH * _TEST_MOTION_HEIGHT];
+
+  camwebsrv_motion_init(&md);
+
+  memset(luma, 0, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 0);
+
+  // a different size starts over, however different the image is; so does
+  // the same number of pixels in another shape
+
+  memset(luma, 255, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, 100, 75) == 0);
+  TEST_CHECK(md.width == 100 && md.height == 75);
+  TEST_CHECK(md.bg[0] == (255 << 8));
+
+  TEST_CHECK(_test_motion_score(&md, luma, 75, 100) == 0);
+  TEST_CHECK(md.width == 75 && md.height == 100);
+
+  // and the new background is what the next image is measured against
+
+  memset(luma, 0, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, 75, 100) == 1000);
+
+  camwebsrv_motion_destroy(&md);
+
+  return 0;
+}
+
+static int _test_motion_step(void)
+{
+  camwebsrv_motion_t md;
+  uint8_t luma[_TEST_MOTION_WIDTH * _TEST_MOTION_HEIGHT];
+
+  // every block moves by the same amount: up to CAMWEBSRV_MOTION_PIXEL_DIFF
+  // on average is noise, anything over it is motion
+
+  camwebsrv_motion_init(&md);
+  memset(luma, 100, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 0);
+  memset(luma, 100 + CAMWEBSRV_MOTION_PIXEL_DIFF, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 0);
+  camwebsrv_motion_destroy(&md);
+
+  camwebsrv_motion_init(&md);
+  memset(luma, 100, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 0);
+  memset(luma, 100 + CAMWEBSRV_MOTION_PIXEL_DIFF + 1, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 1000);
+  camwebsrv_motion_destroy(&md);
+
+  // the same going darker
+
+  camwebsrv_motion_init(&md);
+  memset(luma, 100, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 0);
+  memset(luma, 100 - CAMWEBSRV_MOTION_PIXEL_DIFF - 1, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 1000);
+  camwebsrv_motion_destroy(&md);
+
+  return 0;
+}
+
+static int _test_motion_partial(void)
+{
+  camwebsrv_motion_t md;
+  uint8_t luma[20 * 12];
+  uint16_t x;
+  uint16_t y;
+
+  // 20x12 cuts into 3x2 blocks, the last column and row short; a change in
+  // just the short corner block is one block in six
+
+  TEST_CHECK(CAMWEBSRV_MOTION_BLOCK == 8);
+
+  camwebsrv_motion_init(&md);
+
+  memset(luma, 50, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, 20, 12) == 0);
+
+  for (y = CAMWEBSRV_MOTION_BLOCK; y < 12; y++)
+  {
+    for (x = 2 * CAMWEBSRV_MOTION_BLOCK; x < 20; x++)
+    {
+      luma[y * 20 + x] = 200;
+    }
+  }
+
+  TEST_CHECK(_test_motion_score(&md, luma, 20, 12) == 1000 / 6);
+
+  camwebsrv_motion_destroy(&md);
+
+  return 0;
+}
+
+static int _test_motion_adapt(void)
+{
+  camwebsrv_motion_t md;
+  uint8_t luma[_TEST_MOTION_WIDTH * _TEST_MOTION_HEIGHT];
+  int i;
+
+  // something that moves in and stays put becomes the background after a
+  // few frames, a 1/2^CAMWEBSRV_MOTION_BG_SHIFT of the way at a time
+
+  camwebsrv_motion_init(&md);
+
+  memset(luma, 60, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 0);
+
+  memset(luma, 180, sizeof(luma));
+  TEST_CHECK(_test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) == 1000);
+
+  for (i = 0; i < 64 && _test_motion_score(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT) != 0; i++);
+
+  TEST_CHECK(i > 1 && i < 64);
+
+  printf("motion: a step of 120 settles into the background after %d more frames\n", i + 1);
+
+  camwebsrv_motion_destroy(&md);
+
+  return 0;
+}
+
+static int _test_motion_bench(void)
+{
+  camwebsrv_motion_t md;
+  uint8_t *luma;
+  uint64_t total;
+  uint32_t seed;
+  int64_t t0;
+  int64_t t1;
+  uint16_t score;
+  size_t len;
+  size_t i;
+  int r;
+
+  len = (size_t) _TEST_MOTION_WIDTH * _TEST_MOTION_HEIGHT;
+  luma = (uint8_t *) malloc(len * 2);
+
+  TEST_CHECK(luma != NULL);
+
+  // alternating between two noisy images, so that the background always
+  // has somewhere to go
+
+  for (i = 0, seed = 1; i < len * 2; i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    luma[i] = (uint8_t) (seed >> 16);
+  }
+
+  camwebsrv_motion_init(&md);
+  camwebsrv_motion_update(&md, luma, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT, &score);
+
+  total = 0;
+  t0 = test_now_us();
+
+  for (r = 0; r < _TEST_MOTION_BENCH_ROUNDS; r++)
+  {
+    camwebsrv_motion_update(&md, luma + (r & 1) * len, _TEST_MOTION_WIDTH, _TEST_MOTION_HEIGHT, &score);
+    total += score;
+  }
+
+  t1 = test_now_us();
+
+  printf("motion: %dx%d, %d frames in %lld us (%.2f us/frame), mean score %llu\n",
+    _TEST_MOTION_WIDTH,
+    _TEST_MOTION_HEIGHT,
+    _TEST_MOTION_BENCH_ROUNDS,
+    (long long) (t1 - t0),
+    (double) (t1 - t0) / _TEST_MOTION_BENCH_ROUNDS,
+    (unsigned long long) (total / _TEST_MOTION_BENCH_ROUNDS));
+
+  camwebsrv_motion_destroy(&md);
+  free(luma);
+
+  TEST_CHECK(total > 0);
+
+  return 0;
+}
+
+static uint16_t _test_motion_score(camwebsrv_motion_t *md, const uint8_t *luma, uint16_t width, uint16_t height)
+{
+  uint16_t score = 0xffff;
+
+  if (!camwebsrv_motion_update(md, luma, width, height, &score))
+  {
+    return 0xffff;
+  }
+
+  return score;
+}
@@ -0,0 +1,230 @@
+// 2026-10-16 test_rbytes.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "rbytes.h"
+#include "vbytes.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+// a backlog drained the way sclients drains it: blocks of up to what the
+// old CAMWEBSRV_SCLIENTS_BSIZE was, into a socket that takes a segment
+
+#define _TEST_RBYTES_BENCH_BACKLOG (200 * 1024)
+#define _TEST_RBYTES_BENCH_BLOCK 8192
+#define _TEST_RBYTES_BENCH_MSS 1460
+
+static int _test_rbytes_append(void);
+static int _test_rbytes_wrap(void);
+static int _test_rbytes_limits(void);
+static int _test_rbytes_bench(void);
+static size_t _test_rbytes_send(const uint8_t *bytes, size_t len);
+
+int main(void)
+{
+  int failed = 0;
+
+  TEST_RUN(_test_rbytes_append);
+  TEST_RUN(_test_rbytes_wrap);
+  TEST_RUN(_test_rbytes_limits);
+  TEST_RUN(_test_rbytes_bench);
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_rbytes_append(void)
+{
+  camwebsrv_rbytes_t rb;
+  const uint8_t *bytes;
+  const uint8_t *wbytes;
+  size_t len;
+  size_t wlen;
+
+  TEST_CHECK(camwebsrv_rbytes_init(&rb, 16) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_length(rb) == 0);
+  TEST_CHECK(camwebsrv_rbytes_space(rb) == 16);
+
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, (const uint8_t *) "hello", 5) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, (const uint8_t *) " world", 6) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_length(rb) == 11);
+  TEST_CHECK(camwebsrv_rbytes_space(rb) == 5);
+
+  TEST_CHECK(camwebsrv_rbytes_get_bytes(rb, &bytes, &len, &wbytes, &wlen) == ESP_OK);
+  TEST_CHECK(len == 11 && wlen == 0);
+  TEST_CHECK(memcmp(bytes, "hello world", 11) == 0);
+
+  // consuming only moves the cursor
+
+  TEST_CHECK(camwebsrv_rbytes_consume(rb, 6) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_get_bytes(rb, &bytes, &len, &wbytes, &wlen) == ESP_OK);
+  TEST_CHECK(len == 5 && wlen == 0);
+  TEST_CHECK(memcmp(bytes, "world", 5) == 0);
+
+  TEST_CHECK(camwebsrv_rbytes_destroy(&rb) == ESP_OK);
+  TEST_CHECK(rb == NULL);
+
+  return 0;
+}
+
+static int _test_rbytes_wrap(void)
+{
+  camwebsrv_rbytes_t rb;
+  const uint8_t *bytes;
+  const uint8_t *wbytes;
+  size_t len;
+  size_t wlen;
+
+  TEST_CHECK(camwebsrv_rbytes_init(&rb, 8) == ESP_OK);
+
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, (const uint8_t *) "abcdef", 6) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_consume(rb, 4) == ESP_OK);
+
+  // "ef" sits at the end, so this goes in as "ghij" after it and "kl" at
+  // the start
+
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, (const uint8_t *) "ghijkl", 6) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_length(rb) == 8);
+  TEST_CHECK(camwebsrv_rbytes_space(rb) == 0);
+
+  TEST_CHECK(camwebsrv_rbytes_get_bytes(rb, &bytes, &len, &wbytes, &wlen) == ESP_OK);
+  TEST_CHECK(len == 4 && memcmp(bytes, "efgh", 4) == 0);
+  TEST_CHECK(wlen == 4 && memcmp(wbytes, "ijkl", 4) == 0);
+
+  // draining it completely rewinds, so the next append is in one piece
+
+  TEST_CHECK(camwebsrv_rbytes_consume(rb, 8) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, (const uint8_t *) "01234567", 8) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_get_bytes(rb, &bytes, &len, &wbytes, &wlen) == ESP_OK);
+  TEST_CHECK(len == 8 && wlen == 0);
+  TEST_CHECK(memcmp(bytes, "01234567", 8) == 0);
+
+  TEST_CHECK(camwebsrv_rbytes_destroy(&rb) == ESP_OK);
+
+  return 0;
+}
+
+static int _test_rbytes_limits(void)
+{
+  camwebsrv_rbytes_t rb;
+
+  TEST_CHECK(camwebsrv_rbytes_init(&rb, 0) == ESP_ERR_INVALID_ARG);
+  TEST_CHECK(camwebsrv_rbytes_init(&rb, 4) == ESP_OK);
+
+  // all or nothing
+
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, (const uint8_t *) "abc", 3) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, (const uint8_t *) "de", 2) == ESP_ERR_NO_MEM);
+  TEST_CHECK(camwebsrv_rbytes_length(rb) == 3);
+
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, NULL, 1) == ESP_ERR_INVALID_ARG);
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, NULL, 0) == ESP_OK);
+
+  TEST_CHECK(camwebsrv_rbytes_consume(rb, 4) == ESP_ERR_INVALID_SIZE);
+  TEST_CHECK(camwebsrv_rbytes_length(rb) == 3);
+
+  TEST_CHECK(camwebsrv_rbytes_destroy(&rb) == ESP_OK);
+  TEST_CHECK(camwebsrv_rbytes_destroy(&rb) == ESP_ERR_INVALID_ARG);
+
+  return 0;
+}
+
+static int _test_rbytes_bench(void)
+{
+  camwebsrv_rbytes_t rb;
+  camwebsrv_vbytes_t vb;
+  const uint8_t *bytes;
+  const uint8_t *wbytes;
+  uint8_t *backlog;
+  size_t len;
+  size_t wlen;
+  size_t sent;
+  uint64_t copied;
+  uint64_t vcopied;
+  uint32_t sends;
+  int64_t t0;
+  int64_t trb;
+  int64_t tvb;
+
+  backlog = (uint8_t *) malloc(_TEST_RBYTES_BENCH_BACKLOG);
+
+  TEST_CHECK(backlog != NULL);
+
+  memset(backlog, 0xa5, _TEST_RBYTES_BENCH_BACKLOG);
+
+  // the ring: one copy in, then each partial send only moves the cursor
+
+  TEST_CHECK(camwebsrv_rbytes_init(&rb, _TEST_RBYTES_BENCH_BACKLOG) == ESP_OK);
+
+  t0 = test_now_us();
+
+  TEST_CHECK(camwebsrv_rbytes_append_bytes(rb, backlog, _TEST_RBYTES_BENCH_BACKLOG) == ESP_OK);
+
+  copied = _TEST_RBYTES_BENCH_BACKLOG;
+  sends = 0;
+
+  while (camwebsrv_rbytes_length(rb) > 0)
+  {
+    TEST_CHECK(camwebsrv_rbytes_get_bytes(rb, &bytes, &len, &wbytes, &wlen) == ESP_OK);
+
+    sent = _test_rbytes_send(bytes, len < _TEST_RBYTES_BENCH_BLOCK ? len : _TEST_RBYTES_BENCH_BLOCK);
+    sends++;
+
+    TEST_CHECK(camwebsrv_rbytes_consume(rb, sent) == ESP_OK);
+  }
+
+  trb = test_now_us() - t0;
+
+  TEST_CHECK(camwebsrv_rbytes_destroy(&rb) == ESP_OK);
+
+  // what sclients did before: after each partial send, set_bytes() the
+  // remainder, which copies it out and back in again
+
+  TEST_CHECK(camwebsrv_vbytes_init(&vb) == ESP_OK);
+
+  t0 = test_now_us();
+
+  TEST_CHECK(camwebsrv_vbytes_set_bytes(vb, backlog, _TEST_RBYTES_BENCH_BACKLOG) == ESP_OK);
+
+  vcopied = 2 * (uint64_t) _TEST_RBYTES_BENCH_BACKLOG;
+
+  while (camwebsrv_vbytes_length(vb) > 0)
+  {
+    TEST_CHECK(camwebsrv_vbytes_get_bytes(vb, &bytes, &len) == ESP_OK);
+
+    sent = _test_rbytes_send(bytes, len < _TEST_RBYTES_BENCH_BLOCK ? len : _TEST_RBYTES_BENCH_BLOCK);
+
+    TEST_CHECK(camwebsrv_vbytes_set_bytes(vb, bytes + sent, len - sent) == ESP_OK);
+
+    vcopied += 2 * (uint64_t) (len - sent);
+  }
+
+  tvb = test_now_us() - t0;
+
+  TEST_CHECK(camwebsrv_vbytes_destroy(&vb) == ESP_OK);
+
+  free(backlog);
+
+  printf("rbytes: %d byte backlog in %u sends of at most %d: ring %" PRIu64 " bytes copied, %lld us; vbytes %" PRIu64 " bytes copied, %lld us\n", _TEST_RBYTES_BENCH_BACKLOG, (unsigned) sends, _TEST_RBYTES_BENCH_MSS, copied, (long long) trb, vcopied, (long long) tvb);
+
+  return 0;
+}
+
+static size_t _test_rbytes_send(const uint8_t *bytes, size_t len)
+{
+  volatile uint8_t sink = 0;
+  size_t i;
+
+  // a socket that takes at most one segment per call; touch what it takes
+  // so that the send isn't free
+
+  len = len < _TEST_RBYTES_BENCH_MSS ? len : _TEST_RBYTES_BENCH_MSS;
+
+  for (i = 0; i < len; i += 64)
+  {
+    sink ^= bytes[i];
+  }
+
+  return len;
+}
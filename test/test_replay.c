@@ -0,0 +1,586 @@
+// 2026-10-16 test_replay.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "config.h"
+#include "replay.h"
+#include "seqfile.h"
+#include "framehdr.h"
+#include "ssock.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+
+// the replay source on the host: frames out of a directory of files of
+// their own and of .seq files, in capture order, paced by esp_timer, which
+// vTaskDelay() winds on rather than sleeping. the benchmark then takes
+// them through what a stream client and a sequence capture do with each
+// frame, with a socket pair for the client
+
+#define _TEST_REPLAY_FPS 10
+#define _TEST_REPLAY_PERIOD (1000000 / _TEST_REPLAY_FPS)
+#define _TEST_REPLAY_TICK (portTICK_PERIOD_MS * 1000)
+#define _TEST_REPLAY_SEQ_FRAMES 3
+#define _TEST_REPLAY_BENCH_FRAMES 200
+#define _TEST_REPLAY_BENCH_BYTES 30000
+
+static char _test_replay_dir[] = "/tmp/camwebsrv_test_XXXXXX";
+static uint8_t _test_replay_data[_TEST_REPLAY_BENCH_BYTES + _TEST_REPLAY_BENCH_FRAMES + 64];
+
+static int _test_replay_order(void);
+static int _test_replay_crc(void);
+static int _test_replay_noindex(void);
+static int _test_replay_jitter(void);
+static int _test_replay_bench(void);
+static int _test_replay_bench_run(const char *name, uint8_t fps, int64_t *grab_us, int64_t *send_us, int64_t *write_us);
+static int _test_replay_send(camwebsrv_ssock_stats_t *stats, int *fds, const camwebsrv_camera_frame_t *frame);
+static size_t _test_replay_jpeg(uint8_t *buf, size_t len, uint16_t width, uint16_t height);
+static int _test_replay_file(const char *dir, const char *name, const uint8_t *buf, size_t len);
+static int _test_replay_seq(const char *dir, const char *name, int count, size_t len);
+static void _test_replay_path(char *path, size_t size, const char *dir, const char *name);
+
+int main(void)
+{
+  char cmd[256];
+  int failed = 0;
+
+  if (mkdtemp(_test_replay_dir) == NULL)
+  {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  srandom(1);
+
+  for (size_t i = 0; i < sizeof(_test_replay_data); i++)
+  {
+    _test_replay_data[i] = (uint8_t) (i * 13 + (i >> 8));
+  }
+
+  TEST_RUN(_test_replay_order);
+  TEST_RUN(_test_replay_crc);
+  TEST_RUN(_test_replay_noindex);
+  TEST_RUN(_test_replay_jitter);
+  TEST_RUN(_test_replay_bench);
+
+  // leave what failed behind to look at
+
+  if (failed == 0)
+  {
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", _test_replay_dir);
+    system(cmd);
+  }
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_replay_order(void)
+{
+  char dir[256];
+  uint8_t jpeg[1000];
+  camwebsrv_replay_t rep;
+  camera_fb_t *fb;
+  int64_t tlast;
+  int64_t t;
+  size_t jlen;
+
+  // a raw frame, a jpeg and a three frame sequence, named as seqcap and
+  // the record task name them
+
+  _test_replay_path(dir, sizeof(dir), "order", NULL);
+
+  jlen = _test_replay_jpeg(jpeg, sizeof(jpeg), 640, 480);
+
+  TEST_CHECK(mkdir(dir, 0777) == 0);
+  TEST_CHECK(_test_replay_file(dir, "100-QQVGA.raw", _test_replay_data, 160 * 120) == 0);
+  TEST_CHECK(_test_replay_file(dir, "200.jpg", jpeg, jlen) == 0);
+  TEST_CHECK(_test_replay_seq(dir, "300-test-VGA.seq", _TEST_REPLAY_SEQ_FRAMES, 5000) == 0);
+  TEST_CHECK(_test_replay_file(dir, "notes.txt", jpeg, 10) == 0);
+
+  TEST_CHECK(camwebsrv_replay_init(&rep, dir, _TEST_REPLAY_FPS, 0) == ESP_OK);
+
+  // raw frames go by their length, jpeg ones by their own header
+
+  TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+  TEST_CHECK(fb->format == PIXFORMAT_GRAYSCALE);
+  TEST_CHECK(fb->width == 160 && fb->height == 120);
+  TEST_CHECK(fb->len == 160 * 120);
+  TEST_CHECK(memcmp(fb->buf, _test_replay_data, fb->len) == 0);
+
+  tlast = (int64_t) fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+
+  TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+
+  TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+  TEST_CHECK(fb->format == PIXFORMAT_JPEG);
+  TEST_CHECK(fb->width == 640 && fb->height == 480);
+  TEST_CHECK(fb->len == jlen);
+  TEST_CHECK(memcmp(fb->buf, jpeg, jlen) == 0);
+  TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+
+  // then the sequence's frames in turn, as the header and records have
+  // them; each is paced a period after the one before, give or take a tick
+
+  for (int i = 0; i < _TEST_REPLAY_SEQ_FRAMES; i++)
+  {
+    TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+    TEST_CHECK(fb->format == PIXFORMAT_JPEG);
+    TEST_CHECK(fb->width == 640 && fb->height == 480);
+    TEST_CHECK(fb->len == (size_t) (5000 + i));
+    TEST_CHECK(memcmp(fb->buf, _test_replay_data + i, fb->len) == 0);
+
+    t = (int64_t) fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+
+    TEST_CHECK(t - tlast >= _TEST_REPLAY_PERIOD - _TEST_REPLAY_TICK);
+
+    tlast = t;
+
+    TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+  }
+
+  // and round again
+
+  TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+  TEST_CHECK(fb->format == PIXFORMAT_GRAYSCALE);
+  TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+
+  TEST_CHECK(camwebsrv_replay_destroy(&rep) == ESP_OK);
+  TEST_CHECK(rep == NULL);
+
+  return 0;
+}
+
+static int _test_replay_crc(void)
+{
+  char dir[256];
+  char path[512];
+  camwebsrv_seqfile_header_t header;
+  camwebsrv_seqfile_entry_t *index;
+  camwebsrv_replay_t rep;
+  camera_fb_t *fb;
+  uint32_t count;
+  uint8_t b;
+  int fd;
+
+  // a frame that fails its crc is an error, and the next one plays on
+
+  _test_replay_path(dir, sizeof(dir), "crc", NULL);
+  _test_replay_path(path, sizeof(path), "crc", "100-test-VGA.seq");
+
+  TEST_CHECK(mkdir(dir, 0777) == 0);
+  TEST_CHECK(_test_replay_seq(dir, "100-test-VGA.seq", _TEST_REPLAY_SEQ_FRAMES, 2000) == 0);
+  TEST_CHECK(camwebsrv_seqfile_load(path, &header, &index, &count) == ESP_OK);
+  TEST_CHECK(count == _TEST_REPLAY_SEQ_FRAMES);
+
+  fd = open(path, O_RDWR);
+  b = 0x5A;
+
+  TEST_CHECK(fd >= 0);
+  TEST_CHECK(pwrite(fd, &b, 1, (off_t) (index[1].offset + sizeof(camwebsrv_seqfile_record_t) + 700)) == 1);
+
+  close(fd);
+  free(index);
+
+  TEST_CHECK(camwebsrv_replay_init(&rep, dir, 255, 0) == ESP_OK);
+
+  TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+  TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+
+  TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_ERR_INVALID_CRC);
+
+  TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+  TEST_CHECK(fb->len == 2002);
+  TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+
+  TEST_CHECK(camwebsrv_replay_destroy(&rep) == ESP_OK);
+
+  return 0;
+}
+
+static int _test_replay_noindex(void)
+{
+  char dir[256];
+  char path[512];
+  uint8_t jpeg[1000];
+  camwebsrv_replay_t rep;
+  camera_fb_t *fb;
+  struct stat st;
+  size_t jlen;
+
+  // a capture that never got to write its index is left out; with
+  // nothing else there, there is nothing to play
+
+  _test_replay_path(dir, sizeof(dir), "noindex", NULL);
+  _test_replay_path(path, sizeof(path), "noindex", "100-test-VGA.seq");
+
+  TEST_CHECK(mkdir(dir, 0777) == 0);
+  TEST_CHECK(_test_replay_seq(dir, "100-test-VGA.seq", _TEST_REPLAY_SEQ_FRAMES, 2000) == 0);
+  TEST_CHECK(stat(path, &st) == 0);
+  TEST_CHECK(truncate(path, st.st_size - sizeof(camwebsrv_seqfile_footer_t)) == 0);
+
+  TEST_CHECK(camwebsrv_replay_init(&rep, dir, _TEST_REPLAY_FPS, 0) == ESP_ERR_NOT_FOUND);
+
+  jlen = _test_replay_jpeg(jpeg, sizeof(jpeg), 320, 240);
+
+  TEST_CHECK(_test_replay_file(dir, "200.jpg", jpeg, jlen) == 0);
+
+  TEST_CHECK(camwebsrv_replay_init(&rep, dir, _TEST_REPLAY_FPS, 0) == ESP_OK);
+
+  for (int i = 0; i < 2; i++)
+  {
+    TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+    TEST_CHECK(fb->width == 320 && fb->height == 240);
+    TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+  }
+
+  TEST_CHECK(camwebsrv_replay_destroy(&rep) == ESP_OK);
+
+  return 0;
+}
+
+static int _test_replay_jitter(void)
+{
+  char dir[256];
+  camwebsrv_replay_t rep;
+  camera_fb_t *fb;
+  int64_t tlast;
+  int64_t t;
+  int64_t dmin;
+  int64_t dmax;
+
+  // periods spread over +/- the jitter, to the nearest tick
+
+  _test_replay_path(dir, sizeof(dir), "order", NULL);
+
+  TEST_CHECK(camwebsrv_replay_init(&rep, dir, _TEST_REPLAY_FPS, 40) == ESP_OK);
+
+  tlast = 0;
+  dmin = INT64_MAX;
+  dmax = 0;
+
+  for (int i = 0; i < 50; i++)
+  {
+    TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+
+    t = (int64_t) fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+
+    if (i > 0)
+    {
+      dmin = t - tlast < dmin ? t - tlast : dmin;
+      dmax = t - tlast > dmax ? t - tlast : dmax;
+    }
+
+    tlast = t;
+
+    TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+  }
+
+  TEST_CHECK(camwebsrv_replay_destroy(&rep) == ESP_OK);
+
+  TEST_CHECK(dmin >= _TEST_REPLAY_PERIOD - 40000 - _TEST_REPLAY_TICK);
+  TEST_CHECK(dmax <= _TEST_REPLAY_PERIOD + 40000 + _TEST_REPLAY_TICK);
+  TEST_CHECK(dmax - dmin > _TEST_REPLAY_TICK);
+
+  return 0;
+}
+
+static int _test_replay_bench(void)
+{
+  char dir[256];
+  char name[32];
+  uint8_t *jpeg;
+  size_t jlen;
+  int64_t seq_grab;
+  int64_t jpg_grab;
+  int64_t send;
+  int64_t write;
+
+  // the same frames as one .seq file, and as a .jpg file each
+
+  _test_replay_path(dir, sizeof(dir), "bench-seq", NULL);
+
+  TEST_CHECK(mkdir(dir, 0777) == 0);
+  TEST_CHECK(_test_replay_seq(dir, "100-test-VGA.seq", _TEST_REPLAY_BENCH_FRAMES, _TEST_REPLAY_BENCH_BYTES) == 0);
+
+  _test_replay_path(dir, sizeof(dir), "bench-jpg", NULL);
+
+  TEST_CHECK(mkdir(dir, 0777) == 0);
+
+  jpeg = (uint8_t *) malloc(_TEST_REPLAY_BENCH_BYTES + _TEST_REPLAY_BENCH_FRAMES);
+
+  TEST_CHECK(jpeg != NULL);
+
+  for (int i = 0; i < _TEST_REPLAY_BENCH_FRAMES; i++)
+  {
+    memcpy(jpeg, _test_replay_data + (i % 64), _TEST_REPLAY_BENCH_BYTES + i);
+    jlen = _test_replay_jpeg(jpeg, _TEST_REPLAY_BENCH_BYTES + i, 640, 480);
+    snprintf(name, sizeof(name), "%d.jpg", 1000 + i * 40);
+
+    if (_test_replay_file(dir, name, jpeg, jlen) != 0)
+    {
+      free(jpeg);
+      return 1;
+    }
+  }
+
+  free(jpeg);
+
+  // each frame out of the source, then out to a stream client, then into
+  // a sequence; the source is left unpaced, so it all runs flat out
+
+  TEST_CHECK(_test_replay_bench_run("bench-seq", 255, &seq_grab, &send, &write) == 0);
+  TEST_CHECK(_test_replay_bench_run("bench-jpg", 255, &jpg_grab, &send, &write) == 0);
+
+  printf("replay: %d frames of %d bytes; per frame: grab %" PRId64 " us from .seq, %" PRId64 " us from .jpg; stream %" PRId64 " us; seqfile %" PRId64 " us\n",
+    _TEST_REPLAY_BENCH_FRAMES,
+    _TEST_REPLAY_BENCH_BYTES,
+    seq_grab / _TEST_REPLAY_BENCH_FRAMES,
+    jpg_grab / _TEST_REPLAY_BENCH_FRAMES,
+    send / _TEST_REPLAY_BENCH_FRAMES,
+    write / _TEST_REPLAY_BENCH_FRAMES);
+
+  return 0;
+}
+
+static int _test_replay_bench_run(const char *name, uint8_t fps, int64_t *grab_us, int64_t *send_us, int64_t *write_us)
+{
+  char dir[256];
+  char path[512];
+  camwebsrv_seqfile_header_t header;
+  camwebsrv_seqfile_entry_t *index;
+  camwebsrv_ssock_stats_t stats;
+  camwebsrv_camera_frame_t frame;
+  camwebsrv_replay_t rep;
+  camwebsrv_seqfile_t sf;
+  camera_fb_t *fb;
+  uint32_t count;
+  int64_t t0;
+  int64_t t1;
+  int64_t t2;
+  int64_t t3;
+  int fds[2];
+
+  _test_replay_path(dir, sizeof(dir), name, NULL);
+  _test_replay_path(path, sizeof(path), name, "out.cwsq");
+
+  TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  TEST_CHECK(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+  TEST_CHECK(camwebsrv_replay_init(&rep, dir, fps, 0) == ESP_OK);
+  TEST_CHECK(camwebsrv_seqfile_open(&sf, path, PIXFORMAT_JPEG, FRAMESIZE_VGA, _TEST_REPLAY_BENCH_FRAMES, 0) == ESP_OK);
+
+  camwebsrv_ssock_init(&stats);
+
+  *grab_us = 0;
+  *send_us = 0;
+  *write_us = 0;
+
+  for (int i = 0; i < _TEST_REPLAY_BENCH_FRAMES; i++)
+  {
+    t0 = test_now_us();
+
+    TEST_CHECK(camwebsrv_replay_grab(rep, &fb) == ESP_OK);
+
+    t1 = test_now_us();
+
+    memset(&frame, 0x00, sizeof(frame));
+
+    frame.buf = fb->buf;
+    frame.len = fb->len;
+    frame.tstamp = (int64_t) fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    frame.seq = (uint32_t) (i + 1);
+    frame.width = fb->width;
+    frame.height = fb->height;
+
+    TEST_CHECK(frame.len == (size_t) (_TEST_REPLAY_BENCH_BYTES + i));
+    TEST_CHECK(_test_replay_send(&stats, fds, &frame) == 0);
+
+    t2 = test_now_us();
+
+    TEST_CHECK(camwebsrv_seqfile_append(sf, &frame) == ESP_OK);
+
+    t3 = test_now_us();
+
+    TEST_CHECK(camwebsrv_replay_dispose(rep, fb) == ESP_OK);
+
+    *grab_us += t1 - t0;
+    *send_us += t2 - t1;
+    *write_us += t3 - t2;
+  }
+
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+  TEST_CHECK(camwebsrv_replay_destroy(&rep) == ESP_OK);
+
+  close(fds[0]);
+  close(fds[1]);
+
+  // everything went out, and the sequence reads back whole
+
+  TEST_CHECK(stats.bsent > (uint64_t) _TEST_REPLAY_BENCH_FRAMES * _TEST_REPLAY_BENCH_BYTES);
+  TEST_CHECK(camwebsrv_seqfile_load(path, &header, &index, &count) == ESP_OK);
+  TEST_CHECK(count == _TEST_REPLAY_BENCH_FRAMES);
+  TEST_CHECK(index[count - 1].len == _TEST_REPLAY_BENCH_BYTES + count - 1);
+
+  free(index);
+
+  return 0;
+}
+
+static int _test_replay_send(camwebsrv_ssock_stats_t *stats, int *fds, const camwebsrv_camera_frame_t *frame)
+{
+  char buf[CAMWEBSRV_FRAMEHDR_LEN];
+  uint8_t drain[16384];
+  struct iovec iov[2];
+  const char *hdr;
+  size_t hlen;
+  size_t off;
+  ssize_t rv;
+  int iovcnt;
+
+  hlen = camwebsrv_framehdr_part(buf, frame, &hdr);
+  off = 0;
+
+  // as the streaming task does it: send what the socket takes, laying the
+  // rest out afresh each time; the client end reads as fast as it can
+
+  while (off < hlen + frame->len)
+  {
+    if (off < hlen)
+    {
+      iov[0].iov_base = (void *) (hdr + off);
+      iov[0].iov_len = hlen - off;
+      iov[1].iov_base = (void *) frame->buf;
+      iov[1].iov_len = frame->len;
+      iovcnt = 2;
+    }
+    else
+    {
+      iov[0].iov_base = (void *) (frame->buf + (off - hlen));
+      iov[0].iov_len = frame->len - (off - hlen);
+      iovcnt = 1;
+    }
+
+    rv = camwebsrv_ssock_send(stats, fds[0], iov, iovcnt);
+
+    if (rv < 0)
+    {
+      return 1;
+    }
+
+    off = off + rv;
+
+    while (read(fds[1], drain, sizeof(drain)) > 0);
+  }
+
+  camwebsrv_ssock_frame(stats, frame->seq - 1, frame->seq);
+
+  return 0;
+}
+
+static size_t _test_replay_jpeg(uint8_t *buf, size_t len, uint16_t width, uint16_t height)
+{
+  static const uint8_t sof[] = { 0xFF, 0xD8, 0xFF, 0xC0, 0x00, 0x11, 0x08 };
+
+  // enough of a jpeg for its size to be read off it; the rest of the
+  // buffer is left as it was
+
+  memcpy(buf, sof, sizeof(sof));
+
+  buf[7] = height >> 8;
+  buf[8] = height & 0xFF;
+  buf[9] = width >> 8;
+  buf[10] = width & 0xFF;
+
+  return len;
+}
+
+static int _test_replay_file(const char *dir, const char *name, const uint8_t *buf, size_t len)
+{
+  char path[512];
+  int fd;
+  ssize_t n;
+
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+  if (fd < 0)
+  {
+    return 1;
+  }
+
+  n = write(fd, buf, len);
+
+  close(fd);
+
+  return n == (ssize_t) len ? 0 : 1;
+}
+
+static int _test_replay_seq(const char *dir, const char *name, int count, size_t len)
+{
+  char path[512];
+  camwebsrv_camera_frame_t frame;
+  camwebsrv_seqfile_t sf;
+  uint8_t *buf;
+  int i;
+
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+  buf = (uint8_t *) malloc(len + count);
+
+  if (buf == NULL)
+  {
+    return 1;
+  }
+
+  if (camwebsrv_seqfile_open(&sf, path, PIXFORMAT_JPEG, FRAMESIZE_VGA, count, 0) != ESP_OK)
+  {
+    free(buf);
+    return 1;
+  }
+
+  // frame i is len + i bytes of the test data from i on
+
+  for (i = 0; i < count; i++)
+  {
+    memset(&frame, 0x00, sizeof(frame));
+    memcpy(buf, _test_replay_data + (i % 64), len + i);
+
+    frame.buf = buf;
+    frame.len = len + i;
+    frame.tstamp = 1000000 + (int64_t) i * 40000;
+    frame.seq = (uint32_t) (i + 1);
+    frame.width = 640;
+    frame.height = 480;
+
+    if (camwebsrv_seqfile_append(sf, &frame) != ESP_OK)
+    {
+      break;
+    }
+  }
+
+  free(buf);
+
+  return camwebsrv_seqfile_close(&sf) == ESP_OK && i == count ? 0 : 1;
+}
+
+static void _test_replay_path(char *path, size_t size, const char *dir, const char *name)
+{
+  if (name == NULL)
+  {
+    snprintf(path, size, "%s/%s", _test_replay_dir, dir);
+  }
+  else
+  {
+    snprintf(path, size, "%s/%s/%s", _test_replay_dir, dir, name);
+  }
+}
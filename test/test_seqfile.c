@@ -0,0 +1,612 @@
+// 2026-10-16 test_seqfile.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "seqfile.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <esp_rom_crc.h>
+#include <esp_vfs_fat.h>
+
+#define _TEST_SEQFILE_FRAMES 3
+#define _TEST_SEQFILE_BENCH_FRAMES 200
+#define _TEST_SEQFILE_BENCH_BYTES 60000
+
+// a sector device backed by a file, counting the sectors written to it and
+// the writes they took
+
+typedef struct
+{
+  int fd;
+  size_t written;
+  size_t calls;
+} _test_seqfile_fake_t;
+
+static const size_t _test_seqfile_lens[_TEST_SEQFILE_FRAMES] = { 100, 600, 20000 };
+
+static char _test_seqfile_dir[] = "/tmp/camwebsrv_test_XXXXXX";
+static uint8_t *_test_seqfile_data[_TEST_SEQFILE_FRAMES];
+static camwebsrv_camera_frame_t _test_seqfile_frames[_TEST_SEQFILE_FRAMES];
+
+static int _test_seqfile_blk(void);
+static int _test_seqfile_blk_small(void);
+static int _test_seqfile_blk_full(void);
+static int _test_seqfile_blk_path(void);
+static int _test_seqfile_file(void);
+static int _test_seqfile_file_noreserve(void);
+static int _test_seqfile_read(void);
+static int _test_seqfile_bench(void);
+static esp_err_t _test_seqfile_fake_write(void *ctx, const void *buf, size_t sector, size_t count);
+static int _test_seqfile_fake_open(_test_seqfile_fake_t *fake, camwebsrv_seqfile_blkdev_t *blk, const char *name, size_t sectors);
+static uint8_t *_test_seqfile_load(const char *path, size_t *len);
+static int _test_seqfile_check(const uint8_t *seq, size_t len, uint32_t count);
+static void _test_seqfile_path(char *path, size_t size, const char *name);
+
+int main(void)
+{
+  char cmd[256];
+  int failed = 0;
+  size_t i;
+  size_t j;
+
+  if (mkdtemp(_test_seqfile_dir) == NULL)
+  {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  for (i = 0; i < _TEST_SEQFILE_FRAMES; i++)
+  {
+    _test_seqfile_data[i] = (uint8_t *) malloc(_test_seqfile_lens[i]);
+
+    for (j = 0; j < _test_seqfile_lens[i]; j++)
+    {
+      _test_seqfile_data[i][j] = (uint8_t) (j * 7 + i);
+    }
+
+    _test_seqfile_frames[i].buf = _test_seqfile_data[i];
+    _test_seqfile_frames[i].len = _test_seqfile_lens[i];
+    _test_seqfile_frames[i].tstamp = 1000000 + i * 33333;
+    _test_seqfile_frames[i].seq = 10 + i;
+    _test_seqfile_frames[i].width = 800;
+    _test_seqfile_frames[i].height = 600;
+  }
+
+  TEST_RUN(_test_seqfile_blk);
+  TEST_RUN(_test_seqfile_blk_small);
+  TEST_RUN(_test_seqfile_blk_full);
+  TEST_RUN(_test_seqfile_blk_path);
+  TEST_RUN(_test_seqfile_file);
+  TEST_RUN(_test_seqfile_file_noreserve);
+  TEST_RUN(_test_seqfile_read);
+  TEST_RUN(_test_seqfile_bench);
+
+  for (i = 0; i < _TEST_SEQFILE_FRAMES; i++)
+  {
+    free(_test_seqfile_data[i]);
+  }
+
+  // leave what failed behind to look at
+
+  if (failed == 0)
+  {
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", _test_seqfile_dir);
+    system(cmd);
+  }
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_seqfile_blk(void)
+{
+  _test_seqfile_fake_t fake;
+  camwebsrv_seqfile_blkdev_t blk;
+  camwebsrv_seqfile_t sf;
+  camwebsrv_seqfile_super_t super;
+  uint64_t reserve;
+  uint8_t *dev;
+  size_t len;
+  size_t i;
+
+  TEST_CHECK(_test_seqfile_fake_open(&fake, &blk, "blk", 256) == 0);
+
+  reserve = camwebsrv_seqfile_estimate(_test_seqfile_lens[_TEST_SEQFILE_FRAMES - 1], _TEST_SEQFILE_FRAMES);
+
+  TEST_CHECK(camwebsrv_seqfile_open_blk(&sf, &blk, "/sdcard/seq/blk.cwsq", 4, 9, _TEST_SEQFILE_FRAMES, reserve) == ESP_OK);
+
+  // the super block goes out first, marked unfinished
+
+  TEST_CHECK(pread(fake.fd, &super, sizeof(super), 0) == sizeof(super));
+  TEST_CHECK(memcmp(super.magic, CAMWEBSRV_SEQFILE_MAGIC_SUPER, 4) == 0);
+  TEST_CHECK(super.length == 0);
+
+  for (i = 0; i < _TEST_SEQFILE_FRAMES; i++)
+  {
+    TEST_CHECK(camwebsrv_seqfile_append(sf, &_test_seqfile_frames[i]) == ESP_OK);
+  }
+
+  TEST_CHECK(camwebsrv_seqfile_append(sf, &_test_seqfile_frames[0]) == ESP_ERR_INVALID_SIZE);
+
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+  TEST_CHECK(sf == NULL);
+
+  dev = _test_seqfile_load("blk", &len);
+
+  TEST_CHECK(dev != NULL);
+
+  memcpy(&super, dev, sizeof(super));
+
+  TEST_CHECK(memcmp(super.magic, CAMWEBSRV_SEQFILE_MAGIC_SUPER, 4) == 0);
+  TEST_CHECK(super.version == CAMWEBSRV_SEQFILE_VERSION);
+  TEST_CHECK(super.count == _TEST_SEQFILE_FRAMES);
+  TEST_CHECK(strcmp(super.path, "/sdcard/seq/blk.cwsq") == 0);
+
+  // the sequence starts one sector in, and is laid out as it would be in a
+  // file; everything up to its end went out, and nothing past that
+
+  TEST_CHECK(super.length <= len - CAMWEBSRV_SEQFILE_ALIGN);
+  TEST_CHECK(fake.written == 1 + (super.length + CAMWEBSRV_SEQFILE_ALIGN - 1) / CAMWEBSRV_SEQFILE_ALIGN + 1);
+  TEST_CHECK(_test_seqfile_check(dev + CAMWEBSRV_SEQFILE_ALIGN, super.length, _TEST_SEQFILE_FRAMES) == 0);
+
+  free(dev);
+  close(fake.fd);
+
+  return 0;
+}
+
+static int _test_seqfile_blk_small(void)
+{
+  _test_seqfile_fake_t fake;
+  camwebsrv_seqfile_blkdev_t blk;
+  camwebsrv_seqfile_t sf = NULL;
+
+  TEST_CHECK(_test_seqfile_fake_open(&fake, &blk, "small", 8) == 0);
+
+  // seven sectors past the super block
+
+  TEST_CHECK(camwebsrv_seqfile_open_blk(&sf, &blk, "/sdcard/small", 4, 9, 1, 8 * CAMWEBSRV_SEQFILE_ALIGN) == ESP_ERR_NO_MEM);
+  TEST_CHECK(sf == NULL);
+  TEST_CHECK(fake.written == 0);
+
+  TEST_CHECK(camwebsrv_seqfile_open_blk(&sf, &blk, "/sdcard/small", 4, 9, 1, 7 * CAMWEBSRV_SEQFILE_ALIGN) == ESP_OK);
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+
+  close(fake.fd);
+
+  return 0;
+}
+
+static int _test_seqfile_blk_full(void)
+{
+  _test_seqfile_fake_t fake;
+  camwebsrv_seqfile_blkdev_t blk;
+  camwebsrv_seqfile_t sf;
+  esp_err_t rv;
+  size_t i;
+
+  // without a reserve, running off the end shows up as a failed append
+
+  TEST_CHECK(_test_seqfile_fake_open(&fake, &blk, "full", 48) == 0);
+  TEST_CHECK(camwebsrv_seqfile_open_blk(&sf, &blk, "/sdcard/full", 4, 9, 8, 0) == ESP_OK);
+
+  rv = ESP_OK;
+
+  for (i = 0; i < 8 && rv == ESP_OK; i++)
+  {
+    rv = camwebsrv_seqfile_append(sf, &_test_seqfile_frames[_TEST_SEQFILE_FRAMES - 1]);
+  }
+
+  TEST_CHECK(rv == ESP_ERR_INVALID_SIZE);
+  TEST_CHECK(fake.written <= 48);
+
+  camwebsrv_seqfile_close(&sf);
+
+  TEST_CHECK(sf == NULL);
+
+  close(fake.fd);
+
+  return 0;
+}
+
+static int _test_seqfile_blk_path(void)
+{
+  _test_seqfile_fake_t fake;
+  camwebsrv_seqfile_blkdev_t blk;
+  camwebsrv_seqfile_t sf = NULL;
+  camwebsrv_seqfile_super_t super;
+  char path[CAMWEBSRV_SEQFILE_PATH_LEN + 1];
+
+  TEST_CHECK(_test_seqfile_fake_open(&fake, &blk, "path", 64) == 0);
+
+  // one too long for the super block is turned away before anything is
+  // written, rather than cut short
+
+  memset(path, 'p', CAMWEBSRV_SEQFILE_PATH_LEN);
+  path[0] = '/';
+  path[CAMWEBSRV_SEQFILE_PATH_LEN] = '\0';
+
+  TEST_CHECK(camwebsrv_seqfile_open_blk(&sf, &blk, path, 4, 9, 1, 0) == ESP_ERR_INVALID_SIZE);
+  TEST_CHECK(sf == NULL);
+  TEST_CHECK(fake.written == 0);
+
+  // the longest that fits goes in whole
+
+  path[CAMWEBSRV_SEQFILE_PATH_LEN - 1] = '\0';
+
+  TEST_CHECK(camwebsrv_seqfile_open_blk(&sf, &blk, path, 4, 9, 1, 0) == ESP_OK);
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+
+  TEST_CHECK(pread(fake.fd, &super, sizeof(super), 0) == sizeof(super));
+  TEST_CHECK(super.path[CAMWEBSRV_SEQFILE_PATH_LEN - 1] == '\0');
+  TEST_CHECK(strcmp(super.path, path) == 0);
+
+  close(fake.fd);
+
+  return 0;
+}
+
+static int _test_seqfile_file(void)
+{
+  camwebsrv_seqfile_t sf;
+  struct stat st;
+  char path[256];
+  char name[64];
+  char cmd[1024];
+  uint64_t reserve;
+  uint8_t *seq;
+  size_t len;
+  size_t i;
+
+  _test_seqfile_path(path, sizeof(path), "file.cwsq");
+
+  shim_vfs_fat_free = UINT64_MAX;
+  reserve = camwebsrv_seqfile_estimate(_test_seqfile_lens[_TEST_SEQFILE_FRAMES - 1], _TEST_SEQFILE_FRAMES);
+
+  // laid out in full up front, then trimmed to what was written
+
+  TEST_CHECK(camwebsrv_seqfile_open(&sf, path, 4, 9, _TEST_SEQFILE_FRAMES, reserve) == ESP_OK);
+  TEST_CHECK(stat(path, &st) == 0 && (uint64_t) st.st_size == reserve);
+
+  for (i = 0; i < _TEST_SEQFILE_FRAMES; i++)
+  {
+    TEST_CHECK(camwebsrv_seqfile_append(sf, &_test_seqfile_frames[i]) == ESP_OK);
+  }
+
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+
+  seq = _test_seqfile_load("file.cwsq", &len);
+
+  TEST_CHECK(seq != NULL);
+  TEST_CHECK(len < reserve);
+  TEST_CHECK(_test_seqfile_check(seq, len, _TEST_SEQFILE_FRAMES) == 0);
+
+  free(seq);
+
+  // and bash/seqextract.sh splits it back into the frames that went in
+
+  TEST_CHECK(snprintf(cmd, sizeof(cmd), "bash %s %s %s/file >/dev/null", CAMWEBSRV_TEST_SEQEXTRACT, path, _test_seqfile_dir) < (int) sizeof(cmd));
+  TEST_CHECK(system(cmd) == 0);
+
+  for (i = 0; i < _TEST_SEQFILE_FRAMES; i++)
+  {
+    snprintf(name, sizeof(name), "file/%06u-%lld.jpg", (unsigned) i, (long long) (_test_seqfile_frames[i].tstamp / 1000));
+
+    seq = _test_seqfile_load(name, &len);
+
+    TEST_CHECK(seq != NULL);
+    TEST_CHECK(len == _test_seqfile_frames[i].len);
+    TEST_CHECK(memcmp(seq, _test_seqfile_frames[i].buf, len) == 0);
+
+    free(seq);
+  }
+
+  return 0;
+}
+
+static int _test_seqfile_file_noreserve(void)
+{
+  camwebsrv_seqfile_t sf;
+  char path[256];
+  uint8_t *seq;
+  size_t len;
+
+  _test_seqfile_path(path, sizeof(path), "noreserve.cwsq");
+
+  // a reserve the card hasn't room for is only a warning; the file then
+  // grows as it is written
+
+  shim_vfs_fat_free = CAMWEBSRV_SEQFILE_ALIGN;
+
+  TEST_CHECK(camwebsrv_seqfile_open(&sf, path, 4, 9, 1, 1024 * 1024) == ESP_OK);
+  TEST_CHECK(camwebsrv_seqfile_append(sf, &_test_seqfile_frames[1]) == ESP_OK);
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+
+  shim_vfs_fat_free = UINT64_MAX;
+
+  seq = _test_seqfile_load("noreserve.cwsq", &len);
+
+  TEST_CHECK(seq != NULL);
+  TEST_CHECK(_test_seqfile_check(seq, len, 1) == 0);
+
+  free(seq);
+
+  return 0;
+}
+
+static int _test_seqfile_read(void)
+{
+  camwebsrv_seqfile_header_t header;
+  camwebsrv_seqfile_record_t record;
+  camwebsrv_seqfile_entry_t *index;
+  camwebsrv_seqfile_t sf;
+  struct stat st;
+  char path[256];
+  uint32_t count;
+  uint8_t *buf;
+  uint8_t b;
+  size_t i;
+  int fd;
+
+  _test_seqfile_path(path, sizeof(path), "read.cwsq");
+
+  TEST_CHECK(camwebsrv_seqfile_open(&sf, path, 4, 9, _TEST_SEQFILE_FRAMES, 0) == ESP_OK);
+
+  for (i = 0; i < _TEST_SEQFILE_FRAMES; i++)
+  {
+    TEST_CHECK(camwebsrv_seqfile_append(sf, &_test_seqfile_frames[i]) == ESP_OK);
+  }
+
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+
+  // what went in comes back out, frame by frame
+
+  TEST_CHECK(camwebsrv_seqfile_load(path, &header, &index, &count) == ESP_OK);
+  TEST_CHECK(header.pixformat == 4);
+  TEST_CHECK(header.framesize == 9);
+  TEST_CHECK(count == _TEST_SEQFILE_FRAMES);
+
+  buf = (uint8_t *) malloc(_test_seqfile_lens[_TEST_SEQFILE_FRAMES - 1]);
+
+  TEST_CHECK(buf != NULL);
+
+  for (i = 0; i < count; i++)
+  {
+    TEST_CHECK(index[i].len == _test_seqfile_frames[i].len);
+    TEST_CHECK(index[i].tstamp == _test_seqfile_frames[i].tstamp);
+    TEST_CHECK(camwebsrv_seqfile_read(path, &index[i], &record, buf) == ESP_OK);
+    TEST_CHECK(record.seq == _test_seqfile_frames[i].seq);
+    TEST_CHECK(record.width == 800 && record.height == 600);
+    TEST_CHECK(memcmp(buf, _test_seqfile_frames[i].buf, index[i].len) == 0);
+  }
+
+  // a flipped byte fails the crc
+
+  fd = open(path, O_RDWR);
+  b = 0xA5;
+
+  TEST_CHECK(fd >= 0);
+  TEST_CHECK(pwrite(fd, &b, 1, (off_t) (index[2].offset + sizeof(record) + 10000)) == 1);
+
+  close(fd);
+
+  TEST_CHECK(camwebsrv_seqfile_read(path, &index[2], &record, buf) == ESP_ERR_INVALID_CRC);
+  TEST_CHECK(camwebsrv_seqfile_read(path, &index[1], &record, buf) == ESP_OK);
+
+  free(buf);
+  free(index);
+
+  // and without the footer, there is no index to load
+
+  TEST_CHECK(stat(path, &st) == 0);
+  TEST_CHECK(truncate(path, st.st_size - sizeof(camwebsrv_seqfile_footer_t)) == 0);
+  TEST_CHECK(camwebsrv_seqfile_load(path, &header, &index, &count) == ESP_ERR_NOT_FOUND);
+
+  return 0;
+}
+
+static int _test_seqfile_bench(void)
+{
+  _test_seqfile_fake_t fake;
+  camwebsrv_seqfile_blkdev_t blk;
+  camwebsrv_seqfile_t sf;
+  camwebsrv_camera_frame_t frame;
+  uint8_t *data;
+  char path[256];
+  uint64_t reserve;
+  int64_t t0;
+  int64_t tblk;
+  int64_t tfile;
+  size_t calls;
+  uint32_t i;
+
+  // the same sequence both ways; on the host both end up in the page
+  // cache, so this compares what each path costs on the way there, and how
+  // many writes it takes, rather than what a card would do with them
+
+  data = (uint8_t *) malloc(_TEST_SEQFILE_BENCH_BYTES);
+
+  TEST_CHECK(data != NULL);
+
+  memset(data, 0x5a, _TEST_SEQFILE_BENCH_BYTES);
+  memset(&frame, 0x00, sizeof(frame));
+  frame.buf = data;
+  frame.len = _TEST_SEQFILE_BENCH_BYTES;
+
+  reserve = camwebsrv_seqfile_estimate(_TEST_SEQFILE_BENCH_BYTES, _TEST_SEQFILE_BENCH_FRAMES);
+
+  TEST_CHECK(_test_seqfile_fake_open(&fake, &blk, "bench.blk", 2 + reserve / CAMWEBSRV_SEQFILE_ALIGN) == 0);
+
+  t0 = test_now_us();
+
+  TEST_CHECK(camwebsrv_seqfile_open_blk(&sf, &blk, "/sdcard/bench.cwsq", 4, 9, _TEST_SEQFILE_BENCH_FRAMES, reserve) == ESP_OK);
+
+  for (i = 0; i < _TEST_SEQFILE_BENCH_FRAMES; i++)
+  {
+    frame.seq = i;
+    TEST_CHECK(camwebsrv_seqfile_append(sf, &frame) == ESP_OK);
+  }
+
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+
+  tblk = test_now_us() - t0;
+  calls = fake.calls;
+
+  close(fake.fd);
+
+  _test_seqfile_path(path, sizeof(path), "bench.cwsq");
+
+  t0 = test_now_us();
+
+  TEST_CHECK(camwebsrv_seqfile_open(&sf, path, 4, 9, _TEST_SEQFILE_BENCH_FRAMES, reserve) == ESP_OK);
+
+  for (i = 0; i < _TEST_SEQFILE_BENCH_FRAMES; i++)
+  {
+    frame.seq = i;
+    TEST_CHECK(camwebsrv_seqfile_append(sf, &frame) == ESP_OK);
+  }
+
+  TEST_CHECK(camwebsrv_seqfile_close(&sf) == ESP_OK);
+
+  tfile = test_now_us() - t0;
+
+  free(data);
+
+  printf("seqfile: %d frames of %d bytes: block device %lld us in %u writes, file %lld us\n", _TEST_SEQFILE_BENCH_FRAMES, _TEST_SEQFILE_BENCH_BYTES, (long long) tblk, (unsigned) calls, (long long) tfile);
+
+  return 0;
+}
+
+static esp_err_t _test_seqfile_fake_write(void *ctx, const void *buf, size_t sector, size_t count)
+{
+  _test_seqfile_fake_t *fake = (_test_seqfile_fake_t *) ctx;
+  size_t len = count * CAMWEBSRV_SEQFILE_ALIGN;
+
+  if (pwrite(fake->fd, buf, len, (off_t) sector * CAMWEBSRV_SEQFILE_ALIGN) != (ssize_t) len)
+  {
+    return ESP_FAIL;
+  }
+
+  fake->written += count;
+  fake->calls++;
+
+  return ESP_OK;
+}
+
+static int _test_seqfile_fake_open(_test_seqfile_fake_t *fake, camwebsrv_seqfile_blkdev_t *blk, const char *name, size_t sectors)
+{
+  char path[256];
+
+  _test_seqfile_path(path, sizeof(path), name);
+
+  fake->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  fake->written = 0;
+  fake->calls = 0;
+
+  TEST_CHECK(fake->fd >= 0);
+  TEST_CHECK(ftruncate(fake->fd, (off_t) sectors * CAMWEBSRV_SEQFILE_ALIGN) == 0);
+
+  blk->ctx = fake;
+  blk->sectors = sectors;
+  blk->write = _test_seqfile_fake_write;
+
+  return 0;
+}
+
+static uint8_t *_test_seqfile_load(const char *name, size_t *len)
+{
+  char path[256];
+  struct stat st;
+  uint8_t *buf;
+  int fd;
+
+  _test_seqfile_path(path, sizeof(path), name);
+
+  fd = open(path, O_RDONLY);
+
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    return NULL;
+  }
+
+  buf = (uint8_t *) malloc(st.st_size);
+
+  if (buf == NULL || pread(fd, buf, st.st_size, 0) != st.st_size)
+  {
+    free(buf);
+    close(fd);
+    return NULL;
+  }
+
+  close(fd);
+
+  *len = st.st_size;
+
+  return buf;
+}
+
+static int _test_seqfile_check(const uint8_t *seq, size_t len, uint32_t count)
+{
+  camwebsrv_seqfile_header_t header;
+  camwebsrv_seqfile_footer_t footer;
+  camwebsrv_seqfile_entry_t entry;
+  camwebsrv_seqfile_record_t record;
+  const camwebsrv_camera_frame_t *frame;
+  uint32_t i;
+
+  TEST_CHECK(len >= CAMWEBSRV_SEQFILE_ALIGN + sizeof(footer));
+
+  memcpy(&header, seq, sizeof(header));
+
+  TEST_CHECK(memcmp(header.magic, CAMWEBSRV_SEQFILE_MAGIC_HEADER, 4) == 0);
+  TEST_CHECK(header.version == CAMWEBSRV_SEQFILE_VERSION);
+  TEST_CHECK(header.align == CAMWEBSRV_SEQFILE_ALIGN);
+  TEST_CHECK(header.pixformat == 4 && header.framesize == 9);
+
+  // the footer is last, and points back at the index in front of it
+
+  memcpy(&footer, seq + len - sizeof(footer), sizeof(footer));
+
+  TEST_CHECK(memcmp(footer.magic, CAMWEBSRV_SEQFILE_MAGIC_FOOTER, 4) == 0);
+  TEST_CHECK(footer.count == count);
+  TEST_CHECK(footer.offset + count * sizeof(entry) + sizeof(footer) == len);
+
+  for (i = 0; i < count; i++)
+  {
+    memcpy(&entry, seq + footer.offset + i * sizeof(entry), sizeof(entry));
+
+    TEST_CHECK(entry.offset % CAMWEBSRV_SEQFILE_ALIGN == 0);
+    TEST_CHECK(entry.number == i);
+
+    memcpy(&record, seq + entry.offset, sizeof(record));
+
+    // appended in order, except in the one-frame test, which used frame 1
+
+    frame = count == 1 ? &_test_seqfile_frames[1] : &_test_seqfile_frames[i];
+
+    TEST_CHECK(memcmp(record.magic, CAMWEBSRV_SEQFILE_MAGIC_RECORD, 4) == 0);
+    TEST_CHECK(record.number == i && entry.number == i);
+    TEST_CHECK(record.len == frame->len && entry.len == frame->len);
+    TEST_CHECK(record.tstamp == frame->tstamp && entry.tstamp == frame->tstamp);
+    TEST_CHECK(record.seq == frame->seq && entry.seq == frame->seq);
+    TEST_CHECK(record.width == frame->width && record.height == frame->height);
+    TEST_CHECK(record.crc == esp_rom_crc32_le(0, frame->buf, frame->len) && entry.crc == record.crc);
+
+    // the frame follows its record header without a break
+
+    TEST_CHECK(entry.offset + sizeof(record) + frame->len <= footer.offset);
+    TEST_CHECK(memcmp(seq + entry.offset + sizeof(record), frame->buf, frame->len) == 0);
+  }
+
+  return 0;
+}
+
+static void _test_seqfile_path(char *path, size_t size, const char *name)
+{
+  snprintf(path, size, "%s/%s", _test_seqfile_dir, name);
+}
@@ -0,0 +1,381 @@
+// 2026-10-16 test_seqwriter.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "config.h"
+#include "seqfile.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+#include <sensor.h>
+
+// a model of the sequence capture loop in seqcap.c and its writer task,
+// run against a virtual frame source and a sink throttled to a given card
+// speed. the loop and the writer need freertos, so they are modelled here
+// as they behave:
+//
+//   - seqcap_frame_after() gets the first frame exposed after it asks,
+//     which is there once it has been read out
+//   - seqcap_writer_push() blocks while CAMWEBSRV_SEQCAP_QUEUE_LEN frames
+//     are still waiting for the writer, and counts that as the queue being
+//     full
+//   - the writer appends each frame to the sequence in order; how long
+//     that takes comes from running seqfile.c itself against the sink
+//
+// the old loop, which wrote each frame before asking for the next, is
+// modelled alongside for comparison
+
+#define _TEST_SEQWRITER_SENSOR (1000000 / 25)
+#define _TEST_SEQWRITER_WIDTH 640
+#define _TEST_SEQWRITER_HEIGHT 480
+#define _TEST_SEQWRITER_BYTES (_TEST_SEQWRITER_WIDTH * _TEST_SEQWRITER_HEIGHT / CAMWEBSRV_SEQCAP_JPEG_DIV)
+#define _TEST_SEQWRITER_FRAMES 150
+#define _TEST_SEQWRITER_CARDS (sizeof(_test_seqwriter_cards) / sizeof(_test_seqwriter_cards[0]))
+#define _TEST_SEQWRITER_SECTORS (1 << 22)
+
+// a card: how fast it takes data, what each write costs on top, and the
+// odd write held up by its housekeeping
+
+typedef struct
+{
+  const char *name;
+  uint32_t bytes_per_s;
+  int64_t call_us;
+  int stall_every;
+  int64_t stall_us;
+} _test_seqwriter_card_t;
+
+typedef struct
+{
+  const _test_seqwriter_card_t *card;
+  uint32_t calls;
+  size_t sectors;
+  int64_t us;
+} _test_seqwriter_sink_t;
+
+typedef struct
+{
+  int count;
+  int64_t write_avg;
+  int64_t elapsed;
+  uint32_t qfull;
+  int64_t qfull_us;
+  double fps;
+} _test_seqwriter_stats_t;
+
+static const _test_seqwriter_card_t _test_seqwriter_cards[] =
+{
+  { "20MB/s", 20000000, 500, 0, 0 },
+  { "10MB/s", 10000000, 1000, 0, 0 },
+  { "4MB/s", 4000000, 1500, 0, 0 },
+  { "10MB/s+", 10000000, 1000, 100, 250000 },
+  { "1.5MB/s", 1500000, 2000, 0, 0 },
+  { "1MB/s", 1000000, 3000, 0, 0 }
+};
+
+static uint8_t _test_seqwriter_data[_TEST_SEQWRITER_BYTES * 2];
+static int64_t _test_seqwriter_us[_TEST_SEQWRITER_CARDS][_TEST_SEQWRITER_FRAMES];
+
+static int _test_seqwriter_fast(void);
+static int _test_seqwriter_stalls(void);
+static int _test_seqwriter_slow(void);
+static int _test_seqwriter_compare(void);
+static int _test_seqwriter_run(size_t card, _test_seqwriter_stats_t *piped, _test_seqwriter_stats_t *serial);
+static int _test_seqwriter_write(const _test_seqwriter_card_t *card, int64_t *us);
+static void _test_seqwriter_piped(const int64_t *us, _test_seqwriter_stats_t *stats);
+static void _test_seqwriter_serial(const int64_t *us, _test_seqwriter_stats_t *stats);
+static int64_t _test_seqwriter_frame(int64_t after);
+static esp_err_t _test_seqwriter_sink_write(void *ctx, const void *buf, size_t sector, size_t count);
+static uint32_t _test_seqwriter_rand(uint32_t x);
+
+int main(void)
+{
+  int failed = 0;
+
+  for (size_t i = 0; i < sizeof(_test_seqwriter_data); i++)
+  {
+    _test_seqwriter_data[i] = (uint8_t) _test_seqwriter_rand((uint32_t) i);
+  }
+
+  // what each frame takes to write on each card, worked out once
+
+  for (size_t i = 0; i < _TEST_SEQWRITER_CARDS; i++)
+  {
+    if (_test_seqwriter_write(&_test_seqwriter_cards[i], _test_seqwriter_us[i]) != 0)
+    {
+      printf("%s: seqfile write failed\n", _test_seqwriter_cards[i].name);
+      return 1;
+    }
+  }
+
+  TEST_RUN(_test_seqwriter_fast);
+  TEST_RUN(_test_seqwriter_stalls);
+  TEST_RUN(_test_seqwriter_slow);
+  TEST_RUN(_test_seqwriter_compare);
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_seqwriter_fast(void)
+{
+  _test_seqwriter_stats_t piped;
+  _test_seqwriter_stats_t serial;
+
+  // a card that writes a frame in less than a sensor frame keeps up: the
+  // sensor sets the rate, and the queue never fills; the old loop missed
+  // every other frame while it wrote
+
+  for (size_t n = 0; n < 3; n++)
+  {
+    TEST_CHECK(_test_seqwriter_run(n, &piped, &serial) == 0);
+    TEST_CHECK(piped.write_avg < _TEST_SEQWRITER_SENSOR);
+    TEST_CHECK(piped.qfull == 0);
+    TEST_CHECK(piped.fps > 1000000.0 / _TEST_SEQWRITER_SENSOR * 0.99);
+    TEST_CHECK(serial.fps < 1000000.0 / (2 * _TEST_SEQWRITER_SENSOR) * 1.01);
+  }
+
+  return 0;
+}
+
+static int _test_seqwriter_stalls(void)
+{
+  _test_seqwriter_stats_t piped;
+  _test_seqwriter_stats_t serial;
+
+  // a write held up for a few frames fills the queue, which is reported
+  // and waited out; every frame still gets written
+
+  TEST_CHECK(_test_seqwriter_run(3, &piped, &serial) == 0);
+  TEST_CHECK(piped.count == _TEST_SEQWRITER_FRAMES);
+  TEST_CHECK(piped.qfull > 0);
+  TEST_CHECK(piped.qfull_us > 0);
+  TEST_CHECK(piped.fps > serial.fps);
+
+  return 0;
+}
+
+static int _test_seqwriter_slow(void)
+{
+  _test_seqwriter_stats_t piped;
+  _test_seqwriter_stats_t serial;
+
+  // a card slower than the sensor sets the rate instead; the queue is
+  // full whenever the writer falls a frame behind, and the old loop lost
+  // the readout on top
+
+  for (size_t n = 4; n < 6; n++)
+  {
+    TEST_CHECK(_test_seqwriter_run(n, &piped, &serial) == 0);
+    TEST_CHECK(piped.write_avg > _TEST_SEQWRITER_SENSOR);
+    TEST_CHECK(piped.qfull > 0);
+    TEST_CHECK(piped.fps > 1000000.0 / piped.write_avg * 0.97);
+    TEST_CHECK(piped.fps < 1000000.0 / piped.write_avg * 1.03);
+    TEST_CHECK(serial.fps < 1000000.0 / (piped.write_avg + _TEST_SEQWRITER_SENSOR) * 1.01);
+  }
+
+  return 0;
+}
+
+static int _test_seqwriter_compare(void)
+{
+  _test_seqwriter_stats_t piped;
+  _test_seqwriter_stats_t serial;
+  double bound;
+
+  printf("seqwriter: sensor %d fps, %d byte frames, queue %d, %d frames\n", 1000000 / _TEST_SEQWRITER_SENSOR, _TEST_SEQWRITER_BYTES, CAMWEBSRV_SEQCAP_QUEUE_LEN, _TEST_SEQWRITER_FRAMES);
+
+  for (size_t i = 0; i < _TEST_SEQWRITER_CARDS; i++)
+  {
+    TEST_CHECK(_test_seqwriter_run(i, &piped, &serial) == 0);
+
+    // 1/max(readout, write) is as good as it gets
+
+    bound = 1000000.0 / (double) (piped.write_avg > _TEST_SEQWRITER_SENSOR ? piped.write_avg : _TEST_SEQWRITER_SENSOR);
+
+    printf("  %-8s write %3" PRId64 " ms; queued: %5.2f fps, full %3" PRIu32 " times, %5" PRId64 " ms waiting; one at a time: %5.2f fps; bound %5.2f fps\n",
+      _test_seqwriter_cards[i].name,
+      piped.write_avg / 1000,
+      piped.fps,
+      piped.qfull,
+      piped.qfull_us / 1000,
+      serial.fps,
+      bound);
+
+    TEST_CHECK(piped.fps > serial.fps);
+    TEST_CHECK(piped.fps < bound * 1.01);
+  }
+
+  return 0;
+}
+
+static int _test_seqwriter_run(size_t card, _test_seqwriter_stats_t *piped, _test_seqwriter_stats_t *serial)
+{
+  if (card >= _TEST_SEQWRITER_CARDS)
+  {
+    return 1;
+  }
+
+  _test_seqwriter_piped(_test_seqwriter_us[card], piped);
+  _test_seqwriter_serial(_test_seqwriter_us[card], serial);
+
+  return 0;
+}
+
+static int _test_seqwriter_write(const _test_seqwriter_card_t *card, int64_t *us)
+{
+  _test_seqwriter_sink_t sink;
+  camwebsrv_seqfile_blkdev_t blk;
+  camwebsrv_camera_frame_t frame;
+  camwebsrv_seqfile_t sf;
+  int64_t before;
+
+  memset(&sink, 0x00, sizeof(sink));
+
+  sink.card = card;
+
+  blk.ctx = &sink;
+  blk.sectors = _TEST_SEQWRITER_SECTORS;
+  blk.write = _test_seqwriter_sink_write;
+
+  if (camwebsrv_seqfile_open_blk(&sf, &blk, "/sdcard/captures/test/test-VGA.seq", PIXFORMAT_JPEG, FRAMESIZE_VGA, _TEST_SEQWRITER_FRAMES, camwebsrv_seqfile_estimate(_TEST_SEQWRITER_BYTES, _TEST_SEQWRITER_FRAMES)) != ESP_OK)
+  {
+    return 1;
+  }
+
+  // jpeg frames come out a little bigger or smaller with the scene; what
+  // each append costs is whatever it made the sink take
+
+  for (int i = 0; i < _TEST_SEQWRITER_FRAMES; i++)
+  {
+    memset(&frame, 0x00, sizeof(frame));
+
+    frame.len = _TEST_SEQWRITER_BYTES * 4 / 5 + _test_seqwriter_rand(0x10000u + (uint32_t) i) % (_TEST_SEQWRITER_BYTES * 2 / 5);
+    frame.buf = _test_seqwriter_data + (i % 64);
+    frame.tstamp = (int64_t) i * _TEST_SEQWRITER_SENSOR;
+    frame.seq = (uint32_t) (i + 1);
+    frame.width = _TEST_SEQWRITER_WIDTH;
+    frame.height = _TEST_SEQWRITER_HEIGHT;
+
+    before = sink.us;
+
+    if (camwebsrv_seqfile_append(sf, &frame) != ESP_OK)
+    {
+      camwebsrv_seqfile_close(&sf);
+      return 1;
+    }
+
+    us[i] = sink.us - before;
+  }
+
+  if (camwebsrv_seqfile_close(&sf) != ESP_OK)
+  {
+    return 1;
+  }
+
+  // everything written went through the sink, each sector once
+
+  return sink.sectors >= (size_t) (camwebsrv_seqfile_estimate(_TEST_SEQWRITER_BYTES * 4 / 5, _TEST_SEQWRITER_FRAMES) / CAMWEBSRV_SEQFILE_ALIGN) ? 0 : 1;
+}
+
+static void _test_seqwriter_piped(const int64_t *us, _test_seqwriter_stats_t *stats)
+{
+  int64_t start[_TEST_SEQWRITER_FRAMES];
+  int64_t done;
+  int64_t t;
+
+  memset(stats, 0x00, sizeof(*stats));
+
+  t = 0;
+  done = 0;
+
+  for (int i = 0; i < _TEST_SEQWRITER_FRAMES; i++)
+  {
+    t = _test_seqwriter_frame(t);
+
+    // seqcap_writer_push(): waits for the writer to take the frame that
+    // is CAMWEBSRV_SEQCAP_QUEUE_LEN ahead of this one off the queue
+
+    if (i >= CAMWEBSRV_SEQCAP_QUEUE_LEN && start[i - CAMWEBSRV_SEQCAP_QUEUE_LEN] > t)
+    {
+      stats->qfull++;
+      stats->qfull_us += start[i - CAMWEBSRV_SEQCAP_QUEUE_LEN] - t;
+      t = start[i - CAMWEBSRV_SEQCAP_QUEUE_LEN];
+    }
+
+    // the writer starts on it once it is done with the one before
+
+    start[i] = done > t ? done : t;
+    done = start[i] + us[i];
+
+    stats->write_avg += us[i];
+    stats->count++;
+  }
+
+  // as seqcap_writer_finish() works it out, once the last one is written
+
+  stats->write_avg = stats->write_avg / stats->count;
+  stats->elapsed = done;
+  stats->fps = (double) stats->count * 1000000.0 / (double) stats->elapsed;
+}
+
+static void _test_seqwriter_serial(const int64_t *us, _test_seqwriter_stats_t *stats)
+{
+  int64_t t;
+
+  memset(stats, 0x00, sizeof(*stats));
+
+  t = 0;
+
+  for (int i = 0; i < _TEST_SEQWRITER_FRAMES; i++)
+  {
+    t = _test_seqwriter_frame(t) + us[i];
+
+    stats->write_avg += us[i];
+    stats->count++;
+  }
+
+  stats->write_avg = stats->write_avg / stats->count;
+  stats->elapsed = t;
+  stats->fps = (double) stats->count * 1000000.0 / (double) stats->elapsed;
+}
+
+static int64_t _test_seqwriter_frame(int64_t after)
+{
+  // the sensor runs free; the first frame exposed after asking starts at
+  // the next vsync, and is there a frame later
+
+  return ((after + _TEST_SEQWRITER_SENSOR - 1) / _TEST_SEQWRITER_SENSOR) * _TEST_SEQWRITER_SENSOR + _TEST_SEQWRITER_SENSOR;
+}
+
+static esp_err_t _test_seqwriter_sink_write(void *ctx, const void *buf, size_t sector, size_t count)
+{
+  _test_seqwriter_sink_t *sink = (_test_seqwriter_sink_t *) ctx;
+  const _test_seqwriter_card_t *card = sink->card;
+
+  // nothing is kept; each write just takes as long as the card would
+
+  sink->calls++;
+  sink->sectors = sink->sectors + count;
+  sink->us = sink->us + card->call_us + (int64_t) count * CAMWEBSRV_SEQFILE_ALIGN * 1000000 / card->bytes_per_s;
+
+  if (card->stall_every > 0 && (sink->calls % card->stall_every) == 0)
+  {
+    sink->us = sink->us + card->stall_us;
+  }
+
+  return ESP_OK;
+}
+
+static uint32_t _test_seqwriter_rand(uint32_t x)
+{
+  // the same frames every run
+
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+
+  return x;
+}
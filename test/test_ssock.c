@@ -0,0 +1,421 @@
+// 2026-10-16 test_ssock.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "config.h"
+#include "ssock.h"
+#include "vbytes.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <esp_timer.h>
+
+#define _TEST_SSOCK_STEPS_MAX 16
+#define _TEST_SSOCK_SINK_LEN 4096
+#define _TEST_SSOCK_BENCH_ROUNDS 1000000
+
+// a fake socket, linked in with --wrap=sendmsg: each call takes the next
+// step, which is either how many bytes to accept, or an errno to fail
+// with, and how long the call took; anything accepted is kept, to check
+// what went out and in what order; once the steps run out, it takes
+// everything
+
+typedef struct
+{
+  ssize_t accept;
+  int err;
+  int64_t took_us;
+} _test_ssock_step_t;
+
+static _test_ssock_step_t _test_ssock_steps[_TEST_SSOCK_STEPS_MAX];
+static int _test_ssock_nsteps;
+static int _test_ssock_calls;
+static uint8_t _test_ssock_sink[_TEST_SSOCK_SINK_LEN];
+static size_t _test_ssock_sinklen;
+
+ssize_t __wrap_sendmsg(int sockfd, const struct msghdr *msg, int flags);
+
+static int _test_ssock_partial(void);
+static int _test_ssock_empty(void);
+static int _test_ssock_error(void);
+static int _test_ssock_tmout(void);
+static int _test_ssock_frames(void);
+static int _test_ssock_latency(void);
+static int _test_ssock_json(void);
+static int _test_ssock_bench(void);
+static void _test_ssock_script(const _test_ssock_step_t *steps, int nsteps);
+
+int main(void)
+{
+  int failed = 0;
+
+  TEST_RUN(_test_ssock_partial);
+  TEST_RUN(_test_ssock_empty);
+  TEST_RUN(_test_ssock_error);
+  TEST_RUN(_test_ssock_tmout);
+  TEST_RUN(_test_ssock_frames);
+  TEST_RUN(_test_ssock_latency);
+  TEST_RUN(_test_ssock_json);
+  TEST_RUN(_test_ssock_bench);
+
+  return failed == 0 ? 0 : 1;
+}
+
+ssize_t __wrap_sendmsg(int sockfd, const struct msghdr *msg, int flags)
+{
+  _test_ssock_step_t step = { -1, 0, 0 };
+  ssize_t taken = 0;
+  size_t n;
+  size_t i;
+
+  if (_test_ssock_calls < _test_ssock_nsteps)
+  {
+    step = _test_ssock_steps[_test_ssock_calls];
+  }
+
+  _test_ssock_calls++;
+  shim_timer_offset = shim_timer_offset + step.took_us;
+
+  if (step.err != 0)
+  {
+    errno = step.err;
+    return -1;
+  }
+
+  for (i = 0; i < (size_t) msg->msg_iovlen && (step.accept < 0 || taken < step.accept); i++)
+  {
+    n = msg->msg_iov[i].iov_len;
+    n = (step.accept >= 0 && n > (size_t) (step.accept - taken)) ? (size_t) (step.accept - taken) : n;
+
+    if (_test_ssock_sinklen + n <= sizeof(_test_ssock_sink))
+    {
+      memcpy(_test_ssock_sink + _test_ssock_sinklen, msg->msg_iov[i].iov_base, n);
+    }
+
+    _test_ssock_sinklen = _test_ssock_sinklen + n;
+    taken = taken + n;
+  }
+
+  return taken;
+}
+
+static int _test_ssock_partial(void)
+{
+  static const _test_ssock_step_t steps[] = { { 7, 0, 0 }, { 100, 0, 0 }, { 0, EAGAIN, 0 } };
+  camwebsrv_ssock_stats_t stats;
+  uint8_t ring[64];
+  uint8_t frame[200];
+  struct iovec iov[3];
+  ssize_t sent;
+  size_t i;
+
+  for (i = 0; i < sizeof(ring); i++)
+  {
+    ring[i] = (uint8_t) i;
+  }
+
+  for (i = 0; i < sizeof(frame); i++)
+  {
+    frame[i] = (uint8_t) (i + 100);
+  }
+
+  // the ring's two halves, then the frame, the way node_flush() lays them
+  // out; the socket takes 7, then 100, then would block
+
+  iov[0].iov_base = ring + 40;
+  iov[0].iov_len = 24;
+  iov[1].iov_base = ring;
+  iov[1].iov_len = 10;
+  iov[2].iov_base = frame;
+  iov[2].iov_len = sizeof(frame);
+
+  camwebsrv_ssock_init(&stats);
+  _test_ssock_script(steps, 3);
+
+  sent = camwebsrv_ssock_send(&stats, 3, iov, 3);
+
+  TEST_CHECK(sent == 107);
+  TEST_CHECK(_test_ssock_calls == 3);
+  TEST_CHECK(stats.bsent == 107);
+  TEST_CHECK(stats.eagain == 1);
+  TEST_CHECK(_test_ssock_sinklen == 107);
+  TEST_CHECK(memcmp(_test_ssock_sink, ring + 40, 24) == 0);
+  TEST_CHECK(memcmp(_test_ssock_sink + 24, ring, 10) == 0);
+  TEST_CHECK(memcmp(_test_ssock_sink + 34, frame, 73) == 0);
+
+  // the segment it stopped in was trimmed to what didn't go
+
+  TEST_CHECK(iov[2].iov_base == frame + 73 && iov[2].iov_len == sizeof(frame) - 73);
+
+  // the rest goes next time, and blocking once is still once
+
+  _test_ssock_script(NULL, 0);
+
+  sent = camwebsrv_ssock_send(&stats, 3, iov + 2, 1);
+
+  TEST_CHECK(sent == (ssize_t) sizeof(frame) - 73);
+  TEST_CHECK(_test_ssock_calls == 1);
+  TEST_CHECK(stats.bsent == 34 + sizeof(frame));
+  TEST_CHECK(stats.eagain == 1);
+  TEST_CHECK(memcmp(_test_ssock_sink, frame + 73, sizeof(frame) - 73) == 0);
+
+  return 0;
+}
+
+static int _test_ssock_empty(void)
+{
+  camwebsrv_ssock_stats_t stats;
+  struct iovec iov[3];
+
+  memset(iov, 0x00, sizeof(iov));
+
+  // nothing queued, nothing asked of the socket
+
+  camwebsrv_ssock_init(&stats);
+  _test_ssock_script(NULL, 0);
+
+  TEST_CHECK(camwebsrv_ssock_send(&stats, 3, iov, 3) == 0);
+  TEST_CHECK(_test_ssock_calls == 0);
+  TEST_CHECK(stats.bsent == 0 && stats.eagain == 0);
+
+  return 0;
+}
+
+static int _test_ssock_error(void)
+{
+  static const _test_ssock_step_t steps[] = { { 5, 0, 0 }, { 0, ECONNRESET, 0 } };
+  camwebsrv_ssock_stats_t stats;
+  uint8_t buf[32];
+  struct iovec iov[1];
+
+  memset(buf, 0x55, sizeof(buf));
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = sizeof(buf);
+
+  // a socket error is an error, not a short send; eagain stays put
+
+  camwebsrv_ssock_init(&stats);
+  _test_ssock_script(steps, 2);
+
+  TEST_CHECK(camwebsrv_ssock_send(&stats, 3, iov, 1) < 0);
+  TEST_CHECK(stats.eagain == 0);
+
+  return 0;
+}
+
+static int _test_ssock_tmout(void)
+{
+  static const _test_ssock_step_t steps[] =
+  {
+    { 1, 0, 300000 }, { 1, 0, 300000 }, { 1, 0, 300000 }, { 1, 0, 300000 },
+    { 1, 0, 300000 }, { 1, 0, 300000 }, { 1, 0, 300000 }, { 1, 0, 300000 }
+  };
+  camwebsrv_ssock_stats_t stats;
+  uint8_t buf[32];
+  struct iovec iov[1];
+  int calls;
+
+  memset(buf, 0xaa, sizeof(buf));
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = sizeof(buf);
+
+  // a socket that trickles a byte per call, slowly, is given up on once
+  // CAMWEBSRV_SCLIENTS_SEND_TMOUT has gone by, and all of that time is
+  // counted as spent in send
+
+  calls = (CAMWEBSRV_SCLIENTS_SEND_TMOUT / 300) + 1;
+
+  TEST_CHECK(calls < 8);
+
+  camwebsrv_ssock_init(&stats);
+  _test_ssock_script(steps, 8);
+
+  TEST_CHECK(camwebsrv_ssock_send(&stats, 3, iov, 1) == calls);
+  TEST_CHECK(_test_ssock_calls == calls);
+  TEST_CHECK(stats.bsent == (uint64_t) calls);
+  TEST_CHECK(stats.tsend >= (uint64_t) calls * 300000);
+  TEST_CHECK(stats.tsend < (uint64_t) calls * 300000 + 100000);
+  TEST_CHECK(stats.eagain == 0);
+
+  return 0;
+}
+
+static int _test_ssock_frames(void)
+{
+  camwebsrv_ssock_stats_t stats;
+
+  camwebsrv_ssock_init(&stats);
+
+  // the first frame skips nothing, however far into the stream it is
+
+  camwebsrv_ssock_frame(&stats, 0, 40);
+  TEST_CHECK(stats.fsent == 1 && stats.fdropped == 0);
+
+  camwebsrv_ssock_frame(&stats, 40, 41);
+  TEST_CHECK(stats.fsent == 2 && stats.fdropped == 0);
+
+  camwebsrv_ssock_frame(&stats, 41, 45);
+  TEST_CHECK(stats.fsent == 3 && stats.fdropped == 3);
+
+  // a gap across the sequence number wrapping around counts the same
+
+  camwebsrv_ssock_frame(&stats, UINT32_MAX - 1, 1);
+  TEST_CHECK(stats.fsent == 4 && stats.fdropped == 5);
+
+  return 0;
+}
+
+static int _test_ssock_latency(void)
+{
+  camwebsrv_ssock_stats_t stats;
+  uint32_t total;
+  uint8_t i;
+
+  camwebsrv_ssock_init(&stats);
+
+  // either side of each bucket's bound, in us
+
+  camwebsrv_ssock_latency(&stats, 9999);
+  TEST_CHECK(stats.latavg == 9999 && stats.latmax == 9999);
+
+  camwebsrv_ssock_latency(&stats, 10000);
+  camwebsrv_ssock_latency(&stats, 19999);
+  camwebsrv_ssock_latency(&stats, 999999);
+  camwebsrv_ssock_latency(&stats, 1000000);
+
+  TEST_CHECK(stats.lathist[0] == 1);
+  TEST_CHECK(stats.lathist[1] == 2);
+  TEST_CHECK(stats.lathist[6] == 1);
+  TEST_CHECK(stats.lathist[7] == 1);
+  TEST_CHECK(stats.latmax == 1000000);
+
+  // a clock that went backwards is no latency at all, and one too big to
+  // count is pinned
+
+  camwebsrv_ssock_latency(&stats, -5);
+  TEST_CHECK(stats.lathist[0] == 2);
+
+  camwebsrv_ssock_latency(&stats, (int64_t) UINT32_MAX * 4);
+  TEST_CHECK(stats.lathist[7] == 2);
+  TEST_CHECK(stats.latmax == UINT32_MAX);
+
+  for (i = 0, total = 0; i < CAMWEBSRV_SSOCK_LAT_BUCKETS; i++)
+  {
+    total = total + stats.lathist[i];
+  }
+
+  TEST_CHECK(total == 7);
+
+  return 0;
+}
+
+static int _test_ssock_json(void)
+{
+  static const char *expected =
+    "      \"bytes_sent\": 5000000000,\n"
+    "      \"frames_sent\": 12,\n"
+    "      \"frames_skipped\": 3,\n"
+    "      \"eagain\": 2,\n"
+    "      \"send_us\": 4500,\n"
+    "      \"latency_avg_us\": 15000,\n"
+    "      \"latency_max_us\": 60000,\n"
+    "      \"latency_hist_ms\": {\"10\": 1, \"20\": 2, \"50\": 3, \"100\": 4, \"200\": 5, \"500\": 6, \"1000\": 7, \"inf\": 8}";
+  camwebsrv_ssock_stats_t stats;
+  camwebsrv_vbytes_t vb;
+  const uint8_t *bytes;
+  size_t len;
+  uint8_t i;
+
+  camwebsrv_ssock_init(&stats);
+
+  stats.bsent = 5000000000ULL;
+  stats.fsent = 12;
+  stats.fdropped = 3;
+  stats.eagain = 2;
+  stats.tsend = 4500;
+  stats.latavg = 15000;
+  stats.latmax = 60000;
+
+  for (i = 0; i < CAMWEBSRV_SSOCK_LAT_BUCKETS; i++)
+  {
+    stats.lathist[i] = i + 1;
+  }
+
+  TEST_CHECK(camwebsrv_vbytes_init(&vb) == ESP_OK);
+  TEST_CHECK(camwebsrv_ssock_json(&stats, vb) == ESP_OK);
+  TEST_CHECK(camwebsrv_vbytes_get_bytes(vb, &bytes, &len) == ESP_OK);
+  TEST_CHECK(len == strlen(expected));
+  TEST_CHECK(memcmp(bytes, expected, len) == 0);
+
+  TEST_CHECK(camwebsrv_ssock_json(NULL, vb) == ESP_ERR_INVALID_ARG);
+
+  camwebsrv_vbytes_destroy(&vb);
+
+  return 0;
+}
+
+static int _test_ssock_bench(void)
+{
+  camwebsrv_ssock_stats_t stats;
+  uint8_t buf[1460];
+  struct iovec iov[1];
+  int64_t t0;
+  int64_t t1;
+  int64_t t2;
+  int r;
+
+  memset(buf, 0x00, sizeof(buf));
+
+  // what the counters cost the streaming task: a send to a socket that
+  // takes everything, where the socket itself costs next to nothing, and
+  // filing a latency
+
+  camwebsrv_ssock_init(&stats);
+  _test_ssock_script(NULL, 0);
+
+  t0 = test_now_us();
+
+  for (r = 0; r < _TEST_SSOCK_BENCH_ROUNDS; r++)
+  {
+    iov[0].iov_base = buf;
+    iov[0].iov_len = sizeof(buf);
+    _test_ssock_sinklen = 0;
+    camwebsrv_ssock_send(&stats, 3, iov, 1);
+  }
+
+  t1 = test_now_us();
+
+  for (r = 0; r < _TEST_SSOCK_BENCH_ROUNDS; r++)
+  {
+    camwebsrv_ssock_latency(&stats, (r * 7919) % 2000000);
+  }
+
+  t2 = test_now_us();
+
+  TEST_CHECK(stats.bsent == (uint64_t) _TEST_SSOCK_BENCH_ROUNDS * sizeof(buf));
+
+  printf("ssock: %d sends in %lld us (%.1f ns each), %d latencies in %lld us (%.1f ns each)\n",
+    _TEST_SSOCK_BENCH_ROUNDS,
+    (long long) (t1 - t0),
+    (double) (t1 - t0) * 1000.0 / _TEST_SSOCK_BENCH_ROUNDS,
+    _TEST_SSOCK_BENCH_ROUNDS,
+    (long long) (t2 - t1),
+    (double) (t2 - t1) * 1000.0 / _TEST_SSOCK_BENCH_ROUNDS);
+
+  return 0;
+}
+
+static void _test_ssock_script(const _test_ssock_step_t *steps, int nsteps)
+{
+  if (nsteps > 0)
+  {
+    memcpy(_test_ssock_steps, steps, nsteps * sizeof(_test_ssock_step_t));
+  }
+
+  _test_ssock_nsteps = nsteps;
+  _test_ssock_calls = 0;
+  _test_ssock_sinklen = 0;
+}
@@ -0,0 +1,354 @@
+// 2026-10-16 test_syncgen.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+// a model of the master's capture loop in seqcap.c, run against simulated
+// sd write latencies. syncgen.c and the writer task need the hardware, so
+// they are modelled here as they behave:
+//
+//   - pulses go out every period, timed by the ledc, and are stamped by the
+//     edge isr a few us late
+//   - camwebsrv_syncgen_wait() takes a binary semaphore, so pulses that come
+//     and go while the master is busy leave only the last one behind
+//   - seqcap_frame_after() gets the first frame exposed after the pulse
+//   - seqcap_writer_push() blocks while CAMWEBSRV_SEQCAP_QUEUE_LEN frames
+//     are still waiting for the writer, which writes them in order
+//
+// the old loop, which made its own pulses and wrote each frame before
+// making the next, is modelled alongside for comparison
+
+#define _TEST_SYNCGEN_FPS 10
+#define _TEST_SYNCGEN_PERIOD (1000000 / _TEST_SYNCGEN_FPS)
+#define _TEST_SYNCGEN_SENSOR (1000000 / 25)
+#define _TEST_SYNCGEN_JITTER 15
+#define _TEST_SYNCGEN_FRAMES 300
+
+typedef struct
+{
+  const char *name;
+  int64_t write_us;
+  int64_t spread_us;
+  int stall_every;
+  int64_t stall_us;
+} _test_syncgen_trace_t;
+
+typedef struct
+{
+  uint32_t pulse;
+  int64_t pulse_us;
+  int64_t frame_us;
+} _test_syncgen_rec_t;
+
+typedef struct
+{
+  int count;
+  uint32_t missed;
+  int64_t err_max;
+  double fps;
+} _test_syncgen_stats_t;
+
+static const _test_syncgen_trace_t _test_syncgen_traces[] =
+{
+  { "fast", 40000, 20000, 0, 0 },
+  { "hiccups", 60000, 20000, 50, 150000 },
+  { "stalls", 60000, 20000, 50, 400000 },
+  { "slow", 130000, 30000, 0, 0 }
+};
+
+static int _test_syncgen_fast(void);
+static int _test_syncgen_stalls(void);
+static int _test_syncgen_slow(void);
+static int _test_syncgen_compare(void);
+static int _test_syncgen_hw(const _test_syncgen_trace_t *trace, _test_syncgen_rec_t *recs, _test_syncgen_stats_t *stats);
+static int _test_syncgen_sw(const _test_syncgen_trace_t *trace, _test_syncgen_rec_t *recs, _test_syncgen_stats_t *stats);
+static void _test_syncgen_stats(const _test_syncgen_rec_t *recs, int count, _test_syncgen_stats_t *stats);
+static int64_t _test_syncgen_pulse(uint32_t number);
+static int64_t _test_syncgen_frame(int64_t after);
+static int64_t _test_syncgen_write(const _test_syncgen_trace_t *trace, int i);
+static uint32_t _test_syncgen_rand(uint32_t x);
+
+int main(void)
+{
+  int failed = 0;
+
+  TEST_RUN(_test_syncgen_fast);
+  TEST_RUN(_test_syncgen_stalls);
+  TEST_RUN(_test_syncgen_slow);
+  TEST_RUN(_test_syncgen_compare);
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_syncgen_fast(void)
+{
+  _test_syncgen_rec_t recs[_TEST_SYNCGEN_FRAMES];
+  _test_syncgen_stats_t stats;
+
+  // the card keeps up, so every pulse gets its frame, on the period; the
+  // odd slow write is taken up by the queue
+
+  for (int n = 0; n < 2; n++)
+  {
+    TEST_CHECK(_test_syncgen_hw(&_test_syncgen_traces[n], recs, &stats) == 0);
+    TEST_CHECK(stats.count == _TEST_SYNCGEN_FRAMES);
+    TEST_CHECK(stats.missed == 0);
+    TEST_CHECK(stats.err_max <= _TEST_SYNCGEN_JITTER);
+
+    for (int i = 0; i < stats.count; i++)
+    {
+      TEST_CHECK(recs[i].pulse == (uint32_t) (i + 1));
+      TEST_CHECK(recs[i].frame_us >= recs[i].pulse_us);
+      TEST_CHECK(recs[i].frame_us - recs[i].pulse_us < _TEST_SYNCGEN_SENSOR);
+    }
+  }
+
+  return 0;
+}
+
+static int _test_syncgen_stalls(void)
+{
+  _test_syncgen_rec_t recs[_TEST_SYNCGEN_FRAMES];
+  _test_syncgen_stats_t stats;
+
+  // a write that takes a few periods can cost pulses, but the ones that
+  // are answered stay on the grid, and the gaps are all accounted for
+
+  TEST_CHECK(_test_syncgen_hw(&_test_syncgen_traces[2], recs, &stats) == 0);
+  TEST_CHECK(stats.missed > 0);
+  TEST_CHECK(stats.err_max <= _TEST_SYNCGEN_JITTER);
+  TEST_CHECK((uint32_t) stats.count + stats.missed == recs[stats.count - 1].pulse - recs[0].pulse + 1);
+  TEST_CHECK(recs[stats.count - 1].pulse == _TEST_SYNCGEN_FRAMES);
+
+  return 0;
+}
+
+static int _test_syncgen_slow(void)
+{
+  _test_syncgen_rec_t recs[_TEST_SYNCGEN_FRAMES];
+  _test_syncgen_stats_t stats;
+
+  // a card slower than the period throttles the rate, not the period
+
+  TEST_CHECK(_test_syncgen_hw(&_test_syncgen_traces[3], recs, &stats) == 0);
+  TEST_CHECK(stats.missed > 0);
+  TEST_CHECK(stats.err_max <= _TEST_SYNCGEN_JITTER);
+  TEST_CHECK(stats.fps < _TEST_SYNCGEN_FPS);
+  TEST_CHECK(stats.fps > 1000000.0 / (double) (_test_syncgen_traces[3].write_us + _test_syncgen_traces[3].spread_us) - 1.0);
+
+  for (int i = 1; i < stats.count; i++)
+  {
+    TEST_CHECK(recs[i].pulse > recs[i - 1].pulse);
+  }
+
+  return 0;
+}
+
+static int _test_syncgen_compare(void)
+{
+  _test_syncgen_rec_t recs[_TEST_SYNCGEN_FRAMES];
+  _test_syncgen_stats_t hw;
+  _test_syncgen_stats_t sw;
+
+  printf("syncgen: %d fps, queue %d, %d frames\n", _TEST_SYNCGEN_FPS, CAMWEBSRV_SEQCAP_QUEUE_LEN, _TEST_SYNCGEN_FRAMES);
+
+  for (size_t i = 0; i < sizeof(_test_syncgen_traces) / sizeof(_test_syncgen_traces[0]); i++)
+  {
+    TEST_CHECK(_test_syncgen_hw(&_test_syncgen_traces[i], recs, &hw) == 0);
+    TEST_CHECK(_test_syncgen_sw(&_test_syncgen_traces[i], recs, &sw) == 0);
+
+    printf("  %-8s ledc: %3d frames, %3" PRIu32 " missed, off by %6" PRId64 " us, %5.2f fps; by hand: off by %6" PRId64 " us, %5.2f fps\n",
+      _test_syncgen_traces[i].name,
+      hw.count,
+      hw.missed,
+      hw.err_max,
+      hw.fps,
+      sw.err_max,
+      sw.fps);
+
+    // writing before the next pulse puts the write time in the period
+
+    TEST_CHECK(sw.err_max > hw.err_max);
+  }
+
+  return 0;
+}
+
+static int _test_syncgen_hw(const _test_syncgen_trace_t *trace, _test_syncgen_rec_t *recs, _test_syncgen_stats_t *stats)
+{
+  int64_t start[_TEST_SYNCGEN_FRAMES];
+  int64_t done;
+  int64_t t;
+  uint32_t taken;
+  uint32_t number;
+  int count;
+
+  t = 0;
+  done = 0;
+  taken = 0;
+  count = 0;
+
+  while (count < _TEST_SYNCGEN_FRAMES)
+  {
+    // camwebsrv_syncgen_wait(): the latest pulse given since the last
+    // take, or else the next one
+
+    number = taken;
+
+    while (_test_syncgen_pulse(number + 1) <= t)
+    {
+      number++;
+    }
+
+    if (number == taken)
+    {
+      number = taken + 1;
+      t = _test_syncgen_pulse(number);
+    }
+
+    taken = number;
+
+    if (number > _TEST_SYNCGEN_FRAMES)
+    {
+      break;
+    }
+
+    recs[count].pulse = number;
+    recs[count].pulse_us = _test_syncgen_pulse(number);
+    recs[count].frame_us = _test_syncgen_frame(recs[count].pulse_us);
+
+    // seqcap_frame_after(): the frame is there once it has been read out
+
+    t = recs[count].frame_us + _TEST_SYNCGEN_SENSOR > t ? recs[count].frame_us + _TEST_SYNCGEN_SENSOR : t;
+
+    // seqcap_writer_push(): waits for the writer to take the frame that
+    // is CAMWEBSRV_SEQCAP_QUEUE_LEN ahead of this one off the queue
+
+    if (count >= CAMWEBSRV_SEQCAP_QUEUE_LEN && start[count - CAMWEBSRV_SEQCAP_QUEUE_LEN] > t)
+    {
+      t = start[count - CAMWEBSRV_SEQCAP_QUEUE_LEN];
+    }
+
+    // the writer starts on it once it is done with the one before
+
+    start[count] = done > t ? done : t;
+    done = start[count] + _test_syncgen_write(trace, count);
+
+    count++;
+
+    if (number == _TEST_SYNCGEN_FRAMES)
+    {
+      break;
+    }
+  }
+
+  _test_syncgen_stats(recs, count, stats);
+
+  return count > 0 ? 0 : 1;
+}
+
+static int _test_syncgen_sw(const _test_syncgen_trace_t *trace, _test_syncgen_rec_t *recs, _test_syncgen_stats_t *stats)
+{
+  int64_t t;
+  int64_t delay;
+
+  // the delay was tuned by hand so that the period came out right with
+  // the card at its usual speed, and the frame half a frame away
+
+  delay = _TEST_SYNCGEN_PERIOD - (_TEST_SYNCGEN_SENSOR * 3 / 2) - trace->write_us;
+  delay = delay > 0 ? delay : 0;
+
+  t = _test_syncgen_pulse(1);
+
+  for (int i = 0; i < _TEST_SYNCGEN_FRAMES; i++)
+  {
+    recs[i].pulse = (uint32_t) (i + 1);
+    recs[i].pulse_us = t;
+    recs[i].frame_us = _test_syncgen_frame(t);
+
+    t = recs[i].frame_us + _TEST_SYNCGEN_SENSOR;
+    t = t > recs[i].pulse_us + CAMWEBSRV_SEQCAP_SYNC_PULSE_US ? t : recs[i].pulse_us + CAMWEBSRV_SEQCAP_SYNC_PULSE_US;
+    t += _test_syncgen_write(trace, i) + delay;
+  }
+
+  _test_syncgen_stats(recs, _TEST_SYNCGEN_FRAMES, stats);
+
+  return 0;
+}
+
+static void _test_syncgen_stats(const _test_syncgen_rec_t *recs, int count, _test_syncgen_stats_t *stats)
+{
+  int64_t elapsed;
+
+  // as write_sync_manifest() works them out
+
+  memset(stats, 0x00, sizeof(*stats));
+
+  stats->count = count;
+
+  for (int i = 1; i < count; i++)
+  {
+    uint32_t dn = recs[i].pulse - recs[i - 1].pulse;
+    int64_t err = (recs[i].pulse_us - recs[i - 1].pulse_us) - (int64_t) dn * _TEST_SYNCGEN_PERIOD;
+
+    err = err < 0 ? -err : err;
+    stats->err_max = err > stats->err_max ? err : stats->err_max;
+    stats->missed += dn - 1;
+  }
+
+  elapsed = count > 1 ? recs[count - 1].pulse_us - recs[0].pulse_us : 0;
+  stats->fps = elapsed > 0 ? (double) (count - 1) * 1000000.0 / (double) elapsed : 0.0;
+}
+
+static int64_t _test_syncgen_pulse(uint32_t number)
+{
+  // the ledc edge is exact; the isr stamps it up to _TEST_SYNCGEN_JITTER
+  // later
+
+  return (int64_t) number * _TEST_SYNCGEN_PERIOD + (int64_t) (_test_syncgen_rand(number) % (_TEST_SYNCGEN_JITTER + 1));
+}
+
+static int64_t _test_syncgen_frame(int64_t after)
+{
+  // the master's sensor runs free, a third of a frame out of phase with
+  // the pulses
+
+  int64_t phase = _TEST_SYNCGEN_SENSOR / 3;
+
+  return phase + (((after - phase) + _TEST_SYNCGEN_SENSOR - 1) / _TEST_SYNCGEN_SENSOR) * _TEST_SYNCGEN_SENSOR;
+}
+
+static int64_t _test_syncgen_write(const _test_syncgen_trace_t *trace, int i)
+{
+  int64_t us;
+
+  // fat cluster allocation and card housekeeping show up as the odd write
+  // that takes much longer than the rest
+
+  us = trace->write_us - trace->spread_us / 2 + (int64_t) (_test_syncgen_rand(0x10000u + (uint32_t) i) % (uint32_t) (trace->spread_us + 1));
+
+  if (trace->stall_every > 0 && (i % trace->stall_every) == trace->stall_every - 1)
+  {
+    us += trace->stall_us;
+  }
+
+  return us;
+}
+
+static uint32_t _test_syncgen_rand(uint32_t x)
+{
+  // the same traces every run
+
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+
+  return x;
+}
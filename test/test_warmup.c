@@ -0,0 +1,190 @@
+// 2026-10-16 test_warmup.c
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "test.h"
+#include "config.h"
+#include "warmup.h"
+
+#include <stddef.h>
+
+// (exposure, gain) per frame, as read back from an ov2640 after a restart
+
+typedef struct
+{
+  uint32_t exposure;
+  uint32_t gain;
+} _test_warmup_sample_t;
+
+// restarted in a lit room: aec walks exposure and gain down from where the
+// defaults left them, overshoots a little, and settles
+
+static const _test_warmup_sample_t _test_warmup_trace_lit[] =
+{
+  { 1200, 30 }, { 900, 22 }, { 640, 15 }, { 480, 9 }, { 410, 6 },
+  { 402, 5 }, { 400, 5 }, { 401, 5 }, { 400, 5 }
+};
+
+// already settled, but a light flickers once and the gain chases it
+
+static const _test_warmup_sample_t _test_warmup_trace_flicker[] =
+{
+  { 400, 5 }, { 400, 5 }, { 400, 9 }, { 400, 5 }, { 400, 5 },
+  { 400, 5 }
+};
+
+// a dark room: exposure pinned at the top, gain still climbing
+
+static const _test_warmup_sample_t _test_warmup_trace_dark[] =
+{
+  { 1248, 4 }, { 1248, 8 }, { 1248, 16 }, { 1248, 32 }, { 1248, 48 },
+  { 1248, 60 }, { 1248, 63 }, { 1248, 63 }, { 1248, 63 }
+};
+
+static int _test_warmup_min(void);
+static int _test_warmup_traces(void);
+static int _test_warmup_tolerance(void);
+static int _test_warmup_saturate(void);
+static int _test_warmup_run(const _test_warmup_sample_t *trace, size_t count);
+
+int main(void)
+{
+  int failed = 0;
+
+  TEST_RUN(_test_warmup_min);
+  TEST_RUN(_test_warmup_traces);
+  TEST_RUN(_test_warmup_tolerance);
+  TEST_RUN(_test_warmup_saturate);
+
+  return failed == 0 ? 0 : 1;
+}
+
+static int _test_warmup_min(void)
+{
+  camwebsrv_warmup_t wu;
+  int i;
+
+  // identical readings still need CAMWEBSRV_WARMUP_MIN_FRAMES frames, and
+  // CAMWEBSRV_WARMUP_STABLE_FRAMES of them agreeing with the one before
+
+  camwebsrv_warmup_init(&wu);
+
+  for (i = 0; !camwebsrv_warmup_update(&wu, 400, 5); i++)
+  {
+    TEST_CHECK(i < 16);
+  }
+
+  TEST_CHECK(i + 1 == (CAMWEBSRV_WARMUP_MIN_FRAMES > CAMWEBSRV_WARMUP_STABLE_FRAMES + 1 ? CAMWEBSRV_WARMUP_MIN_FRAMES : CAMWEBSRV_WARMUP_STABLE_FRAMES + 1));
+  TEST_CHECK(wu.frames == i + 1);
+  TEST_CHECK(wu.stable == i);
+
+  // and without a state, there is nothing to wait for
+
+  TEST_CHECK(camwebsrv_warmup_update(NULL, 400, 5));
+
+  return 0;
+}
+
+static int _test_warmup_traces(void)
+{
+  // the index of the frame that ends the warmup in each; these assume the
+  // thresholds in config.h
+
+  TEST_CHECK(CAMWEBSRV_WARMUP_MIN_FRAMES == 2 && CAMWEBSRV_WARMUP_STABLE_FRAMES == 2);
+  TEST_CHECK(CAMWEBSRV_WARMUP_TOLERANCE_PCT == 4 && CAMWEBSRV_WARMUP_TOLERANCE_MIN == 2);
+
+  // 410 -> 402 is inside 4%, and 6 -> 5 inside the minimum of 2
+
+  TEST_CHECK(_test_warmup_run(_test_warmup_trace_lit, sizeof(_test_warmup_trace_lit) / sizeof(_test_warmup_trace_lit[0])) == 6);
+
+  // 5 -> 9 and back again both reset the run
+
+  TEST_CHECK(_test_warmup_run(_test_warmup_trace_flicker, sizeof(_test_warmup_trace_flicker) / sizeof(_test_warmup_trace_flicker[0])) == 5);
+
+  // 60 -> 63 is outside 4% of 63 and outside the minimum
+
+  TEST_CHECK(_test_warmup_run(_test_warmup_trace_dark, sizeof(_test_warmup_trace_dark) / sizeof(_test_warmup_trace_dark[0])) == 8);
+
+  // cut short before any of that, it never settles
+
+  TEST_CHECK(_test_warmup_run(_test_warmup_trace_lit, 5) == -1);
+
+  return 0;
+}
+
+static int _test_warmup_tolerance(void)
+{
+  camwebsrv_warmup_t wu;
+
+  // CAMWEBSRV_WARMUP_TOLERANCE_PCT of the larger reading, either way
+
+  camwebsrv_warmup_init(&wu);
+  camwebsrv_warmup_update(&wu, 1000, 100);
+  camwebsrv_warmup_update(&wu, 1040, 100);
+  TEST_CHECK(wu.stable == 1);
+  camwebsrv_warmup_update(&wu, 1000, 100);
+  TEST_CHECK(wu.stable == 2);
+  camwebsrv_warmup_update(&wu, 1050, 100);
+  TEST_CHECK(wu.stable == 0);
+
+  // the same for gain
+
+  camwebsrv_warmup_init(&wu);
+  camwebsrv_warmup_update(&wu, 1000, 100);
+  camwebsrv_warmup_update(&wu, 1000, 104);
+  TEST_CHECK(wu.stable == 1);
+  camwebsrv_warmup_update(&wu, 1000, 99);
+  TEST_CHECK(wu.stable == 0);
+
+  // near zero, CAMWEBSRV_WARMUP_TOLERANCE_MIN counts of jitter are let
+  // through, and no more
+
+  camwebsrv_warmup_init(&wu);
+  camwebsrv_warmup_update(&wu, 10, 0);
+  camwebsrv_warmup_update(&wu, 12, 2);
+  TEST_CHECK(wu.stable == 1);
+  camwebsrv_warmup_update(&wu, 15, 2);
+  TEST_CHECK(wu.stable == 0);
+  camwebsrv_warmup_update(&wu, 15, 5);
+  TEST_CHECK(wu.stable == 0);
+
+  return 0;
+}
+
+static int _test_warmup_saturate(void)
+{
+  camwebsrv_warmup_t wu;
+  int i;
+
+  // a long run pins the counters rather than wrapping them back to zero
+
+  camwebsrv_warmup_init(&wu);
+
+  for (i = 0; i < 1000; i++)
+  {
+    camwebsrv_warmup_update(&wu, 400, 5);
+  }
+
+  TEST_CHECK(wu.frames == UINT8_MAX);
+  TEST_CHECK(wu.stable == UINT8_MAX);
+  TEST_CHECK(camwebsrv_warmup_update(&wu, 401, 5));
+
+  return 0;
+}
+
+static int _test_warmup_run(const _test_warmup_sample_t *trace, size_t count)
+{
+  camwebsrv_warmup_t wu;
+  size_t i;
+
+  camwebsrv_warmup_init(&wu);
+
+  for (i = 0; i < count; i++)
+  {
+    if (camwebsrv_warmup_update(&wu, trace[i].exposure, trace[i].gain))
+    {
+      return (int) i;
+    }
+  }
+
+  return -1;
+}